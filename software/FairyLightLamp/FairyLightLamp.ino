@@ -6,6 +6,29 @@
 
    Revision
    01-04-2021 - initial version
+   16-10-2026 - one dimmer child per channel (fairy light string) of the PCB. The switch and the encoder operate all channels.
+   16-10-2026 - optionally advance the animations from a timer interrupt (ANIMATION_TIMER_ISR in config.h).
+   16-10-2026 - sleep between the events and report the duty cycle with the heart beat (LOW_POWER_SLEEP in config.h).
+   16-10-2026 - the switch is debounced from the pin change interrupt, Bounce2 is no longer needed.
+   16-10-2026 - animation scripts, started with V_VAR1 on a channel and uploaded through the script child (see config.h).
+   16-10-2026 - the messages to the gateway are sent from the loop by an outbox, without delay(). Acked and coalesced (see messageQueue.h).
+   16-10-2026 - the power state and brightness are kept in a wear leveled journal in the EEPROM and restored at boot (see stateJournal.h).
+   16-10-2026 - the encoder is decoded from the pin change interrupt of both pins, quick turns change the brightness in bigger steps.
+   16-10-2026 - optional statistics of the loop duration, sent with the heart beat and printed on request (LOOP_PROFILER in config.h).
+   16-10-2026 - optionally dither the PWM of the channels for a 12 bit duty cycle (PWM_DITHERING in config.h).
+   16-10-2026 - scenes, started on all lamps at the same moment of the controller time by one broadcast (see config.h).
+   16-10-2026 - the switch calls its handlers directly (StaticMultiClick), instead of through pointers with a copy of the switch.
+   16-10-2026 - all objects are placed statically, their RAM is checked against a budget at compile time. Optional report of
+                the RAM use and the stack high-water mark (MEMORY_REPORT in config.h).
+   16-10-2026 - ambient effects (candle, twinkle and breathe), a double click starts the next effect (see config.h).
+   16-10-2026 - sunrise and sunset fades of minutes, started now or at a controller second by the sun child (see config.h).
+   16-10-2026 - optional fast boot: the light is restored before the gateway is found, the presentation is sent from the loop
+                with random pacing and backoff (FAST_BOOT in config.h). before() also turns off the analog pins and the ADC.
+   16-10-2026 - optional battery level with the heart beat and a brightness cap on a low battery (BATTERY_MONITOR in config.h).
+   16-10-2026 - the timing of the fades, blinks and clicks, the highest brightness and the heart beat interval are parameters,
+                set through the parameters child and kept in the EEPROM (see config.h).
+   16-10-2026 - receive() posts the commands to an inbox, the loop applies them with a burst coalesced into the newest command
+                (see commandInbox.h). Optionally the radio is read from its interrupt (RADIO_RX_BUFFER in config.h).
 
    Future notes for myself - for a future project that uses a dimmer:
    - Handling Domoticz messages:
@@ -16,194 +39,717 @@
       send new brightness after user changes it.
 */
 
-#include <Bounce2.h>
-#include <Encoder.h>
-#include "ledAnimation.h"
+#include <avr/sleep.h>
+#include "ambientEffect.h"
+#include "animationManager.h"
+#include "animationScheduler.h"
+#include "batteryMonitor.h"
+#include "commandInbox.h"
+#include "controllerClock.h"
+#include "ditheredPwm.h"
+#include "loopProfiler.h"
+#include "memoryReport.h"
+#include "messageQueue.h"
 #include "multiClick.h"
+#include "parameterBlock.h"
+#include "pinChangeInterrupt.h"
+#include "quadratureEncoder.h"
+#include "randomBackoff.h"
+#include "sleepScheduler.h"
+#include "stateJournal.h"
 #include "config.h"
 
 const uint8_t POWER_SWITCH_PIN = 7; // Interupt pin so the sketch can wake up
-const uint8_t LEDSTRING_PIN = 5; // Interupt pin so the sketch can wake up
-const uint8_t ENCODER_FIRST_PIN = 2; // The first pin of the encoder, we use an interrupt pin for faster reading
-const uint8_t ENCODER_SECOND_PIN = 4; // The second pin of the encoder, no more interrups left, but we should be able to wake up with just one
+constexpr uint8_t LEDSTRING_PINS[ LIGHT_CHANNELS ] = { 5, 6, 3 }; // The PWM pins of the channels. 9, 10 and 11 are used by the radio
+const uint8_t ENCODER_FIRST_PIN = 2; // The first pin of the encoder, both pins are watched through the pin change interrupt
+const uint8_t ENCODER_SECOND_PIN = 4; // The second pin of the encoder, on the same port as the first pin
 const uint8_t ENCODER_INCREMENTS = 4; // the amount of increments per encoder position
+const uint8_t PIN_CHANGE_WAKE_UP = 2; // Reported by MySensors as the interrupt that woke up the node, when it was the switch or the encoder
+#ifdef RADIO_RX_BUFFER
+static_assert( ( MY_RF24_IRQ_PIN == 2 || MY_RF24_IRQ_PIN == 3 ) && MY_RF24_IRQ_PIN != ENCODER_FIRST_PIN && MY_RF24_IRQ_PIN != ENCODER_SECOND_PIN &&
+               MY_RF24_IRQ_PIN != POWER_SWITCH_PIN, "The IRQ pin of the radio must be a free external interrupt pin, see RADIO_RX_BUFFER in config.h" );
+// Each channel pin, up to the 4 channels of the journal record (see config.h)
+static_assert( ( LIGHT_CHANNELS < 1 || LEDSTRING_PINS[ 0 ] != MY_RF24_IRQ_PIN ) && ( LIGHT_CHANNELS < 2 || LEDSTRING_PINS[ 1 ] != MY_RF24_IRQ_PIN ) &&
+               ( LIGHT_CHANNELS < 3 || LEDSTRING_PINS[ 2 ] != MY_RF24_IRQ_PIN ) && ( LIGHT_CHANNELS < 4 || LEDSTRING_PINS[ 3 ] != MY_RF24_IRQ_PIN ),
+               "The IRQ pin of the radio is the PWM pin of a channel, see RADIO_RX_BUFFER in config.h" );
+#endif
 
 // Hardware definitions
-Encoder *encoder; // encoder( ENCODER_FIRST_PIN, ENCODER_SECOND_PIN );  // The rotary encoder
+QuadratureEncoder encoder( ENCODER_FIRST_PIN, ENCODER_SECOND_PIN, ENCODER_INCREMENTS );  // The rotary encoder
 
-SoftDebouncedMultiClick *powerSwitch; //( POWER_SWITCH_PIN );
+// The handlers of the power switch, called directly by the switch (see StaticMultiClick in multiClick.h)
+struct PowerSwitchHandler {
+  static void onKeyPress( KEY_SCAN_STATES type, uint8_t amount );
+  static void onKeyClick( KEY_SCAN_STATES type, uint8_t amount );
+};
+StaticMultiClick<PowerSwitchHandler> powerSwitch( POWER_SWITCH_PIN );
 
-AnimationManager animations( LEDSTRING_PIN  );
+AnimationScheduler<LIGHT_CHANNELS, ChannelPwmSink> animations( LEDSTRING_PINS );
 
 unsigned long currentMillis; // Used to pass the millis() value to different function so we don't have to call it too many times.
                               // that way we get shorter loop durations.
 unsigned long lastTimeHBSent;
 
+StateJournal journal( EEPROM_JOURNAL_ADDRESS, EEPROM_JOURNAL_SIZE, JOURNAL_SETTLE_TIME ); // The state of the lamp in the EEPROM
 
-// Initializing the sketch
-void setup() {
+LampParameters lampParameters = DEFAULT_PARAMETERS; // The tunable parameters, read from the EEPROM once at boot
+ParameterBlock parameterBlock( EEPROM_PARAMETERS_ADDRESS, PARAMETERS_VERSION, &lampParameters, sizeof( lampParameters ) );
+
+CommandInbox inbox; // The commands received from the gateway, applied from the loop
+
+#ifdef LOOP_PROFILER
+LoopProfiler profiler( PROFILE_STALL_THRESHOLD ); // Statistics of the duration of the loop passes
+#endif
+
+SleepScheduler sleepScheduler; // Determines how long the node can sleep and keeps track of the duty cycle
 
-  encoder = new Encoder( ENCODER_FIRST_PIN, ENCODER_SECOND_PIN );  // The rotary encoder
-  powerSwitch = new SoftDebouncedMultiClick( POWER_SWITCH_PIN );
+ControllerClock controllerClock; // The time of the controller, for starting the scenes at the same moment on all lamps
+bool          sceneWaiting = false; // true while a received scene waits for its start
+uint8_t       waitingScene;
+unsigned long sceneStartAt;      // millis() at which the waiting scene starts
+unsigned long lastSceneStart;    // The start (controller second) of the last scene that was received, to ignore its copies
+bool          sunFadeWaiting = false; // true while a received sunrise or sunset waits for its start
+bool          waitingSunrise;         // The waiting fade is a sunrise (true) or a sunset (false)
+uint8_t       sunFadeMinutes;         // The duration of the waiting fade
+unsigned long sunFadeStartAt;         // millis() at which the waiting fade starts
+unsigned long lastSunFadeStart;       // The start (controller second) of the last fade that was received, to ignore its copies
+uint8_t       sunsetChannels = 0;     // A bit per channel with a running sunset, the channel is turned off at the end
+unsigned long awakeSince; // micros() at the moment the node woke up
 
-  // Setup led output pin doesn't need a pinMode we're using pwm
-  turnLightsOff();
+// The steps of the presentation: the sketch info, the dimmers, the other children and the sync of each channel
+const uint8_t PRESENTATION_STEPS = 1 + LIGHT_CHANNELS + 6 + LIGHT_CHANNELS;
+#ifdef BATTERY_MONITOR
+uint16_t      batteryMillivolts; // The last sample of the battery
+uint8_t       brightnessCap = BATTERY_FULL_CAP; // The cap on the lightness of the brightness levels
+#endif
+#ifdef FAST_BOOT
+RandomBackoff bootSync( BOOT_SYNC_PACING, BOOT_SYNC_SPREAD, BOOT_SYNC_MAX_BACKOFF ); // Paces and retries the presentation
+uint8_t       presentationStep = PRESENTATION_STEPS; // The next step of the presentation, PRESENTATION_STEPS when it's done
+#endif
 
-  uint8_t storedBrightness = loadState( EEPROM_DIM_LEVEL_LAST );
-  lightBrightness = storedBrightness == 255 ? DimmerDefaultValue : storedBrightness;
-  oldEncoderPosition = lightBrightness * ENCODER_INCREMENTS;
+// The static RAM of the objects and variables of the sketch (and config.h), checked against the budget. On the node,
+// and on the host only in the RAM check build (FAIRYLIGHT_RAM_CHECK in host/CMakeLists.txt): the sizes of the other host
+// builds (64 bit pointers and longs) mean nothing.
+const uint16_t SKETCH_STATIC_RAM = sizeof( encoder ) + sizeof( powerSwitch ) + sizeof( animations ) + sizeof( journal ) +
+                                   sizeof( lampParameters ) + sizeof( parameterBlock ) + sizeof( inbox ) +
+#ifdef LOOP_PROFILER
+                                   sizeof( profiler ) +
+#endif
+                                   sizeof( sleepScheduler ) + sizeof( controllerClock ) + sizeof( outbox ) + sizeof( outboxMessages ) + sizeof( queuedMsg ) +
+                                   sizeof( powerState ) + sizeof( lightBrightness ) + sizeof( storedBrightness ) + sizeof( switchStateUpdated ) +
+                                   sizeof( currentMillis ) + sizeof( lastTimeHBSent ) + sizeof( sceneWaiting ) + sizeof( waitingScene ) +
+                                   sizeof( sceneStartAt ) + sizeof( lastSceneStart ) + sizeof( sunFadeWaiting ) + sizeof( waitingSunrise ) +
+                                   sizeof( sunFadeMinutes ) + sizeof( sunFadeStartAt ) + sizeof( lastSunFadeStart ) + sizeof( sunsetChannels ) +
+#ifdef BATTERY_MONITOR
+                                   sizeof( batteryMillivolts ) + sizeof( brightnessCap ) +
+#endif
+#ifdef FAST_BOOT
+                                   sizeof( bootSync ) + sizeof( presentationStep ) +
+#endif
+                                   sizeof( awakeSince );
+#if defined( ARDUINO ) || defined( SKETCH_RAM_CHECK )
+static_assert( SKETCH_STATIC_RAM <= MEMORY_SKETCH_BUDGET, "The sketch takes more static RAM than MEMORY_SKETCH_BUDGET (config.h)" );
+#endif
 
-  assignBrightnessLevelToEncoder();
 
-  powerSwitch->setKeyPressHandler( handlePowerSwitchPressed );
-  powerSwitch->setKeyClickHandler( handlePowerSwitchClicked );
+// Initializing the sketch
+void setup() {
 
-  lastTimeHBSent = millis() - HEART_BEAT_INTERVAL;
+  loadParameters(); // Before the restore, the brightness of the channels is limited by the parameters
+#ifdef BATTERY_MONITOR
+  checkBattery(); // Before the restore, so the channels that were on fade to the capped brightness
+#endif
+  // Setup led output pins doesn't need a pinMode we're using pwm, the dithered pins are set up when they're attached
+#ifdef PWM_DITHERING
+  for ( uint8_t channel = 0; channel < LIGHT_CHANNELS; channel++ ) {
+    ditheredPwmAttach( LEDSTRING_PINS[ channel ] );
+  }
+#endif
+  uint8_t state[ JOURNAL_PAYLOAD_SIZE ];
+  bool restored = journal.restore( state );
+  for ( uint8_t channel = 0; channel < LIGHT_CHANNELS; channel++ ) {
+    turnLightsOff( channel );
+
+    if ( restored ) {
+      // The channels that were on resume with their brightness, the others use the stored brightness when turned on
+      storedBrightness[ channel ] = validBrightness( state[ JOURNAL_STORED_BRIGHTNESS + channel ] );
+      lightBrightness[ channel ] = bitRead( state[ JOURNAL_POWER_STATE ], channel ) ?
+                                   validBrightness( state[ JOURNAL_BRIGHTNESS + channel ] ) : storedBrightness[ channel ];
+    }
+    else {
+      // A new node, or a node that stored its brightness with saveState() before the journal
+      storedBrightness[ channel ] = validBrightness( loadState( EEPROM_DIM_LEVEL_LAST + channel ) );
+      lightBrightness[ channel ] = storedBrightness[ channel ];
+    }
+  }
+  if ( restored ) {
+    for ( uint8_t channel = 0; channel < LIGHT_CHANNELS; channel++ ) {
+      uint8_t effect = ( state[ JOURNAL_EFFECTS ] >> ( channel * 2 ) ) & 0x03; // 0 (steady) in a record of before the effects
+      if ( effect != AMBIENT_STEADY ) {
+        setChannelEffect( channel, effect );
+      }
+      if ( bitRead( state[ JOURNAL_POWER_STATE ], channel ) ) {
+        setLightState( channel, true );
+        sendPowerstateToGateWay( channel );
+      }
+    }
+  }
+#ifdef ANIMATION_TIMER_ISR
+  animations.startFrameTimer( ANIMATION_FRAME_RATE );
+#endif
+#ifdef LOOP_PROFILER
+  frameTimerStartClock(); // Does nothing when the frame timer runs, which is the clock then
+#endif
+  lastTimeHBSent = millis() - getHeartBeatInterval();
+  awakeSince = micros();
+#ifdef FAST_BOOT
+  Serial.print( "Lamp restored at ms: " ); Serial.println( millis() );
+#endif
+#ifdef MEMORY_REPORT
+  printMemoryReport();
+#endif
 }
 
-// We only respond to a long press when the lamp is on so we can give the user feedback that he/she can release the switch.
-// We use the long press to store the current brightness. Which will always be used when turning the lamp manually on
-void handlePowerSwitchPressed( KEY_SCAN_STATES type, uint8_t amount, SoftDebouncedMultiClick source ) {
-  if ( type == KP_LONG_PRESS && powerState ) {
-    saveState( EEPROM_DIM_LEVEL_LAST, lightBrightness );
-    animations.startBoundaryReachedAnimation();
+// We only respond to a long press for the channels that are on so we can give the user feedback that he/she can release the switch.
+// We use the long press to store the current brightness. Which will be used when the lamp is turned on after a power out.
+// It's written to the EEPROM by the journal from the loop, not from here.
+void PowerSwitchHandler::onKeyPress( KEY_SCAN_STATES type, uint8_t amount ) {
+  if ( type == KP_LONG_PRESS ) {
+    for ( uint8_t channel = 0; channel < LIGHT_CHANNELS; channel++ ) {
+      if ( powerState[ channel ] ) {
+        storedBrightness[ channel ] = lightBrightness[ channel ];
+        animations.startBoundaryReachedAnimation( channel );
+      }
+    }
   }
 }
 
-// Handler for normal clicks. Regardless of the amount of clicks. We always toggle the power.
-// In the future we can implement double clicks and even tripple clicks to change the mode when
-// the lamp is on.
-void handlePowerSwitchClicked( KEY_SCAN_STATES type, uint8_t amount, SoftDebouncedMultiClick source ) {
+// Handler for normal clicks. When the lamp is on a single click turns it off, a double click starts the next ambient
+// effect and a tripple click (or more) turns the effects off. When the lamp is off, any amount of clicks turns it on.
+void PowerSwitchHandler::onKeyClick( KEY_SCAN_STATES type, uint8_t amount ) {
   if ( type == KP_SHORT_PRESS_SEQUENCE ) {
-    toggleLightState();
+    if ( amount == 1 || !isAnyChannelOn() ) {
+      toggleLightState();
+    }
+    else if ( amount == 2 ) {
+      startNextEffect();
+    }
+    else {
+      setEffectOfChannelsOn( AMBIENT_STEADY );
+    }
   }
 }
 
 void loop() {
   currentMillis = millis();
+#ifdef LOOP_PROFILER
+  unsigned long loopStartedAt = frameTimerMicros();
+#endif
 
-  if ( currentMillis - lastTimeHBSent >= HEART_BEAT_INTERVAL ) {
+  if ( currentMillis - lastTimeHBSent >= getHeartBeatInterval() && isTransportReady() ) { // With FAST_BOOT the first one waits for the gateway
     lastTimeHBSent = currentMillis;
     sendHeartbeat();
     Serial.println( "Heartbeat send" );    
+
+    uint16_t dutyCycle = sleepScheduler.getDutyCycle();
+    Serial.print( "Duty cycle (per mille): " ); Serial.println( dutyCycle );
+    sleepScheduler.resetDutyCycle();
+    sendNodeStats( dutyCycle );
+#ifdef BATTERY_MONITOR
+    checkBattery();
+#endif
+#ifdef LOOP_PROFILER
+    printLoopStats();
+    sendLoopStats();
+#endif
+#ifdef MEMORY_REPORT
+    printStackUnused();
+#endif
   }
   
-  animations.checkAnimation( currentMillis );
-  powerSwitch->checkSwitch( currentMillis );
+  PROFILED( PROFILE_RECEIVE, checkInbox() ); // Before the animations, so a new target is applied in this pass
+  PROFILED( PROFILE_ANIMATION, animations.checkAnimation( currentMillis ) );
+  PROFILED( PROFILE_SWITCH, powerSwitch.checkSwitch( currentMillis ) );
+
+  PROFILED( PROFILE_ENCODER, checkEncoder() );
 
-  checkEncoder();
+  checkScene();
+  checkSunFade();
+  checkPresentation();
+  if ( isTransportReady() ) { // With FAST_BOOT the loop runs before the gateway is found, the outbox waits for it
+    outbox.update( currentMillis );
+  }
+  journalLampState();
+  journal.update( currentMillis );
+  parameterBlock.update();
+
+#ifdef LOOP_PROFILER
+  profiler.addLoop( frameTimerMicros() - loopStartedAt );
+#endif
+#if defined( LOOP_PROFILER ) || defined( MEMORY_REPORT )
+  checkSerialCommands();
+#endif
+
+  sleepUntilNextEvent();
 }
 
 
+/*
+  Hands the current state of the lamp to the journal, which writes it to the EEPROM once it has settled.
+*/
+void journalLampState() {
+  uint8_t state[ JOURNAL_PAYLOAD_SIZE ] = { 0 };
+  for ( uint8_t channel = 0; channel < LIGHT_CHANNELS; channel++ ) {
+    bitWrite( state[ JOURNAL_POWER_STATE ], channel, powerState[ channel ] );
+    state[ JOURNAL_BRIGHTNESS + channel ] = lightBrightness[ channel ];
+    state[ JOURNAL_STORED_BRIGHTNESS + channel ] = storedBrightness[ channel ];
+    state[ JOURNAL_EFFECTS ] |= animations.getEffect( channel ) << ( channel * 2 );
+  }
+  journal.store( state, currentMillis );
+}
+
+/*
+  Queues the given duty cycle and the counters of the outbox and the inbox for the node stats child, and resets the
+  counters.
+*/
+void sendNodeStats( uint16_t dutyCycle ) {
+  Serial.print( "Messages sent: " ); Serial.print( outbox.getSentCount() );
+  Serial.print( ", coalesced: " ); Serial.print( outbox.getCoalescedCount() );
+  Serial.print( ", retried: " ); Serial.print( outbox.getRetriedCount() );
+  Serial.print( ", dropped: " ); Serial.println( outbox.getDroppedCount() );
+  Serial.print( "Commands coalesced: " ); Serial.print( inbox.getCoalescedCount() );
+  Serial.print( ", dropped: " ); Serial.println( inbox.getDroppedCount() );
+
+  outbox.post( CHILD_ID_NODE_STATS, V_VAR1, dutyCycle, false );
+  outbox.post( CHILD_ID_NODE_STATS, V_VAR2, outbox.getSentCount(), false );
+  outbox.post( CHILD_ID_NODE_STATS, V_VAR3, outbox.getCoalescedCount(), false );
+  outbox.post( CHILD_ID_NODE_STATS, V_VAR4, outbox.getRetriedCount(), false );
+  outbox.post( CHILD_ID_NODE_STATS, V_VAR5, outbox.getDroppedCount(), false );
+  outbox.post( CHILD_ID_NODE_STATS, V_CUSTOM, inbox.getDroppedCount() << 8 | inbox.getCoalescedCount(), false );
+  outbox.resetCounters();
+  inbox.resetCounters();
+}
+
+#ifdef LOOP_PROFILER
+/*
+  Prints the statistics of the loop since the last heart beat on the serial port.
+*/
+void printLoopStats() {
+  Serial.print( "Loop passes: " ); Serial.print( profiler.getLoopCount() );
+  Serial.print( ", min: " ); Serial.print( profiler.getMinLoop() );
+  Serial.print( "us, mean: " ); Serial.print( profiler.getMeanLoop() );
+  Serial.print( "us, max: " ); Serial.print( profiler.getMaxLoop() );
+  Serial.print( "us, stalls: " ); Serial.println( profiler.getStallCount() );
+
+  Serial.print( "Histogram (from 1, 2, 4 ... us):" );
+  for ( uint8_t bucket = 0; bucket < PROFILE_HISTOGRAM_BUCKETS; bucket++ ) {
+    Serial.print( ' ' ); Serial.print( profiler.getHistogram( bucket ) );
+  }
+  Serial.println();
+
+  Serial.print( "Share (per mille) animation: " ); Serial.print( profiler.getShare( PROFILE_ANIMATION ) );
+  Serial.print( ", switch: " ); Serial.print( profiler.getShare( PROFILE_SWITCH ) );
+  Serial.print( ", encoder: " ); Serial.print( profiler.getShare( PROFILE_ENCODER ) );
+  Serial.print( ", receive: " ); Serial.println( profiler.getShare( PROFILE_RECEIVE ) );
+}
+
+/*
+  Queues the statistics of the loop for the loop stats child, and resets them. The durations are capped at 32767us.
+  The shares are sent in percent, two per value: the first section in the high byte and the second in the low byte.
+*/
+void sendLoopStats() {
+  outbox.post( CHILD_ID_LOOP_STATS, V_VAR1, min( profiler.getMeanLoop(), 32767UL ), false );
+  outbox.post( CHILD_ID_LOOP_STATS, V_VAR2, min( profiler.getMaxLoop(), 32767UL ), false );
+  outbox.post( CHILD_ID_LOOP_STATS, V_VAR3, min( profiler.getStallCount(), 32767U ), false );
+  outbox.post( CHILD_ID_LOOP_STATS, V_VAR4, ( profiler.getShare( PROFILE_ANIMATION ) / 10 ) << 8 | profiler.getShare( PROFILE_SWITCH ) / 10, false );
+  outbox.post( CHILD_ID_LOOP_STATS, V_CUSTOM, ( profiler.getShare( PROFILE_ENCODER ) / 10 ) << 8 | profiler.getShare( PROFILE_RECEIVE ) / 10, false );
+  profiler.reset();
+}
+#endif
+
+#if defined( LOOP_PROFILER ) || defined( MEMORY_REPORT )
+/*
+  Handles a command sent on the serial port: PROFILE_DUMP_COMMAND prints the statistics of the loop,
+  MEMORY_REPORT_COMMAND the memory report.
+*/
+void checkSerialCommands() {
+  if ( Serial.available() > 0 ) {
+    char command = Serial.read();
+#ifdef LOOP_PROFILER
+    if ( command == PROFILE_DUMP_COMMAND ) {
+      printLoopStats();
+    }
+#endif
+#ifdef MEMORY_REPORT
+    if ( command == MEMORY_REPORT_COMMAND ) {
+      printMemoryReport();
+    }
+#endif
+  }
+}
+#endif
+
+#ifdef MEMORY_REPORT
+/*
+  Prints the size of a component of the sketch. The texts are kept in flash, so the report doesn't take RAM itself.
+*/
+void printComponentRam( const __FlashStringHelper *name, uint16_t size ) {
+  Serial.print( F( "  " ) ); Serial.print( name ); Serial.print( F( ": " ) ); Serial.println( size );
+}
+
+/*
+  Prints the static RAM of the components of the sketch, the static RAM in total and the use of the heap and the stack
+  on the serial port. The sizes of the components are known at compile time.
+*/
+void printMemoryReport() {
+  Serial.println( F( "Static RAM (bytes):" ) );
+  printComponentRam( F( "animations" ), sizeof( animations ) );
+  printComponentRam( F( "switch" ), sizeof( powerSwitch ) );
+  printComponentRam( F( "encoder" ), sizeof( encoder ) );
+  printComponentRam( F( "journal" ), sizeof( journal ) );
+  printComponentRam( F( "outbox" ), sizeof( outbox ) + sizeof( outboxMessages ) + sizeof( queuedMsg ) );
+  printComponentRam( F( "inbox" ), sizeof( inbox ) );
+  printComponentRam( F( "parameters" ), sizeof( lampParameters ) + sizeof( parameterBlock ) );
+  printComponentRam( F( "controller clock" ), sizeof( controllerClock ) );
+  printComponentRam( F( "sleep scheduler" ), sizeof( sleepScheduler ) );
+#ifdef FAST_BOOT
+  printComponentRam( F( "boot sync" ), sizeof( bootSync ) + sizeof( presentationStep ) );
+#endif
+#ifdef LOOP_PROFILER
+  printComponentRam( F( "loop profiler" ), sizeof( profiler ) );
+#endif
+  printComponentRam( F( "sketch in total" ), SKETCH_STATIC_RAM );
+  printComponentRam( F( "sketch budget" ), MEMORY_SKETCH_BUDGET );
+  printComponentRam( F( "with core and libraries" ), memoryStaticRam() );
+  Serial.print( F( "Heap: " ) ); Serial.print( memoryHeapUsed() );
+  Serial.print( F( ", free now: " ) ); Serial.println( memoryFreeRam() );
+  printStackUnused();
+}
+
+/*
+  Prints the part of the RAM the stack has never used since the boot, with a warning below MEMORY_STACK_MARGIN.
+*/
+void printStackUnused() {
+  uint16_t unused = memoryStackUnused();
+  Serial.print( F( "Stack never used: " ) ); Serial.print( unused );
+  Serial.println( unused < MEMORY_STACK_MARGIN ? F( " bytes, below the margin!" ) : F( " bytes" ) );
+}
+#endif
+
+
+#ifdef BATTERY_MONITOR
+/*                   The battery    */
+
+/*
+  Samples the battery and sends its level. The ADC converts in the noise reduction sleep when all channels are off, it
+  would freeze their PWM for a moment. With BATTERY_BRIGHTNESS_CAP the channels that are on and not animating fade to
+  the new cap when it changed, a running animation keeps the target it was started with.
+*/
+void checkBattery() {
+  batteryMillivolts = batteryReadMillivolts( BATTERY_BANDGAP_MILLIVOLTS, !isAnyChannelOn() );
+  Serial.print( "Battery (mV): " ); Serial.println( batteryMillivolts );
+  if ( isTransportReady() ) { // At the boot with FAST_BOOT the level is sent with the first heart beat
+    sendBatteryLevel( batteryPercentage( batteryMillivolts, BATTERY_EMPTY_MILLIVOLTS, BATTERY_FULL_MILLIVOLTS ) );
+  }
+
+#ifdef BATTERY_BRIGHTNESS_CAP
+  uint8_t cap = batteryBrightnessCap( batteryMillivolts, BATTERY_CAP_FROM_MILLIVOLTS, BATTERY_EMPTY_MILLIVOLTS, BATTERY_MINIMUM_CAP );
+  bool rises = cap >= brightnessCap + BATTERY_CAP_HYSTERESIS || ( cap == BATTERY_FULL_CAP && cap != brightnessCap );
+  if ( cap < brightnessCap || rises ) {
+    brightnessCap = cap;
+    for ( uint8_t channel = 0; channel < LIGHT_CHANNELS; channel++ ) {
+      if ( powerState[ channel ] && animations.animationFinished( channel ) ) {
+        turnLightsOn( channel );
+      }
+    }
+  }
+#endif
+}
+#endif
+
+
+/*                   Sleeping between the events    */
+
+/*
+  Puts the node to sleep until the next event. The node can only power down when all channels are off, no animation
+  is running, the switch is idle, all messages have been sent, the state has been written and the next heart beat is
+  far enough away (and LOW_POWER_SLEEP is defined). Otherwise it sleeps in idle mode, where the next interrupt wakes it
+  up. That is at the latest the 1ms tick of millis().
+*/
+void sleepUntilNextEvent() {
+  sleepScheduler.startPass( currentMillis );
+  sleepScheduler.wakeUpAt( lastTimeHBSent + getHeartBeatInterval() );
+  if ( sceneWaiting ) {
+    sleepScheduler.wakeUpAt( sceneStartAt );
+  }
+  if ( sunFadeWaiting ) {
+    sleepScheduler.wakeUpAt( sunFadeStartAt );
+  }
+  unsigned long nextFadeStep = animations.getNextChange( currentMillis );
+  if ( nextFadeStep != LONG_FADE_NO_CHANGE ) {
+    sleepScheduler.wakeUpAt( currentMillis + nextFadeStep ); // A long fade does nothing until its next step
+  }
+  if ( isAnyChannelOn() || !animations.animationFinished() || !powerSwitch.isIdle( currentMillis ) ||
+       !outbox.isIdle() || !journal.isIdle() || !parameterBlock.isIdle() ) {
+    sleepScheduler.preventPowerDown(); // The PWM, the timing of the animations and clicks, the outbox and the EEPROM writes need the clocks
+  }
+#ifdef FAST_BOOT
+  if ( bootSync.isRunning() ) {
+    sleepScheduler.wakeUpAt( bootSync.getNextAttempt() );
+    sleepScheduler.preventPowerDown(); // The radio has to stay on for the replies to the requests
+  }
+#endif
+
+  unsigned long sleepStarted = micros();
+  sleepScheduler.addAwakeTime( sleepStarted - awakeSince );
+
+#ifdef LOW_POWER_SLEEP
+  unsigned long sleepDuration = sleepScheduler.getSleepDuration();
+  if ( sleepDuration >= MIN_POWER_DOWN_DURATION && powerDown( sleepDuration ) ) {
+    awakeSince = micros();
+    return;
+  }
+#endif
+
+  set_sleep_mode( SLEEP_MODE_IDLE );
+  sleep_mode();
+  awakeSince = micros();
+  sleepScheduler.addSleepTime( awakeSince - sleepStarted );
+}
+
+#ifdef LOW_POWER_SLEEP
+extern volatile unsigned long timer0_millis; // The counter of millis() in the Arduino core
+
+/*
+  Powers down the node (and the radio) for the given amount of ms, or until the switch or the encoder is used. Returns
+  false when MySensors couldn't power down the node.
+  MySensors only supports the external interrupts, so the switch and the encoder pins end the sleep of MySensors
+  through the wake up handler of the pin change interrupt. The switch and the encoder are always attached, by the
+  debouncer and the quadrature decoder.
+*/
+bool powerDown( unsigned long duration ) {
+  pinChangeSetWakeUpHandler( onWakeUpPinChange );
+  int8_t result = sleep( duration );
+  pinChangeSetWakeUpHandler( NULL );
+
+  if ( result == MY_SLEEP_NOT_POSSIBLE ) {
+    return false;
+  }
+
+  // millis() doesn't run while powered down, so move it forward with the time that was slept
+  unsigned long slept = duration - getSleepRemaining();
+  noInterrupts();
+  timer0_millis += slept;
+  interrupts();
+  powerSwitch.clockSkipped( slept ); // the edges that woke up the node have the time stamp of before the sleep
+  sleepScheduler.addSleepTime( slept * 1000 );
+  return true;
+}
+
+/*
+  Wake up handler for a pin change of the encoder or the switch while powered down (interrupt context). Ends the sleep
+  of MySensors.
+*/
+void onWakeUpPinChange() {
+  _wokeUpByInterrupt = PIN_CHANGE_WAKE_UP;
+}
+#endif
+
+
 /*                   Routines for handling changes to the power state of the lamp    */
 
 /*
-  Turns on the fairy light led string with an animated fade to the current brightness level.
+  Turns on the fairy light led string of the given channel with an animated fade to the lightness of its current brightness level.
+*/
+void turnLightsOn( uint8_t channel ) {
+  bitClear( sunsetChannels, channel );
+  animations.fadeToBrightnessLevel( channel, levelLightness( lightBrightness[ channel ] ) );
+}
+
+/*
+  Returns the lightness of the given brightness level, scaled down by the cap of a low battery (BATTERY_BRIGHTNESS_CAP).
 */
-void turnLightsOn() {
-  animations.fadeToBrightnessLevel( map( lightBrightness, MIN_BRIGHTNES, MAX_BRIGHTNESS, 10, 255  ) );
+uint8_t levelLightness( uint8_t level ) {
+#ifdef BATTERY_BRIGHTNESS_CAP
+  return ( (uint16_t)BrightnessLevelTable::read( level ) * ( brightnessCap + 1 ) ) >> 8;
+#else
+  return BrightnessLevelTable::read( level );
+#endif
 }
 
 /*
-  Turns off the fairly led string.
+  Turns off the fairly led string of the given channel.
 */
-void turnLightsOff() {
-  animations.fadeToBrightnessLevel( 0 );
+void turnLightsOff( uint8_t channel ) {
+  bitClear( sunsetChannels, channel );
+  animations.fadeToBrightnessLevel( channel, 0 );
 }
 
 /*
-  Assigns the given brightness as the new brightness, if and only if the new brightness differs from the current brightness.
+  Assigns the given brightness as the new brightness of the given channel, if and only if the new brightness differs from the
+  current brightness.
 */
-void setNewLightBrightness( uint8_t newLightBrightness ) {
-  if ( lightBrightness != newLightBrightness ) {
-    if ( !powerState ) {
-      powerState = true;
+void setNewLightBrightness( uint8_t channel, uint8_t newLightBrightness ) {
+  if ( lightBrightness[ channel ] != newLightBrightness ) {
+    if ( !powerState[ channel ] ) {
+      powerState[ channel ] = true;
     }
 
-    lightBrightness = newLightBrightness;
-    turnLightsOn();
+    lightBrightness[ channel ] = newLightBrightness;
+    turnLightsOn( channel );
   }
   else {
-    if ( !powerState ) {
-      powerState = true;
-      turnLightsOn();
+    if ( !powerState[ channel ] ) {
+      powerState[ channel ] = true;
+      turnLightsOn( channel );
     }
   }
 }
 
 /*
-  Tries to assign to given state as the current state.
+  Tries to assign to given state as the current state of the given channel.
   If possible it will change the state accordingly.
 */
-void setLightState( bool newState ) {
-  if ( newState != powerState ) {
-    powerState = newState;
-    if ( powerState ) {
-      turnLightsOn();
+void setLightState( uint8_t channel, bool newState ) {
+  if ( newState != powerState[ channel ] ) {
+    powerState[ channel ] = newState;
+    if ( powerState[ channel ] ) {
+      turnLightsOn( channel );
     }
     else {
-      turnLightsOff();
+      turnLightsOff( channel );
+    }
+  }
+}
+
+/*
+  Returns the given brightness level when it's a valid level, otherwise the default brightness (e.g. for an erased EEPROM).
+  Both are limited to the highest brightness level of the parameters.
+*/
+uint8_t validBrightness( uint8_t level ) {
+  level = level >= MIN_BRIGHTNES && level <= MAX_BRIGHTNESS ? level : DimmerDefaultValue;
+  return level <= lampParameters.maxBrightness ? level : lampParameters.maxBrightness;
+}
+
+/*
+  Returns true if at least one of the channels is on.
+*/
+bool isAnyChannelOn() {
+  for ( uint8_t channel = 0; channel < LIGHT_CHANNELS; channel++ ) {
+    if ( powerState[ channel ] ) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+  Sets all channels to the given state and sends the states to the gateway.
+*/
+void setAllLightStates( bool newState ) {
+  for ( uint8_t channel = 0; channel < LIGHT_CHANNELS; channel++ ) {
+    setLightState( channel, newState );
+    sendPowerstateToGateWay( channel );
+  }
+}
+
+/*
+  Starts the given ambient effect (AMBIENT_EFFECTS, see ambientEffect.h) on the given channel and sends it to the
+  gateway. An unknown effect turns the effect off.
+*/
+void setChannelEffect( uint8_t channel, uint8_t effect ) {
+  animations.setEffect( channel, effect );
+  outbox.post( CHILD_ID_LIGHT + channel, V_VAR2, animations.getEffect( channel ), false );
+}
+
+/*
+  Starts the given ambient effect on all channels that are on.
+*/
+void setEffectOfChannelsOn( uint8_t effect ) {
+  for ( uint8_t channel = 0; channel < LIGHT_CHANNELS; channel++ ) {
+    if ( powerState[ channel ] ) {
+      setChannelEffect( channel, effect );
+    }
+  }
+}
+
+/*
+  Starts the effect after the effect of the first channel that is on, on all channels that are on. After the last
+  effect the effects are turned off (AMBIENT_STEADY), so a double click cycles through the effects.
+*/
+void startNextEffect() {
+  for ( uint8_t channel = 0; channel < LIGHT_CHANNELS; channel++ ) {
+    if ( powerState[ channel ] ) {
+      uint8_t effect = animations.getEffect( channel ) + 1;
+      setEffectOfChannelsOn( effect < AMBIENT_EFFECT_COUNT ? effect : (uint8_t)AMBIENT_STEADY );
+      return;
     }
   }
 }
 
 /*
-  Toggles the state of the lamp and sends the states to the gateway.
+  Toggles the state of the lamp and sends the states to the gateway. If any of the channels is on, all channels are
+  turned off. Otherwise all channels are turned on.
 */
 void toggleLightState() {
-  setLightState( !powerState );
-  sendPowerstateToGateWay();
+  setAllLightStates( !isAnyChannelOn() );
 }
 
 
 /*                Rotary encoder code    */
 
 /*
-  Scans for changes made by the user to the rotary encoder. And handles them accordingly.
+  Handles the detents the user turned the rotary encoder since the previous loop pass.
+  The encoder changes the brightness of all channels that are on with the amount of turned positions, quick turns count
+  for more levels per detent (see quadratureEncoder.h). When all channels are off, turning the encoder turns them on
+  without changing the brightness.
 */
 void checkEncoder() {
-  newEncoderPosition = encoder->read();
-
-  if ( newEncoderPosition != oldEncoderPosition ) {
-    oldEncoderPosition = newEncoderPosition;
-    if ( oldEncoderPosition % ENCODER_INCREMENTS == 0 ) {
-
-      newBrightness = oldEncoderPosition / ENCODER_INCREMENTS;
-      if ( newBrightness != lightBrightness ) {
-        if ( newBrightness < MIN_BRIGHTNES ) {
-          oldEncoderPosition = MIN_BRIGHTNES * ENCODER_INCREMENTS;
-          assignBrightnessLevelToEncoder();
-          // signal the user that the min brightness level has been reached
-          animations.startBoundaryReachedAnimation();
-        }
-        else if ( newBrightness > MAX_BRIGHTNESS ) {
-          oldEncoderPosition = MAX_BRIGHTNESS * ENCODER_INCREMENTS;
-          assignBrightnessLevelToEncoder();
+  bool    turned = false;
+  int16_t levels = 0;
+  while ( encoder.update( currentMillis ) ) {
+    turned = true;
+    levels += encoder.getDirection() * encoder.getStepSize();
+  }
 
-          // signal the user that the max brightness level has been reached
-          animations.startBoundaryReachedAnimation();
-        }
-        else {
-          if ( !powerState ) {
-            // don't adjust brightness
-            oldEncoderPosition = lightBrightness * ENCODER_INCREMENTS;
-            assignBrightnessLevelToEncoder();
-            setLightState( true ); // turn on the led
-
-            sendPowerstateToGateWay();
-          }
-          else {
-            setNewLightBrightness( oldEncoderPosition / ENCODER_INCREMENTS );
-            sendBrightnessLevelToGateWay();
-          }
+  if ( turned ) {
+    int8_t positions = constrain( levels, -MAX_BRIGHTNESS, MAX_BRIGHTNESS );
+
+    if ( !isAnyChannelOn() ) {
+      setAllLightStates( true ); // turn on the leds, don't adjust brightness
+    }
+    else {
+      for ( uint8_t channel = 0; channel < LIGHT_CHANNELS; channel++ ) {
+        if ( powerState[ channel ] ) {
+          changeLightBrightness( channel, positions );
         }
       }
     }
   }
 }
 
-void assignBrightnessLevelToEncoder() {
-  encoder->write( lightBrightness * ENCODER_INCREMENTS  );
+/*
+  Changes the brightness of the given channel with the given amount of levels. When the brightness would go below the minimum
+  or above the maximum brightness level, the level is capped and the user is signalled that the boundary has been reached.
+*/
+void changeLightBrightness( uint8_t channel, int8_t levels ) {
+  int16_t newBrightness = lightBrightness[ channel ] + levels;
+
+  if ( newBrightness < MIN_BRIGHTNES ) {
+    newBrightness = MIN_BRIGHTNES;
+    // signal the user that the min brightness level has been reached
+    animations.startBoundaryReachedAnimation( channel );
+  }
+  else if ( newBrightness > lampParameters.maxBrightness ) {
+    newBrightness = lampParameters.maxBrightness;
+    // signal the user that the max brightness level has been reached
+    animations.startBoundaryReachedAnimation( channel );
+  }
+
+  if ( newBrightness != lightBrightness[ channel ] ) {
+    setNewLightBrightness( channel, newBrightness );
+    sendBrightnessLevelToGateWay( channel );
+  }
 }
 
 
@@ -212,47 +758,440 @@ void assignBrightnessLevelToEncoder() {
 
 
 /*
-   Prestent the MySensors node to the Gateway. This includes the sketch name and -version as well as the childs of the node
+   Prestent the MySensors node to the Gateway. This includes the sketch name and -version as well as the childs of the node.
+   MySensors calls it once the gateway has been found. With FAST_BOOT it only starts the presentation, the loop sends it
+   step by step (see checkPresentation()).
 */
 void presentation() {
-  sendSketchInfo( MS_SketchName, MS_SketchVersion );
-  delay( 50 ); // Let's not DDOS the Gateway
-  present(  CHILD_ID_LIGHT, S_DIMMER );
-  delay( 50 );
-  send( dimmerMsg.set( (int)map( lightBrightness, MIN_BRIGHTNES, MAX_BRIGHTNESS, 1, 100 ) ) ); // Send the stored brightness value to the Gateway
-  delay( 50 ); // When the node is closer to the gateway it doesn't receive it's current state, which I can not explain. But using delays works
-              // A best practice would be to use random delays, chosen once at the start of the method. The delay would be 40 - 80ms
-              // if all nodes do this it will give them all time to connect to the gateway after a power out. The Sonoff once had a
-              // power out in production, and when the came back on all the sonoff Devices where literally DDOS-ing the Sonoff servers whilst
-              // thrying to connect to it.
-  request( CHILD_ID_LIGHT, V_LIGHT );
+#ifdef FAST_BOOT
+  bootSync.seed( getNodeId() * 251 ^ (uint16_t)micros() ); // Differs per node, so the lamps of a house drift apart
+  bootSync.start( millis() );
+  presentationStep = 0;
+#else
+  for ( uint8_t step = 0; step < PRESENTATION_STEPS; step++ ) {
+    if ( step > 0 ) {
+      delay( 50 ); // Let's not DDOS the Gateway
+    }
+    sendPresentationStep( step );
+  }
+#endif
+}
+
+/*
+  Sends the given step (0 - PRESENTATION_STEPS - 1) of the presentation. Returns false when the message couldn't be
+  delivered to the parent node.
+*/
+bool sendPresentationStep( uint8_t step ) {
+  if ( step == 0 ) {
+    return sendSketchInfo( MS_SketchName, MS_SketchVersion );
+  }
+  step -= 1;
+  if ( step < LIGHT_CHANNELS ) {
+    return present( CHILD_ID_LIGHT + step, S_DIMMER );
+  }
+  step -= LIGHT_CHANNELS;
+  switch ( step ) {
+    case 0:
+      return present( CHILD_ID_NODE_STATS, S_CUSTOM );
+    case 1:
+      return present( CHILD_ID_SCRIPT, S_INFO );
+    case 2:
+      return present( CHILD_ID_SCENE, S_SCENE_CONTROLLER );
+    case 3:
+      return present( CHILD_ID_SUN, S_CUSTOM );
+    case 4:
+      return present( CHILD_ID_PARAMETERS, S_CUSTOM );
+    case 5:
+#ifdef LOOP_PROFILER
+      return present( CHILD_ID_LOOP_STATS, S_CUSTOM );
+#else
+      return true;
+#endif
+  }
+  step -= 6;
+  // When the node is closer to the gateway it doesn't receive it's current state, which I can not explain. But using delays
+  // works. The Sonoff once had a power out in production, and when the came back on all the sonoff Devices where literally
+  // DDOS-ing the Sonoff servers whilst thrying to connect to it. FAST_BOOT paces the steps with random delays for that.
+  sendBrightnessLevelToGateWay( step ); // Send the stored brightness value to the Gateway, through the outbox
+  return request( CHILD_ID_LIGHT + step, V_LIGHT );
+}
+
+/*
+  Sends the next step of the presentation when it's due, with FAST_BOOT. A step that didn't get through is retried
+  after a backoff.
+*/
+void checkPresentation() {
+#ifdef FAST_BOOT
+  if ( !bootSync.isDue( currentMillis ) ) {
+    return;
+  }
+  if ( !sendPresentationStep( presentationStep ) ) {
+    bootSync.failed( currentMillis );
+    return;
+  }
+  presentationStep++;
+  if ( presentationStep < PRESENTATION_STEPS ) {
+    bootSync.succeeded( currentMillis );
+  }
+  else {
+    bootSync.stop();
+    Serial.print( "Presentation sent at ms: " ); Serial.println( millis() );
+  }
+#endif
 }
 
 /*
-  Event handler for handling message received from the gateway.
+  Event handler for handling message received from the gateway. MySensors calls it between two loop passes. The
+  commands are posted to the inbox, the loop applies them (see checkInbox()).
 */
 void receive( const MyMessage &message ) {
-//  Serial.print( "Received message for node id " ); Serial.println( getNodeId() );
-  // We only accept messages for this node
-  if (message.destination == getNodeId()) {
-    if ( message.type == V_DIMMER ) {
-      int dimvalue = atoi( message.data );
-      if ( dimvalue  > 0 && dimvalue <= 100 ) {
-        setNewLightBrightness( converFromMySensorsBrightness( dimvalue ) );
-        assignBrightnessLevelToEncoder();
+  PROFILED_OUTSIDE_LOOP( PROFILE_RECEIVE, postMessage( message ) );
+}
+
+/*
+  Posts a message received from the gateway to the inbox. Only the acks of the outbox and the chunks of a script
+  upload are handled at once: they have to be handled in order, and every single one of them.
+*/
+void postMessage( const MyMessage &message ) {
+  if ( message.isEcho() ) { // The controller acked a message of the outbox, it's not a command
+    outbox.acknowledged( message.sensor, message.type, message.getInt() );
+    return;
+  }
+
+  bool broadcast = message.destination == BROADCAST_ADDRESS;
+  if ( !broadcast && message.destination != getNodeId() ) {
+    return;
+  }
+  if ( message.sensor == CHILD_ID_SCRIPT ) {
+    if ( !broadcast ) {
+      receiveScript( message );
+    }
+    return;
+  }
+
+  // Storing a scene is the only command that has to be handled every time, the others only need their newest value
+  char payload[ MAX_PAYLOAD + 1 ];
+  message.getString( payload );
+  bool coalesce = !( message.sensor == CHILD_ID_SCENE && message.type == V_VAR1 );
+  inbox.post( message.sensor, message.type, ( broadcast ? COMMAND_BROADCAST : 0 ) | ( coalesce ? COMMAND_COALESCE : 0 ), payload );
+}
+
+/*
+  Applies the commands that were received since the previous loop pass, in the order in which they arrived. A burst
+  of commands for the same child and type (like the brightness of a dragged slider) has been coalesced into the newest one.
+*/
+void checkInbox() {
+  InboxCommand command;
+  while ( inbox.read( command ) ) {
+    handleCommand( command );
+  }
+}
+
+/*
+  Handles a command received from the gateway.
+*/
+void handleCommand( const InboxCommand &command ) {
+  if ( command.sensor == CHILD_ID_SCENE ) {
+    receiveScene( command );
+    return;
+  }
+
+  if ( command.sensor == CHILD_ID_SUN ) {
+    receiveSunFade( command );
+    return;
+  }
+
+  if ( command.sensor == CHILD_ID_PARAMETERS ) {
+    receiveParameter( command );
+    return;
+  }
+
+  // We only accept messages for this node and for one of the channels
+  uint8_t channel = command.sensor - CHILD_ID_LIGHT;
+  if ( !( command.flags & COMMAND_BROADCAST ) && channel < LIGHT_CHANNELS ) {
+    if ( command.type == V_DIMMER ) {
+      if ( command.value > 0 && command.value <= 100 ) {
+        setNewLightBrightness( channel, validBrightness( converFromMySensorsBrightness( command.value ) ) );
+      }
+    }
+    else if ( command.type == V_LIGHT ) {
+      setLightState( channel, command.value == 1 );
+      if ( command.value == 1 ) {
+        sendBrightnessLevelToGateWay( channel );
+      }
+    }
+    else if ( command.type == V_VAR1 ) {
+      startScript( channel, command.value );
+    }
+    else if ( command.type == V_VAR2 ) {
+      setChannelEffect( channel, command.value );
+    }
+  }
+}
+
+/*
+  Starts the given animation script on the given channel, a channel that is off is turned on. When the script ends the
+  channel fades back to its brightness level. SCRIPT_NONE stops the running script.
+*/
+void startScript( uint8_t channel, uint8_t script ) {
+  if ( script == SCRIPT_NONE ) {
+    if ( powerState[ channel ] ) {
+      turnLightsOn( channel );
+    }
+    else {
+      turnLightsOff( channel );
+    }
+    return;
+  }
+
+  if ( !powerState[ channel ] ) {
+    powerState[ channel ] = true;
+    turnLightsOn( channel ); // The level the channel fades back to when the script ends
+    sendPowerstateToGateWay( channel );
+  }
+  animations.startScript( channel, script );
+}
+
+/*
+  Handles a message for the script child: a V_TEXT chunk of the script that is being uploaded (the offset and the
+  instructions in hex) or the V_VAR1 that makes the uploaded script available.
+*/
+void receiveScript( const MyMessage &message ) {
+  if ( message.type == V_TEXT ) {
+    char chunk[ MAX_PAYLOAD + 1 ];
+    message.getString( chunk );
+    if ( strlen( chunk ) > 2 ) {
+      char offset[ 3 ] = { chunk[ 0 ], chunk[ 1 ], '\0' };
+      animationScriptUpload( strtoul( offset, NULL, 16 ), chunk + 2 );
+    }
+  }
+  else if ( message.type == V_VAR1 ) {
+    animationScriptCommit( atoi( message.data ) );
+  }
+}
+
+
+
+/*                   Scenes    */
+
+/*
+  Handles a command for the scene child: a V_SCENE_ON (possibly a broadcast) with the scene and the controller second
+  at which it starts, or a V_VAR1 to this node that stores the current state of the channels as the given scene.
+*/
+void receiveScene( const InboxCommand &command ) {
+  uint8_t scene = command.value;
+  if ( command.value >= SCENE_COUNT ) {
+    return;
+  }
+
+  if ( command.type == V_VAR1 && !( command.flags & COMMAND_BROADCAST ) ) {
+    for ( uint8_t channel = 0; channel < LIGHT_CHANNELS; channel++ ) {
+      saveState( EEPROM_SCENES + scene * LIGHT_CHANNELS + channel, powerState[ channel ] ? lightBrightness[ channel ] : 0 );
+    }
+  }
+  else if ( command.type == V_SCENE_ON ) {
+    unsigned long start = command.argument;
+    if ( start != 0 && start == lastSceneStart ) {
+      return; // A copy of the broadcast
+    }
+    lastSceneStart = start;
+    waitingScene = scene;
+    sceneWaiting = true;
+    unsigned long now = millis();
+    sceneStartAt = start != 0 && controllerClock.isSynchronized( now ) ? controllerClock.toLocal( start, now ) : now;
+  }
+}
+
+/*
+  Requests the time of the controller when the clock needs it (once the gateway has been found), and starts the waiting
+  scene once its start has come.
+*/
+void checkScene() {
+  if ( isTransportReady() && controllerClock.isRequestDue( currentMillis ) ) {
+    requestTime();
+    controllerClock.requested( currentMillis );
+  }
+
+  if ( sceneWaiting && (long)( currentMillis - sceneStartAt ) >= 0 ) {
+    sceneWaiting = false;
+    for ( uint8_t channel = 0; channel < LIGHT_CHANNELS; channel++ ) {
+      uint8_t level = loadState( EEPROM_SCENES + waitingScene * LIGHT_CHANNELS + channel );
+      if ( level == 0 ) {
+        setLightState( channel, false );
+      }
+      else if ( level != SCENE_UNSET ) {
+        setNewLightBrightness( channel, validBrightness( level ) );
+      }
+      sendPowerstateToGateWay( channel );
+    }
+  }
+}
+
+
+
+/*                   Sunrise and sunset    */
+
+/*
+  Handles a command for the sun child (possibly a broadcast): V_VAR1 for a sunrise or V_VAR2 for a sunset, with the
+  duration in minutes and the controller second at which it starts.
+*/
+void receiveSunFade( const InboxCommand &command ) {
+  if ( command.type != V_VAR1 && command.type != V_VAR2 ) {
+    return;
+  }
+  uint16_t minutes = command.value;
+  if ( minutes == 0 || minutes > 255 ) {
+    return;
+  }
+
+  unsigned long start = command.argument;
+  if ( start != 0 && start == lastSunFadeStart ) {
+    return; // A copy of the broadcast
+  }
+  lastSunFadeStart = start;
+  waitingSunrise = command.type == V_VAR1;
+  sunFadeMinutes = minutes;
+  sunFadeWaiting = true;
+  unsigned long now = millis();
+  sunFadeStartAt = start != 0 && controllerClock.isSynchronized( now ) ? controllerClock.toLocal( start, now ) : now;
+}
+
+/*
+  Starts the waiting sunrise or sunset once its start has come, and turns off the channels of which the sunset ended.
+*/
+void checkSunFade() {
+  if ( sunFadeWaiting && (long)( currentMillis - sunFadeStartAt ) >= 0 ) {
+    sunFadeWaiting = false;
+    for ( uint8_t channel = 0; channel < LIGHT_CHANNELS; channel++ ) {
+      if ( waitingSunrise ) {
+        bitClear( sunsetChannels, channel );
+        if ( !powerState[ channel ] ) {
+          powerState[ channel ] = true;
+          sendPowerstateToGateWay( channel );
+        }
+        animations.startLongFade( channel, levelLightness( lightBrightness[ channel ] ), sunFadeMinutes );
+      }
+      else if ( powerState[ channel ] ) {
+        bitSet( sunsetChannels, channel );
+        animations.startLongFade( channel, 0, sunFadeMinutes );
       }
     }
-    else if ( message.type == V_LIGHT ) {
-      int value = atoi( message.data );
-      setLightState( value == 1 );
-      if ( value == 1 ) {
-        delay( 10 );
-        sendBrightnessLevelToGateWay();
+  }
+
+  for ( uint8_t channel = 0; channel < LIGHT_CHANNELS; channel++ ) {
+    if ( bitRead( sunsetChannels, channel ) && animations.animationFinished( channel ) ) {
+      setLightState( channel, false ); // Clears the bit
+      sendPowerstateToGateWay( channel );
+    }
+  }
+}
+
+
+
+/*                   Parameters    */
+
+/*
+  Reads the parameters from the EEPROM, the defaults of config.h are kept when they were never set (or the block isn't
+  valid), and applies them.
+*/
+void loadParameters() {
+  if ( !parameterBlock.load() ) {
+    Serial.println( "Default parameters" );
+  }
+  applyParameters();
+}
+
+/*
+  Returns the heart beat interval of the parameters in ms.
+*/
+uint32_t getHeartBeatInterval() {
+  return lampParameters.heartBeatMinutes * 60000UL;
+}
+
+/*
+  Applies the parameters to the animations, the switch and the heart beat. The channels above the highest brightness
+  level are brought down to it. The hot paths only read the parameters in RAM.
+*/
+void applyParameters() {
+  animations.setTiming( lampParameters.fadeStepDuration, lampParameters.blinkAmount, lampParameters.blinkDelay );
+  MultiClickStateMachine::setDurations( lampParameters.shortPressDuration, lampParameters.longPressDuration );
+  if ( lampParameters.heartBeatMinutes > MAX_HEART_BEAT_MINUTES ) { // The block may hold a longer interval, stored before it was capped
+    lampParameters.heartBeatMinutes = MAX_HEART_BEAT_MINUTES;
+  }
+
+  for ( uint8_t channel = 0; channel < LIGHT_CHANNELS; channel++ ) {
+    if ( storedBrightness[ channel ] > lampParameters.maxBrightness ) {
+      storedBrightness[ channel ] = lampParameters.maxBrightness;
+    }
+    if ( lightBrightness[ channel ] > lampParameters.maxBrightness ) {
+      lightBrightness[ channel ] = lampParameters.maxBrightness;
+      if ( powerState[ channel ] ) {
+        turnLightsOn( channel );
+        sendBrightnessLevelToGateWay( channel );
       }
     }
   }
 }
 
+/*
+  Handles a command for the parameters child (possibly a broadcast, to tune all lamps): V_VAR1 - V_VAR5 set a
+  parameter, see config.h for the payloads and their ranges. A valid value is applied at once and written to the
+  EEPROM from the loop, an invalid one is ignored.
+*/
+void receiveParameter( const InboxCommand &command ) {
+  uint16_t      first = command.value;
+  unsigned long second = command.argument;
+
+  LampParameters parameters = lampParameters;
+  switch ( command.type ) {
+    case V_VAR1:
+      if ( first < 10 || first > 500 ) {
+        return;
+      }
+      parameters.fadeStepDuration = first;
+      break;
+    case V_VAR2:
+      if ( first < 1 || first > 10 || second < 50 || second > 2000 ) {
+        return;
+      }
+      parameters.blinkAmount = first;
+      parameters.blinkDelay = second;
+      break;
+    case V_VAR3:
+      if ( first < 50 || first > 1000 || second < 3 * first || second > 10000 ) {
+        return;
+      }
+      parameters.shortPressDuration = first;
+      parameters.longPressDuration = second;
+      break;
+    case V_VAR4:
+      if ( first < MIN_BRIGHTNES || first > MAX_BRIGHTNESS ) {
+        return;
+      }
+      parameters.maxBrightness = first;
+      break;
+    case V_VAR5:
+      if ( first < 1 || first > MAX_HEART_BEAT_MINUTES ) {
+        return;
+      }
+      parameters.heartBeatMinutes = first;
+      break;
+    default:
+      return;
+  }
+
+  lampParameters = parameters;
+  applyParameters();
+  parameterBlock.store();
+}
+
+/*
+  Event handler for the time of the controller, the reply to requestTime(). MySensors calls it between two loop passes.
+*/
+void receiveTime( uint32_t controllerTime ) {
+  controllerClock.received( controllerTime, millis() );
+}
+
 /*
   THis method is called before any hardware. In here we can add the power saving code.
 */
@@ -261,7 +1200,10 @@ void before() {
   for ( uint8_t cnt = 0; cnt <= 19; cnt++ ) {
     if ( cnt == 8 ) { // Don't pull the spi pins low. They're used by MySensors
       cnt = 13;
-      return;
+      continue;
+    }
+    if ( cnt == POWER_SWITCH_PIN || cnt == ENCODER_FIRST_PIN || cnt == ENCODER_SECOND_PIN ) {
+      continue; // Inputs with a pull up, set by the constructors of the switch and the encoder
     }
     pinMode( cnt, OUTPUT );
     digitalWrite( cnt, LOW );
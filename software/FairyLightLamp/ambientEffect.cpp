@@ -0,0 +1,136 @@
+#include "ambientEffect.h"
+
+/*
+  Creates an instance of the AmbientEffect class, without an effect (AMBIENT_STEADY).
+*/
+AmbientEffect::AmbientEffect() {
+  this->effect = AMBIENT_STEADY;
+  this->gain = AMBIENT_FULL_GAIN;
+  this->fromGain = AMBIENT_FULL_GAIN;
+  this->toGain = AMBIENT_FULL_GAIN;
+  this->phase = 0;
+  this->segmentShift = 1;
+  this->lastTick = 0;
+}
+
+/*
+  Seeds the random generator. Give each channel its own seed, otherwise all channels flicker in the same way.
+  A seed of 0 is replaced, the xorshift generator would only return zeros.
+*/
+void AmbientEffect::seed( uint16_t seed ) {
+  this->generator.seed( seed );
+}
+
+/*
+  Starts the given effect (AMBIENT_EFFECTS) from the current gain, so changing the effect doesn't jump. An unknown
+  effect turns the effect off (AMBIENT_STEADY).
+*/
+void AmbientEffect::setEffect( uint8_t effect ) {
+  this->effect = effect < AMBIENT_EFFECT_COUNT ? effect : (uint8_t)AMBIENT_STEADY;
+  this->fromGain = this->gain;
+  this->toGain = this->gain;
+  this->segmentShift = 1;
+  this->phase = this->effect == AMBIENT_BREATHE ? 128 : 0; // A breath starts at the top
+}
+
+/*
+  Returns the effect that is running (AMBIENT_EFFECTS).
+*/
+uint8_t AmbientEffect::getEffect() {
+  return this->effect;
+}
+
+/*
+  Determines wether the effect changes the level (true) or the level is passed unchanged (false). After the effect was
+  turned off it keeps running until the gain is back at full.
+*/
+bool AmbientEffect::isRunning() {
+  return this->effect != AMBIENT_STEADY || this->gain != AMBIENT_FULL_GAIN;
+}
+
+/*
+  Advances the effect by one tick when AMBIENT_TICK ms have passed since the previous tick. A late call advances a
+  single tick, the effect slows down instead of catching up, which nobody sees in a flicker.
+
+  currentMillis: the current millis of the micro controller.
+*/
+void AmbientEffect::checkEffect( unsigned long currentMillis ) {
+  if ( !this->isRunning() || currentMillis - this->lastTick < AMBIENT_TICK ) {
+    return;
+  }
+  this->lastTick = currentMillis;
+
+  switch ( this->effect ) {
+    case AMBIENT_CANDLE:
+      this->tickCandle();
+      break;
+    case AMBIENT_TWINKLE:
+      this->tickTwinkle();
+      break;
+    case AMBIENT_BREATHE:
+      this->tickBreathe();
+      break;
+    default:
+      // Glide back to the full level, an eighth of the distance per tick
+      this->gain += ( AMBIENT_FULL_GAIN - this->gain + 7 ) >> 3;
+      break;
+  }
+}
+
+/*
+  Returns the given light level (Q8.8 fixed point) with the gain of the effect applied.
+*/
+uint16_t AmbientEffect::apply( uint16_t lightLevel ) {
+  return (uint16_t)( ( (uint32_t)lightLevel * ( this->gain + 1 ) ) >> 8 );
+}
+
+/*
+  A tick of the candle: a straight line between random points (value noise). At the end of a segment the next point
+  and the length of the next segment (2, 4 or 8 ticks) are drawn from a single random number. The sum of two random
+  parts makes the flicker stay around the middle, with now and then a deep dip.
+*/
+void AmbientEffect::tickCandle() {
+  this->phase++;
+  if ( this->phase >= ( 1 << this->segmentShift ) ) {
+    uint16_t random = this->generator.next();
+    this->phase = 0;
+    this->fromGain = this->toGain;
+    if ( ( random & CANDLE_DIP_MASK ) == 0 ) {
+      this->toGain = CANDLE_DIP_GAIN + ( ( random >> 8 ) & 0x3F );
+    }
+    else {
+      this->toGain = CANDLE_FLICKER_GAIN + ( ( random >> 8 ) & 0x3F ) + ( ( random >> 5 ) & 0x0F );
+    }
+    this->segmentShift = 1 + ( ( random >> 14 ) & 1 ) + ( ( random >> 15 ) & 1 );
+  }
+  int16_t delta = (int16_t)this->toGain - this->fromGain;
+  this->gain = this->fromGain + ( ( delta * this->phase ) >> this->segmentShift );
+}
+
+/*
+  A tick of the twinkle: a random sparkle to the full level, otherwise an eighth of the distance back to the base.
+*/
+void AmbientEffect::tickTwinkle() {
+  if ( ( this->generator.next() & TWINKLE_SPARKLE_MASK ) == 0 ) {
+    this->gain = AMBIENT_FULL_GAIN;
+  }
+  else if ( this->gain > TWINKLE_BASE_GAIN ) {
+    this->gain -= ( this->gain - TWINKLE_BASE_GAIN + 7 ) >> 3;
+  }
+  else {
+    this->gain += ( TWINKLE_BASE_GAIN - this->gain + 7 ) >> 3;
+  }
+}
+
+/*
+  A tick of the breath: the phase runs through a triangle (up in 128 ticks, down in 128 ticks), which is eased with
+  smoothstep (3x^2 - 2x^3) in 8 bit fixed point, so the breath slows down at the top and the bottom.
+*/
+void AmbientEffect::tickBreathe() {
+  this->phase++;
+  uint8_t  x = ( this->phase < 128 ? this->phase : 255 - this->phase ) << 1; // 0 - 254
+  uint16_t square = ( (uint16_t)x * x ) >> 8;
+  uint16_t cube = ( square * x ) >> 8;
+  uint16_t eased = 3 * square - 2 * cube; // 0 - 256
+  this->gain = BREATHE_LOW_GAIN + ( ( eased * ( AMBIENT_FULL_GAIN - BREATHE_LOW_GAIN ) ) >> 8 );
+}
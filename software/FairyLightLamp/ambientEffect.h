@@ -0,0 +1,77 @@
+#ifndef AMBIENT_EFFECT_H
+#define AMBIENT_EFFECT_H
+
+#include "hal.h"
+#include "xorshift16.h"
+
+/*
+  Library for the ambient effects of a channel: a candle, twinkle or breathe effect on top of the steady brightness.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  The effects are generated, not stored: each channel has its own xorshift pseudo random generator (xorshift16.h) and the effect is
+  integer noise (random points with a straight line between them) or a curve that is calculated on the fly. The effect
+  doesn't produce a level but a gain (0 - 255, 255 is the full level), which the AnimationManager applies to the level
+  of the fade animation. So a fade or a change of the brightness keeps working while an effect runs, and the boundary
+  reached blink and the scripts simply take over the channel and hand it back when they're done.
+
+  The effect advances one tick every AMBIENT_TICK ms, and at most one tick per checkEffect() call. A tick has no loops
+  and no divisions: a fixed amount of work, so the time it takes doesn't depend on the effect, its state or a late
+  call. It's cheap enough for the frame timer interrupt (see animationScheduler.h). The ambient_ticks test of the host
+  (software/host/ambientTicks.cpp) checks this, the benchmark (software/host/benchmark.cpp) times the ticks.
+
+  The effects:
+  - AMBIENT_STEADY : no effect, the gain glides back to full when the effect is turned off.
+  - AMBIENT_CANDLE : a flickering flame, random points from 40 up to 160 ms apart, with a deep dip once in a while.
+  - AMBIENT_TWINKLE: sparkles, the gain jumps to full at random moments and decays back to a dimmed level.
+  - AMBIENT_BREATHE: slowly fades between a low and the full level with an ease in and out, 5 seconds per breath.
+
+  Revision history:
+    16-10-2026 Initial version.
+    17-10-2026 The random generator is the shared Xorshift16.
+*/
+
+typedef enum { AMBIENT_STEADY, AMBIENT_CANDLE, AMBIENT_TWINKLE, AMBIENT_BREATHE } AMBIENT_EFFECTS;
+const uint8_t AMBIENT_EFFECT_COUNT = 4;
+
+const uint8_t AMBIENT_TICK = 20;            // ms between two ticks of an effect
+const uint8_t AMBIENT_FULL_GAIN = 255;
+
+const uint8_t CANDLE_FLICKER_GAIN = 176;    // The lowest gain of the normal flicker, it flickers up to 254
+const uint8_t CANDLE_DIP_GAIN = 96;         // The lowest gain of a dip, it dips down to 96 - 159
+const uint8_t CANDLE_DIP_MASK = 0x1F;       // 1 in 32 points is a dip
+const uint8_t TWINKLE_BASE_GAIN = 144;      // The gain between the sparkles
+const uint8_t TWINKLE_SPARKLE_MASK = 0x3F;  // 1 in 64 ticks starts a sparkle, about once per 1.3 seconds
+const uint8_t BREATHE_LOW_GAIN = 64;        // The gain at the bottom of a breath
+
+/*
+  The ambient effect of a single channel, see the cpp file for the documentation of the methods.
+*/
+class AmbientEffect {
+  public:
+    AmbientEffect();
+
+    void    seed( uint16_t seed );
+    void    setEffect( uint8_t effect );
+    uint8_t getEffect();
+    bool    isRunning();
+
+    void     checkEffect( unsigned long currentMillis );
+    uint16_t apply( uint16_t lightLevel );
+  private:
+    void     tickCandle();
+    void     tickTwinkle();
+    void     tickBreathe();
+
+    Xorshift16    generator;    // The random generator of the effect (xorshift16.h)
+    uint8_t       effect;       // The running effect (AMBIENT_EFFECTS)
+    uint8_t       gain;         // The current gain, 255 is the full level
+    uint8_t       fromGain;     // Candle: the gain at the start of the current segment
+    uint8_t       toGain;       // Candle: the gain at the end of the current segment
+    uint8_t       phase;        // Candle: the tick in the segment, breathe: the tick in the breath
+    uint8_t       segmentShift; // Candle: the length of the segment, 1 << segmentShift ticks
+    unsigned long lastTick;
+};
+
+#endif
@@ -0,0 +1,376 @@
+#ifndef ANIMATION_MANAGER_H
+#define ANIMATION_MANAGER_H
+
+#include "hal.h"
+#include "ledCurves.h"
+#include "ledAnimation.h"
+#include "animationScript.h"
+#include "ambientEffect.h"
+#include "layerCompositor.h"
+
+/*
+  Library for managing the animations of a number of fairy light led strings (channels).
+
+  Author: By Theo
+  Created: January 6th 2021
+
+  The AnimationManager class template was part of ledAnimation.h, see that file for the history of the animations.
+
+  Revision history:
+    16-10-2026 Moved from ledAnimation.h, so it can use the script animation of animationScript.h.
+    16-10-2026 Runs a script per channel.
+    16-10-2026 Writes the channels through a PWM sink, so they can be dithered (see ditheredPwm.h).
+    16-10-2026 The finished animations go to a listener type, instead of a virtual method of the manager itself.
+    16-10-2026 An ambient effect per channel (see ambientEffect.h) on top of the fade to the brightness level.
+    16-10-2026 Long fades (sunrise and sunset) that only step when the duty cycle changes.
+    16-10-2026 The timing of the fades and the boundary reached blinks can be changed at run time.
+    16-10-2026 The animations of a channel are layers of a compositor (see layerCompositor.h) instead of a hierarchy
+               in which only one of them runs. The fade continues under a boundary reached blink.
+    17-10-2026 The layers of a running channel are composed each frame instead of kept per channel, to save RAM.
+*/
+
+/*
+  The default PWM sink of the AnimationManager: writes the 8 bit PWM value of the lightness with analogWrite(). A sink
+  converts a lightness (Q8.8 fixed point) to a duty cycle and writes the duty cycle to a pin, see DitheredPwmSink in
+  ditheredPwm.h for a sink that uses the fraction.
+*/
+struct LedPwmSink {
+  static inline uint16_t toDuty( uint16_t lightLevel ) {
+    return ledLightnessToPwm( lightLevel >> 8 );
+  }
+
+  static inline void write( uint8_t pin, uint16_t duty ) {
+    halPwmWrite( pin, duty );
+  }
+};
+
+/*
+  The animations of a channel, passed to the listener of the AnimationManager when one of them finishes.
+*/
+typedef enum { ANIMATION_BOUNDARY_BLINK, ANIMATION_SCRIPT, ANIMATION_FADE, ANIMATION_LONG_FADE } ANIMATION_KINDS;
+
+/*
+  The layers of a channel, from the lowest priority to the highest, and their blend modes (see layerCompositor.h). The
+  fade to the brightness level is the base, the long fade overrides it while it runs. The ambient effect is a gain on
+  both, a script overrides all of them. The boundary reached blink multiplies the channel with its on (full) and off
+  state, so whatever runs below it keeps running and shows through the on states.
+
+  A new animation is a new layer here, with a line in AnimationManager::composeLayers() that adds it.
+*/
+typedef enum { LAYER_FADE, LAYER_LONG_FADE, LAYER_AMBIENT, LAYER_SCRIPT, LAYER_BLINK } ANIMATION_LAYERS;
+
+struct AnimationLayers {
+  static inline uint8_t blendMode( uint8_t layer ) {
+    return layer == LAYER_AMBIENT || layer == LAYER_BLINK ? BLEND_MULTIPLY : BLEND_OVERRIDE;
+  }
+};
+
+/*
+  The default listener of the AnimationManager: ignores the finished animations. Like the PWM sink a listener is a
+  type with a static method, which checkAnimation() calls directly. So the compiler inlines it, and the empty one of
+  this listener costs no code at all. With the frame timer of the AnimationScheduler it's called from the interrupt.
+*/
+struct NoAnimationListener {
+  static inline void onAnimationFinished( uint8_t /* channel */, ANIMATION_KINDS /* animation */ ) {
+  }
+};
+
+/*
+ Class the implements the supported animations for a number of led strings (channels), each on its own PWM pin.
+ All animations of a channel run at the same time, each one is a layer (see AnimationLayers) and the compositor of
+ the channel blends them into its level. A fade to a brightness level stops the script and the long fade of the
+ channel, when a script ends the channel fades back to the brightness level. A script stops the long fade, the
+ channel then stays at the level the long fade reached. A boundary reached blink stops nothing, a fade that was
+ started just before it continues during the blink.
+
+ A long fade is only advanced when its level reaches the next level at which the duty cycle of the PWM sink changes,
+ which the manager looks up with a binary search on the sink. getNextChange() tells how long that takes, so the node
+ can sleep until then. The ambient effect of a channel is applied to the level of the fade and the long fade, so it
+ continues under a blink and when a script ends.
+
+ The animations only calculate their level. The manager composes the levels of a channel while one of them runs,
+ converts the result to a duty cycle with the PWM sink and writes it to the PWM pin of the channel, if and only if
+ the duty cycle of the channel has changed. All channels are handled in a single checkAnimation() call.
+
+ The class is a template, so the state of all channels is kept in fixed size arrays without using the heap.
+ That's also why it's implemented in this header file instead of the cpp file. The PWM sink and the listener
+ (see NoAnimationListener) are template arguments as well, so their calls are resolved by the compiler.
+ */
+template<uint8_t channelCount, typename PwmSink = LedPwmSink, typename Listener = NoAnimationListener> class AnimationManager {
+  public:
+    AnimationManager( const uint8_t ( &pwmPins )[ channelCount ] );
+
+    void startBoundaryReachedAnimation( uint8_t channel );
+    void fadeToBrightnessLevel( uint8_t channel, uint8_t targetLevel );
+    bool startScript( uint8_t channel, uint8_t script );
+    void startLongFade( uint8_t channel, uint8_t targetLevel, uint8_t minutes );
+    void setEffect( uint8_t channel, uint8_t effect );
+    uint8_t getEffect( uint8_t channel );
+    void setTiming( uint16_t fadeStepDuration, uint8_t blinkAmount, uint16_t blinkDelay );
+
+    bool animationFinished();
+    bool animationFinished( uint8_t channel );
+    void checkAnimation( unsigned long currentMillis );
+    unsigned long getNextChange( unsigned long currentMillis );
+  private:
+    uint16_t getCurrentLightLevel( uint8_t channel );
+    uint16_t nextDutyChange( uint8_t channel );
+    void     stopLongFade( uint8_t channel );
+    uint16_t composeLayers( uint8_t channel );
+
+    uint8_t                          pwmPins[ channelCount ];
+    uint16_t                         dutyCycles[ channelCount ]; // The last duty cycle written to each channel
+    OffBlinkAnimation                offBlinkAnimations[ channelCount ];
+    SmoothBrightnessTransistion      smoothTransistionAnimations[ channelCount ];
+    ScriptAnimation                  scriptAnimations[ channelCount ];
+    LongFadeAnimation                longFadeAnimations[ channelCount ];
+    AmbientEffect                    ambientEffects[ channelCount ];
+};
+
+
+//                              AnimationManager
+
+/*
+  Creates an instance of the AnimationManager class
+  pwmPins : the pwm pins to which the fairy light led strings are connected (through a mosfet), one per channel.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> AnimationManager<channelCount, PwmSink, Listener>::AnimationManager( const uint8_t ( &pwmPins )[ channelCount ] ) {
+  // our off blink animation is defined as turned 3 times of and end with the lights on
+  // we assume the lights are on, because they are when you turn the rotary encoder to change
+  // the brightness level.
+  for ( uint8_t channel = 0; channel < channelCount; channel++ ) {
+    this->pwmPins[ channel ] = pwmPins[ channel ];
+    this->dutyCycles[ channel ] = 0;
+    this->ambientEffects[ channel ].seed( 0xACE1 ^ ( (uint16_t)channel << 8 ) ); // Each channel flickers on its own
+  }
+}
+
+/*
+  Starts a boundary reached animation on the given channel, if and only if there's no boundary reached animation
+  currently running on that channel. The blink is a multiply layer, so its on state is the full level: it shows the
+  layers below it.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> void AnimationManager<channelCount, PwmSink, Listener>::startBoundaryReachedAnimation( uint8_t channel ) {
+  if ( this->offBlinkAnimations[ channel ].animationFinished() ) {
+    this->offBlinkAnimations[ channel ].startAnimation( LAYER_FULL_LEVEL );
+  }
+}
+
+/*
+  determines wether the animations of all channels are finised (true) or if an animation is running (false).
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> bool AnimationManager<channelCount, PwmSink, Listener>::animationFinished() {
+  for ( uint8_t channel = 0; channel < channelCount; channel++ ) {
+    if ( !this->animationFinished( channel ) ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+  determines wether the animation of the given channel is finised (true) or if an animation is running (false). An
+  ambient effect doesn't count, it never finishes.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> bool AnimationManager<channelCount, PwmSink, Listener>::animationFinished( uint8_t channel ) {
+  return this->offBlinkAnimations[ channel ].animationFinished() && this->scriptAnimations[ channel ].animationFinished() &&
+         this->longFadeAnimations[ channel ].animationFinished() && this->smoothTransistionAnimations[ channel ].isAnimationFinished();
+}
+
+/*
+  Checks and handles the animations of all channels. Must be call from the main loop for each cycle.
+  Each running animation is advanced, after which the layers of the channel are set. Channels without a running
+  animation are skipped. Only channels of which the duty cycle has changed are written.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> void AnimationManager<channelCount, PwmSink, Listener>::checkAnimation( unsigned long currentMillis ) {
+  for ( uint8_t channel = 0; channel < channelCount; channel++ ) {
+    bool running = this->ambientEffects[ channel ].isRunning();
+    if ( !this->offBlinkAnimations[ channel ].animationFinished() ) {
+      running = true;
+      if ( this->offBlinkAnimations[ channel ].checkAnimation( currentMillis ) ) {
+        Listener::onAnimationFinished( channel, ANIMATION_BOUNDARY_BLINK );
+      }
+    }
+    if ( !this->scriptAnimations[ channel ].animationFinished() ) {
+      running = true;
+      if ( this->scriptAnimations[ channel ].checkAnimation( currentMillis ) ) {
+        // fade back to the brightness level
+        this->smoothTransistionAnimations[ channel ].continueFrom( this->scriptAnimations[ channel ].getCurrentBrightnessLevel() );
+        Listener::onAnimationFinished( channel, ANIMATION_SCRIPT );
+      }
+    }
+    if ( !this->longFadeAnimations[ channel ].animationFinished() ) {
+      running = true;
+      if ( this->longFadeAnimations[ channel ].getNextChange( currentMillis ) == 0 ) {
+        if ( this->longFadeAnimations[ channel ].checkAnimation( currentMillis ) ) {
+          Listener::onAnimationFinished( channel, ANIMATION_LONG_FADE );
+        }
+        else {
+          this->longFadeAnimations[ channel ].waitForLevel( this->nextDutyChange( channel ) );
+        }
+      }
+    }
+    if ( !this->smoothTransistionAnimations[ channel ].isAnimationFinished() ) {
+      running = true;
+      if ( this->smoothTransistionAnimations[ channel ].checkAnimation( currentMillis ) ) {
+        Listener::onAnimationFinished( channel, ANIMATION_FADE );
+      }
+    }
+    if ( !running ) {
+      continue; // Nothing changed since the animations of the channel finished, so the layers didn't either
+    }
+    this->ambientEffects[ channel ].checkEffect( currentMillis );
+
+    uint16_t dutyCycle = PwmSink::toDuty( this->composeLayers( channel ) );
+    if ( dutyCycle != this->dutyCycles[ channel ] ) {
+      this->dutyCycles[ channel ] = dutyCycle;
+      PwmSink::write( this->pwmPins[ channel ], dutyCycle );
+    }
+  }
+}
+
+/*
+  Returns the level (Q8.8 fixed point) of the given channel, composed from the state of its animations. A layer of an
+  animation that isn't running is inactive.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> uint16_t AnimationManager<channelCount, PwmSink, Listener>::composeLayers( uint8_t channel ) {
+  LayerCompositor<AnimationLayers> layers;
+  layers.addLayer( LAYER_FADE, true, this->smoothTransistionAnimations[ channel ].getCurrentLightLevel() );
+  layers.addLayer( LAYER_LONG_FADE, !this->longFadeAnimations[ channel ].animationFinished(),
+                   this->longFadeAnimations[ channel ].getCurrentLightLevel() );
+  layers.addLayer( LAYER_AMBIENT, this->ambientEffects[ channel ].isRunning(), this->ambientEffects[ channel ].apply( LAYER_FULL_LEVEL ) );
+  layers.addLayer( LAYER_SCRIPT, !this->scriptAnimations[ channel ].animationFinished(),
+                   (uint16_t)this->scriptAnimations[ channel ].getCurrentBrightnessLevel() << 8 );
+  layers.addLayer( LAYER_BLINK, !this->offBlinkAnimations[ channel ].animationFinished(),
+                   this->offBlinkAnimations[ channel ].getCurrentLightLevel() );
+  return layers.getLevel();
+}
+
+/*
+  Transistions the fairy light lef string of the given channel to the given target brightness level. Starting brightness
+  is the current brightness.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> void AnimationManager<channelCount, PwmSink, Listener>::fadeToBrightnessLevel( uint8_t channel, uint8_t targetLevel ) {
+  this->stopLongFade( channel );
+  if ( !this->scriptAnimations[ channel ].animationFinished() ) {
+    this->scriptAnimations[ channel ].stopScript();
+    this->smoothTransistionAnimations[ channel ].continueFrom( this->scriptAnimations[ channel ].getCurrentBrightnessLevel() );
+  }
+  this->smoothTransistionAnimations[ channel ].setLevel( targetLevel );
+}
+
+/*
+  Starts the given script (see animationScript.h) on the given channel, from the current level of the channel.
+  Returns false when the script doesn't exist.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> bool AnimationManager<channelCount, PwmSink, Listener>::startScript( uint8_t channel, uint8_t script ) {
+  uint8_t currentLevel = this->getCurrentLightLevel( channel ) >> 8;
+  this->stopLongFade( channel );
+  return this->scriptAnimations[ channel ].startScript( script, currentLevel );
+}
+
+/*
+  Fades the given channel from its current level to the given target brightness level in the given amount of minutes,
+  like a sunrise or a sunset. A running script is stopped. The fade is stopped by a fade to a brightness level or a
+  script.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> void AnimationManager<channelCount, PwmSink, Listener>::startLongFade( uint8_t channel, uint8_t targetLevel, uint8_t minutes ) {
+  uint16_t currentLevel = this->getCurrentLightLevel( channel );
+  if ( !this->scriptAnimations[ channel ].animationFinished() ) {
+    this->scriptAnimations[ channel ].stopScript();
+  }
+  this->longFadeAnimations[ channel ].startAnimation( currentLevel, targetLevel, minutes * 60000UL );
+  this->smoothTransistionAnimations[ channel ].continueFrom( targetLevel ); // Where the channel is when the long fade ends
+  this->smoothTransistionAnimations[ channel ].setLevel( targetLevel );
+}
+
+/*
+  Returns the amount of ms until the next step of the long fades (0 when it's due), or LONG_FADE_NO_CHANGE when no
+  long fade is running.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> unsigned long AnimationManager<channelCount, PwmSink, Listener>::getNextChange( unsigned long currentMillis ) {
+  unsigned long nextChange = LONG_FADE_NO_CHANGE;
+  for ( uint8_t channel = 0; channel < channelCount; channel++ ) {
+    unsigned long channelChange = this->longFadeAnimations[ channel ].getNextChange( currentMillis );
+    nextChange = channelChange < nextChange ? channelChange : nextChange;
+  }
+  return nextChange;
+}
+
+/*
+  Returns the level (Q8.8 fixed point) of the animation that drives the given channel, without the boundary reached
+  blink and the ambient effect.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> uint16_t AnimationManager<channelCount, PwmSink, Listener>::getCurrentLightLevel( uint8_t channel ) {
+  if ( !this->scriptAnimations[ channel ].animationFinished() ) {
+    return (uint16_t)this->scriptAnimations[ channel ].getCurrentBrightnessLevel() << 8;
+  }
+  if ( !this->longFadeAnimations[ channel ].animationFinished() ) {
+    return this->longFadeAnimations[ channel ].getCurrentLightLevel();
+  }
+  return this->smoothTransistionAnimations[ channel ].getCurrentLightLevel();
+}
+
+/*
+  Returns the first level (Q8.8 fixed point) between the current level and the target level of the long fade of the
+  given channel at which the duty cycle of the PWM sink changes, or the target level when it doesn't change anymore.
+  The duty cycle follows the level, so a binary search takes at most 16 conversions.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> uint16_t AnimationManager<channelCount, PwmSink, Listener>::nextDutyChange( uint8_t channel ) {
+  uint16_t unchanged = this->longFadeAnimations[ channel ].getCurrentLightLevel();
+  uint16_t changed = (uint16_t)this->longFadeAnimations[ channel ].getTargetLevel() << 8;
+  uint16_t dutyCycle = PwmSink::toDuty( unchanged );
+  if ( PwmSink::toDuty( changed ) == dutyCycle ) {
+    return changed;
+  }
+  while ( ( changed > unchanged ? changed - unchanged : unchanged - changed ) > 1 ) {
+    uint16_t middle = changed > unchanged ? unchanged + ( ( changed - unchanged ) >> 1 ) : unchanged - ( ( unchanged - changed ) >> 1 );
+    if ( PwmSink::toDuty( middle ) == dutyCycle ) {
+      unchanged = middle;
+    }
+    else {
+      changed = middle;
+    }
+  }
+  return changed;
+}
+
+/*
+  Stops the long fade of the given channel, if it's running. The fade to the brightness level continues from the level
+  the long fade reached and stays there.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> void AnimationManager<channelCount, PwmSink, Listener>::stopLongFade( uint8_t channel ) {
+  if ( !this->longFadeAnimations[ channel ].animationFinished() ) {
+    uint8_t currentLevel = this->longFadeAnimations[ channel ].getCurrentBrightnessLevel();
+    this->longFadeAnimations[ channel ].stopAnimation();
+    this->smoothTransistionAnimations[ channel ].continueFrom( currentLevel );
+    this->smoothTransistionAnimations[ channel ].setLevel( currentLevel );
+  }
+}
+
+/*
+  Starts the given ambient effect (AMBIENT_EFFECTS, see ambientEffect.h) on the given channel. AMBIENT_STEADY turns
+  the effect off, the channel glides back to its level.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> void AnimationManager<channelCount, PwmSink, Listener>::setEffect( uint8_t channel, uint8_t effect ) {
+  this->ambientEffects[ channel ].setEffect( effect );
+}
+
+/*
+  Returns the ambient effect (AMBIENT_EFFECTS) of the given channel.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> uint8_t AnimationManager<channelCount, PwmSink, Listener>::getEffect( uint8_t channel ) {
+  return this->ambientEffects[ channel ].getEffect();
+}
+
+/*
+  Sets the timing of all channels: the duration of a step of the fade to a brightness level (ms), and the amount of
+  off blinks and the duration of each on and off state (ms) of the boundary reached animation. Running animations
+  continue with the new timing.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> void AnimationManager<channelCount, PwmSink, Listener>::setTiming( uint16_t fadeStepDuration, uint8_t blinkAmount, uint16_t blinkDelay ) {
+  SmoothBrightnessTransistion::setStepDuration( fadeStepDuration );
+  OffBlinkAnimation::setBlink( blinkAmount, blinkDelay );
+}
+
+#endif
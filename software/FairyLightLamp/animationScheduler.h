@@ -0,0 +1,317 @@
+#ifndef ANIMATION_SCHEDULER_H
+#define ANIMATION_SCHEDULER_H
+
+#include "animationManager.h"
+#include "frameTimer.h"
+
+/*
+  Library for scheduling the animations of an AnimationManager, either from the main loop or from a timer interrupt.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  By default the animations are advanced by calling checkAnimation() from the main loop. That means that every
+  blocking call in the loop, like a delay() between two radio messages or an EEPROM write, stretches the step of a
+  fade that is running. Which is visible as a stutter.
+
+  When the frame timer is started the animations are advanced from the Timer1 interrupt at a fixed frame rate,
+  regardless of what the main loop is doing, and checkAnimation() does nothing. Note that a script in the EEPROM is
+  then read from the interrupt, which has to wait when the loop is writing the EEPROM (about 3.3ms per byte).
+
+  The loop (and the MySensors receive() handler) never touch the animations while the frame timer is running. New
+  targets, scripts and boundary animations are handed over through a mailbox per channel, with a sequence number. Each
+  frame the interrupt applies the requests of which the sequence number differs from the last one it applied. All
+  these values are single bytes, which are read and written atomically by the AVR, so no interrupts have to be
+  disabled. The ambient effect of a channel is a state instead of a request, the interrupt starts it when it differs
+  from the running effect.
+
+  A fade request (a target level, a duration and a script) takes several writes, and the loop can post two of them
+  between two frames, like startLongFade() right after fadeToBrightnessLevel(). An interrupt between the writes of the
+  second request would see the new target with the old duration. So the sequence number of the fades is incremented
+  before and after the request is written, it's odd while the loop is writing. The interrupt skips the request of a
+  channel while its sequence number is odd and applies it in a later frame. The loop can't run while the interrupt
+  reads the values, so an even sequence number means the request is complete. The timing of the animations (see
+  setTiming()) has values of 2 bytes, which the AVR writes in two steps, its sequence number works the same way. A
+  boundary reached request has no values, its sequence number is simply incremented.
+
+  Revision history:
+    16-10-2026 Initial version.
+    16-10-2026 Scripts.
+    16-10-2026 PWM sink of the AnimationManager.
+    16-10-2026 Listener of the AnimationManager.
+    16-10-2026 Ambient effects.
+    16-10-2026 Long fades.
+    16-10-2026 Timing of the fades and the boundary reached blinks.
+    17-10-2026 The sequence number of a fade request is odd while the loop writes it, like that of the timing.
+*/
+template<uint8_t channelCount, typename PwmSink = LedPwmSink, typename Listener = NoAnimationListener> class AnimationScheduler {
+  public:
+    AnimationScheduler( const uint8_t ( &pwmPins )[ channelCount ] );
+
+    void startFrameTimer( uint8_t framesPerSecond );
+    bool isFrameTimerRunning();
+
+    void startBoundaryReachedAnimation( uint8_t channel );
+    void fadeToBrightnessLevel( uint8_t channel, uint8_t targetLevel );
+    bool startScript( uint8_t channel, uint8_t script );
+    void startLongFade( uint8_t channel, uint8_t targetLevel, uint8_t minutes );
+    void setEffect( uint8_t channel, uint8_t effect );
+    uint8_t getEffect( uint8_t channel );
+    void setTiming( uint16_t fadeStepDuration, uint8_t blinkAmount, uint16_t blinkDelay );
+
+    bool animationFinished();
+    bool animationFinished( uint8_t channel );
+    void checkAnimation( unsigned long currentMillis );
+    unsigned long getNextChange( unsigned long currentMillis );
+  private:
+    static void onFrame( unsigned long frameMillis );
+    void handleRequests();
+
+    AnimationManager<channelCount, PwmSink, Listener> animations;
+    bool                                     frameTimerRunning = false;
+
+    volatile uint8_t fadeTargets[ channelCount ];           // The requested target level per channel, written by the loop
+    volatile uint8_t fadeScripts[ channelCount ];           // The requested script per channel, SCRIPT_NONE for a fade to the target level
+    volatile uint8_t fadeMinutes[ channelCount ];           // The duration of a requested long fade per channel, 0 for a normal fade
+    volatile uint8_t fadeSequences[ channelCount ];         // Incremented by the loop before and after it writes a fade request
+    volatile uint8_t blinkSequences[ channelCount ];        // Incremented by the loop for each boundary reached request
+    volatile uint8_t appliedFadeSequences[ channelCount ];  // The last fade request applied by the interrupt
+    volatile uint8_t appliedBlinkSequences[ channelCount ]; // The last boundary reached request applied by the interrupt
+    volatile uint8_t effects[ channelCount ];               // The requested ambient effect per channel
+    volatile uint16_t timingStepDuration;                   // The requested timing of all channels, see setTiming()
+    volatile uint8_t  timingBlinkAmount;
+    volatile uint16_t timingBlinkDelay;
+    volatile uint8_t  timingSequence = 0;                   // Incremented by the loop before and after it writes the timing
+    uint8_t           appliedTimingSequence = 0;            // The last timing applied by the interrupt
+
+    static AnimationScheduler *frameTimerInstance; // The instance that is advanced by the frame timer
+};
+
+template<uint8_t channelCount, typename PwmSink, typename Listener> AnimationScheduler<channelCount, PwmSink, Listener> *AnimationScheduler<channelCount, PwmSink, Listener>::frameTimerInstance = NULL;
+
+/*
+  Creates an instance of the AnimationScheduler class. The animations are advanced from the main loop until the
+  frame timer is started.
+  pwmPins : the pwm pins to which the fairy light led strings are connected (through a mosfet), one per channel.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> AnimationScheduler<channelCount, PwmSink, Listener>::AnimationScheduler( const uint8_t ( &pwmPins )[ channelCount ] ) : animations( pwmPins ) {
+  for ( uint8_t channel = 0; channel < channelCount; channel++ ) {
+    this->fadeTargets[ channel ] = 0;
+    this->fadeScripts[ channel ] = SCRIPT_NONE;
+    this->fadeMinutes[ channel ] = 0;
+    this->fadeSequences[ channel ] = 0;
+    this->blinkSequences[ channel ] = 0;
+    this->appliedFadeSequences[ channel ] = 0;
+    this->appliedBlinkSequences[ channel ] = 0;
+    this->effects[ channel ] = AMBIENT_STEADY;
+  }
+}
+
+/*
+  Starts advancing the animations from the frame timer interrupt, with the given frame rate. Only one scheduler
+  can use the frame timer.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> void AnimationScheduler<channelCount, PwmSink, Listener>::startFrameTimer( uint8_t framesPerSecond ) {
+  frameTimerInstance = this;
+  this->frameTimerRunning = true;
+  frameTimerBegin( framesPerSecond, onFrame );
+}
+
+/*
+  Determines wether the animations are advanced by the frame timer (true) or by the main loop (false).
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> bool AnimationScheduler<channelCount, PwmSink, Listener>::isFrameTimerRunning() {
+  return this->frameTimerRunning;
+}
+
+/*
+  Starts a boundary reached animation on the given channel. When the frame timer is running the request is
+  handled in the next frame.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> void AnimationScheduler<channelCount, PwmSink, Listener>::startBoundaryReachedAnimation( uint8_t channel ) {
+  if ( this->frameTimerRunning ) {
+    this->blinkSequences[ channel ] = this->blinkSequences[ channel ] + 1;
+  }
+  else {
+    this->animations.startBoundaryReachedAnimation( channel );
+  }
+}
+
+/*
+  Transistions the given channel to the given target brightness level. When the frame timer is running the request
+  is handled in the next frame.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> void AnimationScheduler<channelCount, PwmSink, Listener>::fadeToBrightnessLevel( uint8_t channel, uint8_t targetLevel ) {
+  if ( this->frameTimerRunning ) {
+    this->fadeSequences[ channel ] = this->fadeSequences[ channel ] + 1; // Odd: the interrupt leaves the request alone
+    this->fadeTargets[ channel ] = targetLevel;
+    this->fadeScripts[ channel ] = SCRIPT_NONE;
+    this->fadeMinutes[ channel ] = 0;
+    this->fadeSequences[ channel ] = this->fadeSequences[ channel ] + 1; // Even again: the request is complete
+  }
+  else {
+    this->animations.fadeToBrightnessLevel( channel, targetLevel );
+  }
+}
+
+/*
+  Starts the given script on the given channel. When the frame timer is running the request is handled in the next
+  frame, so it returns true for every script that exists, not when it's started.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> bool AnimationScheduler<channelCount, PwmSink, Listener>::startScript( uint8_t channel, uint8_t script ) {
+  if ( this->frameTimerRunning ) {
+    if ( !( ( script >= 1 && script <= SCRIPT_BUILT_IN_COUNT ) || script == SCRIPT_EEPROM ) ) {
+      return false;
+    }
+    this->fadeSequences[ channel ] = this->fadeSequences[ channel ] + 1; // Odd: the interrupt leaves the request alone
+    this->fadeScripts[ channel ] = script;
+    this->fadeMinutes[ channel ] = 0;
+    this->fadeSequences[ channel ] = this->fadeSequences[ channel ] + 1; // Even again: the request is complete
+    return true;
+  }
+  return this->animations.startScript( channel, script );
+}
+
+/*
+  Fades the given channel to the given target brightness level in the given amount of minutes. When the frame timer
+  is running the request is handled in the next frame.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> void AnimationScheduler<channelCount, PwmSink, Listener>::startLongFade( uint8_t channel, uint8_t targetLevel, uint8_t minutes ) {
+  if ( this->frameTimerRunning ) {
+    this->fadeSequences[ channel ] = this->fadeSequences[ channel ] + 1; // Odd: the interrupt leaves the request alone
+    this->fadeTargets[ channel ] = targetLevel;
+    this->fadeScripts[ channel ] = SCRIPT_NONE;
+    this->fadeMinutes[ channel ] = minutes;
+    this->fadeSequences[ channel ] = this->fadeSequences[ channel ] + 1; // Even again: the request is complete
+  }
+  else {
+    this->animations.startLongFade( channel, targetLevel, minutes );
+  }
+}
+
+/*
+  Starts the given ambient effect (AMBIENT_EFFECTS) on the given channel, an unknown effect turns the effect off. When
+  the frame timer is running the effect is started in the next frame.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> void AnimationScheduler<channelCount, PwmSink, Listener>::setEffect( uint8_t channel, uint8_t effect ) {
+  this->effects[ channel ] = effect < AMBIENT_EFFECT_COUNT ? effect : (uint8_t)AMBIENT_STEADY;
+  if ( !this->frameTimerRunning ) {
+    this->animations.setEffect( channel, this->effects[ channel ] );
+  }
+}
+
+/*
+  Returns the ambient effect (AMBIENT_EFFECTS) of the given channel, the one that was requested last.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> uint8_t AnimationScheduler<channelCount, PwmSink, Listener>::getEffect( uint8_t channel ) {
+  return this->effects[ channel ];
+}
+
+/*
+  Sets the timing of the fades and the boundary reached blinks of all channels, see AnimationManager::setTiming().
+  When the frame timer is running it's applied in the next frame.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> void AnimationScheduler<channelCount, PwmSink, Listener>::setTiming( uint16_t fadeStepDuration, uint8_t blinkAmount, uint16_t blinkDelay ) {
+  if ( this->frameTimerRunning ) {
+    this->timingSequence = this->timingSequence + 1; // Odd: the interrupt leaves the timing alone
+    this->timingStepDuration = fadeStepDuration;
+    this->timingBlinkAmount = blinkAmount;
+    this->timingBlinkDelay = blinkDelay;
+    this->timingSequence = this->timingSequence + 1; // Even again: the timing is complete
+  }
+  else {
+    this->animations.setTiming( fadeStepDuration, blinkAmount, blinkDelay );
+  }
+}
+
+/*
+  determines wether the animations of all channels are finised (true) or if an animation is running or waiting for
+  the next frame (false).
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> bool AnimationScheduler<channelCount, PwmSink, Listener>::animationFinished() {
+  for ( uint8_t channel = 0; channel < channelCount; channel++ ) {
+    if ( !this->animationFinished( channel ) ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+  determines wether the animation of the given channel is finised (true) or if an animation is running or waiting
+  for the next frame (false).
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> bool AnimationScheduler<channelCount, PwmSink, Listener>::animationFinished( uint8_t channel ) {
+  return this->fadeSequences[ channel ] == this->appliedFadeSequences[ channel ] &&
+         this->blinkSequences[ channel ] == this->appliedBlinkSequences[ channel ] &&
+         this->animations.animationFinished( channel );
+}
+
+/*
+  Checks and handles the animations when they are advanced by the main loop. Must be called from the main loop for
+  each cycle. Does nothing when the frame timer is running.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> void AnimationScheduler<channelCount, PwmSink, Listener>::checkAnimation( unsigned long currentMillis ) {
+  if ( !this->frameTimerRunning ) {
+    this->animations.checkAnimation( currentMillis );
+  }
+}
+
+/*
+  Returns the amount of ms until the next step of the long fades when they're advanced by the main loop, the loop has
+  to run by then. Returns LONG_FADE_NO_CHANGE when no long fade is running or the frame timer advances them.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> unsigned long AnimationScheduler<channelCount, PwmSink, Listener>::getNextChange( unsigned long currentMillis ) {
+  return this->frameTimerRunning ? LONG_FADE_NO_CHANGE : this->animations.getNextChange( currentMillis );
+}
+
+/*
+  Frame timer handler (interrupt context): applies the requests posted by the loop and advances the animations.
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> void AnimationScheduler<channelCount, PwmSink, Listener>::onFrame( unsigned long frameMillis ) {
+  frameTimerInstance->handleRequests();
+  frameTimerInstance->animations.checkAnimation( frameMillis );
+}
+
+/*
+  Applies the timing, fade, script, boundary reached and effect requests that were posted since the previous frame
+  (interrupt context).
+*/
+template<uint8_t channelCount, typename PwmSink, typename Listener> void AnimationScheduler<channelCount, PwmSink, Listener>::handleRequests() {
+  uint8_t timing = this->timingSequence;
+  if ( timing != this->appliedTimingSequence && ( timing & 1 ) == 0 ) {
+    this->animations.setTiming( this->timingStepDuration, this->timingBlinkAmount, this->timingBlinkDelay );
+    this->appliedTimingSequence = timing;
+  }
+
+  for ( uint8_t channel = 0; channel < channelCount; channel++ ) {
+    uint8_t sequence = this->fadeSequences[ channel ];
+    if ( sequence != this->appliedFadeSequences[ channel ] && ( sequence & 1 ) == 0 ) {
+      // The target is the last one the loop asked for, so a fade that was posted just before the script (like
+      // turning the channel on) isn't lost: the channel fades back to it when the script ends.
+      if ( this->fadeMinutes[ channel ] != 0 ) {
+        this->animations.startLongFade( channel, this->fadeTargets[ channel ], this->fadeMinutes[ channel ] );
+      }
+      else {
+        this->animations.fadeToBrightnessLevel( channel, this->fadeTargets[ channel ] );
+      }
+      if ( this->fadeScripts[ channel ] != SCRIPT_NONE ) {
+        this->animations.startScript( channel, this->fadeScripts[ channel ] );
+      }
+      this->appliedFadeSequences[ channel ] = sequence;
+    }
+
+    sequence = this->blinkSequences[ channel ];
+    if ( sequence != this->appliedBlinkSequences[ channel ] ) {
+      this->animations.startBoundaryReachedAnimation( channel );
+      this->appliedBlinkSequences[ channel ] = sequence;
+    }
+
+    uint8_t effect = this->effects[ channel ];
+    if ( effect != this->animations.getEffect( channel ) ) {
+      this->animations.setEffect( channel, effect );
+    }
+  }
+}
+
+#endif
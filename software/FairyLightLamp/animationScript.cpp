@@ -0,0 +1,339 @@
+#include "animationScript.h"
+#include "xorshift16.h"
+
+// The states of the interpreter
+const uint8_t SCRIPT_STOPPED  = 0;
+const uint8_t SCRIPT_RUNNING  = 1;
+const uint8_t SCRIPT_FADING   = 2;
+const uint8_t SCRIPT_HOLDING  = 3;
+const uint8_t SCRIPT_BLINKING = 4;
+
+/*
+  The built-in scripts in flash, script number 1 is the first one.
+*/
+
+// Breathe: slowly fades between a dim and a bright level, forever.
+const uint8_t breatheScript[] PROGMEM = {
+  SCRIPT_OP_FADE( 40, 2500 ),  // 0
+  SCRIPT_OP_HOLD( 300 ),       // 4
+  SCRIPT_OP_FADE( 200, 2500 ), // 7
+  SCRIPT_OP_HOLD( 300 ),       // 11
+  SCRIPT_OP_JUMP( 0 )          // 14
+};
+
+// Flicker: fades to a random level at a random pace, like a candle in a draft, forever.
+const uint8_t flickerScript[] PROGMEM = {
+  SCRIPT_OP_RAND( 0, 90, 200 ),                // 0  R0 = the level
+  SCRIPT_OP_RAND( 1, 40, 160 ),                // 6  R1 = the duration of the fade
+  SCRIPT_FADE | SCRIPT_REGISTER_1 | SCRIPT_REGISTER_2, 0, 1, // 12 FADE R0, R1
+  SCRIPT_OP_RAND( 1, 0, 120 ),                 // 15 R1 = the duration of the hold
+  SCRIPT_HOLD | SCRIPT_REGISTER_1, 1,          // 21 HOLD R1
+  SCRIPT_OP_JUMP( 0 )                          // 23
+};
+
+// Party: 5 quick blinks at full brightness followed by a slow fade, 3 times.
+const uint8_t partyScript[] PROGMEM = {
+  SCRIPT_OP_SET( 0, 3 ),        // 0
+  SCRIPT_OP_LEVEL( 255 ),       // 4
+  SCRIPT_OP_BLINK( 5, 120 ),    // 6
+  SCRIPT_OP_FADE( 30, 1500 ),   // 10
+  SCRIPT_OP_FADE( 255, 1500 ),  // 14
+  SCRIPT_OP_DJNZ( 0, 4 ),       // 18
+  SCRIPT_OP_END                 // 21
+};
+
+static const uint8_t *const builtInScripts[ SCRIPT_BUILT_IN_COUNT ] = { breatheScript, flickerScript, partyScript };
+static const uint8_t        builtInScriptLengths[ SCRIPT_BUILT_IN_COUNT ] = { sizeof( breatheScript ), sizeof( flickerScript ), sizeof( partyScript ) };
+
+// The random generator of the RAND instruction, shared by all channels
+static Xorshift16 generator;
+
+/*
+  Returns the value of the given hex digit, or 0xFF when it isn't a hex digit.
+*/
+static uint8_t hexValue( char digit ) {
+  if ( digit >= '0' && digit <= '9' ) {
+    return digit - '0';
+  }
+  if ( digit >= 'A' && digit <= 'F' ) {
+    return digit - 'A' + 10;
+  }
+  if ( digit >= 'a' && digit <= 'f' ) {
+    return digit - 'a' + 10;
+  }
+  return 0xFF;
+}
+
+/*
+  Stores a chunk of the uploaded script in the EEPROM. The uploaded script can't be used while it's being
+  uploaded, the chunk at offset 0 removes the current script until animationScriptCommit() is called.
+  offset  : the offset of the chunk in the script.
+  hexChunk: the instructions as hex digits (two per byte), like "0228C409".
+  Returns false when the chunk isn't valid or doesn't fit.
+*/
+bool animationScriptUpload( uint8_t offset, const char *hexChunk ) {
+  uint8_t length = 0;
+  while ( hexChunk[ length * 2 ] != '\0' ) {
+    if ( hexValue( hexChunk[ length * 2 ] ) == 0xFF || hexValue( hexChunk[ length * 2 + 1 ] ) == 0xFF ) {
+      return false;
+    }
+    length++;
+  }
+  if ( length == 0 || offset + length > EEPROM_SCRIPT_SIZE - 1 ) {
+    return false;
+  }
+
+  if ( offset == 0 ) {
+    halEepromUpdate( EEPROM_SCRIPT_ADDRESS, 0 );
+  }
+  for ( uint8_t index = 0; index < length; index++ ) {
+    uint8_t value = hexValue( hexChunk[ index * 2 ] ) << 4 | hexValue( hexChunk[ index * 2 + 1 ] );
+    halEepromUpdate( EEPROM_SCRIPT_ADDRESS + 1 + offset + index, value );
+  }
+  return true;
+}
+
+/*
+  Makes the uploaded script with the given length available as script SCRIPT_EEPROM.
+  Returns false when the length doesn't fit.
+*/
+bool animationScriptCommit( uint8_t length ) {
+  if ( length == 0 || length > EEPROM_SCRIPT_SIZE - 1 ) {
+    return false;
+  }
+  halEepromUpdate( EEPROM_SCRIPT_ADDRESS, length );
+  return true;
+}
+
+
+//                              ScriptAnimation
+
+/*
+  Creates an instance of the ScriptAnimation class, no script is running.
+*/
+ScriptAnimation::ScriptAnimation() {
+  this->flashCode = NULL;
+  this->length = 0;
+  this->pc = 0;
+  this->state = SCRIPT_STOPPED;
+  this->level = 0;
+  this->fadeFrom = 0;
+  this->fadeTo = 0;
+  this->blinkPhases = 0;
+  this->duration = 0;
+  this->started = 0;
+  for ( uint8_t index = 0; index < SCRIPT_REGISTERS; index++ ) {
+    this->registers[ index ] = 0;
+  }
+}
+
+/*
+  Starts the given script.
+  script      : the number of the script, 1 - SCRIPT_BUILT_IN_COUNT or SCRIPT_EEPROM.
+  currentLevel: the current level of the channel, where the script starts.
+  Returns false when the script doesn't exist, the running script (if any) keeps running in that case.
+*/
+bool ScriptAnimation::startScript( uint8_t script, uint8_t currentLevel ) {
+  if ( script >= 1 && script <= SCRIPT_BUILT_IN_COUNT ) {
+    this->flashCode = builtInScripts[ script - 1 ];
+    this->length = builtInScriptLengths[ script - 1 ];
+  }
+  else if ( script == SCRIPT_EEPROM ) {
+    uint8_t length = halEepromRead( EEPROM_SCRIPT_ADDRESS );
+    if ( length == 0 || length > EEPROM_SCRIPT_SIZE - 1 ) {
+      return false;
+    }
+    this->flashCode = NULL;
+    this->length = length;
+  }
+  else {
+    return false;
+  }
+
+  this->pc = 0;
+  this->level = currentLevel;
+  this->state = SCRIPT_RUNNING;
+  this->started = halMillis();
+  return true;
+}
+
+/*
+  Stops the running script, the level stays where it is.
+*/
+void ScriptAnimation::stopScript() {
+  this->state = SCRIPT_STOPPED;
+}
+
+/*
+  Determines wether the script has stopped (true) or is still running (false).
+*/
+bool ScriptAnimation::animationFinished() {
+  return this->state == SCRIPT_STOPPED;
+}
+
+/*
+  Returns the current level (lightness) of the script.
+*/
+uint8_t ScriptAnimation::getCurrentBrightnessLevel() {
+  return this->level;
+}
+
+/*
+  Runs the script: continues the running timed instruction and when it has ended executes the next instructions,
+  until the next timed instruction or the maximum amount of instructions per tick. Must be called from the main
+  loop (or the frame timer) for each cycle. Returns true when the script ended during this call.
+*/
+bool ScriptAnimation::checkAnimation( unsigned long currentMillis ) {
+  uint8_t instructions = 0;
+
+  if ( this->state == SCRIPT_STOPPED ) {
+    return false;
+  }
+  while ( this->state != SCRIPT_STOPPED ) {
+    if ( this->state != SCRIPT_RUNNING && !this->continueTimedInstruction( currentMillis ) ) {
+      return false;
+    }
+    if ( instructions++ == SCRIPT_MAX_INSTRUCTIONS ) {
+      return false;
+    }
+    this->executeInstruction();
+  }
+  return true;
+}
+
+/*
+  Continues the running fade, hold or blink. Returns true when it has ended, the next timed instruction starts at
+  the moment this one ended.
+*/
+bool ScriptAnimation::continueTimedInstruction( unsigned long currentMillis ) {
+  unsigned long elapsed = currentMillis - this->started;
+
+  if ( this->state == SCRIPT_BLINKING ) {
+    while ( elapsed >= this->duration && this->blinkPhases > 0 ) {
+      this->started += this->duration;
+      elapsed -= this->duration;
+      this->blinkPhases--;
+      this->level = ( this->blinkPhases & 1 ) || this->blinkPhases == 0 ? this->fadeTo : 0;
+    }
+    if ( this->blinkPhases > 0 ) {
+      return false;
+    }
+  }
+  else {
+    if ( elapsed < this->duration ) {
+      if ( this->state == SCRIPT_FADING ) {
+        this->level = this->fadeFrom + (int16_t)( ( (int32_t)( this->fadeTo - this->fadeFrom ) * (int32_t)elapsed ) / this->duration );
+      }
+      return false;
+    }
+    this->started += this->duration;
+    if ( this->state == SCRIPT_FADING ) {
+      this->level = this->fadeTo;
+    }
+  }
+
+  this->state = SCRIPT_RUNNING;
+  return true;
+}
+
+/*
+  Returns the next byte of the script and moves the program counter. Reads SCRIPT_END after the end of the script.
+*/
+uint8_t ScriptAnimation::readByte() {
+  if ( this->pc >= this->length ) {
+    return SCRIPT_END;
+  }
+  uint8_t value = this->flashCode != NULL ? pgm_read_byte( &this->flashCode[ this->pc ] ) : halEepromRead( EEPROM_SCRIPT_ADDRESS + 1 + this->pc );
+  this->pc++;
+  return value;
+}
+
+/*
+  Reads the given value operand (0 or 1) of the given opcode (with the register flags): either a register or a
+  value of 8 or 16 bits.
+*/
+uint16_t ScriptAnimation::readValue( uint8_t opcode, uint8_t operand ) {
+  if ( opcode & ( operand == 0 ? SCRIPT_REGISTER_1 : SCRIPT_REGISTER_2 ) ) {
+    return this->registers[ this->readByte() & ( SCRIPT_REGISTERS - 1 ) ];
+  }
+  uint16_t value = this->readByte();
+  if ( scriptValueIsWide( opcode & SCRIPT_OPCODE_MASK, operand ) ) {
+    value |= (uint16_t)this->readByte() << 8;
+  }
+  return value;
+}
+
+/*
+  Executes the instruction at the program counter.
+*/
+void ScriptAnimation::executeInstruction() {
+  uint8_t opcode = this->readByte();
+  uint8_t target;
+
+  switch ( opcode & SCRIPT_OPCODE_MASK ) {
+    case SCRIPT_LEVEL: {
+        uint16_t value = this->readValue( opcode, 0 );
+        this->level = value > 255 ? 255 : value;
+        break;
+      }
+    case SCRIPT_FADE: {
+        uint16_t value = this->readValue( opcode, 0 );
+        this->fadeFrom = this->level;
+        this->fadeTo = value > 255 ? 255 : value;
+        this->duration = this->readValue( opcode, 1 );
+        this->state = SCRIPT_FADING;
+        break;
+      }
+    case SCRIPT_HOLD: {
+        this->duration = this->readValue( opcode, 0 );
+        this->state = SCRIPT_HOLDING;
+        break;
+      }
+    case SCRIPT_BLINK: {
+        uint16_t count = this->readValue( opcode, 0 );
+        this->duration = this->readValue( opcode, 1 );
+        if ( count > 0 ) {
+          this->fadeTo = this->level;
+          this->blinkPhases = count > 127 ? 254 : count * 2;
+          this->level = 0; // A blink starts with the off phase
+          this->state = SCRIPT_BLINKING;
+        }
+        break;
+      }
+    case SCRIPT_SET: {
+        target = this->readByte() & ( SCRIPT_REGISTERS - 1 );
+        this->registers[ target ] = this->readValue( opcode, 0 );
+        break;
+      }
+    case SCRIPT_RAND: {
+        target = this->readByte() & ( SCRIPT_REGISTERS - 1 );
+        uint16_t minimum = this->readValue( opcode, 0 );
+        uint16_t maximum = this->readValue( opcode, 1 );
+        uint16_t range = maximum - minimum + 1;
+        this->registers[ target ] = range == 0 ? generator.next() : minimum + generator.next() % range;
+        break;
+      }
+    case SCRIPT_ADD: {
+        target = this->readByte() & ( SCRIPT_REGISTERS - 1 );
+        this->registers[ target ] += this->readValue( opcode, 0 );
+        break;
+      }
+    case SCRIPT_DJNZ: {
+        target = this->readByte() & ( SCRIPT_REGISTERS - 1 );
+        uint8_t address = this->readByte();
+        this->registers[ target ]--;
+        if ( this->registers[ target ] != 0 ) {
+          this->pc = address;
+        }
+        break;
+      }
+    case SCRIPT_JUMP: {
+        this->pc = this->readByte();
+        break;
+      }
+    default: { // SCRIPT_END or an unknown instruction
+        this->state = SCRIPT_STOPPED;
+        break;
+      }
+  }
+}
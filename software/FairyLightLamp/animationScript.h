@@ -0,0 +1,140 @@
+#ifndef ANIMATION_SCRIPT_H
+#define ANIMATION_SCRIPT_H
+
+#include "hal.h"
+#include "ledAnimation.h"
+
+/*
+  Library for running animation scripts: small bytecode programs that animate the brightness of a channel.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  The animations of ledAnimation.h are C++ classes, so each new effect means flashing every lamp. A script is a
+  list of instructions that is executed by a tiny interpreter (ScriptAnimation). The built-in scripts are stored
+  in flash, one more script can be uploaded through MySensors and is stored in the EEPROM.
+
+  The interpreter has 4 registers (R0 - R3) of 16 bits and uses a fixed amount of RAM per channel. Each tick it
+  continues the running timed instruction (fade, hold or blink) and executes the next instructions until it
+  reaches a timed instruction, with a maximum of SCRIPT_MAX_INSTRUCTIONS per tick, so an endless loop without a
+  timed instruction can't block the sketch. A timed instruction starts where the previous one ended, so a script
+  doesn't drift when a tick is late.
+
+  Instructions, an operand marked with * can be a register (see SCRIPT_REGISTER_1 and SCRIPT_REGISTER_2):
+    END                    0x00              stops the script, the channel fades back to its brightness level
+    LEVEL  *level          0x01 l            sets the level (lightness 0-255) immediately
+    FADE   *level, *ms     0x02 l ms ms      fades linearly from the current level to the given level
+    HOLD   *ms             0x03 ms ms        keeps the current level
+    BLINK  *count, *ms     0x04 c ms ms      blinks off the given amount of times, ms for each off and on
+    SET    Rn, *value      0x05 n v v        Rn = value
+    RAND   Rn, *min, *max  0x06 n a a b b    Rn = a random value from min up to and including max
+    ADD    Rn, *value      0x07 n v v        Rn = Rn + value (wraps around, so a negative value subtracts)
+    DJNZ   Rn, address     0x08 n a          Rn = Rn - 1, jumps to the address when Rn isn't zero
+    JUMP   address         0x09 a            jumps to the address
+  All values are little endian, addresses are the offset of an instruction in the script. When an operand is a
+  register, the register number (a single byte) takes the place of the value. The macros below can be used to
+  write a script in C++, the host assembler (software/host/scriptAssembler.cpp) translates a text file.
+
+  Scripts are identified by a number: 1 - SCRIPT_BUILT_IN_COUNT are the built-in scripts and SCRIPT_EEPROM is the
+  uploaded script. The uploaded script is stored from EEPROM_SCRIPT_ADDRESS: first the length of the script (0 or
+  0xFF when there's no script) followed by the instructions. It's uploaded in chunks with animationScriptUpload()
+  and becomes available with animationScriptCommit().
+
+  Revision history:
+    16-10-2026 Initial version.
+    16-10-2026 checkAnimation() returns true when the script ended, instead of calling a listener.
+    17-10-2026 RAND uses the shared Xorshift16 generator (xorshift16.h).
+*/
+
+const uint8_t SCRIPT_REGISTERS = 4;
+const uint8_t SCRIPT_MAX_INSTRUCTIONS = 16; // The maximum amount of instructions per tick
+
+// The opcodes
+const uint8_t SCRIPT_END   = 0x00;
+const uint8_t SCRIPT_LEVEL = 0x01;
+const uint8_t SCRIPT_FADE  = 0x02;
+const uint8_t SCRIPT_HOLD  = 0x03;
+const uint8_t SCRIPT_BLINK = 0x04;
+const uint8_t SCRIPT_SET   = 0x05;
+const uint8_t SCRIPT_RAND  = 0x06;
+const uint8_t SCRIPT_ADD   = 0x07;
+const uint8_t SCRIPT_DJNZ  = 0x08;
+const uint8_t SCRIPT_JUMP  = 0x09;
+
+// Added to an opcode when the first or second value operand is a register
+const uint8_t SCRIPT_REGISTER_1 = 0x80;
+const uint8_t SCRIPT_REGISTER_2 = 0x40;
+const uint8_t SCRIPT_OPCODE_MASK = 0x3F;
+
+// The script numbers
+const uint8_t SCRIPT_NONE = 0;
+const uint8_t SCRIPT_BUILT_IN_COUNT = 3;
+const uint8_t SCRIPT_EEPROM = 255;
+
+// The EEPROM area of the uploaded script: the length followed by the instructions. MySensors uses the EEPROM up to
+// its local config area (loadState() and saveState()), which ends around address 670.
+const uint16_t EEPROM_SCRIPT_ADDRESS = 896;
+const uint8_t  EEPROM_SCRIPT_SIZE = 128;
+
+// Macros for writing a script in C++
+#define SCRIPT_VALUE( value )         (uint8_t)( (uint16_t)( value ) & 0xFF ), (uint8_t)( (uint16_t)( value ) >> 8 )
+#define SCRIPT_OP_END                 SCRIPT_END
+#define SCRIPT_OP_LEVEL( level )      SCRIPT_LEVEL, ( level )
+#define SCRIPT_OP_FADE( level, ms )   SCRIPT_FADE, ( level ), SCRIPT_VALUE( ms )
+#define SCRIPT_OP_HOLD( ms )          SCRIPT_HOLD, SCRIPT_VALUE( ms )
+#define SCRIPT_OP_BLINK( count, ms )  SCRIPT_BLINK, ( count ), SCRIPT_VALUE( ms )
+#define SCRIPT_OP_SET( r, value )     SCRIPT_SET, ( r ), SCRIPT_VALUE( value )
+#define SCRIPT_OP_RAND( r, min, max ) SCRIPT_RAND, ( r ), SCRIPT_VALUE( min ), SCRIPT_VALUE( max )
+#define SCRIPT_OP_ADD( r, value )     SCRIPT_ADD, ( r ), SCRIPT_VALUE( value )
+#define SCRIPT_OP_DJNZ( r, address )  SCRIPT_DJNZ, ( r ), ( address )
+#define SCRIPT_OP_JUMP( address )     SCRIPT_JUMP, ( address )
+
+/*
+  Returns the amount of value operands of the given opcode (without the register flags) and wether they're 16 bits.
+  Used by the interpreter and the assembler, so they can't disagree on the encoding.
+*/
+inline uint8_t scriptValueOperands( uint8_t opcode ) {
+  return opcode == SCRIPT_FADE || opcode == SCRIPT_BLINK || opcode == SCRIPT_RAND ? 2 :
+         opcode == SCRIPT_LEVEL || opcode == SCRIPT_HOLD || opcode == SCRIPT_SET || opcode == SCRIPT_ADD ? 1 : 0;
+}
+
+inline bool scriptValueIsWide( uint8_t opcode, uint8_t operand ) {
+  return !( ( opcode == SCRIPT_LEVEL || opcode == SCRIPT_FADE || opcode == SCRIPT_BLINK ) && operand == 0 );
+}
+
+bool animationScriptUpload( uint8_t offset, const char *hexChunk );
+bool animationScriptCommit( uint8_t length );
+
+/*
+  Class for running a script on a channel. See the cpp file for the documentation.
+*/
+class ScriptAnimation {
+  public:
+    ScriptAnimation();
+
+    bool startScript( uint8_t script, uint8_t currentLevel );
+    void stopScript();
+    bool checkAnimation( unsigned long currentMillis );
+    bool animationFinished();
+
+    uint8_t getCurrentBrightnessLevel();
+  private:
+    uint8_t  readByte();
+    uint16_t readValue( uint8_t opcode, uint8_t operand );
+    bool     continueTimedInstruction( unsigned long currentMillis );
+    void     executeInstruction();
+
+    const uint8_t *flashCode;   // The instructions of a built-in script, NULL when the script is in the EEPROM
+    uint8_t        length;      // The length of the script
+    uint8_t        pc;          // The address of the next instruction
+    uint8_t        state;       // Stopped, running or the timed instruction that's running
+    uint8_t        level;       // The current level (lightness)
+    uint8_t        fadeFrom;    // The level at the start of a fade
+    uint8_t        fadeTo;      // The target of a fade, or the on level of a blink
+    uint8_t        blinkPhases; // The amount of off and on phases left of a blink
+    uint16_t       duration;    // The duration of the timed instruction, or of a phase of a blink
+    unsigned long  started;     // millis() at which the timed instruction (or blink phase) started
+    uint16_t       registers[ SCRIPT_REGISTERS ];
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include "batteryMonitor.h"
+
+#ifdef ARDUINO
+#include <avr/power.h>
+#include <avr/sleep.h>
+
+const uint8_t BATTERY_BANDGAP_CHANNEL = 0x0E; // MUX3..0 of the 1.1V bandgap
+#if F_CPU > 8000000
+const uint8_t BATTERY_PRESCALER_BITS = _BV( ADPS2 ) | _BV( ADPS1 ) | _BV( ADPS0 ); // 128
+#else
+const uint8_t BATTERY_PRESCALER_BITS = _BV( ADPS2 ) | _BV( ADPS1 );                // 64
+#endif
+
+EMPTY_INTERRUPT( ADC_vect ); // Only wakes up the node from the noise reduction sleep
+
+/*
+  Does a single conversion and returns its result. In the noise reduction sleep the conversion starts when the node
+  goes to sleep. Another interrupt (like the tick of millis()) may wake it up first, then it sleeps again. When the
+  conversion ends just before the next sleep, that sleep starts another conversion and waits for it.
+*/
+static uint16_t readConversion( bool noiseReduction ) {
+  if ( noiseReduction ) {
+    set_sleep_mode( SLEEP_MODE_ADC );
+    sleep_enable();
+    do {
+      sleep_cpu();
+    } while ( bit_is_set( ADCSRA, ADSC ) );
+    sleep_disable();
+  }
+  else {
+    ADCSRA |= _BV( ADSC );
+    loop_until_bit_is_clear( ADCSRA, ADSC );
+  }
+  return ADC;
+}
+#endif
+
+/*
+  Measures VCC and returns it in mV. The ADC is powered up for the measurement only.
+
+  bandgapMillivolts: the voltage of the bandgap reference of this chip, nominal 1100.
+  noiseReduction   : convert in the ADC noise reduction sleep, only when the PWM may freeze for a moment.
+*/
+uint16_t batteryReadMillivolts( uint16_t bandgapMillivolts, bool noiseReduction ) {
+  uint16_t sum = 0;
+#ifdef ARDUINO
+  power_adc_enable();
+  ADMUX = _BV( REFS0 ) | BATTERY_BANDGAP_CHANNEL; // VCC as reference
+  ADCSRA = _BV( ADEN ) | ( noiseReduction ? _BV( ADIE ) : 0 ) | BATTERY_PRESCALER_BITS;
+  delayMicroseconds( BATTERY_SETTLE_MICROS );
+  readConversion( noiseReduction ); // Still off while the reference settles
+  for ( uint8_t cnt = 0; cnt < BATTERY_CONVERSIONS; cnt++ ) {
+    sum += readConversion( noiseReduction );
+  }
+  ADCSRA = 0;
+  power_adc_disable();
+#else
+  (void)noiseReduction;
+  uint32_t reading = ( (uint32_t)bandgapMillivolts * 1023 + hostVcc() / 2 ) / hostVcc();
+  sum = BATTERY_CONVERSIONS * ( reading == 0 ? 1 : reading > 1023 ? 1023 : reading );
+#endif
+  return sum == 0 ? 0xFFFF : (uint16_t)( (uint32_t)bandgapMillivolts * 1023 * BATTERY_CONVERSIONS / sum );
+}
+
+/*
+  Returns the battery level in percent (0 - 100) of the given voltage, linear between the empty and the full voltage.
+  The discharge curve of alkaline cells isn't linear, but it's good enough to know when to swap them.
+*/
+uint8_t batteryPercentage( uint16_t millivolts, uint16_t emptyMillivolts, uint16_t fullMillivolts ) {
+  if ( millivolts <= emptyMillivolts ) {
+    return 0;
+  }
+  if ( millivolts >= fullMillivolts ) {
+    return 100;
+  }
+  return (uint32_t)( millivolts - emptyMillivolts ) * 100 / ( fullMillivolts - emptyMillivolts );
+}
+
+/*
+  Returns the cap on the lightness of the brightness levels (BATTERY_FULL_CAP is no cap) for the given voltage: no cap
+  from capFromMillivolts up, linear down to minimumCap at the empty voltage and below.
+*/
+uint8_t batteryBrightnessCap( uint16_t millivolts, uint16_t capFromMillivolts, uint16_t emptyMillivolts, uint8_t minimumCap ) {
+  if ( millivolts >= capFromMillivolts ) {
+    return BATTERY_FULL_CAP;
+  }
+  if ( millivolts <= emptyMillivolts ) {
+    return minimumCap;
+  }
+  return minimumCap + (uint32_t)( BATTERY_FULL_CAP - minimumCap ) * ( millivolts - emptyMillivolts ) /
+                      ( capFromMillivolts - emptyMillivolts );
+}
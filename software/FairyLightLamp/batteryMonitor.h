@@ -0,0 +1,43 @@
+#ifndef BATTERY_MONITOR_H
+#define BATTERY_MONITOR_H
+
+#include "hal.h"
+
+/*
+  Library for measuring the battery voltage of a node that runs directly on its batteries (no voltage regulator), and
+  for turning the voltage into a battery level and a cap on the brightness.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  The ADC measures the internal bandgap reference (about 1.1V) with VCC as its reference, so VCC follows from the
+  reading: VCC = bandgap * 1023 / reading. No pin and no voltage divider is needed. The bandgap differs per chip
+  (1.0 - 1.2V), the sketch passes the calibrated value.
+
+  The ADC is off between the samples, before() of the sketch turns it off. batteryReadMillivolts() powers it up, waits
+  BATTERY_SETTLE_MICROS for the reference to settle, throws away the first conversion and averages the next
+  BATTERY_CONVERSIONS. Then it powers the ADC down again, including its clock (PRR). With noiseReduction the conversions
+  are done in the ADC noise reduction sleep mode, which stops the CPU and the I/O clock while the ADC converts. That
+  is more accurate and draws less current, but it also stops Timer0 and Timer1, so the PWM of the channels freezes for
+  about 0.6ms. Only use it when the channels are off.
+
+  The energy of a sample is modeled by the host (software/host/batteryModel.cpp), with these constants.
+
+  On the host the voltage is set by the simulation (hostSetVcc()), the reading goes through the same 10 bit math.
+
+  Revision history:
+    16-10-2026 Initial version.
+*/
+
+const uint16_t BATTERY_SETTLE_MICROS = 1000;   // The reference settles after the ADC was powered up
+const uint8_t  BATTERY_CONVERSIONS = 4;        // The conversions that are averaged, after the first one
+const uint32_t BATTERY_ADC_CLOCK = 125000;     // Hz, the prescaler is chosen for this clock on 8MHz and 16MHz boards
+const uint8_t  BATTERY_FIRST_CONVERSION_CLOCKS = 25; // ADC clocks of the first conversion after the ADC was enabled
+const uint8_t  BATTERY_CONVERSION_CLOCKS = 13;       // ADC clocks of the next conversions
+const uint8_t  BATTERY_FULL_CAP = 255;         // The brightness cap that doesn't cap at all
+
+uint16_t batteryReadMillivolts( uint16_t bandgapMillivolts, bool noiseReduction );
+uint8_t  batteryPercentage( uint16_t millivolts, uint16_t emptyMillivolts, uint16_t fullMillivolts );
+uint8_t  batteryBrightnessCap( uint16_t millivolts, uint16_t capFromMillivolts, uint16_t emptyMillivolts, uint8_t minimumCap );
+
+#endif
@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include "commandInbox.h"
+
+/*
+  Creates an instance of the CommandInbox class, empty.
+*/
+CommandInbox::CommandInbox() {
+  this->head = 0;
+  this->count = 0;
+  this->resetCounters();
+}
+
+/*
+  Posts a command with the given child, type and flags (COMMAND_BROADCAST and COMMAND_COALESCE), and the numbers of
+  the given payload. A waiting command for the same child and type is removed when both may be coalesced.
+  Returns false when the inbox is full, the command is dropped in that case.
+*/
+bool CommandInbox::post( uint8_t sensor, uint8_t type, uint8_t flags, const char *payload ) {
+  if ( flags & COMMAND_COALESCE ) {
+    for ( uint8_t index = 0; index < this->count; index++ ) {
+      InboxCommand &command = this->waiting( index );
+      if ( ( command.flags & COMMAND_COALESCE ) && command.sensor == sensor && command.type == type ) {
+        this->remove( index );
+        if ( this->coalescedCount < 255 ) {
+          this->coalescedCount++;
+        }
+        break; // There's at most one, it was coalesced when it was posted
+      }
+    }
+  }
+
+  if ( this->count == COMMAND_INBOX_SIZE ) {
+    if ( this->droppedCount < 255 ) {
+      this->droppedCount++;
+    }
+    return false;
+  }
+  InboxCommand &command = this->waiting( this->count );
+  char *rest;
+  unsigned long value = strtoul( payload, &rest, 10 );
+  command.sensor = sensor;
+  command.type = type;
+  command.flags = flags;
+  command.value = value > 0xFFFF ? 0xFFFF : value;
+  command.argument = strtoul( rest, NULL, 10 );
+  this->count++;
+  return true;
+}
+
+/*
+  Copies the oldest waiting command to the given command and removes it from the inbox. Returns false when the inbox
+  is empty.
+*/
+bool CommandInbox::read( InboxCommand &command ) {
+  if ( this->count == 0 ) {
+    return false;
+  }
+  command = this->commands[ this->head ];
+  this->head = ( this->head + 1 ) & ( COMMAND_INBOX_SIZE - 1 );
+  this->count--;
+  return true;
+}
+
+/*
+  Determines wether no command is waiting (true).
+*/
+bool CommandInbox::isEmpty() {
+  return this->count == 0;
+}
+
+/*
+  Returns the waiting command at the given position, 0 being the oldest one.
+*/
+InboxCommand &CommandInbox::waiting( uint8_t index ) {
+  return this->commands[ ( this->head + index ) & ( COMMAND_INBOX_SIZE - 1 ) ];
+}
+
+/*
+  Removes the waiting command at the given position, the newer ones move up a position.
+*/
+void CommandInbox::remove( uint8_t index ) {
+  for ( ; index + 1 < this->count; index++ ) {
+    this->waiting( index ) = this->waiting( index + 1 );
+  }
+  this->count--;
+}
+
+/*
+  Returns the amount of commands that were replaced by a newer one since the counters were reset, at most 255.
+*/
+uint8_t CommandInbox::getCoalescedCount() {
+  return this->coalescedCount;
+}
+
+/*
+  Returns the amount of commands dropped because the inbox was full since the counters were reset, at most 255.
+*/
+uint8_t CommandInbox::getDroppedCount() {
+  return this->droppedCount;
+}
+
+/*
+  Resets the counters, e.g. after they were reported with the heart beat.
+*/
+void CommandInbox::resetCounters() {
+  this->coalescedCount = 0;
+  this->droppedCount = 0;
+}
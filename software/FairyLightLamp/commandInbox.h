@@ -0,0 +1,85 @@
+#ifndef COMMAND_INBOX_H
+#define COMMAND_INBOX_H
+
+#include "hal.h"
+
+/*
+  Library for receiving the commands of the controller into a buffer, which the main loop drains, instead of
+  handling them in the receive() callback of MySensors.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  When a slider of the controller is dragged, the node receives a burst of brightness messages. Handling each one in
+  receive() retargets the fade of the channel for every message, each time from the start of the easing curve, and
+  keeps MySensors from reading the radio in the mean time. The messages of the burst that arrive while the loop is
+  busy pile up in the FIFO of the radio (3 messages) and the rest is lost.
+
+  receive() now only posts the command to the inbox: the child, the type, wether it was a broadcast, and the numbers
+  of the payload (the payloads of the commands are one or two numbers, like "<scene> <start>"). That takes a few
+  microseconds, so MySensors is back at the radio at once. The loop reads the commands in the order in which they
+  arrived and applies them. A command that may be coalesced replaces the one for the same child and type that is
+  still waiting: the older one is removed and the new one goes to the end, so the order of the commands stays
+  right (a V_DIMMER followed by a V_LIGHT 0 still ends with the light off). So only the newest target of a burst
+  retargets the fade. A command that has to be handled every time, like storing a scene, is never coalesced.
+
+  The commands are kept in a ring of COMMAND_INBOX_SIZE, a new command is dropped when the ring is full. Since the
+  commands of a burst are coalesced, a few slots are enough: they only have to hold the commands for different
+  children that arrive during a single loop pass. The inbox counts the coalesced and dropped commands, up to 255 each
+  (they're reported as a byte each with the heart beat). The inbox is written by receive() and read by the loop, which
+  never run at the same time (MySensors calls receive() between the loop passes, also with its RX message buffer
+  of which the radio interrupt fills the buffer of MySensors, not the inbox). So it needs no volatile variables.
+
+  Like the outbox (see messageQueue.h) the inbox doesn't know MySensors, the sketch posts the fields of the message.
+
+  Revision history:
+    16-10-2026 Initial version.
+    17-10-2026 4 slots and byte counters, to keep the sketch within its RAM budget.
+*/
+
+const uint8_t COMMAND_INBOX_SIZE = 4; // The amount of commands that can be waiting, a power of 2
+static_assert( ( COMMAND_INBOX_SIZE & ( COMMAND_INBOX_SIZE - 1 ) ) == 0, "The size of the inbox must be a power of 2" );
+
+// The flags of a command
+const uint8_t COMMAND_BROADCAST = 0x01; // The command was sent to all nodes
+const uint8_t COMMAND_COALESCE = 0x02;  // The command may be replaced by a newer one for the same child and type
+
+/*
+  A received command. The value is the first number of the payload (at most 0xFFFF), the argument the second one (0
+  when there's none).
+*/
+struct InboxCommand {
+  uint8_t  sensor;
+  uint8_t  type;
+  uint8_t  flags;
+  uint16_t value;
+  uint32_t argument;
+};
+
+/*
+  Definition of the class, the method documentation can be found in the commandInbox.cpp file.
+*/
+class CommandInbox {
+  public:
+    CommandInbox();
+
+    bool post( uint8_t sensor, uint8_t type, uint8_t flags, const char *payload );
+    bool read( InboxCommand &command );
+    bool isEmpty();
+
+    uint8_t getCoalescedCount();
+    uint8_t getDroppedCount();
+    void    resetCounters();
+  private:
+    InboxCommand &waiting( uint8_t index );
+    void         remove( uint8_t index );
+
+    InboxCommand commands[ COMMAND_INBOX_SIZE ];
+    uint8_t      head;           // The slot of the oldest waiting command
+    uint8_t      count;          // The amount of waiting commands
+
+    uint8_t      coalescedCount; // Commands that were replaced by a newer one, saturates at 255
+    uint8_t      droppedCount;   // Commands dropped because the inbox was full, saturates at 255
+};
+
+#endif
@@ -5,8 +5,30 @@
 // Comment to turnof Serial communication (saves space) comment it when you want to debug.
 //#define MY_DISABLED_SERIAL
 
-// Set the wait for ready to zero if you want the light the be operable even when the Gateway is off.
-//#define MY_TRANSPORT_WAIT_READY_MS 0
+// Uncomment to boot fast: the lamp restores its state from the journal and is operable at once, while the radio looks
+// for the gateway in the background. Without it MySensors waits until the gateway is found before setup() runs, and the
+// presentation blocks the sketch for about a second with its delays; when the gateway is off the lamp stays dark. The
+// presentation and the requests of the light state are sent from the loop, paced with random delays and retried with a
+// randomized exponential backoff (see randomBackoff.h), so the lamps of a house don't flood the gateway after a power
+// out. MY_TRANSPORT_WAIT_READY_MS must be more than 0, 0 makes MySensors wait forever.
+//#define FAST_BOOT
+#ifdef FAST_BOOT
+#define MY_TRANSPORT_WAIT_READY_MS 1
+#endif
+
+// Uncomment to read the messages from the radio in its interrupt, into the RX message buffer of MySensors. Without it the
+// radio is only read between the loop passes, and a burst of messages (like a dragged slider) that arrives while the
+// loop is busy overflows the FIFO of the radio after 3 messages. MySensors passes the buffered messages to receive(),
+// which posts them to the inbox (see commandInbox.h). Needs the IRQ pin of the NRF24 wired to an external interrupt pin
+// (INT0 on pin 2 or INT1 on pin 3). On the fairy light PCB both are taken, by the encoder and the third channel, so it's
+// for a board on which one of them is free; the sketch doesn't compile when the pin is taken. Each buffered message
+// takes 32 bytes of RAM.
+//#define RADIO_RX_BUFFER
+#ifdef RADIO_RX_BUFFER
+#define MY_RX_MESSAGE_BUFFER_FEATURE
+#define MY_RX_MESSAGE_BUFFER_SIZE 4
+#define MY_RF24_IRQ_PIN 2
+#endif
 
 
 // Enable and select radio type attached
@@ -15,70 +37,284 @@
 
 #include <SPI.h>
 #include <MySensors.h>
+#include "ledCurves.h"
 
 #define MS_SketchName "FairyLight lantern"
 #define MS_SketchVersion "1.0"
 
+// The PCB has 3 channels (mosfets) for a fairy light string. Each channel is presented as a dimmer child, the first
+// channel has child id CHILD_ID_LIGHT, the next ones the following ids.
 #define CHILD_ID_LIGHT 1
+const uint8_t LIGHT_CHANNELS = 3;
 
-const uint8_t EEPROM_DIM_LEVEL_LAST = 1;
+const uint8_t EEPROM_DIM_LEVEL_LAST = 1; // The stored brightness of the first channel before the state journal, only read when the journal is empty
 const uint8_t DimmerDefaultValue = 5;
 
-MyMessage lightMsg( CHILD_ID_LIGHT, V_LIGHT );
-MyMessage dimmerMsg( CHILD_ID_LIGHT, V_DIMMER );
+MyMessage queuedMsg; // The messages of the outbox are sent with this message, see sendQueuedMessage()
+
+// Uncomment to dither the PWM of the channels (see ditheredPwm.h), which gives them a 12 bit duty cycle instead of the 8
+// bits of analogWrite(). Fades no longer step at the bottom and the lowest brightness level is 5 times dimmer, e.g. for a
+// night light. Uses the Timer2 overflow interrupt and sets the PWM frequency of pin 3 to the one of pins 5 and 6.
+//#define PWM_DITHERING
 
 // Definitions for the light level
 const uint8_t MIN_BRIGHTNES = 1;
-const uint8_t MAX_BRIGHTNESS = 15; // 15 level lamp means around 17 pwm steps per level (since we start at 10)
+const uint8_t MAX_BRIGHTNESS = 15; // 15 level lamp, the levels are evenly spaced in lightness (see ledCurves.h)
+#ifdef PWM_DITHERING
+typedef DitheredPwmSink ChannelPwmSink; // Writes the duty cycle of the channels
+const uint8_t MIN_BRIGHTNESS_PWM = 2; // The PWM value of the lowest brightness level
+#else
+typedef LedPwmSink ChannelPwmSink;
+const uint8_t MIN_BRIGHTNESS_PWM = 10;
+#endif
 
 const uint8_t MIN_MYSENSORS_BRIGHTNES = 1;
 const uint8_t MAX_MYSENSORS_BRIGHTNESS = 100; // 15 level lamp means around 17 pwm steps per level (since we start at 10)
 
+// Lookup tables in flash for the conversions between the brightness levels, the lightness and the gateway brightness
+typedef LedCurveTable< LedBrightnessLevelCurve<MAX_BRIGHTNESS, MIN_BRIGHTNESS_PWM> > BrightnessLevelTable;
+typedef LedCurveTable< LedMapCurve<MIN_MYSENSORS_BRIGHTNES, MAX_MYSENSORS_BRIGHTNESS, MIN_BRIGHTNES, MAX_BRIGHTNESS> > FromMySensorsBrightnessTable;
+typedef LedCurveTable< LedMapCurve<MIN_BRIGHTNES, MAX_BRIGHTNESS, MIN_MYSENSORS_BRIGHTNES, MAX_MYSENSORS_BRIGHTNESS> > ToMySensorsBrightnessTable;
 
-// Variables for storing the current state of power, brightness and the controls.
-bool    powerState = false; // false means light off, true means light on
-uint8_t lightBrightness, newBrightness; // the brightness and the potential new brightness
-long oldEncoderPosition, newEncoderPosition; // The last read encoder position and the potential new position
+
+// Variables for storing the current state of power, brightness and the controls. The power state and brightness are kept per channel.
+bool    powerState[ LIGHT_CHANNELS ]; // false means light off, true means light on
+uint8_t lightBrightness[ LIGHT_CHANNELS ]; // the brightness of each channel
+uint8_t storedBrightness[ LIGHT_CHANNELS ]; // the brightness stored with a long press, used after a power out for the channels that were off
 bool switchStateUpdated; // Indicates wether or not the state of the power switch has been changed,
 
-const unsigned long HEART_BEAT_INTERVAL = 1800000; // We send a heart beat ruffly each half hour
+const unsigned long HEART_BEAT_INTERVAL = 1800000; // We send a heart beat ruffly each half hour, by default (see the parameters)
+// The longest heart beat interval. The sleep duty cycle (see sleepScheduler.h) and the loop statistics (see
+// loopProfiler.h) add up us in 32 bits, which wraps after 71 minutes. They're reset with each heart beat.
+const uint8_t MAX_HEART_BEAT_MINUTES = 60;
+
+// Uncomment to advance the animations from a timer interrupt at a fixed frame rate, instead of from the main loop. This
+// prevents fades from stuttering while the loop is blocked by e.g. a delay() or radio retries. Uses Timer1.
+//#define ANIMATION_TIMER_ISR
+const uint8_t ANIMATION_FRAME_RATE = 100; // frames per second, a multiple of the 20 steps per second of a fade
+
+// Between the events the node sleeps. By default it uses the idle sleep mode, in which the clocks (and so the PWM of the
+// channels and millis()) keep running and every interrupt wakes it up. Uncomment to power down the node, including the
+// radio, when all channels are off and nothing is going on until the next heart beat. The switch and the encoder wake
+// it up through a pin change interrupt. Note that the node can't receive messages from the controller while it's
+// powered down, so only use it for a node that is operated by hand (e.g. on batteries).
+//#define LOW_POWER_SLEEP
+const unsigned long MIN_POWER_DOWN_DURATION = 1000; // ms, shorter sleeps aren't worth powering down the radio
+
+// Uncomment to measure the battery (3 AA cells directly on VCC, without a voltage regulator) against the internal
+// bandgap reference, see batteryMonitor.h. It's sampled at the boot and with each heart beat, the ADC is only powered
+// during the sample, and the level is sent with sendBatteryLevel(). Calibrate the bandgap per node: measure VCC with a
+// multimeter and scale BATTERY_BANDGAP_MILLIVOLTS with the measured VCC divided by the reported one.
+//#define BATTERY_MONITOR
+const uint16_t BATTERY_BANDGAP_MILLIVOLTS = 1100;
+const uint16_t BATTERY_EMPTY_MILLIVOLTS = 3000; // 0%, 1.0V per cell
+const uint16_t BATTERY_FULL_MILLIVOLTS = 4500;  // 100%, 1.5V per cell
+
+// Uncomment to cap the brightness as the battery runs low, to make it last longer (implies BATTERY_MONITOR). Below
+// BATTERY_CAP_FROM_MILLIVOLTS the lightness of every brightness level is scaled down, linear down to BATTERY_MINIMUM_CAP
+// (of 255) at the empty voltage. The LEDs load the battery, so the voltage recovers a bit once the cap lowers the
+// load. The cap only goes up again when it rises by BATTERY_CAP_HYSTERESIS, e.g. after swapping the batteries.
+//#define BATTERY_BRIGHTNESS_CAP
+const uint16_t BATTERY_CAP_FROM_MILLIVOLTS = 3900; // 1.3V per cell
+const uint8_t  BATTERY_MINIMUM_CAP = 128;          // Half the lightness
+const uint8_t  BATTERY_CAP_HYSTERESIS = 16;
+#ifdef BATTERY_BRIGHTNESS_CAP
+#define BATTERY_MONITOR
+#endif
+
+// The state of the lamp is stored in a journal in the EEPROM (see stateJournal.h), so the lamp resumes after a power out
+// or a battery swap. A change is written once the state is unchanged for this amount of ms, so a spin of the encoder
+// is written only once. The record holds: the power state of the channels (bit per channel), the brightness of the
+// channels, the stored brightness of the channels and the ambient effect of the channels (2 bits per channel).
+const uint16_t JOURNAL_SETTLE_TIME = 2000;
+const uint8_t  JOURNAL_POWER_STATE = 0;
+const uint8_t  JOURNAL_BRIGHTNESS = 1;
+const uint8_t  JOURNAL_STORED_BRIGHTNESS = JOURNAL_BRIGHTNESS + LIGHT_CHANNELS;
+const uint8_t  JOURNAL_EFFECTS = JOURNAL_STORED_BRIGHTNESS + LIGHT_CHANNELS;
+static_assert( JOURNAL_EFFECTS + 1 <= JOURNAL_PAYLOAD_SIZE, "The state of the channels doesn't fit in a journal record" );
+static_assert( LIGHT_CHANNELS <= 4 && AMBIENT_EFFECT_COUNT <= 4, "The effects of the channels don't fit in a byte of the journal record" );
+
+// A custom child that reports with the heart beat: V_VAR1 the duty cycle (the part of the time the node was awake, in per
+// mille) and the counters of the outbox: V_VAR2 the messages sent, V_VAR3 the values coalesced, V_VAR4 the resends and V_VAR5
+// the messages dropped since the previous heart beat. V_CUSTOM has the counters of the inbox: the commands dropped (high
+// byte) and coalesced (low byte), both up to 255.
+#define CHILD_ID_NODE_STATS 10
+
+// The messages to the gateway are sent from the loop by an outbox (see messageQueue.h), with at least this amount of ms
+// between two messages to prevent a ddos effect on the gateway and to give the antenna time to recover. The power state
+// and brightness of the channels are sent with an ack request, they're resent when the controller doesn't echo them.
+const uint16_t MESSAGE_PACING = 15;
+
+// Uncomment to keep statistics of the duration of the loop passes (see loopProfiler.h), measured with Timer1. They're
+// sent with the heart beat to the loop stats child: V_VAR1 the mean and V_VAR2 the maximum duration in us, V_VAR3 the
+// amount of passes that took longer than PROFILE_STALL_THRESHOLD, V_VAR4 the share (in percent) of checkAnimation()
+// (high byte) and checkSwitch() (low byte) and V_CUSTOM the share of checkEncoder() and receive(). Sending the
+// character 'p' on the serial port prints the statistics, including the minimum and the histogram of the durations.
+// When commented the instrumentation is removed completely.
+//#define LOOP_PROFILER
+const uint16_t PROFILE_STALL_THRESHOLD = 10000; // us, at most 65535
+const char PROFILE_DUMP_COMMAND = 'p';
+#define CHILD_ID_LOOP_STATS 12
+
+// The sections of the loop profiler
+const uint8_t PROFILE_ANIMATION = 0;
+const uint8_t PROFILE_SWITCH = 1;
+const uint8_t PROFILE_ENCODER = 2;
+const uint8_t PROFILE_RECEIVE = 3;
+
+// Runs the given statement and adds its duration to the given section of the profiler
+#ifdef LOOP_PROFILER
+#define PROFILED( section, statement ) \
+  do { unsigned long profiledSince = frameTimerMicros(); statement; profiler.addSection( section, frameTimerMicros() - profiledSince ); } while ( 0 )
+#define PROFILED_OUTSIDE_LOOP( section, statement ) \
+  do { unsigned long profiledSince = frameTimerMicros(); statement; profiler.addOutsideLoop( section, frameTimerMicros() - profiledSince ); } while ( 0 )
+#else
+#define PROFILED( section, statement ) statement
+#define PROFILED_OUTSIDE_LOOP( section, statement ) statement
+#endif
+
+// The objects of the sketch are all placed statically, nothing is allocated on the heap. Their static RAM is checked
+// against this budget when the sketch is compiled (see SKETCH_STATIC_RAM in the sketch), so a new feature that takes
+// too much RAM shows up at the build instead of as a stack that runs into the variables. The rest of the 2KB is for the
+// Arduino core, MySensors and the stack, which needs a few hundred bytes for the radio and the interrupts.
+const uint16_t MEMORY_SKETCH_BUDGET = 900;
+
+// Uncomment to report the RAM use (see memoryReport.h) on the serial port at boot and when the character 'm' is sent:
+// the static RAM of each component of the sketch, the static RAM in total, the heap and the stack high-water mark,
+// measured by painting the free RAM at boot. The part of the RAM the stack has never used is printed with each heart
+// beat as well, with a warning below MEMORY_STACK_MARGIN.
+//#define MEMORY_REPORT
+const char     MEMORY_REPORT_COMMAND = 'm';
+const uint16_t MEMORY_STACK_MARGIN = 128; // bytes
+
+// Animation scripts (see animationScript.h). V_VAR1 on a dimmer child starts a script on that channel: 1 - 3 are the
+// built-in scripts, 255 the uploaded script and 0 stops the script. The script is uploaded to this child in V_TEXT chunks
+// of 2 hex digits with the offset followed by the instructions in hex, V_VAR1 with the length of the script makes it
+// available. The assembler (software/host/scriptAssembler.cpp) prints these messages for a script.
+// The uploaded script is stored in the EEPROM from address 896 up to 1023 (EEPROM_SCRIPT_ADDRESS).
+#define CHILD_ID_SCRIPT 11
+
+// Ambient effects (see ambientEffect.h): a candle, twinkle or breathe effect on top of the brightness of a channel.
+// A double click starts the next effect on the channels that are on (candle, twinkle, breathe and back to steady),
+// a tripple click turns the effects off. V_VAR2 on a dimmer child sets the effect of that channel: 0 steady, 1 candle,
+// 2 twinkle and 3 breathe. The node reports the effect of a channel with V_VAR2 when it changes.
+
+// Scenes. A scene is a brightness level per channel (0 is off), V_VAR1 with the number of the scene (0 - SCENE_COUNT - 1)
+// on the scene child stores the current state of the channels as that scene. The controller starts a scene on all lamps
+// with a single broadcast: V_SCENE_ON on the scene child with "<scene> <start>" as payload, the start being the second
+// of the controller time (the time it replies to requestTime() with) at which the fades start, a few seconds ahead. The
+// nodes follow the controller time (see controllerClock.h), so the fades of all lamps start within a few tens of ms.
+// A broadcast isn't acked, so the controller should send it a few times, a node ignores the copies of a scene it already
+// has. Without a start, or when the node isn't synchronized yet, the scene starts on reception.
+#define CHILD_ID_SCENE 13
+const uint8_t SCENE_COUNT = 4;
+const uint8_t EEPROM_SCENES = 16; // The position of the scenes in the MySensors state, LIGHT_CHANNELS levels per scene
+const uint8_t SCENE_UNSET = 0xFF; // The level of a channel in a scene that was never stored, the channel is left alone
+
+// Sunrise and sunset: fades of minutes instead of half a second, for waking up and falling asleep. V_VAR1 on the sun
+// child starts a sunrise: all channels turn on and fade from their current level to their brightness level. V_VAR2 starts
+// a sunset: the channels that are on fade to off and are turned off at the end. The payload is "<minutes> <start>", the
+// duration (1 - 255) and like a scene the second of the controller time at which the fade starts, so the node waits
+// (and sleeps) until then, or starts at once without a start. A broadcast starts it on all lamps. The fade only steps
+// when the PWM output changes (see LongFadeAnimation in ledAnimation.h). Using the switch, the encoder or a dimmer
+// message on a channel stops its fade.
+#define CHILD_ID_SUN 14
+
+// Parameters that can be tuned from the controller, without flashing the node. They're kept in a block in the EEPROM
+// (see parameterBlock.h), which is read once at boot, and applied at once when they're set. A message to the parameters
+// child sets:
+//   V_VAR1: the duration of a step of a fade in ms (10 - 500), a fade takes animationSteps (10) steps.
+//   V_VAR2: "<amount> <delay>", the off blinks (1 - 10) of the boundary reached animation and the duration of each on
+//           and off state in ms (50 - 2000).
+//   V_VAR3: "<short> <long>", the short press duration in ms (50 - 1000) and the long press duration in ms, at least 3
+//           times the short press (up to 10000).
+//   V_VAR4: the highest brightness level (MIN_BRIGHTNES - MAX_BRIGHTNESS), the encoder and the gateway can't go above it.
+//   V_VAR5: the heart beat interval in minutes (1 - MAX_HEART_BEAT_MINUTES).
+// A value out of range is ignored. Bump PARAMETERS_VERSION when LampParameters changes, the node then starts with the
+// defaults instead of reading the old block into the wrong fields.
+#define CHILD_ID_PARAMETERS 15
+const uint8_t PARAMETERS_VERSION = 1;
+
+struct LampParameters {
+  uint16_t fadeStepDuration;   // ms
+  uint8_t  blinkAmount;
+  uint16_t blinkDelay;         // ms
+  uint16_t shortPressDuration; // ms
+  uint16_t longPressDuration;  // ms
+  uint8_t  maxBrightness;
+  uint8_t  heartBeatMinutes;
+};
+static_assert( sizeof( LampParameters ) + PARAMETER_BLOCK_OVERHEAD <= EEPROM_PARAMETERS_SIZE, "The parameters don't fit in the parameter block" );
+
+const LampParameters DEFAULT_PARAMETERS = { animationStepDuration, boundaryBlinkAmount, boundaryBlinkDelay, SHORT_KEY_PRESS_DURATION,
+                                            LONG_KEY_PRESS_DURATION, MAX_BRIGHTNESS, HEART_BEAT_INTERVAL / 60000 };
+
+// The pacing of the presentation with FAST_BOOT: the first message is sent 0 - BOOT_SYNC_SPREAD ms after the gateway was
+// found, the next ones 1 - 2 times BOOT_SYNC_PACING ms apart. A message that doesn't get through is retried after a
+// backoff that doubles up to BOOT_SYNC_MAX_BACKOFF ms.
+const uint16_t BOOT_SYNC_PACING = 40;
+const uint16_t BOOT_SYNC_SPREAD = 2000;
+const uint16_t BOOT_SYNC_MAX_BACKOFF = 16000;
 
 /*
  Returns the given gateway brightness to the lamps brightness level.
  The lamp doesn't support 1-100 by design. Because it's really anoying having to turn a
  rotary encode 100 times to go from max to low or the other way arround. 15 brightness levels seem
  to be good enough. Which can all be changed by changing the constants in this file.
+ The given brightness must be in the range 0 - MAX_MYSENSORS_BRIGHTNESS.
  */
 uint8_t converFromMySensorsBrightness( int aBrightness ) {
-  return map( aBrightness, MIN_MYSENSORS_BRIGHTNES, MAX_MYSENSORS_BRIGHTNESS, MIN_BRIGHTNES, MAX_BRIGHTNESS );
+  return FromMySensorsBrightnessTable::read( aBrightness );
 }
 
 /*
- Returns the current light brightness converted to the gateway brightness (Domotiz supports 1-100)
+ Returns the current light brightness of the given channel converted to the gateway brightness (Domotiz supports 1-100)
  */
-uint8_t getConvertedMySensorsBrightness() {
-  return map( lightBrightness, MIN_BRIGHTNES, MAX_BRIGHTNESS, MIN_MYSENSORS_BRIGHTNES, MAX_MYSENSORS_BRIGHTNESS );
+uint8_t getConvertedMySensorsBrightness( uint8_t channel ) {
+  return ToMySensorsBrightnessTable::read( lightBrightness[ channel ] );
 }
 
 /*
- Sends the current brightness level to the gateway when e.g. the user changed the brightness manually.
+ Send handler of the outbox: sends the given value to the given child and type of the gateway, with an ack request when ack
+ is true. Returns false when the message couldn't be delivered to the parent node.
+ */
+bool sendQueuedMessage( uint8_t sensor, uint8_t type, int16_t value, bool ack ) {
+  queuedMsg.setSensor( sensor );
+  queuedMsg.setType( type );
+  return send( queuedMsg.set( value ), ack );
+}
+
+// The child and type combinations posted to the outbox: V_LIGHT, V_DIMMER and V_VAR2 (the effect) of each channel, the 6
+// values of the node stats and the 5 of the loop stats. A heart beat while the channels are being resent has all of
+// them waiting at once, so the outbox has a slot for each of them.
+const uint8_t OUTBOX_KEYS = 3 * LIGHT_CHANNELS + 6
+#ifdef LOOP_PROFILER
+                            + 5
+#endif
+                            ;
+QueuedMessage outboxMessages[ OUTBOX_KEYS ]; // The slots of the outbox
+MessageQueue  outbox( sendQueuedMessage, MESSAGE_PACING, outboxMessages, OUTBOX_KEYS ); // The messages to the gateway, sent from the loop
+
+/*
+ Sends the current brightness level of the given channel to the gateway when e.g. the user changed the brightness manually.
+ The message is queued, a newer brightness replaces the brightness that is still waiting to be sent.
  */
-void sendBrightnessLevelToGateWay() {
-  send( dimmerMsg.set( (int)getConvertedMySensorsBrightness() ) ); // Send the stored brightness value to the Gateway
+void sendBrightnessLevelToGateWay( uint8_t channel ) {
+  outbox.post( CHILD_ID_LIGHT + channel, V_DIMMER, getConvertedMySensorsBrightness( channel ), true );
 }
 
 /*
- Sends the current power state to the gateway. If the current power state is on (true), the current brightness level is also
+ Sends the current power state of the given channel to the gateway. If the current power state is on (true), the current brightness level is also
  send, because domoticz will set the brightness to full when a dimmer is turned on. Don't know if this is by design (I use a very old
  Domoticz version) or if it's a bug. But it's certainly anoying. But resending the current brightness syncs the domoticz brightness
  level to what was stored on the lamp.
+ The messages are queued, the outbox sends them after each other with MESSAGE_PACING ms in between.
  */
-void sendPowerstateToGateWay( ) {
-  send( lightMsg.set( powerState == true ? "1" : "0" ) );
+void sendPowerstateToGateWay( uint8_t channel ) {
+  outbox.post( CHILD_ID_LIGHT + channel, V_LIGHT, powerState[ channel ] ? 1 : 0, true );
 
-  if ( powerState ) {
-    delay( 15 ); // Delay is for preventing ddos effect on Gateway and to give the antenna more time to recover. 
-    sendBrightnessLevelToGateWay(); // Domotics sets the brightness to max when it turns on a dimmer. It doesn't go back to the previous,
-                                     // So in this case we use the stored users brightness
+  if ( powerState[ channel ] ) {
+    sendBrightnessLevelToGateWay( channel ); // Domotics sets the brightness to max when it turns on a dimmer. It doesn't go back to the previous,
+                                             // So in this case we use the stored users brightness
   }
 }
@@ -0,0 +1,220 @@
+#include "controllerClock.h"
+
+const unsigned long CLOCK_MAX_ELAPSED = 86400000; // ms, longer periods are capped so the drift math fits a long
+
+/*
+  Returns the change of the given amount of ms at the given drift in ppm, without overflowing a long.
+*/
+static long driftOver( long elapsed, long ppm ) {
+  if ( elapsed > (long)CLOCK_MAX_ELAPSED || elapsed < -(long)CLOCK_MAX_ELAPSED ) {
+    elapsed = elapsed > 0 ? CLOCK_MAX_ELAPSED : -(long)CLOCK_MAX_ELAPSED;
+  }
+  return ( elapsed / 1000 * ppm + elapsed % 1000 * ppm / 1000 ) / 1000;
+}
+
+/*
+  Creates an instance of the ControllerClock class, it has no estimate until the first reply.
+*/
+ControllerClock::ControllerClock() {
+  this->hasEstimate = false;
+  this->hasAnchor = false;
+  this->waiting = false;
+  this->hasRequested = false;
+  this->converging = true;
+  this->convergingRequests = 0;
+  this->requestedAt = 0;
+  this->roundTrip = 0;
+  this->drift = 0;
+  this->driftUncertainty = CLOCK_MAX_DRIFT;
+}
+
+/*
+  Returns true when the sketch should request the time of the controller now. Call it each loop pass, the request
+  is timed to make the reply as informative as possible.
+*/
+bool ControllerClock::isRequestDue( unsigned long currentMillis ) {
+  if ( this->waiting ) {
+    if ( currentMillis - this->requestedAt < CLOCK_REPLY_TIMEOUT ) {
+      return false;
+    }
+    this->waiting = false; // The request or its reply got lost
+  }
+  if ( this->hasRequested && currentMillis - this->requestedAt < CLOCK_MIN_INTERVAL ) {
+    return false;
+  }
+  if ( !this->hasEstimate ) {
+    return true;
+  }
+  // Once on target (or as close as the round trips allow), the requests start again when the uncertainty has doubled
+  unsigned long target = CLOCK_TARGET_UNCERTAINTY + this->roundTrip / 2;
+  unsigned long uncertainty = this->getUncertainty( currentMillis );
+  if ( this->converging && ( uncertainty <= target || this->convergingRequests >= CLOCK_MAX_CONVERGING ) ) {
+    this->converging = false;
+    this->resyncUncertainty = 2 * ( uncertainty > target ? uncertainty : target );
+  }
+  else if ( !this->converging &&
+            ( uncertainty > this->resyncUncertainty || currentMillis - this->estimatedAt >= CLOCK_MAX_INTERVAL ) ) {
+    this->converging = true;
+    this->convergingRequests = 0;
+  }
+  if ( !this->converging ) {
+    return false;
+  }
+
+  // The predicted second boundary of the controller has to fall in the middle of the round trip
+  unsigned long phase = ( currentMillis + this->roundTrip / 2 + this->offsetAt( currentMillis ) ) % 1000;
+  return phase < CLOCK_PHASE_WINDOW;
+}
+
+/*
+  Registers that the sketch requested the time of the controller.
+*/
+void ControllerClock::requested( unsigned long currentMillis ) {
+  this->waiting = true;
+  this->hasRequested = true;
+  this->requestedAt = currentMillis;
+  this->convergingRequests++;
+}
+
+/*
+  Handles the reply to the last request.
+  controllerSeconds: the time of the controller, in seconds.
+  currentMillis: millis() at the reception of the reply.
+  A reply without a request can't be bounded and is ignored.
+*/
+void ControllerClock::received( unsigned long controllerSeconds, unsigned long currentMillis ) {
+  if ( !this->waiting ) {
+    return;
+  }
+  this->waiting = false;
+  unsigned long trip = currentMillis - this->requestedAt;
+  trip = trip < CLOCK_REPLY_TIMEOUT ? trip : CLOCK_REPLY_TIMEOUT;
+  this->roundTrip = this->roundTrip == 0 ? trip : ( 3 * this->roundTrip + trip ) / 4;
+
+  if ( !this->hasEstimate || (long)( controllerSeconds - this->baseSecond ) < 0 ) {
+    this->restart( controllerSeconds, this->requestedAt, currentMillis );
+    return;
+  }
+  if ( controllerSeconds - this->baseSecond >= 2 * CLOCK_REBASE_SECONDS ) {
+    // Move the base, so the controller ms since the base second keep fitting in an unsigned long
+    unsigned long shift = ( controllerSeconds - this->baseSecond - CLOCK_REBASE_SECONDS ) * 1000;
+    this->baseSecond += shift / 1000;
+    this->offset -= shift;
+    this->anchorOffset -= shift;
+  }
+
+  // The reply was stamped between the request and now, during the second of the reply
+  unsigned long secondStart = ( controllerSeconds - this->baseSecond ) * 1000;
+  unsigned long predicted = this->offsetAt( currentMillis );
+  unsigned long uncertainty = this->getUncertainty( currentMillis );
+  long spread = uncertainty < 0x7FFFFFFF ? uncertainty : 0x7FFFFFFF;
+  long low = (long)( secondStart - currentMillis - predicted );
+  long high = (long)( secondStart + 999 - this->requestedAt - predicted );
+  low = low > -spread ? low : -spread;
+  high = high < spread ? high : spread;
+  if ( low > high ) {
+    this->restart( controllerSeconds, this->requestedAt, currentMillis ); // The controller clock was set
+    return;
+  }
+
+  this->offset = predicted + ( low + high ) / 2;
+  this->uncertainty = high - low < 0xFFFF ? ( high - low + 1 ) / 2 : 0xFFFF;
+  this->estimatedAt = currentMillis;
+  this->measureDrift( currentMillis );
+}
+
+/*
+  Returns true when the clock is accurate enough to time something on, CLOCK_SYNC_TOLERANCE.
+*/
+bool ControllerClock::isSynchronized( unsigned long currentMillis ) {
+  return this->hasEstimate && this->getUncertainty( currentMillis ) <= CLOCK_SYNC_TOLERANCE;
+}
+
+/*
+  Returns the millis() at which the given second of the controller starts. Only meaningful when the clock is
+  synchronized, the second must be within a few weeks of now.
+*/
+unsigned long ControllerClock::toLocal( unsigned long controllerSeconds, unsigned long currentMillis ) {
+  unsigned long target = ( controllerSeconds - this->baseSecond ) * 1000;
+  unsigned long local = target - this->offsetAt( currentMillis );
+  return target - this->offsetAt( local ); // With the drift up to the moment itself
+}
+
+/*
+  Returns the uncertainty of the clock now in ms, half the width of the bounds of the offset. Returns 0xFFFFFFFF
+  when there is no estimate yet.
+*/
+unsigned long ControllerClock::getUncertainty( unsigned long currentMillis ) {
+  if ( !this->hasEstimate ) {
+    return 0xFFFFFFFF;
+  }
+  return this->uncertainty + driftOver( currentMillis - this->estimatedAt, this->driftUncertainty );
+}
+
+/*
+  Returns the drift in ppm that the controller clock runs faster than millis(), 0 until it has been measured.
+*/
+int32_t ControllerClock::getDrift() {
+  return this->drift;
+}
+
+/*
+  Starts over with the given reply: a new base second, an estimate of a second wide and no drift.
+*/
+void ControllerClock::restart( unsigned long controllerSeconds, unsigned long requestedAt, unsigned long receivedAt ) {
+  unsigned long trip = receivedAt - requestedAt;
+  this->hasEstimate = true;
+  this->baseSecond = controllerSeconds;
+  this->offset = 0 - receivedAt + ( 999 + trip ) / 2; // The middle of ( -receivedAt, 999 - requestedAt )
+  this->uncertainty = ( 999 + trip + 1 ) / 2;
+  this->estimatedAt = receivedAt;
+  this->drift = 0;
+  this->driftUncertainty = CLOCK_MAX_DRIFT;
+  this->hasAnchor = false;
+  this->converging = true;
+  this->convergingRequests = 0;
+}
+
+/*
+  Measures the drift between the anchor and the current estimate, when both are accurate and far enough apart.
+*/
+void ControllerClock::measureDrift( unsigned long currentMillis ) {
+  if ( this->uncertainty > CLOCK_ANCHOR_UNCERTAINTY ) {
+    return;
+  }
+
+  if ( this->hasAnchor ) {
+    unsigned long baseline = ( currentMillis - this->anchorAt ) / 100; // In 0.1s, so the ppm fit a long
+    if ( baseline < CLOCK_MIN_BASELINE / 100 ) {
+      if ( 2 * this->uncertainty > this->anchorUncertainty ) {
+        return;
+      }
+      // Anchor at the better estimate instead, the baseline has hardly started
+    }
+    else {
+      long     measured = (long)( this->offset - this->anchorOffset ) * 10000 / (long)baseline;
+      uint32_t measuredUncertainty = ( this->uncertainty + this->anchorUncertainty ) * 10000UL / baseline + CLOCK_DRIFT_WANDER;
+      if ( measuredUncertainty < this->driftUncertainty ) {
+        this->drift = measured > CLOCK_MAX_DRIFT ? CLOCK_MAX_DRIFT : measured < -(long)CLOCK_MAX_DRIFT ? -(long)CLOCK_MAX_DRIFT : measured;
+        this->driftUncertainty = measuredUncertainty;
+      }
+      if ( baseline < CLOCK_MAX_BASELINE / 100 ) {
+        return;
+      }
+      // A drift measured from the new anchor has to beat the current one, which may have wandered off since
+      this->driftUncertainty += this->driftUncertainty < CLOCK_MAX_DRIFT - CLOCK_DRIFT_WANDER ? CLOCK_DRIFT_WANDER : 0;
+    }
+  }
+
+  this->hasAnchor = true;
+  this->anchorOffset = this->offset;
+  this->anchorAt = currentMillis;
+  this->anchorUncertainty = this->uncertainty;
+}
+
+/*
+  Returns the predicted offset at the given millis(), with the drift since the last reply.
+*/
+unsigned long ControllerClock::offsetAt( unsigned long localMillis ) {
+  return this->offset + driftOver( (long)( localMillis - this->estimatedAt ), this->drift );
+}
@@ -0,0 +1,96 @@
+#ifndef CONTROLLER_CLOCK_H
+#define CONTROLLER_CLOCK_H
+
+#include "hal.h"
+
+/*
+  Library for following the clock of the controller with millis(), so several nodes can do something at the same
+  moment of the controller time (e.g. start the fade of a scene).
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  The controller only tells its time in whole seconds (the reply to requestTime() of MySensors), and the resonator
+  of a Pro Mini can be 0.5% off, that's 18 seconds per hour. So the clock keeps an estimate of the offset between
+  the controller time and millis() with its uncertainty, and an estimate of the drift between the two clocks.
+
+  Each reply bounds the offset: the controller stamped the reply somewhere between the request and the reception of
+  the reply, and at that moment its time was between the second of the reply and the next second. The bounds are
+  intersected with the bounds of the previous estimate, which grow with the drift uncertainty since the previous
+  reply. The new estimate is the middle of the intersection. A reply only narrows the estimate when a second of the
+  controller starts during its round trip, so once the clock has an estimate the requests are timed to make the
+  predicted second boundary fall in the middle of the round trip: each reply then halves the uncertainty, like a
+  binary search, until it's about half the round trip (the target) or CLOCK_MAX_CONVERGING requests have been sent.
+  The requests start again when the uncertainty has doubled.
+
+  The drift is measured between an accurate estimate (the anchor) and a later accurate estimate, at least
+  CLOCK_MIN_BASELINE apart. A longer baseline gives a more accurate drift, which is kept when it's better than the
+  current one. After CLOCK_MAX_BASELINE the anchor moves, so the drift follows the temperature. Until the drift is
+  known the uncertainty grows with CLOCK_MAX_DRIFT and the requests are frequent, after that a few per hour are
+  enough. When a reply doesn't fit the estimate at all (the controller clock was set) the clock starts over.
+
+  The offset is kept in ms relative to a recent second of the controller (the base), so the phase within the second
+  survives the wrap around of an unsigned long. The clock doesn't know MySensors, the sketch sends the requests and
+  passes the replies.
+
+  Revision history:
+    16-10-2026 Initial version.
+*/
+
+const uint16_t      CLOCK_MAX_DRIFT = 5000;          // ppm, the worst case of a ceramic resonator until the drift is measured
+const uint16_t      CLOCK_DRIFT_WANDER = 20;         // ppm added to a measured drift, for the temperature
+const unsigned long CLOCK_MIN_BASELINE = 60000;      // ms between the estimates the drift is measured from
+const unsigned long CLOCK_MAX_BASELINE = 3600000;    // ms after which the anchor of the drift moves
+const uint8_t       CLOCK_TARGET_UNCERTAINTY = 10;   // ms on top of half the round trip, requests stop below it
+const uint8_t       CLOCK_MAX_CONVERGING = 4;        // The maximum amount of requests to get on target
+const uint8_t       CLOCK_ANCHOR_UNCERTAINTY = 50;   // ms, the estimates the drift is measured from are at least this accurate
+const uint16_t      CLOCK_SYNC_TOLERANCE = 100;      // ms, the clock is synchronized when it's this accurate
+const unsigned long CLOCK_MIN_INTERVAL = 2000;       // ms between two requests
+const unsigned long CLOCK_MAX_INTERVAL = 3600000;    // ms between two requests when the clock is accurate
+const unsigned long CLOCK_REPLY_TIMEOUT = 2000;      // ms after which a request without a reply is lost
+const uint8_t       CLOCK_PHASE_WINDOW = 25;         // ms after the ideal moment in which a request is still sent
+const unsigned long CLOCK_REBASE_SECONDS = 86400;    // The base second moves once a day
+
+/*
+  Definition of the class, the method documentation can be found in the controllerClock.cpp file.
+*/
+class ControllerClock {
+  public:
+    ControllerClock();
+
+    bool isRequestDue( unsigned long currentMillis );
+    void requested( unsigned long currentMillis );
+    void received( unsigned long controllerSeconds, unsigned long currentMillis );
+
+    bool          isSynchronized( unsigned long currentMillis );
+    unsigned long toLocal( unsigned long controllerSeconds, unsigned long currentMillis );
+    unsigned long getUncertainty( unsigned long currentMillis );
+    int32_t       getDrift();
+  private:
+    void          restart( unsigned long controllerSeconds, unsigned long requestedAt, unsigned long receivedAt );
+    void          measureDrift( unsigned long currentMillis );
+    unsigned long offsetAt( unsigned long localMillis );
+
+    bool          hasEstimate;
+    unsigned long baseSecond;       // The controller second the controller time is relative to
+    unsigned long offset;           // Controller ms since the base second minus millis(), at estimatedAt
+    unsigned long estimatedAt;      // millis() of the last reply
+    uint16_t      uncertainty;      // ms, half the width of the bounds of the offset at estimatedAt
+    int32_t       drift;            // ppm the controller clock runs faster than millis()
+    uint16_t      driftUncertainty; // ppm
+
+    bool          hasAnchor;
+    unsigned long anchorOffset;     // The estimate the drift is measured from
+    unsigned long anchorAt;
+    uint16_t      anchorUncertainty;
+
+    bool          waiting;          // true while a request waits for its reply
+    bool          hasRequested;
+    bool          converging;       // true while the requests narrow the estimate down to the target
+    uint8_t       convergingRequests;
+    unsigned long resyncUncertainty; // ms, the requests start again above this uncertainty
+    unsigned long requestedAt;      // millis() of the last request
+    uint16_t      roundTrip;        // ms, the average round trip of the requests
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef CRC8_H
+#define CRC8_H
+
+#include <stdint.h>
+
+/*
+  CRC-8 (polynomial 0x07) of the records the sketch keeps in the EEPROM: the state journal (stateJournal.h) and the
+  parameter block (parameterBlock.h). A record that was only partly written when the power went out fails its CRC.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  Revision history:
+    16-10-2026 Moved from stateJournal.cpp, so the parameter block can use it.
+*/
+
+/*
+  Returns the CRC after adding the given byte to the given CRC. Starting at 0, it can be fed a byte at a time, like
+  while a record is written a byte per loop pass.
+*/
+inline uint8_t crc8Update( uint8_t crc, uint8_t data ) {
+  crc ^= data;
+  for ( uint8_t bit = 0; bit < 8; bit++ ) {
+    crc = crc & 0x80 ? ( crc << 1 ) ^ 0x07 : crc << 1;
+  }
+  return crc;
+}
+
+/*
+  Returns the CRC-8 of the given bytes.
+*/
+inline uint8_t crc8( const uint8_t *data, uint8_t length ) {
+  uint8_t crc = 0;
+  for ( uint8_t index = 0; index < length; index++ ) {
+    crc = crc8Update( crc, data[ index ] );
+  }
+  return crc;
+}
+
+#endif
@@ -0,0 +1,151 @@
+#include "ditheredPwm.h"
+
+const uint8_t DITHER_FRACTION_MASK = ( 1 << LED_DUTY_FRACTION_BITS ) - 1;
+
+/*
+  An attached pin: its duty cycle split in the PWM value and the fraction, and the error of the sigma delta. On the node
+  also the output compare register of the pin and the value that inverts the PWM value (0xFF for the Timer0 pins).
+*/
+struct DitherSlot {
+  uint8_t          pin;
+  uint8_t          pwmValue;
+  uint8_t          fraction;
+  uint8_t          error;
+#ifdef ARDUINO
+  volatile uint8_t *compareRegister;
+  uint8_t          invert;
+#endif
+};
+
+static DitherSlot       slots[ DITHER_MAX_PINS ];
+static uint8_t          slotCount = 0;
+static volatile uint8_t ditheringMask = 0; // The slots that have a fraction, a bit per slot
+
+/*
+  Writes the given PWM value to the pin of the given slot.
+*/
+static inline void writeSlot( DitherSlot &slot, uint8_t pwmValue ) {
+#ifdef ARDUINO
+  *slot.compareRegister = pwmValue ^ slot.invert;
+#else
+  halPwmWrite( slot.pin, pwmValue );
+#endif
+}
+
+/*
+  Attaches the given pin, which is turned off. Must be called from setup(), the Arduino core configures the timers after
+  the global objects have been created.
+  pin: the PWM pin, 3, 5 or 6.
+  Returns false when the pin isn't supported or all slots are in use.
+*/
+bool ditheredPwmAttach( uint8_t pin ) {
+  if ( slotCount == DITHER_MAX_PINS ) {
+    return false;
+  }
+  DitherSlot &slot = slots[ slotCount ];
+  slot.pin = pin;
+  slot.pwmValue = 0;
+  slot.fraction = 0;
+  slot.error = 0;
+
+#ifdef ARDUINO
+  if ( pin == 5 || pin == 6 ) {
+    slot.compareRegister = pin == 5 ? &OCR0B : &OCR0A;
+    slot.invert = 0xFF;
+  }
+  else if ( pin == 3 ) {
+    slot.compareRegister = &OCR2B;
+    slot.invert = 0;
+  }
+  else {
+    return false;
+  }
+  writeSlot( slot, 0 );
+  halPinMode( pin, OUTPUT );
+
+  uint8_t oldSREG = SREG;
+  cli();
+  if ( pin == 5 ) {
+    TCCR0A |= _BV( COM0B1 ) | _BV( COM0B0 ); // Inverting mode
+  }
+  else if ( pin == 6 ) {
+    TCCR0A |= _BV( COM0A1 ) | _BV( COM0A0 ); // Inverting mode
+  }
+  else {
+    TCCR2A |= _BV( COM2B1 );
+  }
+  TCCR2B = ( TCCR2B & ~( _BV( CS22 ) | _BV( CS21 ) | _BV( CS20 ) ) ) | _BV( CS21 ) | _BV( CS20 ); // Prescaler 32
+  SREG = oldSREG;
+#else
+  writeSlot( slot, 0 );
+#endif
+
+  slotCount++;
+  return true;
+}
+
+/*
+  Writes the given duty cycle to the given pin. Pins that aren't attached are ignored.
+  duty: 0 - LED_DUTY_MAX, the PWM value with LED_DUTY_FRACTION_BITS fraction bits.
+*/
+void ditheredPwmWrite( uint8_t pin, uint16_t duty ) {
+  for ( uint8_t index = 0; index < slotCount; index++ ) {
+    DitherSlot &slot = slots[ index ];
+    if ( slot.pin != pin ) {
+      continue;
+    }
+
+#ifdef ARDUINO
+    uint8_t oldSREG = SREG;
+    cli(); // the PWM value and the fraction are used together by the interrupt
+#endif
+    slot.pwmValue = duty >> LED_DUTY_FRACTION_BITS;
+    slot.fraction = duty & DITHER_FRACTION_MASK;
+    if ( slot.fraction == 0 ) {
+      ditheringMask &= ~( 1 << index );
+      writeSlot( slot, slot.pwmValue );
+    }
+    else {
+      ditheringMask |= 1 << index;
+    }
+#ifdef ARDUINO
+    if ( ditheringMask != 0 ) {
+      TIMSK2 |= _BV( TOIE2 );
+    }
+    else {
+      TIMSK2 &= ~_BV( TOIE2 );
+    }
+    SREG = oldSREG;
+#endif
+    return;
+  }
+}
+
+/*
+  Returns true when at least one pin is dithered, so ditheredPwmTick() has to be called.
+*/
+bool ditheredPwmIsDithering() {
+  return ditheringMask != 0;
+}
+
+/*
+  Handles a PWM period: writes the PWM value of each dithered pin, rounded up when the error of its fraction carries.
+  Called by the Timer2 overflow interrupt, or by the simulation on the host.
+*/
+void ditheredPwmTick() {
+  uint8_t mask = ditheringMask;
+  for ( uint8_t index = 0; index < slotCount; index++ ) {
+    if ( mask & ( 1 << index ) ) {
+      DitherSlot &slot = slots[ index ];
+      uint8_t sum = slot.error + slot.fraction;
+      slot.error = sum & DITHER_FRACTION_MASK;
+      writeSlot( slot, slot.pwmValue + ( sum >> LED_DUTY_FRACTION_BITS ) );
+    }
+  }
+}
+
+#ifdef ARDUINO
+ISR( TIMER2_OVF_vect ) {
+  ditheredPwmTick();
+}
+#endif
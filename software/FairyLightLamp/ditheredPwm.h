@@ -0,0 +1,61 @@
+#ifndef DITHERED_PWM_H
+#define DITHERED_PWM_H
+
+#include "hal.h"
+#include "ledCurves.h"
+
+/*
+  Library for driving PWM pins with a 12 bit duty cycle, by dithering the 8 bit PWM value over time.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  analogWrite() has 256 steps. At the bottom of the gamma curve each step is a visible jump (1 to 2 doubles the
+  brightness), so the end of a fade steps and the lowest brightness level can't go below a few PWM steps. Timer1 has 16
+  bit PWM, but its pins (9 and 10) are used by the radio and Timer1 is the frame timer (see frameTimer.h). So instead
+  the PWM value of the pins on Timer0 (pins 5 and 6) and Timer2 (pin 3) is dithered: a duty cycle of e.g. 2 5/16 is
+  written as 2 for 11 and 3 for 5 out of every 16 PWM periods. Each period the fraction is added to an error and the
+  PWM value is rounded up when the error carries, a first order sigma delta, which spreads the rounded up periods
+  evenly.
+
+  The duty cycle is updated from the Timer2 overflow interrupt. Timer2's prescaler is changed to 32, so it overflows
+  once per Timer0 PWM period: 980 times per second on 16MHz and 490 times per second on 8MHz boards (and the PWM of pin
+  3 runs at that rate as well). The interrupt is only enabled while a pin has a fraction, a whole PWM value is written
+  once. With LED_DUTY_FRACTION_BITS fraction bits the slowest pattern (a fraction of 1/16) repeats 61 times per second
+  on 16MHz boards. The pattern changes the PWM value one step, which is only a large part of the duty cycle at the
+  bottom of the curve, where the eye is the least sensitive to flicker. More fraction bits would flicker visibly.
+
+  Fast PWM on Timer0 gives a spike of 1/256 for a PWM value of 0, which is why analogWrite() turns the pin off instead.
+  The interrupt can't do that, so the Timer0 pins run in inverting mode: the PWM value is inverted and 0 is really off.
+  The price is that fully on is 255/256.
+
+  Once attached the pin must not be written with analogWrite() or digitalWrite(), they disconnect the timer from the
+  pin. On the host there is no timer, the simulation calls ditheredPwmTick() itself and each period is a halPwmWrite().
+
+  Revision history:
+    16-10-2026 Initial version.
+*/
+
+// The maximum amount of pins that can be attached
+const uint8_t DITHER_MAX_PINS = 3;
+
+bool ditheredPwmAttach( uint8_t pin );
+void ditheredPwmWrite( uint8_t pin, uint16_t duty );
+bool ditheredPwmIsDithering();
+void ditheredPwmTick();
+
+/*
+  PWM sink for the AnimationManager (see animationManager.h) that writes the lightness with its fraction as a 12 bit
+  duty cycle to the dithered pins.
+*/
+struct DitheredPwmSink {
+  static inline uint16_t toDuty( uint16_t lightLevel ) {
+    return ledLightnessToDuty( lightLevel );
+  }
+
+  static inline void write( uint8_t pin, uint16_t duty ) {
+    ditheredPwmWrite( pin, duty );
+  }
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include "frameTimer.h"
+
+// The handler that is called for each frame, NULL when no frame timer has been started.
+static frameTimerHandler frameHandler = NULL;
+
+#ifdef ARDUINO
+// The clock: the amount of times Timer1 wrapped around, the us per wrap and the prescaler (8 or 64, 0 when not started)
+static volatile unsigned long clockWraps = 0;
+static unsigned long          clockWrapMicros = 0;
+static uint8_t                clockPrescaler = 0;
+#endif
+
+/*
+  Starts calling the given handler the given amount of times per second.
+  framesPerSecond: the frame rate, 4 - 255 frames per second.
+  handler        : the handler that is called for each frame.
+*/
+void frameTimerBegin( uint8_t framesPerSecond, frameTimerHandler handler ) {
+#ifdef ARDUINO
+  uint8_t oldSREG = SREG;
+  cli(); // the handler can not be assigned atomically, so make sure the interrupt doesn't fire halfway
+
+  frameHandler = handler;
+
+  TCCR1A = 0;                                   // No PWM outputs
+  TCCR1B = _BV( WGM12 ) | _BV( CS11 ) | _BV( CS10 ); // CTC mode with OCR1A as top, prescaler 64
+  TCNT1 = 0;
+  OCR1A = F_CPU / 64 / framesPerSecond - 1;
+  TIFR1 = _BV( OCF1A ) | _BV( TOV1 );           // Clear a pending compare match or overflow
+  TIMSK1 = _BV( OCIE1A );                       // The clock counts the frames
+
+  clockWraps = 0;
+  clockPrescaler = 64;
+  clockWrapMicros = ( OCR1A + 1UL ) * 64 / ( F_CPU / 1000000UL );
+
+  SREG = oldSREG;
+#else
+  (void)framesPerSecond;
+  frameHandler = handler;
+#endif
+}
+
+/*
+  Handles a frame by calling the frame handler. Called by the timer interrupt, or by the simulation on the host.
+*/
+void frameTimerTick() {
+  if ( frameHandler != NULL ) {
+    frameHandler( halMillis() );
+  }
+}
+
+/*
+  Starts the clock of frameTimerMicros(). When the frame timer runs it's already the clock, otherwise Timer1 counts
+  freely and its overflows are counted.
+*/
+void frameTimerStartClock() {
+#ifdef ARDUINO
+  if ( clockPrescaler != 0 ) {
+    return;
+  }
+  uint8_t oldSREG = SREG;
+  cli();
+
+  TCCR1A = 0;                                   // No PWM outputs
+  TCCR1B = _BV( CS11 );                         // Normal mode, prescaler 8
+  TCNT1 = 0;
+  TIFR1 = _BV( TOV1 );                          // Clear a pending overflow
+  TIMSK1 = _BV( TOIE1 );
+
+  clockWraps = 0;
+  clockPrescaler = 8;
+  clockWrapMicros = 65536UL * 8 / ( F_CPU / 1000000UL );
+
+  SREG = oldSREG;
+#endif
+}
+
+/*
+  Returns the microseconds counted by Timer1. Only the difference between two values is meaningful, it wraps around
+  like micros() does. Returns 0 when neither the clock nor the frame timer has been started.
+*/
+unsigned long frameTimerMicros() {
+#ifdef ARDUINO
+  uint8_t oldSREG = SREG;
+  cli();
+  uint16_t      ticks = TCNT1;
+  unsigned long wraps = clockWraps;
+  // A wrap that happened after the interrupts were disabled hasn't been counted yet. The flags of the wraps (OCF1A and
+  // TOV1) are at the same bits as their interrupt enables in TIMSK1.
+  uint16_t halfWrap = clockPrescaler == 8 ? 0x8000 : ( OCR1A + 1 ) / 2;
+  if ( ( TIFR1 & TIMSK1 & ( _BV( OCF1A ) | _BV( TOV1 ) ) ) && ticks < halfWrap ) {
+    wraps++;
+  }
+  SREG = oldSREG;
+  return wraps * clockWrapMicros + (unsigned long)ticks * clockPrescaler / ( F_CPU / 1000000UL );
+#else
+  return hostMicros();
+#endif
+}
+
+#ifdef ARDUINO
+ISR( TIMER1_COMPA_vect ) {
+  clockWraps++;
+  frameTimerTick();
+}
+
+ISR( TIMER1_OVF_vect ) {
+  clockWraps++;
+}
+#endif
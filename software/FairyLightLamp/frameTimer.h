@@ -0,0 +1,43 @@
+#ifndef FRAME_TIMER_H
+#define FRAME_TIMER_H
+
+#include "hal.h"
+
+/*
+  Library for calling a handler at a fixed frame rate from the Timer1 compare interrupt, and for measuring short
+  durations with Timer1.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  Timer1 isn't used by the sketch or MySensors. The PWM pins of Timer1 (9 and 10) are used by the radio as normal
+  digital pins, so we can use the timer in CTC mode with a prescaler of 64, which supports frame rates from 4 up to
+  255 frames per second on both 8MHz and 16MHz boards.
+
+  The handler is called from an interrupt, so it must be short and shouldn't use anything that depends on interrupts.
+  It receives the millis() at the moment of the frame.
+
+  frameTimerMicros() returns the microseconds counted by Timer1, with a resolution of a timer tick. When the frame
+  timer runs that's the frame timer itself (a tick is 64 clock cycles), the frames are counted by its interrupt. Without
+  the frame timer, frameTimerStartClock() lets Timer1 count freely with a prescaler of 8 (a tick is 0.5us on 16MHz
+  boards) and counts the overflows, which happen every 32.8ms on 16MHz and every 65.5ms on 8MHz boards. The value
+  wraps around, so only the difference between two values is meaningful.
+
+  On the host there's no timer, the simulation calls frameTimerTick() itself and the clock is the virtual clock.
+
+  Revision history:
+    16-10-2026 Initial version.
+    16-10-2026 Timer1 clock for the loop profiler.
+*/
+
+/*
+  Blue print for the frame handler. The argument is the millis() of the frame.
+*/
+typedef void (*frameTimerHandler)( unsigned long );
+
+void frameTimerBegin( uint8_t framesPerSecond, frameTimerHandler handler );
+void frameTimerTick();
+void frameTimerStartClock();
+unsigned long frameTimerMicros();
+
+#endif
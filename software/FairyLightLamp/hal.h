@@ -0,0 +1,99 @@
+#ifndef HAL_H
+#define HAL_H
+
+/*
+  Hardware abstraction layer for the fairy light libraries.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  The animation and multi click libraries don't talk to the Arduino core directly, but through the
+  small set of functions below:
+  - clock        : halMillis() returns the milliseconds since start up.
+  - PWM sink     : halPwmWrite() writes a duty cycle to a PWM pin.
+  - digital input: halPinMode() and halDigitalRead() configure and read a switch pin, halReadPort() reads all pins
+                   of a port at once (see halPinPort() and halPinMask() for the port and bit of a pin).
+  - EEPROM       : halEepromRead() and halEepromUpdate() read and write a byte of the EEPROM. A write takes about
+                   3.3ms, halEepromReady() tells if the previous write is done so the next one doesn't have to wait.
+                   halEepromReadBlock() reads a number of bytes at once, like a block of settings at boot.
+
+  When the sketch is compiled by the Arduino IDE the functions are inlined onto millis(), analogWrite(),
+  pinMode() and digitalRead(), so there's no overhead on the node. When the libraries are compiled on a
+  host (see the software/host directory) the functions are implemented by a simulation with a virtual
+  clock, a PWM sink that records every write and a digital input that can be driven from a benchmark.
+  That way we can measure the hot paths without flashing a node and hooking up a scope.
+
+  Revision history:
+    16-10-2026 Initial version.
+    16-10-2026 Port reads for scanning several switches at once.
+    16-10-2026 EEPROM access for the animation scripts.
+    16-10-2026 halEepromReady() for writing the EEPROM without waiting.
+    16-10-2026 halEepromReadBlock() for reading a block of settings in one go.
+*/
+
+#include <stdint.h>
+
+// The ports of the ATmega328P, numbered like their pin change interrupts (PCINT0 - PCINT2)
+const uint8_t HAL_PORT_B = 0; // pins 8 - 13
+const uint8_t HAL_PORT_C = 1; // pins A0 - A5 (14 - 19)
+const uint8_t HAL_PORT_D = 2; // pins 0 - 7
+const uint8_t HAL_PORT_COUNT = 3;
+
+// Returns the port of the given Arduino pin
+inline uint8_t halPinPort( uint8_t pin ) {
+  return pin < 8 ? HAL_PORT_D : pin < 14 ? HAL_PORT_B : HAL_PORT_C;
+}
+
+// Returns the bit of the given Arduino pin within its port
+inline uint8_t halPinMask( uint8_t pin ) {
+  return 1 << ( pin < 8 ? pin : pin < 14 ? pin - 8 : pin - 14 );
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <avr/eeprom.h>
+
+inline unsigned long halMillis() {
+  return millis();
+}
+
+inline void halPwmWrite( uint8_t pin, uint8_t value ) {
+  analogWrite( pin, value );
+}
+
+inline void halPinMode( uint8_t pin, uint8_t mode ) {
+  pinMode( pin, mode );
+}
+
+inline uint8_t halDigitalRead( uint8_t pin ) {
+  return digitalRead( pin );
+}
+
+inline uint8_t halReadPort( uint8_t port ) {
+  return port == HAL_PORT_B ? PINB : port == HAL_PORT_C ? PINC : PIND;
+}
+
+inline uint8_t halEepromRead( uint16_t address ) {
+  return eeprom_read_byte( (const uint8_t *)address );
+}
+
+inline void halEepromReadBlock( void *buffer, uint16_t address, uint8_t length ) {
+  eeprom_read_block( buffer, (const void *)address, length );
+}
+
+inline void halEepromUpdate( uint16_t address, uint8_t value ) {
+  eeprom_update_byte( (uint8_t *)address, value ); // Only writes when the value differs, which saves EEPROM wear
+}
+
+inline bool halEepromReady() {
+  return eeprom_is_ready();
+}
+
+#else
+
+#include "hostHal.h"
+
+#endif
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef LAYER_COMPOSITOR_H
+#define LAYER_COMPOSITOR_H
+
+#include "hal.h"
+
+/*
+  Library for composing the levels of the animations of a channel (layers) into the single level that is written to
+  the PWM pin.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  Each animation of a channel is a layer with a level (Q8.8 fixed point). The layers are composed from the lowest
+  priority to the highest, each one blended with the result of the layers below it:
+  - BLEND_OVERRIDE: the level of the layer replaces the layers below it, like a fade to a brightness level.
+  - BLEND_MULTIPLY: the level of the layer is a gain for the layers below it, LAYER_FULL_LEVEL leaves them as they are
+                    and 0 turns them off. Like an ambient effect or the off state of a blink.
+  - BLEND_ADD     : the level of the layer is added to the layers below it, up to the maximum level.
+  An inactive layer is skipped. All math is integer math, a multiply is a single 16 x 16 bit multiplication.
+
+  The priority and the blend mode of the layers are fixed, so they're not kept per channel. Like the PWM sink of the
+  AnimationManager, they're a type with static members (see AnimationLayers in animationManager.h):
+
+    struct Layers {
+      static inline uint8_t blendMode( uint8_t layer ) ...; // LAYER_BLEND_MODES, layer 0 has the lowest priority
+    };
+
+  The compiler resolves the blend mode of each layer, so the compositor costs no table in flash or RAM, and a blend
+  mode that no layer uses (like BLEND_ADD for the animations) costs no code either. The compositor keeps no state
+  between frames: it's a local variable of a single composition, to which the layers are added from the lowest
+  priority to the highest. Each layer is blended as it's added, so only the level so far is kept, 2 bytes on the stack
+  instead of the levels of all layers of all channels in RAM. Whether the level has to be written at all is decided
+  by the caller, e.g. by comparing the duty cycle with the last one it wrote.
+
+  Revision history:
+    16-10-2026 Initial version.
+    17-10-2026 Blends each layer as it's added instead of keeping the levels of the layers, so it takes no RAM.
+*/
+
+/*
+  The ways a layer is blended with the layers below it.
+*/
+typedef enum { BLEND_OVERRIDE, BLEND_MULTIPLY, BLEND_ADD } LAYER_BLEND_MODES;
+
+// const for the layers: the highest level, which passes the layers below a multiply layer unchanged.
+const uint16_t LAYER_FULL_LEVEL = 0xFFFF;
+
+/*
+  Returns the given level (Q8.8 fixed point) of the layers below, blended with the given level of a layer in the given
+  blend mode (LAYER_BLEND_MODES). A multiply scales with ( level + 1 ) / 65536, so both 0 and LAYER_FULL_LEVEL are
+  exact.
+*/
+inline uint16_t blendLayer( uint16_t below, uint16_t level, uint8_t blendMode ) {
+  switch ( blendMode ) {
+    case BLEND_MULTIPLY:
+      return (uint16_t)( ( (uint32_t)below * ( (uint32_t)level + 1 ) ) >> 16 );
+    case BLEND_ADD:
+      return level > LAYER_FULL_LEVEL - below ? LAYER_FULL_LEVEL : below + level;
+    default:
+      return level;
+  }
+}
+
+/*
+  Class template that composes the layers of a single channel during a single frame. It's implemented in this header
+  file, so the blend modes of Layers are resolved by the compiler.
+*/
+template<typename Layers> class LayerCompositor {
+  public:
+    LayerCompositor();
+
+    void     addLayer( uint8_t layer, bool active, uint16_t level );
+    uint16_t getLevel();
+  private:
+    uint16_t level; // Q8.8 fixed point, the level of the layers added so far
+};
+
+
+//                              LayerCompositor
+
+/*
+  Creates an instance of the LayerCompositor class, without layers. It composes to level 0.
+*/
+template<typename Layers> LayerCompositor<Layers>::LayerCompositor() {
+  this->level = 0;
+}
+
+/*
+  Adds the given layer, which must have a higher priority than the layers added before it. An active layer is blended
+  at the given level (Q8.8 fixed point) with the layers below it, an inactive one is skipped and its level is ignored.
+*/
+template<typename Layers> void LayerCompositor<Layers>::addLayer( uint8_t layer, bool active, uint16_t level ) {
+  if ( active ) {
+    this->level = blendLayer( this->level, level, Layers::blendMode( layer ) );
+  }
+}
+
+/*
+  Returns the level (Q8.8 fixed point) of the active layers added so far.
+*/
+template<typename Layers> uint16_t LayerCompositor<Layers>::getLevel() {
+  return this->level;
+}
+
+#endif
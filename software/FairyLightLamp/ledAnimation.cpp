@@ -6,216 +6,312 @@
 */
 
 
-//                              AnimationBase
-
-/*
-  Assignes the given animation listener as the listener for the animation. Assign NULL if you
-  want to deregister the current listener.
-*/
-void AnimationBase::setAnimationListener( AnimationListener *aListener ) {
-  this->listener = aListener;
-}
-
-/*
-  Animations must call this method when the animation is finised so that
-  the animation finished event can be received by the animation listener.
-*/
-void AnimationBase::fireAnimationFinished() {
-  if ( this->listener != NULL ) {
-    this->listener->onAnimationFinished( this ); // Not sure if it can reference the child reference
-  }
-}
-
-
-
-
 //                              SmoothBrightnessTransistion
 
 /*
-  Create an instance of the SmoothBrightnessTransistion class.
-
-  pwmPin: IO pin of the arduino to is used to show the animation.
+  Create an instance of the SmoothBrightnessTransistion class. The animation starts at level 0 (off), the
+  current level can be read with getCurrentBrightnessLevel().
 */
-SmoothBrightnessTransistion::SmoothBrightnessTransistion( uint8_t pwmPin ) {
-  this->pwmPin = pwmPin;
-  this->currentLightLevel = 0.0;
-  this->targetLightLevel = 0.0; // We are at the end of the animation
-  this->animationStepDuration = 50;
-  this->animationStarted = millis();
-  this->stepIncrement = 0.0; // doesn't need to be initialized
+SmoothBrightnessTransistion::SmoothBrightnessTransistion() {
+  this->currentLightLevel = 0;
+  this->targetLightLevel = 0; // We are at the end of the animation
+  this->animationStarted = halMillis();
+  this->startLightLevel = 0;
+  this->animationStep = animationSteps;
 }
 
 /*
-  method for checking and handling the current animation.
+  method for checking and handling the current animation. Returns true when the animation finished during this call.
 
   currentMillis: the current millis of the micro controller.
 */
-void SmoothBrightnessTransistion::checkAnimation( unsigned long currentMillis ) {
+bool SmoothBrightnessTransistion::checkAnimation( unsigned long currentMillis ) {
   if ( !this->isAnimationFinished() ) {
-    if ( currentMillis - this->animationStarted >= animationStepDuration ) {
+    if ( currentMillis - this->animationStarted >= stepDuration ) {
       this->animationStarted = currentMillis;
-      this->currentLightLevel += this->stepIncrement;
+      this->animationStep++;
 
-      // Cap of current level if it exceeds the target level.
-      if ( this->stepIncrement < 0 ) {
-        if ( this->currentLightLevel < this->targetLightLevel ) {
-          this->currentLightLevel = this->targetLightLevel;
-        }
+      // The progress (0-255) along the easing curve is looked up, the last step always ends exactly at the target.
+      uint16_t targetLevel = (uint16_t)this->targetLightLevel << 8;
+      if ( this->animationStep >= animationSteps ) {
+        this->currentLightLevel = targetLevel;
+        return true;
       }
       else {
-        if ( this->currentLightLevel > this->targetLightLevel ) {
-          this->currentLightLevel = this->targetLightLevel;
+        uint8_t progress = LedCurveTable< LedEasingCurve<animationSteps> >::read( this->animationStep );
+        if ( targetLevel < this->startLightLevel ) {
+          this->currentLightLevel = this->startLightLevel - (uint16_t)( ( (uint32_t)( this->startLightLevel - targetLevel ) * progress ) >> 8 );
+        }
+        else {
+          this->currentLightLevel = this->startLightLevel + (uint16_t)( ( (uint32_t)( targetLevel - this->startLightLevel ) * progress ) >> 8 );
         }
       }
-      analogWrite( this->pwmPin, (uint8_t)this->currentLightLevel );
     }
   }
+  return false;
 }
 
 /*
    Determines wether the animation is finished (true) or still running (false)
 */
 bool SmoothBrightnessTransistion::isAnimationFinished() {
-  return (uint8_t)this->currentLightLevel == (uint8_t)this->targetLightLevel;
+  return this->getCurrentBrightnessLevel() == this->targetLightLevel;
 }
 
 /*
-  (re)triggers the animation. The currentLevel will be transistioned to the given target level.
+  (re)triggers the animation. The currentLevel will be transistioned to the given target level. When an animation
+  is running it continues from the current level, starting at the beginning of the easing curve.
 */
 void SmoothBrightnessTransistion::setLevel( uint8_t targetLevel ) {
   this->targetLightLevel = targetLevel;
-  this->stepIncrement = ( (double)this->targetLightLevel - this->currentLightLevel ) / animationSteps;
-  this->animationStarted = millis();
+  this->startLightLevel = this->currentLightLevel;
+  this->animationStep = 0;
+  this->animationStarted = halMillis();
 }
 
 /*
-  Returns the current brightness as a byte - internal it's a double.
+  Continues the animation from the given level, e.g. when another animation (a script) drove the channel in the
+  mean time. It fades from the given level to the target level, or stays there when it's the target level.
+*/
+void SmoothBrightnessTransistion::continueFrom( uint8_t currentLevel ) {
+  this->currentLightLevel = (uint16_t)currentLevel << 8;
+  this->setLevel( this->targetLightLevel );
+}
+
+uint16_t SmoothBrightnessTransistion::stepDuration = animationStepDuration;
+
+/*
+  Sets the duration of a step in ms of all fades, a fade takes animationSteps of them. A running fade continues with
+  the new duration from its next step.
+*/
+void SmoothBrightnessTransistion::setStepDuration( uint16_t duration ) {
+  stepDuration = duration;
+}
+
+/*
+  Returns the current brightness as a byte - internal it's a Q8.8 fixed point value, of which the
+  high byte is the brightness.
 */
 uint8_t SmoothBrightnessTransistion::getCurrentBrightnessLevel() {
-  return (uint8_t)this->currentLightLevel;
+  return (uint8_t)( this->currentLightLevel >> 8 );
+}
+
+/*
+  Returns the current brightness with its fraction, as the Q8.8 fixed point value.
+*/
+uint16_t SmoothBrightnessTransistion::getCurrentLightLevel() {
+  return this->currentLightLevel;
 }
 
 
 
-//                              AnimationBase
+//                              OffBlinkAnimation
+
+// The counter of a finished blink animation, at least the amount of blinks whatever setBlink() sets
+const uint8_t BLINK_FINISHED = 0xFF;
+
+uint8_t  OffBlinkAnimation::blinkAmount = boundaryBlinkAmount;
+uint16_t OffBlinkAnimation::blinkDelay = boundaryBlinkDelay;
 
 /*
-  Creates an instance of the OffBlinkAnimation class
-  pwmPin    : the PWM pin on which the animations need to be shown
-  amount    : the amount of off blinks that will be shown
-  blinkDelay: the duration in ms between the on and off state
+  Creates an instance of the OffBlinkAnimation class, finished. The amount of off blinks and the duration of each on
+  and off state are those of setBlink().
 */
-OffBlinkAnimation::OffBlinkAnimation( uint8_t pwmPin, uint8_t amount, unsigned long blinkDelay ) {
-  this->blinkAmount = amount;
-  this->blinkDelay = blinkDelay;
-  this->pwmPin = pwmPin;
+OffBlinkAnimation::OffBlinkAnimation() {
   this->blinkState = true;
-  this->blinkCounter = amount;
+  this->blinkCounter = BLINK_FINISHED;
+  this->lightLevel = 0;
 }
 
 /*
   Starts a blink animation.
-  brightnessLevel: the brightness level of the on state.
+  lightLevel: the brightness level (lightness) of the on state, a Q8.8 fixed point value.
 */
-void OffBlinkAnimation::startAnimation( uint8_t brightnessLevel ) {
+void OffBlinkAnimation::startAnimation( uint16_t lightLevel ) {
   this->blinkCounter = 1; // We start with the blink cycle
-  this->brightnessLevel = brightnessLevel;
+  this->lightLevel = lightLevel;
   this->blinkState = false; // means off
-  this->animationStart = millis();
-  analogWrite( this->pwmPin, 0 ); // Show the first off
+  this->animationStart = halMillis();
 }
 
 /*
-  Checks and handles the animation. Must be called in the main loop
+  Checks and handles the animation. Must be called in the main loop. Returns true when the animation finished during
+  this call.
 */
-void OffBlinkAnimation::checkAnimation( unsigned long currentMillis ) {
-  if ( ( currentMillis - this->animationStart >= this->blinkDelay ) && !this->animationFinished()) {
+bool OffBlinkAnimation::checkAnimation( unsigned long currentMillis ) {
+  if ( ( currentMillis - this->animationStart >= blinkDelay ) && !this->animationFinished()) {
     this->blinkState = !this->blinkState;
 
-    if ( this->blinkState ) {
-      analogWrite( this->pwmPin, this->brightnessLevel ); // Show the first off
-    }
-    else {
-      analogWrite( this->pwmPin, 0 ); // Show the first off
+    if ( !this->blinkState ) {
       this->blinkCounter++;
     }
+    this->animationStart = currentMillis;
     if ( this->animationFinished() ) {
-      this->fireAnimationFinished();
+      this->blinkCounter = BLINK_FINISHED; // Stays finished when the amount of blinks is raised
+      return true;
     }
-
-    this->animationStart = currentMillis;
   }
+  return false;
 }
 
 /*
    Determins wether an animation is running (false) or if the animations is finished (true).
 */
 bool OffBlinkAnimation::animationFinished() {
-  return this->blinkCounter == this->blinkAmount && this->blinkState;
+  return this->blinkCounter >= blinkAmount && this->blinkState;
 }
 
+/*
+  Sets the amount of off blinks (at least 1) and the duration in ms of each on and off state of all blink animations.
+  A running animation continues with the new delay, and ends after the new amount or after the current blink when
+  that's already past it.
+*/
+void OffBlinkAnimation::setBlink( uint8_t amount, uint16_t delay ) {
+  blinkAmount = amount;
+  blinkDelay = delay;
+}
 
-
-//                              AnimationBase
+/*
+  Returns the brightness level of the current blink state, zero when the blink is off.
+*/
+uint8_t OffBlinkAnimation::getCurrentBrightnessLevel() {
+  return this->getCurrentLightLevel() >> 8;
+}
 
 /*
-  Creates an instance of the AnimationManager class
-  pwmPin : the pwm pin to which the fairy light led string is connected (through a mosfet)
+  Returns the brightness level of the current blink state with its fraction (Q8.8), zero when the blink is off.
 */
-AnimationManager::AnimationManager( uint8_t pwmPin ) {
-  // our off blink animation is defined as turned 3 times of and end with the lights on
-  // we assume the lights are on, because they are when you turn the rotary encoder to change
-  // the brightness level.
-  this->offBlinkAnimation = new OffBlinkAnimation( pwmPin, 3, 300 );
-  this->smoothTransistionAnimation = new SmoothBrightnessTransistion( pwmPin );
+uint16_t OffBlinkAnimation::getCurrentLightLevel() {
+  return this->blinkState ? this->lightLevel : 0;
+}
+
+
+
+//                              LongFadeAnimation
 
-  this->offBlinkAnimation->setAnimationListener( this );
-  this->smoothTransistionAnimation->setAnimationListener( this );
+/*
+  Creates an instance of the LongFadeAnimation class, no fade is running.
+*/
+LongFadeAnimation::LongFadeAnimation() {
+  this->startLightLevel = 0;
+  this->currentLightLevel = 0;
+  this->targetLightLevel = 0;
+  this->running = false;
+  this->timeShift = 0;
+  this->durationUnits = 0;
+  this->animationStarted = 0;
+  this->nextChange = 0;
 }
 
 /*
-  Listens for animation finish events for the Animations managed by the class.
+  Starts a fade from the given level to the given target level, which takes the given duration.
+  lightLevel : the level at which the fade starts, a Q8.8 fixed point value.
+  targetLevel: the brightness level (lightness) at the end of the fade.
+  duration   : the duration of the fade in ms.
+
+  The time is counted in units of a power of 2 ms, so the duration in units fits 16 bits. A level times a duration
+  then fits the 32 bits of an unsigned long. For an hour a unit is 64ms, way shorter than the time between two steps.
 */
-void AnimationManager::onAnimationFinished( AnimationBase *source  ) {
-  if ( source == this->offBlinkAnimation ) {
-  }
-  else if ( source == this->smoothTransistionAnimation ) {
+void LongFadeAnimation::startAnimation( uint16_t lightLevel, uint8_t targetLevel, unsigned long duration ) {
+  this->timeShift = 0;
+  while ( ( duration >> this->timeShift ) > 0xFFFF ) {
+    this->timeShift++;
   }
+  this->durationUnits = duration >> this->timeShift;
+  this->startLightLevel = lightLevel;
+  this->currentLightLevel = lightLevel;
+  this->targetLightLevel = targetLevel;
+  this->animationStarted = halMillis();
+  this->nextChange = 0; // Checked at once, so the owner learns the first level to wait for
+  this->running = true;
+}
+
+/*
+  Stops the fade at its current level, e.g. when the user changes the brightness.
+*/
+void LongFadeAnimation::stopAnimation() {
+  this->running = false;
 }
 
 /*
-  Starts a boundary reached animation, if and only if there's no boundary reached animation currently running.
+  Checks and handles the animation. Does nothing until the level that was given to waitForLevel() is reached, then the
+  current level is calculated for the current time. Returns true when the animation finished during this call.
 */
-void AnimationManager::startBoundaryReachedAnimation() {
-  if ( this->offBlinkAnimation->animationFinished() ) {
-    this->offBlinkAnimation->startAnimation( this->smoothTransistionAnimation->getCurrentBrightnessLevel() );
+bool LongFadeAnimation::checkAnimation( unsigned long currentMillis ) {
+  if ( !this->running || currentMillis - this->animationStarted < this->nextChange ) {
+    return false;
   }
+
+  uint16_t targetLevel = (uint16_t)this->targetLightLevel << 8;
+  unsigned long elapsedUnits = ( currentMillis - this->animationStarted ) >> this->timeShift;
+  if ( elapsedUnits >= this->durationUnits ) {
+    this->currentLightLevel = targetLevel;
+    this->running = false;
+    return true;
+  }
+
+  if ( targetLevel < this->startLightLevel ) {
+    this->currentLightLevel = this->startLightLevel - (uint16_t)( (uint32_t)( this->startLightLevel - targetLevel ) * elapsedUnits / this->durationUnits );
+  }
+  else {
+    this->currentLightLevel = this->startLightLevel + (uint16_t)( (uint32_t)( targetLevel - this->startLightLevel ) * elapsedUnits / this->durationUnits );
+  }
+  return false;
 }
 
 /*
-  determines wether the animation is finised (true) or if an animation is running (false).
+  Determines wether the animation is finished or stopped (true) or still running (false).
 */
-bool AnimationManager::animationFinished() {
-  bool result = this->offBlinkAnimation->animationFinished() && this->smoothTransistionAnimation->isAnimationFinished();
-  return result;
+bool LongFadeAnimation::animationFinished() {
+  return !this->running;
 }
 
 /*
-  Checks and handles animations. Must be call from the main loop for each cycle.
+  Tells the fade to do nothing until it reaches the given level (Q8.8 fixed point), the next level at which the
+  output changes. The moment is rounded up to the next unit of time, so the level is reached at the next check.
 */
-void AnimationManager::checkAnimation( unsigned long currentMillis ) {
-  if ( !this->offBlinkAnimation->animationFinished() ) {
-    this->offBlinkAnimation->checkAnimation( currentMillis );
+void LongFadeAnimation::waitForLevel( uint16_t lightLevel ) {
+  uint16_t targetLevel = (uint16_t)this->targetLightLevel << 8;
+  uint16_t span = targetLevel < this->startLightLevel ? this->startLightLevel - targetLevel : targetLevel - this->startLightLevel;
+  uint16_t distance = lightLevel < this->startLightLevel ? this->startLightLevel - lightLevel : lightLevel - this->startLightLevel;
+  if ( span == 0 || distance >= span ) {
+    this->nextChange = (unsigned long)this->durationUnits << this->timeShift;
   }
-  else if ( !this->smoothTransistionAnimation->isAnimationFinished() ) {
-    this->smoothTransistionAnimation->checkAnimation( currentMillis );
+  else {
+    unsigned long units = ( (uint32_t)distance * this->durationUnits + span - 1 ) / span;
+    this->nextChange = units << this->timeShift;
+  }
+}
+
+/*
+  Returns the amount of ms until the level the fade waits for is reached (0 when it's due), or LONG_FADE_NO_CHANGE when
+  no fade is running.
+*/
+unsigned long LongFadeAnimation::getNextChange( unsigned long currentMillis ) {
+  if ( !this->running ) {
+    return LONG_FADE_NO_CHANGE;
   }
+  unsigned long elapsed = currentMillis - this->animationStarted;
+  return elapsed >= this->nextChange ? 0 : this->nextChange - elapsed;
+}
+
+/*
+  Returns the brightness level at the end of the fade.
+*/
+uint8_t LongFadeAnimation::getTargetLevel() {
+  return this->targetLightLevel;
+}
+
+/*
+  Returns the current brightness as a byte, the high byte of the Q8.8 level.
+*/
+uint8_t LongFadeAnimation::getCurrentBrightnessLevel() {
+  return (uint8_t)( this->currentLightLevel >> 8 );
 }
 
 /*
-  Transistions the fairy light lef string to the given target brightness level. Starting brightness
-  is the current brightness.
+  Returns the current brightness with its fraction, as the Q8.8 fixed point value.
 */
-void AnimationManager::fadeToBrightnessLevel( uint8_t targetLevel ) {
-  this->smoothTransistionAnimation->setLevel( targetLevel );
+uint16_t LongFadeAnimation::getCurrentLightLevel() {
+  return this->currentLightLevel;
 }
@@ -1,7 +1,8 @@
 #ifndef LED_ANIMATION_H
 #define LED_ANIMATION_H
 
-#include <Arduino.h>
+#include "hal.h"
+#include "ledCurves.h"
 
 /*
   Library for handling fading and blinking anymotiond on a PWM pin. This libraru was developped to
@@ -13,9 +14,11 @@
   The library contains classes for the implementation for the following animations:
   - SmoothBrightnessTransistion: Class for smooth transistions between different brightness levels.
                                  it translates from the current brightness level to the target brightness level
-                                 in 10 steps of a 50ms duration. Whenever a new target brightness level is set
-                                 the animation is adjusted to the new situation. Providing smooth transistions with
-                                 a static total duration (10 * 50ms = 500ms) for a beter user experience.
+                                 in 10 steps of a 50ms duration, following the easing curve (see ledCurves.h).
+                                 Whenever a new target brightness level is set the animation is adjusted to the new
+                                 situation. Providing smooth transistions with a static total duration
+                                 (10 * 50ms = 500ms) for a beter user experience. The duration of a step can be
+                                 changed at run time, the amount of steps can't: the easing curve is a table in flash.
    - OffBlinkAnimation         : Class for an off blink animation. The amount of times the lamp is turned of and
                                  the duration for eacht on and off can be provided when the class is instanciated.
                                  You could use this as an OnBlinkAnimation, but bare in mind that it always starts with
@@ -23,119 +26,134 @@
                                  when the user tries to exceeds the brightness limits (minimum and maximum) of the
                                  fairy light led strings lamp. If this is unwanted behavior and you want the opposite -
                                  meaning x on blinks, it is better to write a new class,
-
-  All of the above animation classes are wrapped in the AnimationManager class. This class handles the correct
-  animation according to the implement animation hierarchie, which is if an off blink is requested this animation is handled
-  first. If a smooth transistion animation is requested it is handled of no off blink animation is active. This is so that we
-  can provide the user with exceeding brightness level and if the user changes the brightness level when the off animation is
-  playing, the transition to the new brightnes is handled afterwards. This way wwe provide the user with a better overall
-  experience.
+   - LongFadeAnimation         : Class for a fade that lasts minutes instead of half a second, like a sunrise or a
+                                 sunset. The lightness follows a straight line in time, which looks even because the
+                                 lightness is already perceptual. It doesn't step at a fixed interval, the owner tells it
+                                 the next level at which the PWM output changes (see AnimationManager), and it does
+                                 nothing until that level is reached. So a fade of an hour takes a few hundred steps
+                                 instead of one every 50ms, and the node knows how long it can sleep in between.
+
+  All of the above animation classes are wrapped in the AnimationManager class template (see animationManager.h),
+  together with the script animation of animationScript.h. Each animation is a layer of the channel, which the manager
+  blends into the level of the channel (see layerCompositor.h). An off blink is the top layer, it turns the layers
+  below it off and on again. So when the user changes the brightness level while the off blink is playing, the
+  transition to the new brightness runs during the blink, and the user sees it in its on states.
+
+  The brightness levels used by the animations are lightness values (0-255), which are converted to PWM values
+  with the gamma table from ledCurves.h when they are written to the PWM pin.
 
   Revision history:
     06-01-2021 Initial version.
+    16-10-2026 SmoothBrightnessTransistion uses Q8.8 fixed point math instead of doubles. The AVR has no FPU,
+               so each step was a soft float add, compare and convert.
+    16-10-2026 Brightness levels are lightness values which are gamma corrected when written. The fade follows
+               the easing curve, instead of a linear ramp.
+    16-10-2026 AnimationManager drives a number of channels (led strings), without heap allocations. The animations
+               no longer write to the PWM pin themselves, the manager writes a channel when its value changed.
+    16-10-2026 AnimationManager moved to animationManager.h. SmoothBrightnessTransistion can continue from the level
+               of another animation.
+    16-10-2026 The level of SmoothBrightnessTransistion and OffBlinkAnimation can be read with its fraction, for the
+               dithered PWM outputs (see ditheredPwm.h).
+    16-10-2026 The animations no longer have a listener (a pointer per animation and a virtual call), checkAnimation()
+               returns true when the animation finished. The AnimationManager passes it to its listener type.
+    16-10-2026 LongFadeAnimation for sunrises and sunsets.
+    16-10-2026 The step duration of SmoothBrightnessTransistion and the blinks of OffBlinkAnimation can be changed at
+               run time.
+    17-10-2026 The step duration and the blinks are shared by all instances, like the durations of MultiClick.
 */
 
 
-// const that defines the amount of steps for a smooth transistion animations.
-const uint8_t animationSteps = 10;
-
-/*
-  Pre declare listener class so we can implement the circular reference between the AnimationListern and the AnimationBase classes
-*/
-class AnimationListener;
-
-/*
-  Base class for animation, so that listener can subscribe for animition finished events.
-*/
-class AnimationBase {
-  public:
-    void setAnimationListener( AnimationListener *aListener );
-  protected:
-    void fireAnimationFinished();
-  private:
-    AnimationListener* listener = NULL;
-};
-
-/*
-  Classes that want to subscribe to Animation changes should inherint the AnimationListener class.
+// const that defines the amount of steps for a smooth transistion animations and the default duration of a step.
+const uint8_t  animationSteps = 10;
+const uint16_t animationStepDuration = 50;
 
-  note: Currently not used by the AnimationManager class. But could be used so that the sketch can go into
-       sleep mode when all animations have ended.
-*/
-class AnimationListener {
-  public:
-    virtual void onAnimationFinished( AnimationBase* source );
-};
+// consts that define the boundary reached animation: 3 times off, with 300ms for each on and off.
+const uint8_t  boundaryBlinkAmount = 3;
+const uint16_t boundaryBlinkDelay = 300;
 
+// const for the long fades: returned by getNextChange() when there is no change to wait for.
+const unsigned long LONG_FADE_NO_CHANGE = 0xFFFFFFFF;
 
 /*
   Class for providing smooth transisitions between different light brightness levels. See
   cpp file for the documentation.
 */
-class SmoothBrightnessTransistion : public AnimationBase {
+class SmoothBrightnessTransistion {
   public:
-    SmoothBrightnessTransistion( uint8_t pwmPin );
+    SmoothBrightnessTransistion();
 
-    void checkAnimation( unsigned long currentMillis );
+    bool checkAnimation( unsigned long currentMillis );
     void setLevel( uint8_t targetLevel );
+    void continueFrom( uint8_t currentLevel );
+    static void setStepDuration( uint16_t duration );
 
-    uint8_t getCurrentBrightnessLevel();
+    uint8_t  getCurrentBrightnessLevel();
+    uint16_t getCurrentLightLevel();
 
     bool isAnimationFinished();
   private:
-    uint8_t       pwmPin;
-    double        currentLightLevel;
-    double        targetLightLevel;
-    double        stepIncrement; // The increment amount. Can be negative
+    uint16_t      currentLightLevel; // Q8.8 fixed point, the high byte is the lightness
+    uint16_t      startLightLevel;   // Q8.8 fixed point, the level at which the animation started
+    uint8_t       targetLightLevel;
+    uint8_t       animationStep;     // The current step (0 - animationSteps) on the easing curve
 
     // members for the animation (step) duration
-    unsigned long animationStarted;
-    unsigned long animationStepDuration;
+    static uint16_t stepDuration; // The step duration of all fades, so a fade doesn't take RAM for it
+    unsigned long   animationStarted;
 };
 
 /*
   Class for handling off blink animations. Dee cpp file for documentation.
 */
-class OffBlinkAnimation : public AnimationBase {
+class OffBlinkAnimation {
   public:
-    OffBlinkAnimation( uint8_t pwmPin, uint8_t amount, unsigned long blinkDelay ); // AnimationListener *animationListener
+    OffBlinkAnimation();
 
-    void startAnimation( uint8_t brightnessLevel );
-    void checkAnimation( unsigned long currentMillis );
+    void startAnimation( uint16_t lightLevel );
+    bool checkAnimation( unsigned long currentMillis );
     bool animationFinished();
+    static void setBlink( uint8_t amount, uint16_t delay );
+
+    uint8_t  getCurrentBrightnessLevel();
+    uint16_t getCurrentLightLevel();
   protected:
   private:
-    uint8_t       pwmPin;
-    uint8_t       blinkAmount;
-    uint8_t       blinkCounter;
-    uint8_t       brightnessLevel;
-    bool          blinkState;
+    static uint8_t  blinkAmount; // The blinks of all blink animations, so a blink doesn't take RAM for them
+    static uint16_t blinkDelay;
 
-    unsigned long blinkDelay;
+    uint8_t       blinkCounter;      // BLINK_FINISHED when the animation is finished
+    uint16_t      lightLevel;        // Q8.8 fixed point, the level of the on state
+    bool          blinkState;
     unsigned long animationStart;
-
-    AnimationListener *animationListener;
 };
 
 /*
- Class the implements hierarchy for the supported animations. See cpp file for documentation.
-  The boundary reeached animation has a higher hierachy than the fade to brightness level animation.
- */
-class AnimationManager : public AnimationListener {
+  Class for fades of minutes, like a sunrise. See the cpp file for the documentation.
+*/
+class LongFadeAnimation {
   public:
-    AnimationManager( uint8_t pwmPin );
-    void onAnimationFinished( AnimationBase* source  );
+    LongFadeAnimation();
 
-    void startBoundaryReachedAnimation();
-    void fadeToBrightnessLevel( uint8_t targetLevel );
+    void startAnimation( uint16_t lightLevel, uint8_t targetLevel, unsigned long duration );
+    void stopAnimation();
+    bool checkAnimation( unsigned long currentMillis );
+    bool animationFinished();
 
+    void          waitForLevel( uint16_t lightLevel );
+    unsigned long getNextChange( unsigned long currentMillis );
 
-    bool animationFinished();
-    void checkAnimation( unsigned long currentMillis );
+    uint8_t  getTargetLevel();
+    uint8_t  getCurrentBrightnessLevel();
+    uint16_t getCurrentLightLevel();
   private:
-    OffBlinkAnimation           *offBlinkAnimation;
-    SmoothBrightnessTransistion *smoothTransistionAnimation;
+    uint16_t      startLightLevel;   // Q8.8 fixed point, the level at which the fade started
+    uint16_t      currentLightLevel; // Q8.8 fixed point
+    uint8_t       targetLightLevel;
+    bool          running;
+    uint8_t       timeShift;         // The time is counted in units of 1 << timeShift ms, so the math fits 32 bits
+    uint16_t      durationUnits;     // The duration of the fade in those units
+    unsigned long animationStarted;
+    unsigned long nextChange;        // ms after the start at which the level the owner waits for is reached
 };
 
-
 #endif
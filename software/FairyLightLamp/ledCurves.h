@@ -0,0 +1,249 @@
+#ifndef LED_CURVES_H
+#define LED_CURVES_H
+
+#include "hal.h"
+
+/*
+  Library with lookup tables for the brightness curves of the fairy light led strings.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  LEDs don't look linear. Doubling the PWM value doesn't double the brightness we see, at the top
+  a few PWM steps are invisible while at the bottom every step is a visible jump. So the animations
+  work with a perceived brightness, the lightness (0-255), which is converted to a PWM value by a gamma
+  table just before it's written. The fade follows an easing curve instead of a linear ramp.
+
+  All the tables are calculated by the compiler (constexpr) and stored in flash (PROGMEM). At run time
+  each conversion is a single table lookup, no math.
+
+  The curves can be selected at compile time by changing the defines below. Note that the Arduino IDE
+  compiles each cpp file on its own, so defining them in the sketch doesn't work, change them here.
+  - LED_GAMMA_CURVE : LED_GAMMA_CIE1931 (the CIE 1931 lightness formula) or LED_GAMMA_LINEAR (no correction)
+  - LED_EASING_CURVE: LED_EASING_LINEAR, LED_EASING_EASE_IN_OUT (smooth start and end) or LED_EASING_EXPONENTIAL
+                      (slow start, fast end)
+
+  For the dithered PWM outputs (see ditheredPwm.h) there's a second gamma table with a duty cycle of 12 bits: the PWM value
+  with LED_DUTY_FRACTION_BITS fraction bits. ledLightnessToDuty() interpolates it for a lightness with a fraction (Q8.8),
+  so a fade at the bottom of the curve gets a duty cycle for each step instead of sharing a few PWM values.
+
+  Revision history:
+    16-10-2026 Initial version.
+    16-10-2026 Gamma table with a 12 bit duty cycle for the dithered PWM outputs.
+*/
+
+#define LED_GAMMA_LINEAR       0
+#define LED_GAMMA_CIE1931      1
+
+#define LED_EASING_LINEAR      0
+#define LED_EASING_EASE_IN_OUT 1
+#define LED_EASING_EXPONENTIAL 2
+
+#ifndef LED_GAMMA_CURVE
+#define LED_GAMMA_CURVE LED_GAMMA_CIE1931
+#endif
+
+#ifndef LED_EASING_CURVE
+#define LED_EASING_CURVE LED_EASING_EASE_IN_OUT
+#endif
+
+// The fraction bits of the duty cycle of ledLightnessToDuty(), a duty cycle of LED_DUTY_MAX is fully on
+const uint8_t  LED_DUTY_FRACTION_BITS = 4;
+const uint16_t LED_DUTY_MAX = 255 << LED_DUTY_FRACTION_BITS;
+
+
+/*
+  Compile time math. Only C++11 is available on the AVR, so each function is a single (recursive) expression.
+*/
+namespace LedCurveMath {
+  constexpr double cube( double x ) {
+    return x * x * x;
+  }
+
+  // Cube root of x (0 < x <= 1) with Newton's method
+  constexpr double cubeRoot( double x, double y = 1.0, uint8_t iterations = 40 ) {
+    return iterations == 0 ? y : cubeRoot( x, y - ( cube( y ) - x ) / ( 3 * y * y ), iterations - 1 );
+  }
+
+  // e^x with the Taylor series
+  constexpr double exponent( double x, double term = 1.0, uint8_t n = 1 ) {
+    return n > 60 ? term : term + exponent( x, term * x / n, n + 1 );
+  }
+
+  // Rounds the given fraction (0-1) to a byte (0-255)
+  constexpr uint8_t toByte( double fraction ) {
+    return fraction <= 0.0 ? 0 : fraction >= 1.0 ? 255 : (uint8_t)( fraction * 255 + 0.5 );
+  }
+
+  // Rounds the given fraction (0-1) to a duty cycle (0-LED_DUTY_MAX)
+  constexpr uint16_t toDuty( double fraction ) {
+    return fraction <= 0.0 ? 0 : fraction >= 1.0 ? LED_DUTY_MAX : (uint16_t)( fraction * LED_DUTY_MAX + 0.5 );
+  }
+
+  // The CIE 1931 formula: luminance (0-1) for the given lightness (0-1)
+  constexpr double cie1931( double lightness ) {
+    return lightness * 100 <= 8 ? lightness * 100 / 903.3 : cube( ( lightness * 100 + 16 ) / 116 );
+  }
+
+  // The inverse of the CIE 1931 formula: lightness (0-1) for the given luminance (0-1)
+  constexpr double inverseCie1931( double luminance ) {
+    return luminance <= 0.008856 ? luminance * 903.3 / 100 : ( 116 * cubeRoot( luminance ) - 16 ) / 100;
+  }
+
+  // The Arduino map() function
+  constexpr long map( long x, long inMin, long inMax, long outMin, long outMax ) {
+    return ( x - inMin ) * ( outMax - outMin ) / ( inMax - inMin ) + outMin;
+  }
+}
+
+
+/*
+  The curves. Each curve defines the amount of values in the table (size) and the function that calculates a value.
+*/
+
+/*
+  Converts a lightness (0-255) to a PWM value (0-255).
+*/
+struct LedGammaCurve {
+  static constexpr uint16_t size = 256;
+
+  static constexpr uint8_t value( uint16_t lightness ) {
+#if LED_GAMMA_CURVE == LED_GAMMA_CIE1931
+    return LedCurveMath::toByte( LedCurveMath::cie1931( lightness / 255.0 ) );
+#else
+    return (uint8_t)lightness;
+#endif
+  }
+
+  // The lightness that results in the given PWM value, used to calculate tables at compile time.
+  static constexpr uint8_t inverse( uint8_t pwm ) {
+#if LED_GAMMA_CURVE == LED_GAMMA_CIE1931
+    return LedCurveMath::toByte( LedCurveMath::inverseCie1931( pwm / 255.0 ) );
+#else
+    return pwm;
+#endif
+  }
+};
+
+/*
+  Converts a lightness (0-255) to a duty cycle (0-LED_DUTY_MAX), the PWM value with LED_DUTY_FRACTION_BITS fraction bits.
+*/
+struct LedFineGammaCurve {
+  static constexpr uint16_t size = 256;
+
+  static constexpr uint16_t value( uint16_t lightness ) {
+#if LED_GAMMA_CURVE == LED_GAMMA_CIE1931
+    return LedCurveMath::toDuty( LedCurveMath::cie1931( lightness / 255.0 ) );
+#else
+    return lightness << LED_DUTY_FRACTION_BITS;
+#endif
+  }
+};
+
+/*
+  The progress (0-255) of a fade with the given amount of steps for each step (0-steps).
+*/
+template<uint8_t steps> struct LedEasingCurve {
+  static constexpr uint16_t size = steps + 1;
+
+  static constexpr uint8_t value( uint16_t step ) {
+#if LED_EASING_CURVE == LED_EASING_EASE_IN_OUT
+    return LedCurveMath::toByte( 3 * ( (double)step / steps ) * ( (double)step / steps ) - 2 * LedCurveMath::cube( (double)step / steps ) );
+#elif LED_EASING_CURVE == LED_EASING_EXPONENTIAL
+    return step == 0 ? 0 : LedCurveMath::toByte( LedCurveMath::exponent( 10 * ( (double)step / steps - 1 ) * 0.6931471805599453 ) );
+#else
+    return LedCurveMath::toByte( (double)step / steps );
+#endif
+  }
+};
+
+/*
+  The lightness (0-255) of each brightness level (0-maxLevel). Level 0 is off, level 1 has the lightness of
+  the given minimum PWM value and the other levels are evenly spaced up to full brightness. Because the spacing
+  is in lightness, each level looks as much brighter as the previous one.
+*/
+template<uint8_t maxLevel, uint8_t minPwm> struct LedBrightnessLevelCurve {
+  static constexpr uint16_t size = maxLevel + 1;
+
+  static constexpr uint8_t value( uint16_t level ) {
+    return level == 0 ? 0 : (uint8_t)( LedGammaCurve::inverse( minPwm ) + ( ( 255 - LedGammaCurve::inverse( minPwm ) ) * ( level - 1 ) + ( maxLevel - 1 ) / 2 ) / ( maxLevel - 1 ) );
+  }
+};
+
+/*
+  The Arduino map() function as a table, for converting values from one range (starting at zero) to another.
+  Values that would be mapped to a negative value are mapped to zero.
+*/
+template<uint8_t inMin, uint8_t inMax, uint8_t outMin, uint8_t outMax> struct LedMapCurve {
+  static constexpr uint16_t size = inMax + 1;
+
+  static constexpr uint8_t value( uint16_t x ) {
+    return LedCurveMath::map( x, inMin, inMax, outMin, outMax ) < 0 ? 0 : (uint8_t)LedCurveMath::map( x, inMin, inMax, outMin, outMax );
+  }
+};
+
+
+/*
+  Generates the table of a curve in flash. The indices are generated by a template recursion, so that the
+  values can be expanded into the initializer of the table.
+*/
+template<uint16_t... indices> struct LedCurveIndices {};
+
+template<uint16_t count, uint16_t... indices> struct LedCurveIndexSequence : LedCurveIndexSequence<count - 1, count - 1, indices...> {};
+
+template<uint16_t... indices> struct LedCurveIndexSequence<0, indices...> {
+  typedef LedCurveIndices<indices...> type;
+};
+
+template<typename Curve, typename Indices = typename LedCurveIndexSequence<Curve::size>::type> struct LedCurveTable;
+
+template<typename Curve, uint16_t... indices> struct LedCurveTable<Curve, LedCurveIndices<indices...> > {
+  static const uint8_t values[ sizeof...( indices ) ] PROGMEM;
+
+  // Returns the value for the given index from the table in flash.
+  static inline uint8_t read( uint16_t index ) {
+    return pgm_read_byte( &values[ index ] );
+  }
+};
+
+template<typename Curve, uint16_t... indices> const uint8_t LedCurveTable<Curve, LedCurveIndices<indices...> >::values[ sizeof...( indices ) ] PROGMEM = { Curve::value( indices )... };
+
+/*
+  The same for a curve with 16 bit values.
+*/
+template<typename Curve, typename Indices = typename LedCurveIndexSequence<Curve::size>::type> struct LedWordCurveTable;
+
+template<typename Curve, uint16_t... indices> struct LedWordCurveTable<Curve, LedCurveIndices<indices...> > {
+  static const uint16_t values[ sizeof...( indices ) ] PROGMEM;
+
+  // Returns the value for the given index from the table in flash.
+  static inline uint16_t read( uint16_t index ) {
+    return pgm_read_word( &values[ index ] );
+  }
+};
+
+template<typename Curve, uint16_t... indices> const uint16_t LedWordCurveTable<Curve, LedCurveIndices<indices...> >::values[ sizeof...( indices ) ] PROGMEM = { Curve::value( indices )... };
+
+
+/*
+  Returns the PWM value for the given lightness.
+*/
+inline uint8_t ledLightnessToPwm( uint8_t lightness ) {
+  return LedCurveTable<LedGammaCurve>::read( lightness );
+}
+
+/*
+  Returns the duty cycle (0-LED_DUTY_MAX) for the given lightness, a Q8.8 fixed point value. The fraction is
+  interpolated between the entries of the table.
+*/
+inline uint16_t ledLightnessToDuty( uint16_t lightLevel ) {
+  uint8_t  lightness = lightLevel >> 8;
+  uint16_t duty = LedWordCurveTable<LedFineGammaCurve>::read( lightness );
+  if ( lightness == 255 ) {
+    return duty;
+  }
+  uint16_t next = LedWordCurveTable<LedFineGammaCurve>::read( lightness + 1 );
+  return duty + (uint16_t)( ( (uint32_t)( next - duty ) * (uint8_t)lightLevel ) >> 8 );
+}
+
+#endif
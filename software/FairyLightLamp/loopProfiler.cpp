@@ -0,0 +1,124 @@
+#include "loopProfiler.h"
+
+/*
+  Creates an instance of the LoopProfiler class.
+  stallMicros: loop passes that take longer than this amount of us (at most 65535) are counted as stall.
+*/
+LoopProfiler::LoopProfiler( uint16_t stallMicros ) {
+  this->stallMicros = stallMicros;
+  this->reset();
+}
+
+/*
+  Adds a loop pass of the given duration in us.
+*/
+void LoopProfiler::addLoop( unsigned long micros ) {
+  this->loopCount++;
+  this->loopMicros += micros;
+  if ( micros < this->minLoop ) {
+    this->minLoop = micros;
+  }
+  if ( micros > this->maxLoop ) {
+    this->maxLoop = micros;
+  }
+  if ( micros > this->stallMicros && this->stallCount < 0xFFFF ) {
+    this->stallCount++;
+  }
+
+  uint8_t bucket = 0;
+  for ( unsigned long remaining = micros >> 1; remaining != 0 && bucket < PROFILE_HISTOGRAM_BUCKETS - 1; remaining >>= 1 ) {
+    bucket++;
+  }
+  if ( this->histogram[ bucket ] < 0xFFFF ) {
+    this->histogram[ bucket ]++;
+  }
+}
+
+/*
+  Adds the given duration in us to the given section (0 - PROFILE_MAX_SECTIONS - 1), which ran in a loop pass.
+*/
+void LoopProfiler::addSection( uint8_t section, unsigned long micros ) {
+  if ( section < PROFILE_MAX_SECTIONS ) {
+    this->sectionMicros[ section ] += micros;
+  }
+}
+
+/*
+  Adds the given duration in us to the given section, which ran outside the loop. The duration is added to the loop
+  time, but not as a loop pass.
+*/
+void LoopProfiler::addOutsideLoop( uint8_t section, unsigned long micros ) {
+  this->addSection( section, micros );
+  this->loopMicros += micros;
+}
+
+/*
+  Returns the amount of loop passes since the last reset.
+*/
+unsigned long LoopProfiler::getLoopCount() {
+  return this->loopCount;
+}
+
+/*
+  Returns the duration of the shortest loop pass in us, 0 when there was none.
+*/
+unsigned long LoopProfiler::getMinLoop() {
+  return this->loopCount == 0 ? 0 : this->minLoop;
+}
+
+/*
+  Returns the duration of the longest loop pass in us.
+*/
+unsigned long LoopProfiler::getMaxLoop() {
+  return this->maxLoop;
+}
+
+/*
+  Returns the mean duration of the loop passes in us, including the sections outside the loop.
+*/
+unsigned long LoopProfiler::getMeanLoop() {
+  return this->loopCount == 0 ? 0 : this->loopMicros / this->loopCount;
+}
+
+/*
+  Returns the amount of loop passes that took longer than the stall threshold.
+*/
+uint16_t LoopProfiler::getStallCount() {
+  return this->stallCount;
+}
+
+/*
+  Returns the amount of loop passes in the given bucket of the histogram (see loopProfiler.h), at most 65535.
+*/
+uint16_t LoopProfiler::getHistogram( uint8_t bucket ) {
+  return bucket < PROFILE_HISTOGRAM_BUCKETS ? this->histogram[ bucket ] : 0;
+}
+
+/*
+  Returns the share of the loop time spent in the given section, in per mille.
+*/
+uint16_t LoopProfiler::getShare( uint8_t section ) {
+  if ( section >= PROFILE_MAX_SECTIONS || this->loopMicros == 0 ) {
+    return 0;
+  }
+  // Divide the loop time instead of multiplying the section time, which could overflow
+  unsigned long perMille = this->loopMicros / 1000;
+  return perMille == 0 ? 0 : this->sectionMicros[ section ] / perMille;
+}
+
+/*
+  Resets the statistics, e.g. after they have been reported.
+*/
+void LoopProfiler::reset() {
+  this->loopCount = 0;
+  this->minLoop = 0xFFFFFFFF;
+  this->maxLoop = 0;
+  this->loopMicros = 0;
+  this->stallCount = 0;
+  for ( uint8_t bucket = 0; bucket < PROFILE_HISTOGRAM_BUCKETS; bucket++ ) {
+    this->histogram[ bucket ] = 0;
+  }
+  for ( uint8_t section = 0; section < PROFILE_MAX_SECTIONS; section++ ) {
+    this->sectionMicros[ section ] = 0;
+  }
+}
@@ -0,0 +1,67 @@
+#ifndef LOOP_PROFILER_H
+#define LOOP_PROFILER_H
+
+#include "hal.h"
+
+/*
+  Library for keeping statistics of the duration of the loop passes and of the parts of the sketch that run in it.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  The sketch measures each loop pass and each part (a section, like checkAnimation()) with the Timer1 clock (see
+  frameTimerMicros() in frameTimer.h) and adds the durations to the profiler. The profiler keeps:
+  - the amount of loop passes and their minimum, maximum and mean duration.
+  - a histogram of the loop durations with a bucket per power of two: bucket n counts the passes of 2^n up to
+    2^(n+1) - 1 us, the first bucket also counts 0 us and the last one everything from 2^15 us (32.8ms).
+  - the amount of stalls: passes that took longer than the stall threshold.
+  - the time spent in each section, as a share (per mille) of the time spent in the loop. A section that runs outside
+    the loop (like receive(), which MySensors calls between two loop passes) is added with addOutsideLoop(), its time
+    counts as loop time as well.
+
+  Adding a duration takes a few compares and additions, so the profiler can be always on. The statistics cover about
+  70 minutes of loop time, so they must be reset at least once per hour, the sketch does it after reporting them. The
+  buckets of the histogram are 16 bits and saturate at 65535: in idle sleep each Timer0 tick wakes the loop, about
+  1000 passes per second, which fills the bucket of the short passes in about a minute. The buckets that matter, those
+  of the slow passes, take far longer to fill, and the exact amount of passes is in the loop count. A bucket of 65535
+  reads as "at least 65535".
+
+  Revision history:
+    16-10-2026 Initial version.
+    16-10-2026 The buckets of the histogram saturate at 65535 instead of wrapping around.
+*/
+
+const uint8_t PROFILE_MAX_SECTIONS = 4;
+const uint8_t PROFILE_HISTOGRAM_BUCKETS = 16;
+
+/*
+  Definition of the class, the method documentation can be found in the loopProfiler.cpp file.
+*/
+class LoopProfiler {
+  public:
+    LoopProfiler( uint16_t stallMicros );
+
+    void addLoop( unsigned long micros );
+    void addSection( uint8_t section, unsigned long micros );
+    void addOutsideLoop( uint8_t section, unsigned long micros );
+
+    unsigned long getLoopCount();
+    unsigned long getMinLoop();
+    unsigned long getMaxLoop();
+    unsigned long getMeanLoop();
+    uint16_t      getStallCount();
+    uint16_t      getHistogram( uint8_t bucket );
+    uint16_t      getShare( uint8_t section );
+    void          reset();
+  private:
+    uint16_t      stallMicros;     // Loop passes that take longer are counted as stall
+    unsigned long loopCount;
+    unsigned long minLoop;
+    unsigned long maxLoop;
+    unsigned long loopMicros;      // The total time of the loop passes and the sections outside the loop
+    uint16_t      stallCount;
+    uint16_t      histogram[ PROFILE_HISTOGRAM_BUCKETS ];
+    unsigned long sectionMicros[ PROFILE_MAX_SECTIONS ];
+};
+
+#endif
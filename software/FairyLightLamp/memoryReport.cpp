@@ -0,0 +1,72 @@
+#include "memoryReport.h"
+
+#ifdef ARDUINO
+// Symbols of the linker script and avr-libc: the start of .data, the end of .bss (where the heap starts), the end of
+// the RAM and the end of the heap (NULL as long as malloc() was never called).
+extern uint8_t __data_start;
+extern uint8_t __heap_start;
+extern uint8_t __stack;
+extern char    *__brkval;
+
+/*
+  Paints the free RAM, from the end of the static RAM up to the end of the RAM. It's placed in the .init3 section, so
+  it runs after the stack pointer and the zero register have been set up, before .data and .bss are initialized and
+  before the constructors of the global objects. It's naked and never called, the startup code falls through it.
+*/
+void memoryPaintStack() __attribute__ (( naked, used, section( ".init3" ) ));
+void memoryPaintStack() {
+  for ( uint8_t *address = &__heap_start; address <= &__stack; address++ ) {
+    *address = MEMORY_CANARY;
+  }
+}
+#endif
+
+/*
+  Returns the amount of static RAM (.data and .bss) in bytes, of the sketch, the Arduino core and the libraries.
+*/
+uint16_t memoryStaticRam() {
+#ifdef ARDUINO
+  return &__heap_start - &__data_start;
+#else
+  return 0;
+#endif
+}
+
+/*
+  Returns the amount of heap in bytes, 0 as long as nothing has been allocated with new or malloc().
+*/
+uint16_t memoryHeapUsed() {
+#ifdef ARDUINO
+  return __brkval == NULL ? 0 : (uint8_t *)__brkval - &__heap_start;
+#else
+  return 0;
+#endif
+}
+
+/*
+  Returns the amount of RAM in bytes between the end of the heap and the stack pointer at this moment.
+*/
+uint16_t memoryFreeRam() {
+#ifdef ARDUINO
+  uint8_t top; // The stack pointer, roughly
+  return &top - ( __brkval == NULL ? &__heap_start : (uint8_t *)__brkval );
+#else
+  return 0;
+#endif
+}
+
+/*
+  Returns the amount of RAM in bytes that has never been used by the stack (or the heap) since the boot: the paint
+  that is left above the end of the static RAM.
+*/
+uint16_t memoryStackUnused() {
+#ifdef ARDUINO
+  uint8_t *address = &__heap_start;
+  while ( address <= &__stack && *address == MEMORY_CANARY ) {
+    address++;
+  }
+  return address - &__heap_start;
+#else
+  return 0;
+#endif
+}
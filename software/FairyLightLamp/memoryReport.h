@@ -0,0 +1,34 @@
+#ifndef MEMORY_REPORT_H
+#define MEMORY_REPORT_H
+
+#include "hal.h"
+
+/*
+  Library for measuring the RAM use of the node: the static RAM and the high-water mark of the stack.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  The ATmega328P has 2KB of RAM, shared by the static variables of the sketch, the Arduino core and MySensors (.data
+  and .bss), the heap and the stack. The objects of the sketch are all placed statically, so the static RAM is known
+  after linking and the heap stays empty. What's left is for the stack, which grows down from the end of the RAM.
+
+  The free RAM is painted with MEMORY_CANARY at boot, before the constructors of the global objects run (the .init3
+  section). The stack overwrites the paint as deep as it has ever been, so the bytes above the end of the static RAM
+  that still hold the paint have never been used: the high-water mark of the stack. A stack byte that happens to be
+  equal to the paint makes it look a byte less deep, which doesn't matter for the margin.
+
+  On the host there's no paint and no RAM layout, all functions return 0.
+
+  Revision history:
+    16-10-2026 Initial version.
+*/
+
+const uint8_t MEMORY_CANARY = 0xC5; // The paint of the free RAM
+
+uint16_t memoryStaticRam();
+uint16_t memoryHeapUsed();
+uint16_t memoryFreeRam();
+uint16_t memoryStackUnused();
+
+#endif
@@ -0,0 +1,178 @@
+#include "messageQueue.h"
+
+// The states of a message in the queue
+const uint8_t MESSAGE_FREE = 0;
+const uint8_t MESSAGE_WAITING = 1;
+const uint8_t MESSAGE_AWAITING_ACK = 2;
+
+/*
+  Creates an instance of the MessageQueue class.
+  sendHandler : the handler that sends a message through MySensors.
+  pacingMillis: the minimum time between two messages, to give the gateway (and the radio) some room.
+  messages    : the slots of the queue, one for each child/type combination that can be waiting at the same time.
+  size        : the amount of slots, at most 128.
+*/
+MessageQueue::MessageQueue( messageSendHandler sendHandler, uint16_t pacingMillis, QueuedMessage *messages, uint8_t size ) {
+  this->sendHandler = sendHandler;
+  this->pacingMillis = pacingMillis;
+  this->lastSentAt = 0;
+  this->nextOrder = 0;
+  this->messages = messages;
+  this->size = size;
+  for ( uint8_t index = 0; index < size; index++ ) {
+    this->messages[ index ].state = MESSAGE_FREE;
+  }
+  this->resetCounters();
+}
+
+/*
+  Posts the given value for the given child and type. When a message for the same child and type is still waiting (or
+  waiting for its ack) its value is replaced and it's sent again as soon as possible.
+  ack: true when the controller must ack the message, it's resent when the ack isn't received in time.
+  Returns false when the queue is full, the message is dropped in that case.
+*/
+bool MessageQueue::post( uint8_t sensor, uint8_t type, int16_t value, bool ack ) {
+  QueuedMessage *freeMessage = NULL;
+
+  for ( uint8_t index = 0; index < this->size; index++ ) {
+    QueuedMessage &message = this->messages[ index ];
+    if ( message.state == MESSAGE_FREE ) {
+      if ( freeMessage == NULL ) {
+        freeMessage = &message;
+      }
+    }
+    else if ( message.sensor == sensor && message.type == type ) {
+      message.value = value;
+      message.ack = message.ack || ack;
+      message.attempts = 0;
+      message.state = MESSAGE_WAITING;
+      this->coalescedCount++;
+      return true;
+    }
+  }
+
+  if ( freeMessage == NULL ) {
+    this->droppedCount++;
+    return false;
+  }
+  freeMessage->sensor = sensor;
+  freeMessage->type = type;
+  freeMessage->value = value;
+  freeMessage->ack = ack;
+  freeMessage->attempts = 0;
+  freeMessage->order = this->nextOrder++;
+  freeMessage->state = MESSAGE_WAITING;
+  return true;
+}
+
+/*
+  Handles the ack of the controller for the given child, type and value. An ack for an older value (one that has been
+  replaced since it was sent) is ignored, the new value still has to be delivered.
+*/
+void MessageQueue::acknowledged( uint8_t sensor, uint8_t type, int16_t value ) {
+  for ( uint8_t index = 0; index < this->size; index++ ) {
+    QueuedMessage &message = this->messages[ index ];
+    if ( message.state == MESSAGE_AWAITING_ACK && message.sensor == sensor && message.type == type && message.value == value ) {
+      message.state = MESSAGE_FREE;
+    }
+  }
+}
+
+/*
+  Sends the oldest message that is due, if the pacing interval since the previous message has passed. Sends at most
+  one message per call. A message of which the ack of the last attempt didn't arrive in time is dropped. Must be
+  called from the main loop for each cycle, at least every 30 seconds: a message that hasn't been sent yet is due at
+  once, the time of a resend is compared in 16 bits.
+*/
+void MessageQueue::update( unsigned long currentMillis ) {
+  if ( currentMillis - this->lastSentAt < this->pacingMillis ) {
+    return;
+  }
+
+  QueuedMessage *oldest = NULL;
+  for ( uint8_t index = 0; index < this->size; index++ ) {
+    QueuedMessage &message = this->messages[ index ];
+    bool           due = message.attempts == 0 || (int16_t)( (uint16_t)currentMillis - message.dueAt ) >= 0;
+    if ( message.state != MESSAGE_FREE && due && message.attempts > MESSAGE_MAX_RETRIES ) {
+      message.state = MESSAGE_FREE; // The ack of the last attempt didn't arrive in time either
+      this->droppedCount++;
+    }
+    else if ( message.state != MESSAGE_FREE && due && ( oldest == NULL || (int8_t)( message.order - oldest->order ) < 0 ) ) {
+      oldest = &message;
+    }
+  }
+  if ( oldest == NULL ) {
+    return;
+  }
+
+  bool delivered = this->sendHandler( oldest->sensor, oldest->type, oldest->value, oldest->ack );
+  this->lastSentAt = currentMillis;
+  this->sentCount++;
+  if ( oldest->attempts > 0 ) {
+    this->retriedCount++;
+  }
+
+  if ( delivered && !oldest->ack ) {
+    oldest->state = MESSAGE_FREE;
+  }
+  else if ( !delivered && oldest->attempts == MESSAGE_MAX_RETRIES ) {
+    oldest->state = MESSAGE_FREE;
+    this->droppedCount++;
+  }
+  else { // After the last attempt the ack is awaited for one more timeout, then it's dropped (attempts is above the maximum)
+    oldest->state = delivered ? MESSAGE_AWAITING_ACK : MESSAGE_WAITING;
+    oldest->dueAt = (uint16_t)currentMillis + ( MESSAGE_ACK_TIMEOUT << oldest->attempts );
+    oldest->attempts++;
+  }
+}
+
+/*
+  Determines wether all messages have been sent and acked (true) or if messages are waiting (false).
+*/
+bool MessageQueue::isIdle() {
+  for ( uint8_t index = 0; index < this->size; index++ ) {
+    if ( this->messages[ index ].state != MESSAGE_FREE ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+  Returns the amount of messages handed to the radio since the last reset, including the resends.
+*/
+uint16_t MessageQueue::getSentCount() {
+  return this->sentCount;
+}
+
+/*
+  Returns the amount of values that replaced a waiting value since the last reset.
+*/
+uint16_t MessageQueue::getCoalescedCount() {
+  return this->coalescedCount;
+}
+
+/*
+  Returns the amount of resends since the last reset.
+*/
+uint16_t MessageQueue::getRetriedCount() {
+  return this->retriedCount;
+}
+
+/*
+  Returns the amount of messages that were dropped since the last reset, because they weren't acked after the last
+  retry or because the queue was full.
+*/
+uint16_t MessageQueue::getDroppedCount() {
+  return this->droppedCount;
+}
+
+/*
+  Resets the counters, e.g. after they have been reported.
+*/
+void MessageQueue::resetCounters() {
+  this->sentCount = 0;
+  this->coalescedCount = 0;
+  this->retriedCount = 0;
+  this->droppedCount = 0;
+}
@@ -0,0 +1,99 @@
+#ifndef MESSAGE_QUEUE_H
+#define MESSAGE_QUEUE_H
+
+#include "hal.h"
+
+/*
+  Library for sending messages to the gateway from the main loop, without blocking it.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  Sending a message directly blocks the loop until the radio is done, and the sketch used delay() between messages
+  to give the gateway some room. A quick spin of the encoder sent a message per detent, which stalled the animations
+  and the switch. The sketch now posts its messages to a MessageQueue, which sends them from update() with at least
+  the pacing interval between two messages.
+
+  A message is identified by its child and type. When a message for the same child and type is still waiting, the
+  new value replaces the old one (coalescing): the controller is only interested in the latest brightness, not in
+  every detent on the way. The message keeps its place in the queue, so messages are sent in the order in which
+  their child and type were first posted.
+
+  A message can request an ack (the echo of the controller, see MySensors). It's resent when the ack hasn't been
+  received in time, with a timeout that doubles after every attempt (MESSAGE_ACK_TIMEOUT, 2 x, 4 x ...). A message
+  that couldn't be delivered to the parent node is retried in the same way. After MESSAGE_MAX_RETRIES it's dropped:
+  at once when the last resend couldn't be delivered, and when its ack hasn't been received within the timeout of the
+  last resend otherwise.
+
+  The queue doesn't know MySensors: the send handler builds and sends the message. So it also runs on the host.
+  The values are 16 bit integers, which covers all messages of the sketch.
+
+  The messages are kept in an array of the sketch, with a slot for each child and type it posts, so the queue takes
+  no more RAM than it needs. A slot takes 8 bytes: the time at which a message is resent is kept in 16 bits, which is
+  enough because a resend is at most a few seconds away (a new message is due at once, whatever its time).
+
+  Revision history:
+    16-10-2026 Initial version.
+    16-10-2026 20 messages, the sketch posts 20 different child/type combinations with the loop profiler.
+    17-10-2026 The messages are kept in an array of the sketch, sized for the child/type combinations it posts. A
+               message takes 8 instead of 12 bytes.
+    17-10-2026 The ack of the last resend is awaited, the message is only dropped when it doesn't arrive in time.
+*/
+
+const uint8_t  MESSAGE_MAX_RETRIES = 3;    // The amount of times a message is resent before it's dropped
+const uint16_t MESSAGE_ACK_TIMEOUT = 250;  // ms before the first resend, doubles after each attempt
+static_assert( MESSAGE_MAX_RETRIES < 7, "The attempts of a message, up to MESSAGE_MAX_RETRIES + 1, are kept in 3 bits" );
+static_assert( ( (unsigned long)MESSAGE_ACK_TIMEOUT << MESSAGE_MAX_RETRIES ) < 0x8000, "The time of a resend is kept in 16 bits" );
+
+/*
+  Blue print for the send handler: sends the given value to the given child and type, requesting an ack when ack is
+  true. Returns false when the message couldn't be delivered to the parent node.
+*/
+typedef bool (*messageSendHandler)( uint8_t sensor, uint8_t type, int16_t value, bool ack );
+
+/*
+  A slot of the queue, for a single child and type. Only the MessageQueue uses its fields.
+*/
+struct QueuedMessage {
+  uint8_t  sensor;
+  uint8_t  type;
+  uint8_t  order;        // the position in the queue, compared with a wrap around
+  uint8_t  state    : 2; // free, waiting to be sent or waiting for the ack
+  uint8_t  ack      : 1; // 1 when an ack is requested
+  uint8_t  attempts : 3; // the amount of times it has been sent, 1 more after the ack of the last attempt is awaited
+  int16_t  value;
+  uint16_t dueAt;        // the lower 16 bits of millis() at which it's resent
+};
+
+/*
+  Definition of the class, the method documentation can be found in the messageQueue.cpp file.
+*/
+class MessageQueue {
+  public:
+    MessageQueue( messageSendHandler sendHandler, uint16_t pacingMillis, QueuedMessage *messages, uint8_t size );
+
+    bool post( uint8_t sensor, uint8_t type, int16_t value, bool ack );
+    void acknowledged( uint8_t sensor, uint8_t type, int16_t value );
+    void update( unsigned long currentMillis );
+    bool isIdle();
+
+    uint16_t getSentCount();
+    uint16_t getCoalescedCount();
+    uint16_t getRetriedCount();
+    uint16_t getDroppedCount();
+    void     resetCounters();
+  private:
+    messageSendHandler sendHandler;
+    uint16_t           pacingMillis;   // The minimum time between two messages
+    unsigned long      lastSentAt;     // millis() of the last message that was sent
+    uint8_t            nextOrder;      // The order of the next new message
+    QueuedMessage      *messages;      // A slot for each child/type combination that can be waiting
+    uint8_t            size;           // The amount of slots, at most 128
+
+    uint16_t           sentCount;      // Messages handed to the radio, including the resends
+    uint16_t           coalescedCount; // Values that replaced a waiting value
+    uint16_t           retriedCount;   // Resends
+    uint16_t           droppedCount;   // Messages dropped after the last retry or because the queue was full
+};
+
+#endif
@@ -1,69 +1,85 @@
 #include "multiClick.h"
 
-/**
- Constructs an instance of the SoftDebouncedMultiClick class.
- debouncer: a reference to the debouncer that is used to read the switch states
- */
-SoftDebouncedMultiClick::SoftDebouncedMultiClick( Bounce* debouncer ) {
-  this->debouncer = debouncer;
-}
-
-/**
- Constructs an instance of the SoftDebouncedMultiClick class.
- switchPin: the pun to witch the switch that is being monitored is connected.
- */
-SoftDebouncedMultiClick::SoftDebouncedMultiClick( uint8_t switchPin ) {
-  this->debouncer = new Bounce();
-  this->debouncer->attach( switchPin, INPUT_PULLUP ); // Attach the debouncer to a pin with INPUT_PULLUP mode
-  this->debouncer->interval( 25 );                    // Use a debounce interval of 25 milliseconds
-}
-
 /*
- Assignes the given handler as the keypress handler. 
+ Assignes the given handler as the keypress handler.
  aHandler: the reference to the handler or NULL if the press doesn't need to be handled anymore.
 
  Note: Single normal clicks can not be detected, because we can not know wether this is a long or a normal press
  until the switch is either released or when it's pressed long enough to detect a long press.
  */
-void SoftDebouncedMultiClick::setKeyPressHandler( multiClickEventHandler aHandler ) {
+void PointerClickDispatcher::setKeyPressHandler( multiClickEventHandler aHandler ) {
   this->keyPressHandler = aHandler;
 }
 
 /*
- Assignes the given handler as the key click handler. 
+ Assignes the given handler as the key click handler.
  aHandler: the reference to the handler or NULL if the press doesn't need to be handled anymore.
  */
-void SoftDebouncedMultiClick::setKeyClickHandler( multiClickEventHandler aHandler ) {
+void PointerClickDispatcher::setKeyClickHandler( multiClickEventHandler aHandler ) {
   this->keyReleaseHandler = aHandler;
 }
 
+/*
+ Fires the given event to the key pressed or key click handler, with a reference to the given switch. Does nothing for
+ MC_NO_EVENT.
+ */
+void PointerClickDispatcher::fire( MultiClickEvent event, SoftDebouncedMultiClick &source ) {
+  if ( event.kind == MC_KEY_PRESSED_EVENT && keyPressHandler != NULL ) {
+    keyPressHandler( event.type, event.amount, source );
+  }
+  else if ( event.kind == MC_KEY_RELEASED_EVENT && keyReleaseHandler != NULL ) {
+    keyReleaseHandler( event.type, event.amount, source );
+  }
+}
+
+
+uint16_t MultiClickStateMachine::shortPressDuration = SHORT_KEY_PRESS_DURATION;
+uint16_t MultiClickStateMachine::longPressDuration = LONG_KEY_PRESS_DURATION;
+
+/*
+ Sets the short and long press durations (ms) of all switches. A short press is at most shortPress long, and a
+ sequence of short presses ends when no press follows within twice that time. A press becomes a long press after
+ longPress, keep it well above twice the short press duration.
+ */
+void MultiClickStateMachine::setDurations( uint16_t shortPress, uint16_t longPress ) {
+  shortPressDuration = shortPress;
+  longPressDuration = longPress;
+}
+
 /**
- The state machine implementation. This sould be called in each main loop.
- currentMillis: the currentMills 
+ The state machine implementation. Returns the event that has to be fired, if any.
+ switchUpdated : true when the switch has changed to the given state at the given time
+ newSwitchState: the new state of the switch, only used when switchUpdated is true
+ eventMillis   : the time of the change, or the current time when the switch didn't change
  */
-void SoftDebouncedMultiClick::checkSwitch( unsigned long currentMillis ) {
-  switchUpdated = debouncer->update();
-  switchState = debouncer->read();
+MultiClickEvent MultiClickStateMachine::handleSwitchState( bool switchUpdated, uint8_t newSwitchState, unsigned long eventMillis ) {
+  MultiClickEvent event = { MC_NO_EVENT, KP_SCANNING, 0 };
+
+  if ( switchUpdated ) {
+    switchState = newSwitchState;
+  }
 
   switch ( scanState ) {
     case KP_SCANNING : {
         if ( switchUpdated ) {
           if ( switchState == KEY_PRESSED ) {
-            keyPressedTS = currentMillis;
+            keyPressedTS = eventMillis;
           }
           else {
-            if ( currentMillis - keyPressedTS <= SHORT_KEY_PRESS_DURATION ) {
-              setKeyScanningState( KP_SHORT_PRESS_SEQUENCE );
+            if ( eventMillis - keyPressedTS <= shortPressDuration ) {
+              event = setKeyScanningState( KP_SHORT_PRESS_SEQUENCE );
             }
             else {
-              fireKeyReleasedEvent( KP_SHORT_PRESS_SEQUENCE, 1 );
+              event.kind = MC_KEY_RELEASED_EVENT;
+              event.type = KP_SHORT_PRESS_SEQUENCE;
+              event.amount = 1;
             }
           }
         }
         else {
           if ( switchState == KEY_PRESSED ) {
-            if ( currentMillis - keyPressedTS >= LONG_KEY_PRESS_DURATION ) {
-              setKeyScanningState( KP_LONG_PRESS );
+            if ( eventMillis - keyPressedTS >= longPressDuration ) {
+              event = setKeyScanningState( KP_LONG_PRESS );
             }
           }
         }
@@ -72,7 +88,7 @@ void SoftDebouncedMultiClick::checkSwitch( unsigned long currentMillis ) {
     case KP_LONG_PRESS: {
         if ( switchUpdated ) {
           if ( switchState == KEY_RELEASED ) { // Long press has ended
-            setKeyScanningState( KP_SCANNING );
+            event = setKeyScanningState( KP_SCANNING );
           }
         }
         break;
@@ -80,41 +96,52 @@ void SoftDebouncedMultiClick::checkSwitch( unsigned long currentMillis ) {
     case KP_SHORT_PRESS_SEQUENCE: {
         if ( switchUpdated ) {
           if ( switchState == KEY_PRESSED ) {
-            keyPressedTS = currentMillis;
+            keyPressedTS = eventMillis;
             pressCount++;
-            fireKeyPressedEvent( KP_SHORT_PRESS_SEQUENCE, pressCount );
+            event.kind = MC_KEY_PRESSED_EVENT;
+            event.type = KP_SHORT_PRESS_SEQUENCE;
+            event.amount = pressCount;
           }
         }
         else {
           if ( switchState == KEY_RELEASED ) {
-            if ( currentMillis - keyPressedTS > ( 2 * SHORT_KEY_PRESS_DURATION ) ) {
-              setKeyScanningState( KP_SCANNING );
+            if ( eventMillis - keyPressedTS > ( 2UL * shortPressDuration ) ) {
+              event = setKeyScanningState( KP_SCANNING );
             }
           }
         }
         break;
       }
   }
+  return event;
 }
 
 /*
- Assigns the given state as the new state of the state maching. And fires events when needed.
+ Assigns the given state as the new state of the state maching. And returns the event that has to be fired, if any.
  newState: the newState of the state machine.
  */
-void SoftDebouncedMultiClick::setKeyScanningState( KEY_SCAN_STATES newState ) {
+MultiClickEvent MultiClickStateMachine::setKeyScanningState( KEY_SCAN_STATES newState ) {
+  MultiClickEvent event = { MC_NO_EVENT, KP_SCANNING, 0 };
+
   if ( newState != scanState ) {
     switch ( newState ) {
       case KP_SCANNING: {
           if ( scanState == KP_LONG_PRESS ) {
-            fireKeyReleasedEvent( KP_LONG_PRESS, 1 );
+            event.kind = MC_KEY_RELEASED_EVENT;
+            event.type = KP_LONG_PRESS;
+            event.amount = 1;
           }
           else if ( scanState == KP_SHORT_PRESS_SEQUENCE ) {
-           fireKeyReleasedEvent( KP_SHORT_PRESS_SEQUENCE, pressCount );
+            event.kind = MC_KEY_RELEASED_EVENT;
+            event.type = KP_SHORT_PRESS_SEQUENCE;
+            event.amount = pressCount;
           }
           break;
         }
       case KP_LONG_PRESS: {
-          fireKeyPressedEvent( KP_LONG_PRESS, 1 );
+          event.kind = MC_KEY_PRESSED_EVENT;
+          event.type = KP_LONG_PRESS;
+          event.amount = 1;
           break;
         }
       case KP_SHORT_PRESS_SEQUENCE: {
@@ -124,31 +151,13 @@ void SoftDebouncedMultiClick::setKeyScanningState( KEY_SCAN_STATES newState ) {
     }
     scanState = newState;
   }
+  return event;
 }
 
 /*
- Fires a key pressed (Meaning the switch is hold down) event.
- */
-void SoftDebouncedMultiClick::fireKeyPressedEvent( KEY_SCAN_STATES eventType, uint8_t amount ) {
-  if ( keyPressHandler != NULL ) {
-    keyPressHandler( eventType, amount, this );
-  }
-}
-
-/*
- Fires a key click (Meaning the switch is released) event.
- */
-void SoftDebouncedMultiClick::fireKeyReleasedEvent( KEY_SCAN_STATES eventType, uint8_t amount ) {
-  if ( keyReleaseHandler != NULL ) {
-    keyReleaseHandler( eventType, amount, this );
-  }
-}
-
-/*
- Determines wether the internal state machine is idle (true) or busy with scanning (false).
- Idles means that no key is down and no short press sequence is in progress. If the internal state is idle
- the arduino can be put in sleep mode, without missing any vital information regarding the clicks.
+ Determines wether the state machine is idle (true) or busy with scanning (false).
+ Idles means that no key is down and no short press sequence is in progress.
  */
-bool SoftDebouncedMultiClick::isIdle( unsigned long currentMillis ) {
-  return scanState == KP_SCANNING && switchState == KEY_RELEASED && ( currentMillis - keyPressedTS > SHORT_KEY_PRESS_DURATION );
+bool MultiClickStateMachine::isIdle( unsigned long currentMillis ) {
+  return scanState == KP_SCANNING && switchState == KEY_RELEASED && ( currentMillis - keyPressedTS > shortPressDuration );
 }
@@ -1,11 +1,11 @@
 #ifndef MULTI_CLICK_H
 #define MULTI_CLICK_H
 
-#include <Arduino.h>
-#include <Bounce2.h>
+#include "hal.h"
+#include "pinChangeDebouncer.h"
 
 /*
-  Library for adding mutli click and long click detection to the Bounce2 library.
+  Library for adding mutli click and long click detection to a switch.
 
   Author: By Theo
   Created: January 7th 2021
@@ -28,18 +28,29 @@
 
     We use a byte as a click counter. This means that after 255 clicks the value flips back to zero. But that's acceptable.
 
-    Currently this library uses Bounce2 to do a soft debounce. While this is an awesome library, there's one disadvantage. It
-    blocks the sketch while updating the state. This means when you have many switches, who's state have to be checked each loop,
-    the sort press won't work or doesn't work well.
-    On the Arduino site a hardware debouncer is posted with using a pull up resisitor. I find it hard to believe this will work much
-    better. But it looks promising, because it's a non blocking soft debouncer. The code is also very small so we can add it into this library
-    which gives us 1 less dependency. the reason why I'm hesitating is that you can miss changes when there's a blocking code (let's sat 10ms) in
-    the loop during which a bounce happens. But the question is how bad is this opposed to the blocking behavior of Bounce2.
+    This library used Bounce2 to do a soft debounce. While that is an awesome library, it only sees the switch when it's updated
+    from the loop. So when the loop was blocked, e.g. by radio traffic, short presses were missed or got the wrong duration.
+    The switch is now debounced from the pin change interrupt (see pinChangeDebouncer.h), which stores each edge with its
+    time stamp. The state machine handles the changes with the time at which they happened, so the click timing stays
+    accurate regardless of the loop.
+
+    The state machine itself is a separate class (MultiClickStateMachine), so that it can also be used for a bank of switches
+    that is debounced in another way (see multiClickBank.h).
+
+  Revision history:
+    07-01-2021 Initial version.
+    16-10-2026 Debounce from the pin change interrupt instead of Bounce2.
+    16-10-2026 Moved the state machine into the MultiClickStateMachine class.
+    16-10-2026 The handlers get a reference to the switch instead of a copy. Added StaticMultiClick, of which the
+               handlers are resolved by the compiler.
+    16-10-2026 The short and long press durations can be changed at run time (MultiClickStateMachine::setDurations()).
+    17-10-2026 SoftDebouncedMultiClick and StaticMultiClick are a single template (DebouncedMultiClick), which takes the
+               way the handlers are called as a parameter.
 */
 
 
 /*
-  Constants used by the multiclick library
+  Constants used by the multiclick library, the durations are the defaults of all switches
 */
 const unsigned long LONG_KEY_PRESS_DURATION = 1500; // It takes 1.5 seconds before we see a key press as a long key press
 const unsigned long SHORT_KEY_PRESS_DURATION = 170; // A press (the duration between 2 key clicks) which makes ik count as a short
@@ -53,48 +64,173 @@ const unsigned long SHORT_KEY_PRESS_DURATION = 170; // A press (the duration bet
 const uint8_t KEY_PRESSED = LOW;
 const uint8_t KEY_RELEASED = HIGH;
 
-// Pre declare classes
-class SoftDebouncedMultiClick;
-
-
 /*
   The different states of the multiclick's internal state machine.
 */
 typedef enum { KP_SCANNING, KP_SHORT_PRESS_SEQUENCE, KP_LONG_PRESS  } KEY_SCAN_STATES;
 
 /*
-  Blue print for mutli click event handlers. First argument is the state, the 2nd is the amount (long press will always be 1)
+  The kinds of events the state machine can fire: none, a key pressed (the switch is hold down) or a key click (the
+  switch is released) event.
+*/
+typedef enum { MC_NO_EVENT, MC_KEY_PRESSED_EVENT, MC_KEY_RELEASED_EVENT } MULTI_CLICK_EVENT_KINDS;
+
+/*
+  An event of the state machine, with the state and the amount that are passed to the handler.
+*/
+struct MultiClickEvent {
+  MULTI_CLICK_EVENT_KINDS kind;
+  KEY_SCAN_STATES         type;
+  uint8_t                 amount;
+};
+
+/*
+  The multi click and long click state machine of a single switch. It's fed with the debounced switch state and returns
+  the events, the owner fires them to its handlers.
 */
-typedef void (*multiClickEventHandler)( KEY_SCAN_STATES, uint8_t, SoftDebouncedMultiClick );
+class MultiClickStateMachine {
+  public:
+    MultiClickEvent handleSwitchState( bool switchUpdated, uint8_t newSwitchState, unsigned long eventMillis );
+    bool isIdle( unsigned long currentMillis );
+
+    static void setDurations( uint16_t shortPress, uint16_t longPress );
+  private:
+    MultiClickEvent setKeyScanningState( KEY_SCAN_STATES newState );
+
+    static uint16_t shortPressDuration; // The short and long press durations of all switches, so a switch doesn't
+    static uint16_t longPressDuration;  // take RAM for them
+
+    uint8_t         switchState = KEY_RELEASED; // stores the current state of the switch
+    uint8_t         scanState = KP_SCANNING;    // Stores the current state of the state machine (a KEY_SCAN_STATES)
+    uint8_t         pressCount = 1;             // the amount of presses in the current sequence if short/normal clickes
+    unsigned long   keyPressedTS = 0;           // Stores the last ts when the switch was pressed
+};
+
+/*
+  The multi click switch: a switch debounced from the pin change interrupt and its state machine. The events go to the
+  Dispatcher, a policy type of which the switch is derived, with the method
+
+    template<typename Switch> void fire( MultiClickEvent event, Switch &source );
+
+  The Dispatcher decides how the handlers are called: through function pointers (PointerClickDispatcher, which is
+  SoftDebouncedMultiClick) or directly (StaticClickDispatcher, which is StaticMultiClick). The class is a template, that's
+  why it's implemented in this header file.
+*/
+template<typename Dispatcher> class DebouncedMultiClick : public Dispatcher {
+  public:
+    DebouncedMultiClick( uint8_t switchPin );
+
+    void checkSwitch( unsigned long currentMillis );
+    bool isIdle( unsigned long currentMillis );
+    void clockSkipped( unsigned long skippedMillis );
+  private:
+    PinChangeDebouncer     debouncer;    // Debounces the switch from the pin change interrupt
+    MultiClickStateMachine stateMachine; // Detects the clicks and long presses
+};
+
+class PointerClickDispatcher;
+
+/*
+  The multi click switch of which the handlers are set at run time, see PointerClickDispatcher.
+*/
+typedef DebouncedMultiClick<PointerClickDispatcher> SoftDebouncedMultiClick;
+
+/*
+  Blue print for mutli click event handlers. First argument is the state, the 2nd is the amount (long press will always be 1),
+  the 3rd the switch that fired the event. The switch is passed by reference: a copy would include the edge buffer of
+  the debouncer, almost 100 bytes on the stack for each event.
+*/
+typedef void (*multiClickEventHandler)( KEY_SCAN_STATES, uint8_t, SoftDebouncedMultiClick & );
 
 /**
-  Definition of the class, private aatributes are documented here
+  The Dispatcher of a switch of which the handlers are function pointers, which can be changed at run time.
   The method documentation can be found in the multiClick.cpp file.
 */
-class SoftDebouncedMultiClick {
+class PointerClickDispatcher {
   public:
-    SoftDebouncedMultiClick( Bounce* debouncer );
-    SoftDebouncedMultiClick( uint8_t switchPin );
-
     void setKeyPressHandler( multiClickEventHandler aHandler );
     void setKeyClickHandler( multiClickEventHandler aHandler );
-
-    void checkSwitch( unsigned long currentMillis );
-    bool isIdle(  unsigned long currentMillis );
   protected:
-    void setKeyScanningState( KEY_SCAN_STATES newState );
-    void fireKeyPressedEvent( KEY_SCAN_STATES eventType, uint8_t amount );
-    void fireKeyReleasedEvent( KEY_SCAN_STATES eventType, uint8_t amount );
+    void fire( MultiClickEvent event, SoftDebouncedMultiClick &source );
   private:
-    Bounce*         debouncer;               // Reference to the Bounce object, used to detect changes in the switch state (software blocking debounce)
-    bool            switchUpdated = false;   // Indicates wether the debouncer has been updated since the last chech
-    uint8_t         switchState = LOW;       // stores the current state of the switch
-    KEY_SCAN_STATES scanState = KP_SCANNING; // Stores the current state of the state machine
-    unsigned long   keyPressedTS;            // Stores the last ts when the switch was pressed
-    uint8_t         pressCount = 1;          // the amount of presses in the current sequence if short/normal clickes
-
     multiClickEventHandler keyPressHandler = NULL;   // Stores a reference to the keyPressHandler method
     multiClickEventHandler keyReleaseHandler = NULL; // Stores a reference to the keyReleaseHandler method
 };
 
+/*
+  The Dispatcher of a switch of which the handlers are known at compile time: the Handler type has the static methods
+
+    static void onKeyPress( KEY_SCAN_STATES type, uint8_t amount );
+    static void onKeyClick( KEY_SCAN_STATES type, uint8_t amount );
+
+  which are called directly instead of through a function pointer. So the compiler can inline them into checkSwitch(),
+  and the switch doesn't store the handler pointers (the dispatcher is an empty base class). Use it when the handlers
+  don't change, like those of the sketch.
+*/
+template<typename Handler> class StaticClickDispatcher {
+  protected:
+    template<typename Switch> void fire( MultiClickEvent event, Switch &source );
+};
+
+/*
+  The multi click switch of which the handlers are the static methods of the Handler type, see StaticClickDispatcher.
+*/
+template<typename Handler> using StaticMultiClick = DebouncedMultiClick< StaticClickDispatcher<Handler> >;
+
+
+//                              DebouncedMultiClick
+
+/**
+ Constructs an instance of the DebouncedMultiClick class.
+ switchPin: the pun to witch the switch that is being monitored is connected. The pin is configured as INPUT_PULLUP
+            and watched by the pin change interrupt.
+ */
+template<typename Dispatcher> DebouncedMultiClick<Dispatcher>::DebouncedMultiClick( uint8_t switchPin ) : debouncer( switchPin, 25 ) { // Use a debounce interval of 25 milliseconds
+}
+
+/**
+ Handles the switch changes that were debounced since the previous call. This sould be called in each main loop.
+ Each change is handled with the time at which it happened, so a blocked loop doesn't change the click timing.
+ currentMillis: the currentMills
+ */
+template<typename Dispatcher> void DebouncedMultiClick<Dispatcher>::checkSwitch( unsigned long currentMillis ) {
+  while ( this->debouncer.update( currentMillis ) ) {
+    unsigned long changedAt = this->debouncer.changedAt();
+    this->fire( this->stateMachine.handleSwitchState( false, KEY_RELEASED, changedAt ), *this ); // the time outs that passed before the change
+    this->fire( this->stateMachine.handleSwitchState( true, this->debouncer.read(), changedAt ), *this );
+  }
+  this->fire( this->stateMachine.handleSwitchState( false, KEY_RELEASED, currentMillis ), *this );
+}
+
+/*
+ Determines wether the internal state machine is idle (true) or busy with scanning (false).
+ Idles means that no key is down and no short press sequence is in progress. If the internal state is idle
+ the arduino can be put in sleep mode, without missing any vital information regarding the clicks.
+ */
+template<typename Dispatcher> bool DebouncedMultiClick<Dispatcher>::isIdle( unsigned long currentMillis ) {
+  return this->debouncer.isSettled() && this->stateMachine.isIdle( currentMillis );
+}
+
+/*
+ Tells the debouncer that millis() skipped the given amount of ms, like after a power down. See PinChangeDebouncer.
+ */
+template<typename Dispatcher> void DebouncedMultiClick<Dispatcher>::clockSkipped( unsigned long skippedMillis ) {
+  this->debouncer.clockSkipped( skippedMillis );
+}
+
+
+//                              StaticClickDispatcher
+
+/*
+  Calls the key pressed or key click method of the Handler for the given event. Does nothing for MC_NO_EVENT.
+*/
+template<typename Handler> template<typename Switch> void StaticClickDispatcher<Handler>::fire( MultiClickEvent event, Switch & ) {
+  if ( event.kind == MC_KEY_PRESSED_EVENT ) {
+    Handler::onKeyPress( event.type, event.amount );
+  }
+  else if ( event.kind == MC_KEY_RELEASED_EVENT ) {
+    Handler::onKeyClick( event.type, event.amount );
+  }
+}
+
 #endif
@@ -0,0 +1,184 @@
+#ifndef MULTI_CLICK_BANK_H
+#define MULTI_CLICK_BANK_H
+
+#include "hal.h"
+#include "multiClick.h"
+
+/*
+  Library for multi click and long click detection on a bank of up to 8 switches, with a single debouncer.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  A SoftDebouncedMultiClick reads and debounces its own pin. With several switches, like a seasonal build with a
+  switch per string, that means a pin read and a debouncer update per switch in every loop. The bank reads each port
+  that has switches once per scan (PINB, PINC and PIND) and debounces all pins of the port at once with a vertical
+  counter: a 2 bit counter per pin, of which the low bits of all pins are stored in one byte and the high bits in
+  another. A few bitwise operations count all pins at the same time, a pin toggles after it has been different from
+  its debounced level for 4 scans in a row. With a scan each 5ms that's a debounce time of 15 - 20ms.
+
+  Each switch has its own MultiClickStateMachine (an array of 7 bytes per switch), so the clicks and long presses work
+  exactly like those of a SoftDebouncedMultiClick. The handlers receive the index of the switch in the bank.
+
+  The bank is scanned from the loop, so unlike the SoftDebouncedMultiClick the timing depends on the loop. A change
+  is handled with the time of the scan that accepted it.
+
+  Revision history:
+    16-10-2026 Initial version.
+*/
+
+const unsigned long MULTI_CLICK_BANK_SCAN_INTERVAL = 5; // The ms between two scans
+
+/*
+  Blue print for the event handlers of a bank. The arguments are the state, the amount (long press will always be 1)
+  and the index of the switch in the bank.
+*/
+typedef void (*multiClickBankEventHandler)( KEY_SCAN_STATES, uint8_t, uint8_t );
+
+template<uint8_t switchCount> class MultiClickBank {
+  static_assert( switchCount > 0 && switchCount <= 8, "A bank supports 1 - 8 switches" );
+
+  public:
+    MultiClickBank( const uint8_t ( &switchPins )[ switchCount ] );
+
+    void setKeyPressHandler( multiClickBankEventHandler aHandler );
+    void setKeyClickHandler( multiClickBankEventHandler aHandler );
+
+    void checkSwitches( unsigned long currentMillis );
+    bool isIdle( unsigned long currentMillis );
+  private:
+    void scan( unsigned long scanMillis );
+    void fireEvent( uint8_t switchIndex, MultiClickEvent event );
+
+    uint8_t switchPorts[ switchCount ];            // The port of each switch
+    uint8_t switchMasks[ switchCount ];            // The bit of each switch within its port
+    uint8_t portMasks[ HAL_PORT_COUNT ];           // The bits of the switches of each port
+    uint8_t debouncedLevels[ HAL_PORT_COUNT ];     // The debounced levels of each port
+    uint8_t counterLowBits[ HAL_PORT_COUNT ];      // Bit 0 of the vertical counter of each pin
+    uint8_t counterHighBits[ HAL_PORT_COUNT ];     // Bit 1 of the vertical counter of each pin
+    bool    settled = true;                        // Indicates wether all pins were at their debounced level at the last scan
+    unsigned long lastScan;                        // millis() of the last scan
+
+    MultiClickStateMachine stateMachines[ switchCount ]; // Detects the clicks and long presses of each switch
+
+    multiClickBankEventHandler keyPressHandler = NULL;   // Stores a reference to the keyPressHandler method
+    multiClickBankEventHandler keyReleaseHandler = NULL; // Stores a reference to the keyReleaseHandler method
+};
+
+/*
+  Creates an instance of the MultiClickBank class.
+  switchPins: the pins of the switches, they're configured as INPUT_PULLUP.
+*/
+template<uint8_t switchCount> MultiClickBank<switchCount>::MultiClickBank( const uint8_t ( &switchPins )[ switchCount ] ) {
+  for ( uint8_t port = 0; port < HAL_PORT_COUNT; port++ ) {
+    this->portMasks[ port ] = 0;
+    this->counterLowBits[ port ] = 0xFF;  // All counters at 3, the amount of scans to go
+    this->counterHighBits[ port ] = 0xFF;
+  }
+
+  for ( uint8_t index = 0; index < switchCount; index++ ) {
+    halPinMode( switchPins[ index ], INPUT_PULLUP );
+    this->switchPorts[ index ] = halPinPort( switchPins[ index ] );
+    this->switchMasks[ index ] = halPinMask( switchPins[ index ] );
+    this->portMasks[ this->switchPorts[ index ] ] |= this->switchMasks[ index ];
+  }
+
+  for ( uint8_t port = 0; port < HAL_PORT_COUNT; port++ ) {
+    this->debouncedLevels[ port ] = this->portMasks[ port ] != 0 ? halReadPort( port ) : 0;
+  }
+  this->lastScan = halMillis();
+}
+
+/*
+  Assignes the given handler as the keypress handler of all switches.
+  aHandler: the reference to the handler or NULL if the press doesn't need to be handled anymore.
+*/
+template<uint8_t switchCount> void MultiClickBank<switchCount>::setKeyPressHandler( multiClickBankEventHandler aHandler ) {
+  this->keyPressHandler = aHandler;
+}
+
+/*
+  Assignes the given handler as the key click handler of all switches.
+  aHandler: the reference to the handler or NULL if the click doesn't need to be handled anymore.
+*/
+template<uint8_t switchCount> void MultiClickBank<switchCount>::setKeyClickHandler( multiClickBankEventHandler aHandler ) {
+  this->keyReleaseHandler = aHandler;
+}
+
+/*
+  Scans the switches when the scan interval has passed. This sould be called in each main loop.
+*/
+template<uint8_t switchCount> void MultiClickBank<switchCount>::checkSwitches( unsigned long currentMillis ) {
+  if ( currentMillis - this->lastScan >= MULTI_CLICK_BANK_SCAN_INTERVAL ) {
+    this->lastScan = currentMillis;
+    this->scan( currentMillis );
+  }
+}
+
+/*
+  Reads the ports, debounces all pins and feeds the state machines.
+*/
+template<uint8_t switchCount> void MultiClickBank<switchCount>::scan( unsigned long scanMillis ) {
+  uint8_t toggled[ HAL_PORT_COUNT ];
+
+  this->settled = true;
+  for ( uint8_t port = 0; port < HAL_PORT_COUNT; port++ ) {
+    toggled[ port ] = 0;
+    if ( this->portMasks[ port ] != 0 ) {
+      uint8_t changed = ( halReadPort( port ) ^ this->debouncedLevels[ port ] ) & this->portMasks[ port ];
+
+      // Count down the counters of the changed pins, reset the others to 3. The pins of which the counter rolls over
+      // from 0 to 3 have been changed for 4 scans, so they toggle.
+      this->counterLowBits[ port ] = ~( this->counterLowBits[ port ] & changed );
+      this->counterHighBits[ port ] = this->counterLowBits[ port ] ^ ( this->counterHighBits[ port ] & changed );
+      toggled[ port ] = changed & this->counterLowBits[ port ] & this->counterHighBits[ port ];
+      this->debouncedLevels[ port ] ^= toggled[ port ];
+
+      if ( changed != toggled[ port ] ) {
+        this->settled = false;
+      }
+    }
+  }
+
+  for ( uint8_t index = 0; index < switchCount; index++ ) {
+    uint8_t port = this->switchPorts[ index ];
+    uint8_t mask = this->switchMasks[ index ];
+    if ( toggled[ port ] & mask ) {
+      uint8_t level = ( this->debouncedLevels[ port ] & mask ) ? HIGH : LOW;
+      this->fireEvent( index, this->stateMachines[ index ].handleSwitchState( false, level, scanMillis ) ); // the time outs that passed before the change
+      this->fireEvent( index, this->stateMachines[ index ].handleSwitchState( true, level, scanMillis ) );
+    }
+    else {
+      this->fireEvent( index, this->stateMachines[ index ].handleSwitchState( false, KEY_RELEASED, scanMillis ) );
+    }
+  }
+}
+
+/*
+  Fires the given event of the given switch to the key pressed or key click handler. Does nothing for MC_NO_EVENT.
+*/
+template<uint8_t switchCount> void MultiClickBank<switchCount>::fireEvent( uint8_t switchIndex, MultiClickEvent event ) {
+  if ( event.kind == MC_KEY_PRESSED_EVENT && this->keyPressHandler != NULL ) {
+    this->keyPressHandler( event.type, event.amount, switchIndex );
+  }
+  else if ( event.kind == MC_KEY_RELEASED_EVENT && this->keyReleaseHandler != NULL ) {
+    this->keyReleaseHandler( event.type, event.amount, switchIndex );
+  }
+}
+
+/*
+  Determines wether all switches are idle (true) or if one of them is busy (false). See SoftDebouncedMultiClick::isIdle().
+*/
+template<uint8_t switchCount> bool MultiClickBank<switchCount>::isIdle( unsigned long currentMillis ) {
+  if ( !this->settled ) {
+    return false;
+  }
+  for ( uint8_t index = 0; index < switchCount; index++ ) {
+    if ( !this->stateMachines[ index ].isIdle( currentMillis ) ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif
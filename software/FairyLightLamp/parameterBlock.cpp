@@ -0,0 +1,78 @@
+#include <string.h>
+#include "parameterBlock.h"
+#include "crc8.h"
+
+/*
+  Creates an instance of the ParameterBlock class.
+  address   : the EEPROM address of the block.
+  version   : the version of the parameters, a block of another version is ignored.
+  parameters: the struct with the parameters, it holds their defaults until load() reads the stored ones.
+  size      : the size of the struct, at most EEPROM_PARAMETERS_SIZE - PARAMETER_BLOCK_OVERHEAD bytes.
+*/
+ParameterBlock::ParameterBlock( uint16_t address, uint8_t version, void *parameters, uint8_t size ) {
+  this->address = address;
+  this->version = version;
+  this->parameters = (uint8_t *)parameters;
+  this->size = size;
+  this->writeIndex = size + PARAMETER_BLOCK_OVERHEAD;
+  this->crc = 0;
+}
+
+/*
+  Reads the block with a single read and copies the stored parameters to the struct. Must be called once at boot,
+  before store(). Returns false when the block isn't valid, the struct is left untouched in that case.
+*/
+bool ParameterBlock::load() {
+  uint8_t block[ EEPROM_PARAMETERS_SIZE ];
+  uint8_t length = this->size + PARAMETER_BLOCK_OVERHEAD;
+  if ( length > EEPROM_PARAMETERS_SIZE ) {
+    return false;
+  }
+
+  halEepromReadBlock( block, this->address, length );
+  if ( block[ 0 ] != this->version || block[ 1 ] != this->size || crc8( block, length - 1 ) != block[ length - 1 ] ) {
+    return false;
+  }
+  memcpy( this->parameters, block + 2, this->size );
+  return true;
+}
+
+/*
+  Writes the struct to the EEPROM from update(). When the block is being written it starts again.
+*/
+void ParameterBlock::store() {
+  this->writeIndex = 0;
+}
+
+/*
+  Writes the next byte of the block when it's being written and the EEPROM is ready for it. Must be called from the
+  main loop for each cycle.
+*/
+void ParameterBlock::update() {
+  if ( this->writeIndex < this->size + PARAMETER_BLOCK_OVERHEAD && halEepromReady() ) {
+    uint8_t value = this->blockByte( this->writeIndex );
+    halEepromUpdate( this->address + this->writeIndex, value );
+    this->crc = crc8Update( this->writeIndex == 0 ? 0 : this->crc, value );
+    this->writeIndex++;
+  }
+}
+
+/*
+  Determines wether the block has been written (true) or if it's being written (false).
+*/
+bool ParameterBlock::isIdle() {
+  return this->writeIndex == this->size + PARAMETER_BLOCK_OVERHEAD;
+}
+
+/*
+  Returns the given byte of the block: the version, the size, a byte of the struct or the CRC of the bytes before it.
+*/
+uint8_t ParameterBlock::blockByte( uint8_t index ) {
+  if ( index == 0 ) {
+    return this->version;
+  }
+  if ( index == 1 ) {
+    return this->size;
+  }
+  return index < this->size + 2 ? this->parameters[ index - 2 ] : this->crc;
+}
@@ -0,0 +1,62 @@
+#ifndef PARAMETER_BLOCK_H
+#define PARAMETER_BLOCK_H
+
+#include "hal.h"
+
+/*
+  Library for keeping a block of settings (parameters) in the EEPROM, which can be changed at run time.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  The parameters are a struct of the sketch, the block doesn't know their meaning. In the EEPROM they're stored with
+  a version, their size and a CRC-8 (see crc8.h):
+
+    | version | size | parameters ... | crc |
+
+  At boot load() reads the whole block with a single block read, and copies the parameters to the struct when the
+  block is valid: the version and the size match and the CRC is right. Otherwise (a new node, a block of another
+  version of the sketch, or a write that was cut off by a power out) the struct keeps its defaults. From then on the
+  sketch only reads the struct in RAM, never the EEPROM.
+
+  When the sketch changed the struct it calls store(). update() writes the block one byte per call, and only when the
+  EEPROM is done with the previous byte, so the loop never waits for the EEPROM. The CRC is calculated along with
+  the bytes that are written. A store() while the block is being written starts again at the first byte, so the
+  block always ends up with a consistent copy of the struct. Unchanged bytes aren't written at all.
+
+  Bump the version when the struct changes, the old block is then ignored instead of read into the wrong fields.
+
+  Revision history:
+    16-10-2026 Initial version.
+*/
+
+const uint8_t PARAMETER_BLOCK_OVERHEAD = 3; // The version, the size and the crc
+
+// The EEPROM area of the parameter block, between the local config of MySensors (which ends around address 670) and
+// the state journal (EEPROM_JOURNAL_ADDRESS).
+const uint16_t EEPROM_PARAMETERS_ADDRESS = 672;
+const uint8_t  EEPROM_PARAMETERS_SIZE = 32;
+
+/*
+  Definition of the class, the method documentation can be found in the parameterBlock.cpp file.
+*/
+class ParameterBlock {
+  public:
+    ParameterBlock( uint16_t address, uint8_t version, void *parameters, uint8_t size );
+
+    bool load();
+    void store();
+    void update();
+    bool isIdle();
+  private:
+    uint8_t blockByte( uint8_t index );
+
+    uint16_t address;     // The EEPROM address of the block
+    uint8_t  version;     // The version of the parameters
+    uint8_t  *parameters; // The struct with the parameters in RAM
+    uint8_t  size;        // The size of the struct
+    uint8_t  writeIndex;  // The next byte of the block to write, size + PARAMETER_BLOCK_OVERHEAD when it's written
+    uint8_t  crc;         // The CRC of the bytes written so far
+};
+
+#endif
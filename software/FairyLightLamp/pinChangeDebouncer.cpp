@@ -0,0 +1,119 @@
+#include "pinChangeDebouncer.h"
+
+/*
+  Creates an instance of the PinChangeDebouncer class and attaches it to the pin change interrupt of the given pin.
+  pin           : the pin of the switch, it's configured as INPUT_PULLUP.
+  intervalMillis: the debounce interval, the time the pin must keep the same level before it's accepted.
+*/
+PinChangeDebouncer::PinChangeDebouncer( uint8_t pin, uint16_t intervalMillis ) {
+  this->pin = pin;
+  this->intervalMillis = intervalMillis;
+
+  halPinMode( pin, INPUT_PULLUP );
+  this->stableState = halDigitalRead( pin );
+  this->stableSince = halMillis();
+  this->pendingState = this->stableState;
+  this->pendingSince = this->stableSince;
+
+  pinChangeAttach( pin, onPinChange, this );
+}
+
+/*
+  Pin change handler (interrupt context): stores the edge in the ring buffer.
+*/
+void PinChangeDebouncer::onPinChange( uint8_t level, void *context ) {
+  PinChangeDebouncer *debouncer = (PinChangeDebouncer *)context;
+  uint8_t head = debouncer->head;
+  uint8_t next = ( head + 1 ) & ( DEBOUNCE_BUFFER_SIZE - 1 );
+
+  if ( next == debouncer->tail ) {
+    debouncer->overflow = true;
+    return;
+  }
+  debouncer->edges[ head ] = ( (uint16_t)halMillis() & ~1 ) | ( level ? 1 : 0 );
+  debouncer->head = next; // Written after the edge, so the edge is complete
+}
+
+/*
+  Consumes the edges that were stored by the interrupt. Returns true when the debounced state has changed, in that
+  case read() returns the new state and changedAt() the time of the change. When several changes are waiting only the
+  first one is returned, so update() must be called until it returns false to handle all changes in order.
+  currentMillis: the current millis(), used to accept the level of the last edge.
+*/
+bool PinChangeDebouncer::update( unsigned long currentMillis ) {
+  while ( this->tail != this->head ) {
+    uint8_t tail = this->tail;
+    uint16_t edge = this->edges[ tail ];
+    int16_t edgeAge = (int16_t)( (uint16_t)currentMillis - ( edge & ~1 ) );
+    if ( edgeAge < 0 ) {
+      break; // The edge happened after currentMillis was read, it's handled in the next pass
+    }
+    unsigned long edgeTime = currentMillis - edgeAge;
+
+    // The level of the previous edge was kept until this edge, long enough to accept it. Don't consume this edge yet.
+    if ( this->pendingState != this->stableState && edgeTime - this->pendingSince >= this->intervalMillis ) {
+      this->stableState = this->pendingState;
+      this->stableSince = this->pendingSince;
+      return true;
+    }
+
+    this->pendingState = edge & 1;
+    this->pendingSince = edgeTime;
+    this->tail = ( tail + 1 ) & ( DEBOUNCE_BUFFER_SIZE - 1 );
+  }
+
+  if ( this->overflow && this->tail == this->head ) {
+    // Edges have been dropped, so the level of the last edge can be wrong. Start over from the current level.
+    this->overflow = false;
+    this->pendingState = halDigitalRead( this->pin );
+    this->pendingSince = currentMillis;
+  }
+
+  if ( this->pendingState != this->stableState && currentMillis - this->pendingSince >= this->intervalMillis ) {
+    this->stableState = this->pendingState;
+    this->stableSince = this->pendingSince;
+    return true;
+  }
+  return false;
+}
+
+/*
+  Returns the debounced state of the pin.
+*/
+uint8_t PinChangeDebouncer::read() {
+  return this->stableState;
+}
+
+/*
+  Returns the millis() at which the debounced state started, the moment the pin settled at its current level.
+*/
+unsigned long PinChangeDebouncer::changedAt() {
+  return this->stableSince;
+}
+
+/*
+  Determines wether all edges have been handled and the pin is at its debounced level (true) or if the pin is still
+  changing (false).
+*/
+bool PinChangeDebouncer::isSettled() {
+  return this->tail == this->head && this->pendingState == this->stableState;
+}
+
+/*
+  Moves the time stamps of the edges that haven't been handled yet forward with the given amount of ms. Must be called
+  when millis() skipped time, like after a power down: the edges that woke up the node are stamped with the millis()
+  from before the sleep.
+*/
+void PinChangeDebouncer::clockSkipped( unsigned long skippedMillis ) {
+#ifdef ARDUINO
+  uint8_t oldSREG = SREG;
+  cli();
+#endif
+  for ( uint8_t index = this->tail; index != this->head; index = ( index + 1 ) & ( DEBOUNCE_BUFFER_SIZE - 1 ) ) {
+    this->edges[ index ] += skippedMillis & ~1UL; // Keeps the level in the lowest bit
+  }
+#ifdef ARDUINO
+  SREG = oldSREG;
+#endif
+  this->pendingSince += skippedMillis;
+}
@@ -0,0 +1,61 @@
+#ifndef PIN_CHANGE_DEBOUNCER_H
+#define PIN_CHANGE_DEBOUNCER_H
+
+#include "hal.h"
+#include "pinChangeInterrupt.h"
+
+/*
+  Library for debouncing a switch from the pin change interrupt, without blocking the main loop.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  The pin change interrupt stores every edge of the switch with its millis() in a ring buffer. The main loop
+  consumes the edges in update() and debounces them afterwards: a new state is accepted when the pin kept the same
+  level for the whole debounce interval. Because the edges carry their own time stamp, the accepted state changes get
+  the time at which they really happened, even when the loop was blocked (e.g. by radio traffic) while the switch was
+  used. And no edge is missed, as long as the buffer doesn't overflow.
+
+  The buffer is lock free: only the interrupt writes the edges and the head, only the loop moves the tail. Both
+  indices are single bytes, which are read and written atomically by the AVR. The interrupt writes the edge before it
+  moves the head, so the loop never reads a half written edge. When the buffer is full new edges are dropped and the
+  loop reads the pin once the buffer has been emptied. To save RAM an edge is 2 bytes: the lower 16 bits of millis()
+  with the new level in the lowest bit. So the time of an edge is rounded down to an even ms, which makes no difference
+  for an interval of tens of ms, and it works as long as the loop handles an edge within half a minute.
+
+  Revision history:
+    16-10-2026 Initial version.
+    17-10-2026 The level of an edge is the lowest bit of its time, 2 instead of 3 bytes per edge.
+*/
+
+// The amount of edges in the ring buffer, a power of two. A click with a lot of contact bounce is about 10 edges, so
+// this holds a bouncy double click while the loop is blocked.
+const uint8_t DEBOUNCE_BUFFER_SIZE = 32;
+
+class PinChangeDebouncer {
+  public:
+    PinChangeDebouncer( uint8_t pin, uint16_t intervalMillis );
+
+    bool update( unsigned long currentMillis );
+    uint8_t read();
+    unsigned long changedAt();
+    bool isSettled();
+    void clockSkipped( unsigned long skippedMillis );
+  private:
+    static void onPinChange( uint8_t level, void *context );
+
+    uint8_t       pin;
+    uint16_t      intervalMillis;  // the time the pin must keep the same level before it's accepted
+    uint8_t       stableState;     // the debounced level
+    unsigned long stableSince;     // millis() at which the debounced level started
+    uint8_t       pendingState;    // the level of the last consumed edge
+    unsigned long pendingSince;    // millis() of the last consumed edge
+
+    volatile uint16_t edges[ DEBOUNCE_BUFFER_SIZE ];      // the lower 16 bits of millis() of each edge with its new level
+                                                          // as the lowest bit, written by the interrupt
+    volatile uint8_t  head = 0;                           // the next edge to write, moved by the interrupt
+    volatile uint8_t  tail = 0;                           // the next edge to consume, moved by the loop
+    volatile bool     overflow = false;                   // set by the interrupt when an edge was dropped
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include "pinChangeInterrupt.h"
+
+/*
+  An attached pin: the port (HAL_PORT_B = PCINT0, HAL_PORT_C = PCINT1, HAL_PORT_D = PCINT2) and bit of the pin with
+  its handler.
+*/
+struct PinChangeSlot {
+  uint8_t          pin;
+  uint8_t          port;
+  uint8_t          mask;
+  pinChangeHandler handler;
+  void             *context;
+};
+
+const uint8_t PIN_CHANGE_NO_PIN = 0xFF;  // Marks an unused slot
+static PinChangeSlot          slots[ PIN_CHANGE_MAX_PINS ] = { { PIN_CHANGE_NO_PIN, 0, 0, NULL, NULL }, { PIN_CHANGE_NO_PIN, 0, 0, NULL, NULL },
+                                                               { PIN_CHANGE_NO_PIN, 0, 0, NULL, NULL }, { PIN_CHANGE_NO_PIN, 0, 0, NULL, NULL } };
+static uint8_t                portMasks[ HAL_PORT_COUNT ];  // The attached pins of each port
+static uint8_t                portLevels[ HAL_PORT_COUNT ]; // The levels of each port at the previous interrupt
+static pinChangeWakeUpHandler wakeUpHandler = NULL;
+
+/*
+  Enables the interrupt for the attached pins of the given port, or disables it when no pins are attached.
+*/
+static void enablePort( uint8_t port ) {
+#ifdef ARDUINO
+  volatile uint8_t *pcmsk = port == HAL_PORT_B ? &PCMSK0 : port == HAL_PORT_C ? &PCMSK1 : &PCMSK2;
+  *pcmsk = portMasks[ port ];
+  if ( portMasks[ port ] != 0 ) {
+    PCIFR = _BV( port ); // Clear a change that happened before the pin was attached
+    PCICR |= _BV( port );
+  }
+  else {
+    PCICR &= ~_BV( port );
+  }
+#else
+  (void)port;
+#endif
+}
+
+#ifndef ARDUINO
+/*
+  Called by the simulation when it changes the level of a pin, in place of the interrupt.
+*/
+static void onHostPinChange( uint8_t pin ) {
+  pinChangeDispatch( halPinPort( pin ) );
+}
+#endif
+
+/*
+  Calls the given handler from the pin change interrupt each time the level of the given pin changes.
+  pin    : the Arduino pin to watch, its pin mode must be set by the caller.
+  handler: the handler, NULL when the pin only has to wake up the node.
+  context: passed to the handler, e.g. the object that handles the change.
+  Returns false when all slots are in use.
+*/
+bool pinChangeAttach( uint8_t pin, pinChangeHandler handler, void *context ) {
+  pinChangeDetach( pin );
+#ifndef ARDUINO
+  hostSetPinChangeCallback( onHostPinChange );
+#endif
+
+  for ( uint8_t index = 0; index < PIN_CHANGE_MAX_PINS; index++ ) {
+    if ( slots[ index ].pin == PIN_CHANGE_NO_PIN ) {
+      uint8_t port = halPinPort( pin );
+#ifdef ARDUINO
+      uint8_t oldSREG = SREG;
+      cli(); // the slot can not be written atomically, so make sure the interrupt doesn't fire halfway
+#endif
+      slots[ index ].port = port;
+      slots[ index ].mask = halPinMask( pin );
+      slots[ index ].handler = handler;
+      slots[ index ].context = context;
+      slots[ index ].pin = pin;
+      portMasks[ port ] |= slots[ index ].mask;
+      portLevels[ port ] = halReadPort( port );
+      enablePort( port );
+#ifdef ARDUINO
+      SREG = oldSREG;
+#endif
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+  Stops watching the given pin. Does nothing when the pin isn't attached.
+*/
+void pinChangeDetach( uint8_t pin ) {
+  for ( uint8_t index = 0; index < PIN_CHANGE_MAX_PINS; index++ ) {
+    if ( slots[ index ].pin == pin ) {
+#ifdef ARDUINO
+      uint8_t oldSREG = SREG;
+      cli();
+#endif
+      portMasks[ slots[ index ].port ] &= ~slots[ index ].mask;
+      enablePort( slots[ index ].port );
+      slots[ index ].pin = PIN_CHANGE_NO_PIN;
+#ifdef ARDUINO
+      SREG = oldSREG;
+#endif
+    }
+  }
+}
+
+/*
+  Assigns the handler that is called after every change of an attached pin, NULL for none.
+*/
+void pinChangeSetWakeUpHandler( pinChangeWakeUpHandler handler ) {
+#ifdef ARDUINO
+  uint8_t oldSREG = SREG;
+  cli(); // a pointer is two bytes, which can not be written atomically
+#endif
+  wakeUpHandler = handler;
+#ifdef ARDUINO
+  SREG = oldSREG;
+#endif
+}
+
+/*
+  Calls the handlers of the attached pins of the given port that changed since the previous call. Called by the
+  interrupts, or by the simulated pins on the host.
+*/
+void pinChangeDispatch( uint8_t port ) {
+  uint8_t levels = halReadPort( port );
+  uint8_t changed = ( levels ^ portLevels[ port ] ) & portMasks[ port ];
+  portLevels[ port ] = levels;
+
+  if ( changed == 0 ) {
+    return;
+  }
+  for ( uint8_t index = 0; index < PIN_CHANGE_MAX_PINS; index++ ) {
+    PinChangeSlot &slot = slots[ index ];
+    if ( slot.pin != PIN_CHANGE_NO_PIN && slot.port == port && ( changed & slot.mask ) && slot.handler != NULL ) {
+      slot.handler( ( levels & slot.mask ) ? HIGH : LOW, slot.context );
+    }
+  }
+  if ( wakeUpHandler != NULL ) {
+    wakeUpHandler();
+  }
+}
+
+#ifdef ARDUINO
+ISR( PCINT0_vect ) {
+  pinChangeDispatch( 0 );
+}
+
+ISR( PCINT1_vect ) {
+  pinChangeDispatch( 1 );
+}
+
+ISR( PCINT2_vect ) {
+  pinChangeDispatch( 2 );
+}
+#endif
@@ -0,0 +1,47 @@
+#ifndef PIN_CHANGE_INTERRUPT_H
+#define PIN_CHANGE_INTERRUPT_H
+
+#include "hal.h"
+
+/*
+  Library for sharing the pin change interrupts between the parts of the sketch that need them.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  The Pro Mini only has two external interrupts (pins 2 and 3), and pin 3 is one of the PWM channels. The other
+  pins can only be watched through the pin change interrupts, of which there's one per port: PCINT0 (pins 8-13),
+  PCINT1 (A0-A5) and PCINT2 (pins 0-7). The switch and the encoder are all on port D, so they share PCINT2. An
+  interrupt vector can only be defined once, that's why this library owns the vectors and dispatches each change to
+  the handler of the pin that changed.
+
+  A handler is called from the interrupt, so it must be short. It receives the new level of the pin and the context
+  that was given when it was attached. The wake up handler is called after every change of an attached pin, it's
+  used to end a sleep when the switch or the encoder is used.
+
+  On the host there are no interrupts, the simulated pins (see hostSetPin()) call pinChangeDispatch() themselves.
+
+  Revision history:
+    16-10-2026 Initial version.
+*/
+
+/*
+  Blue print for the pin change handlers. The first argument is the new level of the pin, the second the context that
+  was given to pinChangeAttach().
+*/
+typedef void (*pinChangeHandler)( uint8_t, void * );
+
+/*
+  Blue print for the wake up handler.
+*/
+typedef void (*pinChangeWakeUpHandler)();
+
+// The amount of pins that can be attached at the same time
+const uint8_t PIN_CHANGE_MAX_PINS = 4;
+
+bool pinChangeAttach( uint8_t pin, pinChangeHandler handler, void *context );
+void pinChangeDetach( uint8_t pin );
+void pinChangeSetWakeUpHandler( pinChangeWakeUpHandler handler );
+void pinChangeDispatch( uint8_t port );
+
+#endif
@@ -0,0 +1,130 @@
+#include "quadratureEncoder.h"
+
+/*
+  The quarter step of each transition, indexed by the previous state and the new state of the pins ( previous << 2 |
+  new ). A state is the level of the first pin (bit 1) and the second pin (bit 0). Turning clockwise the states are
+  3, 2, 0, 1, 3 ... which counts up, like the Encoder library does.
+*/
+static const int8_t transitions[ 16 ] PROGMEM = {
+   0, +1, -1,  0,
+  -1,  0,  0, +1,
+  +1,  0,  0, -1,
+   0, -1, +1,  0
+};
+
+/*
+  Creates an instance of the QuadratureEncoder class and attaches it to the pin change interrupts of the given pins.
+  firstPin, secondPin: the pins of the encoder, on the same port. They're configured as INPUT_PULLUP.
+  incrementsPerDetent: the amount of quarter steps (edges) from one detent to the next.
+*/
+QuadratureEncoder::QuadratureEncoder( uint8_t firstPin, uint8_t secondPin, uint8_t incrementsPerDetent ) {
+  this->port = halPinPort( firstPin );
+  this->firstMask = halPinMask( firstPin );
+  this->secondMask = halPinMask( secondPin );
+  this->halfDetent = ( incrementsPerDetent + 1 ) / 2;
+  this->direction = 1;
+  this->stepSize = 1;
+  this->lastDetentAt = halMillis();
+
+  halPinMode( firstPin, INPUT_PULLUP );
+  halPinMode( secondPin, INPUT_PULLUP );
+  uint8_t levels = halReadPort( this->port );
+  this->restState = ( levels & this->firstMask ? 2 : 0 ) | ( levels & this->secondMask ? 1 : 0 );
+  this->state = this->restState;
+  this->quarterSteps = 0;
+
+  pinChangeAttach( firstPin, onPinChange, this );
+  pinChangeAttach( secondPin, onPinChange, this );
+}
+
+/*
+  Pin change handler of both pins (interrupt context): decodes the transition and stores a detent when the encoder is
+  back at its rest position.
+*/
+void QuadratureEncoder::onPinChange( uint8_t level, void *context ) {
+  (void)level; // Both pins are needed, they're read from the port at once
+  QuadratureEncoder *encoder = (QuadratureEncoder *)context;
+  uint8_t levels = halReadPort( encoder->port );
+  uint8_t state = ( levels & encoder->firstMask ? 2 : 0 ) | ( levels & encoder->secondMask ? 1 : 0 );
+
+  encoder->quarterSteps += (int8_t)pgm_read_byte( &transitions[ ( encoder->state << 2 ) | state ] );
+  encoder->state = state;
+  if ( state != encoder->restState ) {
+    return;
+  }
+
+  int8_t detent = encoder->quarterSteps >= encoder->halfDetent ? 1 : encoder->quarterSteps <= -encoder->halfDetent ? -1 : 0;
+  encoder->quarterSteps = 0;
+  if ( detent == 0 ) {
+    return;
+  }
+
+  uint8_t head = encoder->head;
+  uint8_t next = ( head + 1 ) & ( ENCODER_BUFFER_SIZE - 1 );
+  if ( encoder->overflowDetents != 0 || next == encoder->tail ) {
+    encoder->overflowDetents += detent; // Keeps the order: these are consumed after the buffer
+    return;
+  }
+  encoder->detents[ head ] = ( (uint16_t)halMillis() & ~1 ) | ( detent > 0 ? 1 : 0 );
+  encoder->head = next; // Written after the detent, so the detent is complete
+}
+
+/*
+  Consumes the next detent that was stored by the interrupt. Returns true when there was one, in that case
+  getDirection() and getStepSize() return its direction and step size. update() must be called until it returns
+  false to handle all detents in order.
+  currentMillis: the current millis(), used to restore the full time of a detent.
+*/
+bool QuadratureEncoder::update( unsigned long currentMillis ) {
+  int8_t        detent;
+  unsigned long detentTime;
+
+  if ( this->tail != this->head ) {
+    uint8_t tail = this->tail;
+    uint16_t stored = this->detents[ tail ];
+    detentTime = currentMillis - (uint16_t)( (uint16_t)currentMillis - ( stored & ~1 ) );
+    detent = stored & 1 ? 1 : -1;
+    this->tail = ( tail + 1 ) & ( ENCODER_BUFFER_SIZE - 1 );
+  }
+  else {
+#ifdef ARDUINO
+    uint8_t oldSREG = SREG;
+    cli(); // an int16_t can not be read and written atomically
+#endif
+    int16_t overflowDetents = this->overflowDetents;
+    detent = overflowDetents > 0 ? 1 : overflowDetents < 0 ? -1 : 0;
+    this->overflowDetents = overflowDetents - detent;
+#ifdef ARDUINO
+    SREG = oldSREG;
+#endif
+    if ( detent == 0 ) {
+      return false;
+    }
+    detentTime = this->lastDetentAt; // The time isn't known, these detents came in quicker than the loop handled them
+  }
+
+  unsigned long interval = detentTime - this->lastDetentAt;
+  if ( detent != this->direction || interval >= ENCODER_QUICK_INTERVAL ) {
+    this->stepSize = 1;
+  }
+  else {
+    this->stepSize = interval < ENCODER_FAST_INTERVAL ? ENCODER_FAST_STEP : ENCODER_QUICK_STEP;
+  }
+  this->direction = detent;
+  this->lastDetentAt = detentTime;
+  return true;
+}
+
+/*
+  Returns the direction of the last consumed detent: +1 when turned clockwise, -1 when turned counter clockwise.
+*/
+int8_t QuadratureEncoder::getDirection() {
+  return this->direction;
+}
+
+/*
+  Returns the step size of the last consumed detent: 1 for a slow turn, up to ENCODER_FAST_STEP for a quick turn.
+*/
+uint8_t QuadratureEncoder::getStepSize() {
+  return this->stepSize;
+}
@@ -0,0 +1,80 @@
+#ifndef QUADRATURE_ENCODER_H
+#define QUADRATURE_ENCODER_H
+
+#include "hal.h"
+#include "pinChangeInterrupt.h"
+
+/*
+  Library for reading a rotary encoder from the pin change interrupts, with acceleration for quick turns.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  The Encoder library only uses an interrupt for the pins with an external interrupt. The second pin of the lamp
+  (pin 4) doesn't have one, so it was polled from the loop and quick turns lost steps while the loop was busy. This
+  library watches both pins through the pin change interrupt (see pinChangeInterrupt.h) and decodes the quadrature
+  signal with a transition table: the previous and the new state of the two pins give -1, 0 or +1 quarter step. An
+  invalid transition (both pins changed, a missed edge) counts as 0. A detent is counted when the encoder is back at
+  its rest position (the state at start up) after at least half of the quarter steps of a detent in one direction, so
+  a wobble of the knob doesn't count and a single missed edge doesn't lose the detent.
+
+  Each detent is stored as the lower 16 bits of its millis() in a lock free ring buffer, with its direction in the
+  lowest bit (1 for +1), like the edges of the switch (see pinChangeDebouncer.h). When the buffer is full the detents
+  are counted instead, so none are lost when the loop is blocked for a long time. The loop consumes the detents in
+  update() and gets the direction of each detent and a step size, which grows when the detents follow each other
+  quickly in the same direction. That way a quick spin of the knob goes from the minimum to the maximum brightness in
+  a few detents, and a slow turn still changes the brightness one level per detent.
+
+  The counted detents are a single net count, 2 bytes instead of a buffer entry per detent. So after a stall that
+  filled the buffer, the detents that came in while it was full lose their times and their order: a turn back and
+  forth counts as its net detents in one direction, each one a fast step (ENCODER_FAST_STEP) after a detent in the
+  same direction. The position the knob was turned to is kept, the brightness it's worth isn't. A back and forth turn
+  during a stall can end up a few levels further than the same turn with a loop that keeps up (see the replay test of
+  the host, software/host/encoderReplay.cpp, which checks the levels of both).
+
+  Revision history:
+    16-10-2026 Initial version.
+    17-10-2026 The direction of a detent is the lowest bit of its time, 2 instead of 3 bytes per detent.
+    17-10-2026 Documented the step sizes of the detents that are counted while the buffer is full.
+*/
+
+// The amount of detents in the ring buffer, a power of two
+const uint8_t ENCODER_BUFFER_SIZE = 16;
+
+// Acceleration: a detent within this amount of ms after the previous detent in the same direction counts as
+// ENCODER_QUICK_STEP or ENCODER_FAST_STEP steps.
+const uint8_t ENCODER_QUICK_INTERVAL = 60;
+const uint8_t ENCODER_FAST_INTERVAL = 25;
+const uint8_t ENCODER_QUICK_STEP = 2;
+const uint8_t ENCODER_FAST_STEP = 3;
+
+class QuadratureEncoder {
+  public:
+    QuadratureEncoder( uint8_t firstPin, uint8_t secondPin, uint8_t incrementsPerDetent );
+
+    bool update( unsigned long currentMillis );
+    int8_t getDirection();
+    uint8_t getStepSize();
+  private:
+    static void onPinChange( uint8_t level, void *context );
+
+    uint8_t       port;            // the port of both pins
+    uint8_t       firstMask;       // the bit of the first pin within the port
+    uint8_t       secondMask;      // the bit of the second pin within the port
+    uint8_t       restState;       // the state of the pins at a detent
+    int8_t        halfDetent;      // the quarter steps needed to count a detent
+    int8_t        direction;       // the direction of the last consumed detent, -1 or +1
+    uint8_t       stepSize;        // the step size of the last consumed detent
+    unsigned long lastDetentAt;    // millis() of the last consumed detent
+
+    volatile uint8_t  state;                              // the state of the pins at the previous edge, used by the interrupt
+    volatile int8_t   quarterSteps;                       // the quarter steps since the last rest state, used by the interrupt
+    volatile uint16_t detents[ ENCODER_BUFFER_SIZE ];     // the lower 16 bits of millis() of each detent with its direction
+                                                          // as the lowest bit, written by the interrupt
+    volatile uint8_t  head = 0;                           // the next detent to write, moved by the interrupt
+    volatile uint8_t  tail = 0;                           // the next detent to consume, moved by the loop
+    volatile int16_t  overflowDetents = 0;                // the detents counted since the buffer was full, while it's
+                                                          // non zero all new detents are counted here
+};
+
+#endif
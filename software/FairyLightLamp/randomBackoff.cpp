@@ -0,0 +1,87 @@
+#include "randomBackoff.h"
+
+/*
+  Creates an instance of the RandomBackoff class, stopped.
+
+  pacing    : ms, the next attempt after a success is 1 - 2 times this delay later. Also the first backoff.
+  spread    : ms, the first attempt is 0 - spread after start().
+  maxBackoff: ms, the backoff after failures doesn't grow beyond this delay.
+*/
+RandomBackoff::RandomBackoff( uint16_t pacing, uint16_t spread, uint16_t maxBackoff ) {
+  this->pacing = pacing;
+  this->spread = spread;
+  this->maxBackoff = maxBackoff;
+  this->backoff = pacing;
+  this->running = false;
+  this->nextAttempt = 0;
+}
+
+/*
+  Seeds the random generator. Give each node its own seed, otherwise the nodes keep the same timing. A seed of 0 is
+  replaced, the xorshift generator would only return zeros.
+*/
+void RandomBackoff::seed( uint16_t seed ) {
+  this->generator.seed( seed );
+}
+
+/*
+  Starts a series of attempts, the first one is a random delay (within the spread) after the given millis.
+*/
+void RandomBackoff::start( unsigned long currentMillis ) {
+  this->backoff = this->pacing;
+  this->running = true;
+  this->nextAttempt = currentMillis + this->randomDelay( this->spread );
+}
+
+/*
+  Ends the series, isDue() no longer returns true.
+*/
+void RandomBackoff::stop() {
+  this->running = false;
+}
+
+/*
+  Determines wether a series of attempts is running.
+*/
+bool RandomBackoff::isRunning() {
+  return this->running;
+}
+
+/*
+  Determines wether the next attempt should be made at the given millis.
+*/
+bool RandomBackoff::isDue( unsigned long currentMillis ) {
+  return this->running && (long)( currentMillis - this->nextAttempt ) >= 0;
+}
+
+/*
+  The attempt got through: the backoff is reset and the next attempt is 1 - 2 times the pacing later.
+*/
+void RandomBackoff::succeeded( unsigned long currentMillis ) {
+  this->backoff = this->pacing;
+  this->nextAttempt = currentMillis + this->pacing + this->randomDelay( this->pacing );
+}
+
+/*
+  The attempt failed: the backoff doubles (up to the maximum) and the next attempt is in its upper half, so a retry is
+  never sooner than half the backoff.
+*/
+void RandomBackoff::failed( unsigned long currentMillis ) {
+  this->backoff = this->backoff > this->maxBackoff / 2 ? this->maxBackoff : this->backoff * 2;
+  uint16_t half = this->backoff / 2;
+  this->nextAttempt = currentMillis + half + this->randomDelay( this->backoff - half );
+}
+
+/*
+  Returns the millis() of the next attempt, only meaningful while isRunning().
+*/
+unsigned long RandomBackoff::getNextAttempt() {
+  return this->nextAttempt;
+}
+
+/*
+  Returns a random delay of 0 up to (not including) the given range in ms, 0 for a range of 0.
+*/
+uint16_t RandomBackoff::randomDelay( uint16_t range ) {
+  return range == 0 ? 0 : this->generator.next() % range;
+}
@@ -0,0 +1,53 @@
+#ifndef RANDOM_BACKOFF_H
+#define RANDOM_BACKOFF_H
+
+#include "hal.h"
+#include "xorshift16.h"
+
+/*
+  Library for pacing a series of messages to the gateway with random delays, and for retrying a message that didn't
+  get through with a randomized exponential backoff.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  After a power out all nodes of the house boot at the same moment and find the gateway at about the same moment. When
+  they all send their presentation with the same fixed delays, their messages keep colliding and the gateway is flooded
+  with retries. So the first attempt is drawn from a spread after start(), the next attempt after a success is paced
+  with 1 - 2 times the pacing, and after a failure the backoff doubles (up to a maximum) and the next attempt is drawn
+  from the upper half of the backoff. Each node seeds the generator with something of its own (its node id), so the
+  nodes drift apart instead of repeating each other's timing.
+
+  The class only keeps the time of the next attempt, the caller sends the message when isDue() and reports the result
+  with succeeded() or failed(). A random delay takes a 16 bit division, once per message.
+
+  Revision history:
+    16-10-2026 Initial version.
+    17-10-2026 The random generator is the shared Xorshift16.
+*/
+
+class RandomBackoff {
+  public:
+    RandomBackoff( uint16_t pacing, uint16_t spread, uint16_t maxBackoff );
+
+    void seed( uint16_t seed );
+    void start( unsigned long currentMillis );
+    void stop();
+    bool isRunning();
+    bool isDue( unsigned long currentMillis );
+    void succeeded( unsigned long currentMillis );
+    void failed( unsigned long currentMillis );
+    unsigned long getNextAttempt();
+  private:
+    uint16_t randomDelay( uint16_t range );
+
+    uint16_t      pacing;      // ms, the minimum delay after a success
+    uint16_t      spread;      // ms, the range of the delay of the first attempt
+    uint16_t      maxBackoff;  // ms, the maximum backoff after failures
+    uint16_t      backoff;     // ms, the current backoff, doubles with each failure
+    Xorshift16    generator;   // The random generator of the delays (xorshift16.h)
+    bool          running;
+    unsigned long nextAttempt; // millis() of the next attempt
+};
+
+#endif
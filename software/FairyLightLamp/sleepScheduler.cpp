@@ -0,0 +1,82 @@
+#include "sleepScheduler.h"
+
+/*
+  Creates an instance of the SleepScheduler class.
+*/
+SleepScheduler::SleepScheduler() {
+  this->passStarted = 0;
+  this->sleepDuration = SLEEP_FOREVER;
+  this->resetDutyCycle();
+}
+
+/*
+  Starts collecting the deadlines of a loop pass.
+  currentMillis: the millis() of the loop pass, all deadlines are relative to this moment.
+*/
+void SleepScheduler::startPass( unsigned long currentMillis ) {
+  this->passStarted = currentMillis;
+  this->sleepDuration = SLEEP_FOREVER;
+}
+
+/*
+  Registers a deadline: the node must be awake at the given millis(). Deadlines in the past mean the node must
+  stay awake.
+*/
+void SleepScheduler::wakeUpAt( unsigned long deadlineMillis ) {
+  long remaining = (long)( deadlineMillis - this->passStarted ); // works across the overflow of millis()
+  if ( remaining <= 0 ) {
+    this->sleepDuration = 0;
+  }
+  else if ( (unsigned long)remaining < this->sleepDuration ) {
+    this->sleepDuration = remaining;
+  }
+}
+
+/*
+  Registers that the node can't power down in this pass, e.g. because an animation is running and needs the clocks.
+*/
+void SleepScheduler::preventPowerDown() {
+  this->sleepDuration = 0;
+}
+
+/*
+  Returns the amount of ms the node can power down, which is the time until the nearest deadline of this pass.
+  Zero means the node can't power down and SLEEP_FOREVER that there's no deadline.
+*/
+unsigned long SleepScheduler::getSleepDuration() {
+  return this->sleepDuration;
+}
+
+/*
+  Adds the given amount of microseconds to the time the node was awake.
+*/
+void SleepScheduler::addAwakeTime( unsigned long awakeMicros ) {
+  this->awakeMicros += awakeMicros;
+}
+
+/*
+  Adds the given amount of microseconds to the time the node slept.
+*/
+void SleepScheduler::addSleepTime( unsigned long sleepMicros ) {
+  this->sleepMicros += sleepMicros;
+}
+
+/*
+  Returns the duty cycle since the last reset in per mille (0-1000): the part of the time the node was awake.
+*/
+uint16_t SleepScheduler::getDutyCycle() {
+  // Scale down first, so the multiplication can't overflow
+  unsigned long total = ( this->awakeMicros + this->sleepMicros ) >> 10;
+  if ( total == 0 ) {
+    return 1000;
+  }
+  return (uint16_t)( ( ( this->awakeMicros >> 10 ) * 1000 ) / total );
+}
+
+/*
+  Resets the duty cycle measurement.
+*/
+void SleepScheduler::resetDutyCycle() {
+  this->awakeMicros = 0;
+  this->sleepMicros = 0;
+}
@@ -0,0 +1,50 @@
+#ifndef SLEEP_SCHEDULER_H
+#define SLEEP_SCHEDULER_H
+
+#include "hal.h"
+
+/*
+  Library for determining how long the node can sleep until the next event and for keeping track of the
+  achieved duty cycle (the part of the time the node is awake).
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  Each loop pass the sketch registers the deadlines of everything that has to happen at a certain time (like the
+  heartbeat) and tells the scheduler when it can't power down at all (like when an animation is running or
+  the switch is being pressed). After that getSleepDuration() returns how long the node can sleep. Events that wake
+  up the node by themselves, like the switch and the encoder through a pin change interrupt, don't need a deadline.
+
+  The sketch measures how long it was awake and how long it slept, and reports the duty cycle with the heartbeat.
+  The times are kept in microseconds, which fits about 70 minutes. So the duty cycle must be reset at least once
+  per hour, the sketch does it after reporting it.
+
+  Revision history:
+    16-10-2026 Initial version.
+*/
+
+// Sleep duration returned when there's no deadline at all
+const unsigned long SLEEP_FOREVER = 0xFFFFFFFF;
+
+class SleepScheduler {
+  public:
+    SleepScheduler();
+
+    void startPass( unsigned long currentMillis );
+    void wakeUpAt( unsigned long deadlineMillis );
+    void preventPowerDown();
+    unsigned long getSleepDuration();
+
+    void addAwakeTime( unsigned long awakeMicros );
+    void addSleepTime( unsigned long sleepMicros );
+    uint16_t getDutyCycle();
+    void resetDutyCycle();
+  private:
+    unsigned long passStarted;   // millis() at the start of the current loop pass
+    unsigned long sleepDuration; // ms until the nearest deadline of the current pass
+
+    unsigned long awakeMicros;   // total time awake since the last reset
+    unsigned long sleepMicros;   // total time asleep since the last reset
+};
+
+#endif
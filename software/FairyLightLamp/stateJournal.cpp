@@ -0,0 +1,126 @@
+#include <string.h>
+#include "stateJournal.h"
+#include "crc8.h"
+
+// The sequence number of an erased slot, never used for a record
+const uint16_t JOURNAL_ERASED_SEQUENCE = 0xFFFF;
+
+/*
+  Creates an instance of the StateJournal class.
+  address     : the EEPROM address of the journal area.
+  size        : the size of the journal area in bytes, it holds size / JOURNAL_RECORD_SIZE records.
+  settleMillis: the time the state must be unchanged before it's written.
+*/
+StateJournal::StateJournal( uint16_t address, uint8_t size, uint16_t settleMillis ) {
+  this->address = address;
+  this->slotCount = size / JOURNAL_RECORD_SIZE;
+  this->settleMillis = settleMillis;
+  this->nextSlot = 0;
+  this->sequence = 0;
+  memset( this->payload, 0xFF, JOURNAL_PAYLOAD_SIZE );
+  this->changed = false;
+  this->changedAt = 0;
+  this->writeIndex = JOURNAL_RECORD_SIZE;
+}
+
+/*
+  Reads the record of the given slot into the given buffer of JOURNAL_RECORD_SIZE bytes.
+*/
+void StateJournal::readRecord( uint8_t slot, uint8_t *buffer ) {
+  uint16_t slotAddress = this->address + (uint16_t)slot * JOURNAL_RECORD_SIZE;
+  for ( uint8_t index = 0; index < JOURNAL_RECORD_SIZE; index++ ) {
+    buffer[ index ] = halEepromRead( slotAddress + index );
+  }
+}
+
+/*
+  Finds the newest valid record with a single scan of the journal and copies its state to the given payload (of
+  JOURNAL_PAYLOAD_SIZE bytes). Must be called once at boot, before store().
+  Returns false when the journal has no valid record (a new node), the payload is left untouched in that case.
+*/
+bool StateJournal::restore( uint8_t *payload ) {
+  uint8_t buffer[ JOURNAL_RECORD_SIZE ];
+  bool    found = false;
+
+  for ( uint8_t slot = 0; slot < this->slotCount; slot++ ) {
+    this->readRecord( slot, buffer );
+    uint16_t recordSequence = buffer[ 0 ] | ( buffer[ 1 ] << 8 );
+    if ( recordSequence == JOURNAL_ERASED_SEQUENCE || crc8( buffer, JOURNAL_RECORD_SIZE - 1 ) != buffer[ JOURNAL_RECORD_SIZE - 1 ] ) {
+      continue;
+    }
+    if ( !found || (int16_t)( recordSequence - this->sequence ) > 0 ) {
+      found = true;
+      this->sequence = recordSequence;
+      this->nextSlot = slot + 1 == this->slotCount ? 0 : slot + 1;
+      memcpy( this->payload, buffer + 2, JOURNAL_PAYLOAD_SIZE );
+    }
+  }
+
+  if ( found ) {
+    memcpy( payload, this->payload, JOURNAL_PAYLOAD_SIZE );
+  }
+  return found;
+}
+
+/*
+  Remembers the given state (JOURNAL_PAYLOAD_SIZE bytes), it's written by update() once it hasn't changed for the
+  settle time. A state equal to the last stored state is ignored.
+*/
+void StateJournal::store( const uint8_t *payload, unsigned long currentMillis ) {
+  if ( memcmp( this->payload, payload, JOURNAL_PAYLOAD_SIZE ) != 0 ) {
+    memcpy( this->payload, payload, JOURNAL_PAYLOAD_SIZE );
+    this->changed = true;
+    this->changedAt = currentMillis;
+  }
+}
+
+/*
+  Writes the next byte of the record that is being written, when the EEPROM is ready for it. Otherwise starts a new
+  record when the stored state has settled. Must be called from the main loop for each cycle.
+*/
+void StateJournal::update( unsigned long currentMillis ) {
+  if ( this->writeIndex < JOURNAL_RECORD_SIZE ) {
+    if ( halEepromReady() ) {
+      uint16_t slotAddress = this->address + (uint16_t)this->nextSlot * JOURNAL_RECORD_SIZE;
+      halEepromUpdate( slotAddress + this->writeIndex, this->record[ this->writeIndex ] );
+      if ( ++this->writeIndex == JOURNAL_RECORD_SIZE ) {
+        this->nextSlot = this->nextSlot + 1 == this->slotCount ? 0 : this->nextSlot + 1;
+      }
+    }
+    return;
+  }
+
+  if ( this->changed && currentMillis - this->changedAt >= this->settleMillis ) {
+    this->changed = false;
+    this->sequence++;
+    if ( this->sequence == JOURNAL_ERASED_SEQUENCE ) {
+      this->sequence = 0;
+    }
+    this->record[ 0 ] = this->sequence & 0xFF;
+    this->record[ 1 ] = this->sequence >> 8;
+    memcpy( this->record + 2, this->payload, JOURNAL_PAYLOAD_SIZE );
+    this->record[ JOURNAL_RECORD_SIZE - 1 ] = crc8( this->record, JOURNAL_RECORD_SIZE - 1 );
+    this->writeIndex = 0;
+  }
+}
+
+/*
+  Determines wether the last stored state has been written (true) or if it's waiting or being written (false).
+*/
+bool StateJournal::isIdle() {
+  return !this->changed && this->writeIndex == JOURNAL_RECORD_SIZE;
+}
+
+/*
+  Returns the amount of records the journal holds.
+*/
+uint8_t StateJournal::getSlotCount() {
+  return this->slotCount;
+}
+
+/*
+  Returns the sequence number of the newest record, 0 when there's none.
+*/
+uint16_t StateJournal::getSequence() {
+  return this->sequence;
+}
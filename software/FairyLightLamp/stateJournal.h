@@ -0,0 +1,74 @@
+#ifndef STATE_JOURNAL_H
+#define STATE_JOURNAL_H
+
+#include "hal.h"
+
+/*
+  Library for persisting the state of the lamp in the EEPROM, without wearing out a single byte and without blocking
+  the main loop.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  The sketch used saveState() to write the stored brightness to the same EEPROM byte on every long press. An EEPROM
+  byte survives about 100.000 writes, and each write blocks the loop for about 3.3ms. To resume exactly where the lamp
+  was after a power out we also want to store the power state and the brightness while they change, which would wear
+  out that byte within a couple of years.
+
+  The journal is a ring of records in its EEPROM area. A record is the sequence number (16 bit), the state (the
+  payload of JOURNAL_PAYLOAD_SIZE bytes, its meaning is up to the sketch) and a CRC-8 over both:
+
+    | sequence low | sequence high | payload ... | crc |
+
+  Each new state is written to the slot after the newest record, so the writes are spread over all slots. A record
+  that was only partly written when the power went out fails its CRC, in that case the previous record is still
+  intact. At boot restore() reads all slots once and takes the valid record with the highest sequence number (compared
+  with a wrap around, the records in the ring are always less than 32768 apart).
+
+  store() only remembers the new state. update() writes it once the state hasn't changed for the settle time, so a
+  spin of the encoder ends up as a single record. The record is then written one byte per call, and only when the
+  EEPROM is done with the previous byte, so the loop never waits for the EEPROM. Unchanged bytes aren't written at all.
+
+  Revision history:
+    16-10-2026 Initial version.
+    16-10-2026 The CRC moved to crc8.h.
+*/
+
+const uint8_t JOURNAL_PAYLOAD_SIZE = 8;                         // The bytes of state in a record
+const uint8_t JOURNAL_RECORD_SIZE = JOURNAL_PAYLOAD_SIZE + 3;   // The sequence number, the payload and the crc
+
+// The EEPROM area of the journal, between the parameter block (EEPROM_PARAMETERS_ADDRESS, after the local config of
+// MySensors) and the uploaded animation script (EEPROM_SCRIPT_ADDRESS). It holds 17 records.
+const uint16_t EEPROM_JOURNAL_ADDRESS = 704;
+const uint8_t  EEPROM_JOURNAL_SIZE = 192;
+
+/*
+  Definition of the class, the method documentation can be found in the stateJournal.cpp file.
+*/
+class StateJournal {
+  public:
+    StateJournal( uint16_t address, uint8_t size, uint16_t settleMillis );
+
+    bool restore( uint8_t *payload );
+    void store( const uint8_t *payload, unsigned long currentMillis );
+    void update( unsigned long currentMillis );
+    bool isIdle();
+
+    uint8_t  getSlotCount();
+    uint16_t getSequence();
+  private:
+    uint16_t      address;       // The EEPROM address of the first slot
+    uint8_t       slotCount;     // The amount of records in the ring
+    uint16_t      settleMillis;  // The time the state must be unchanged before it's written
+    uint8_t       nextSlot;      // The slot the next record is written to
+    uint16_t      sequence;      // The sequence number of the newest record (written or being written)
+    uint8_t       payload[ JOURNAL_PAYLOAD_SIZE ];  // The latest state given to store()
+    bool          changed;       // true when payload hasn't been written yet
+    unsigned long changedAt;     // millis() of the last change of payload
+    uint8_t       record[ JOURNAL_RECORD_SIZE ];    // The record that is being written
+    uint8_t       writeIndex;    // The next byte of record to write, JOURNAL_RECORD_SIZE when the record is written
+
+    void readRecord( uint8_t slot, uint8_t *buffer );
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef XORSHIFT16_H
+#define XORSHIFT16_H
+
+#include <stdint.h>
+
+/*
+  The 16 bit xorshift pseudo random generator (shifts 7, 9, 8) of the ambient effects (ambientEffect.h), the random
+  backoff (randomBackoff.h) and the RAND instruction of the animation scripts (animationScript.h). Not random enough for
+  anything but timing and effects, but small and fast: three shifts and xors, no multiplication or division. It
+  returns each value but 0 once per 65535 numbers.
+
+  Author: By Theo
+  Created: October 17th 2026
+
+  Revision history:
+    17-10-2026 Moved from ambientEffect.cpp, randomBackoff.cpp and animationScript.cpp, which each had a copy.
+*/
+
+// const for the generator: its state after construction, or after a seed of 0 (a state of 0 only returns zeros).
+const uint16_t XORSHIFT16_DEFAULT_SEED = 0xACE1;
+
+/*
+  The state of a single generator, 2 bytes.
+*/
+struct Xorshift16 {
+  uint16_t state; // Never 0
+
+  Xorshift16();
+
+  void     seed( uint16_t seed );
+  uint16_t next();
+};
+
+/*
+  Creates a generator with the default seed.
+*/
+inline Xorshift16::Xorshift16() {
+  this->state = XORSHIFT16_DEFAULT_SEED;
+}
+
+/*
+  Seeds the generator. A seed of 0 is replaced by the default seed, the generator would only return zeros.
+*/
+inline void Xorshift16::seed( uint16_t seed ) {
+  this->state = seed == 0 ? XORSHIFT16_DEFAULT_SEED : seed;
+}
+
+/*
+  Returns the next pseudo random number, never 0.
+*/
+inline uint16_t Xorshift16::next() {
+  this->state ^= this->state << 7;
+  this->state ^= this->state >> 9;
+  this->state ^= this->state << 8;
+  return this->state;
+}
+
+#endif
@@ -0,0 +1,193 @@
+/*
+  Test of the constant work of a tick of the ambient effects (see FairyLightLamp/ambientEffect.h).
+
+  Author: By Theo
+  Created: October 17th 2026
+
+  The benchmark times the ticks on the host, which says little about the AVR: the host has its own noise, and a
+  division or a loop that runs a few times more for some states hides in it. A tick of the AVR has a fixed cost when
+  it has no loops and no divisions (the AVR has no divide instruction, a division is a loop in libgcc), so that's what
+  is checked, deterministically:
+  - the source of the functions that run in a tick (given as the arguments) has no loop statement and no division or
+    modulo.
+  - a late call advances a single tick, it doesn't catch up: each effect gives the same gains when checkEffect() is
+    called every AMBIENT_TICK ms as when it's called up to a second late.
+
+  Returns 0 when all checks pass, so it can be run by ctest.
+
+    ./build/fairylight_ambient_ticks software/FairyLightLamp/ambientEffect.cpp software/FairyLightLamp/xorshift16.h
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include "ambientEffect.h"
+
+// The functions that run in a tick, each one must be defined in one of the source files
+const char *tickFunctions[] = {
+  "AmbientEffect::isRunning(",
+  "AmbientEffect::checkEffect(",
+  "Xorshift16::next(",
+  "AmbientEffect::tickCandle(",
+  "AmbientEffect::tickTwinkle(",
+  "AmbientEffect::tickBreathe(",
+  "AmbientEffect::apply(",
+};
+const uint8_t tickFunctionCount = sizeof( tickFunctions ) / sizeof( tickFunctions[ 0 ] );
+
+const char     *loopKeywords[] = { "for", "while", "do", "goto" };
+const uint16_t TICK_REPLAY_TICKS = 5000;
+
+/*
+  Returns the given source without its comments, so a slash or a keyword in a comment doesn't count.
+*/
+std::string stripComments( const std::string &source ) {
+  std::string code;
+  for ( size_t index = 0; index < source.size(); index++ ) {
+    if ( source.compare( index, 2, "//" ) == 0 ) {
+      index = source.find( '\n', index );
+      if ( index == std::string::npos ) {
+        break;
+      }
+      code += '\n';
+    }
+    else if ( source.compare( index, 2, "/*" ) == 0 ) {
+      index = source.find( "*/", index + 2 );
+      if ( index == std::string::npos ) {
+        break;
+      }
+      index++;
+      code += ' ';
+    }
+    else {
+      code += source[ index ];
+    }
+  }
+  return code;
+}
+
+/*
+  Returns the body of the definition of the given function in the given code, empty when it isn't defined there. A
+  qualified name followed by its body is a definition, calls within the class aren't qualified.
+*/
+std::string functionBody( const std::string &code, const char *function ) {
+  for ( size_t start = code.find( function ); start != std::string::npos; start = code.find( function, start + 1 ) ) {
+    size_t open = code.find_first_of( "{;", start );
+    if ( open == std::string::npos || code[ open ] == ';' ) {
+      continue; // A declaration
+    }
+    int depth = 0;
+    for ( size_t index = open; index < code.size(); index++ ) {
+      depth += code[ index ] == '{' ? 1 : code[ index ] == '}' ? -1 : 0;
+      if ( depth == 0 ) {
+        return code.substr( open, index - open + 1 );
+      }
+    }
+  }
+  return "";
+}
+
+/*
+  Prints the loop statements, divisions and modulos in the given body and returns their amount.
+*/
+uint8_t countVariableWork( const std::string &body, const char *function ) {
+  uint8_t found = 0;
+  for ( size_t index = 0; index < body.size(); index++ ) {
+    char character = body[ index ];
+    if ( character == '/' || character == '%' ) {
+      printf( "  %-34s a %s\n", function, character == '/' ? "division" : "modulo" );
+      found++;
+    }
+    if ( !isalpha( character ) || ( index > 0 && ( isalnum( body[ index - 1 ] ) || body[ index - 1 ] == '_' ) ) ) {
+      continue;
+    }
+    for ( const char *keyword : loopKeywords ) {
+      size_t length = strlen( keyword );
+      if ( body.compare( index, length, keyword ) == 0 && !isalnum( body[ index + length ] ) && body[ index + length ] != '_' ) {
+        printf( "  %-34s a %s statement\n", function, keyword );
+        found++;
+      }
+    }
+  }
+  return found;
+}
+
+/*
+  Checks the functions of a tick in the given source files. Returns the amount of failures.
+*/
+uint8_t checkSources( int fileCount, char **files ) {
+  std::string code;
+  for ( int file = 0; file < fileCount; file++ ) {
+    FILE *source = fopen( files[ file ], "r" );
+    if ( source == NULL ) {
+      printf( "  %-34s can't be read\n", files[ file ] );
+      return 1;
+    }
+    char buffer[ 4096 ];
+    for ( size_t length; ( length = fread( buffer, 1, sizeof( buffer ), source ) ) > 0; ) {
+      code.append( buffer, length );
+    }
+    fclose( source );
+  }
+  code = stripComments( code );
+
+  uint8_t failures = 0;
+  for ( uint8_t index = 0; index < tickFunctionCount; index++ ) {
+    std::string body = functionBody( code, tickFunctions[ index ] );
+    bool passed = !body.empty() && countVariableWork( body, tickFunctions[ index ] ) == 0;
+    failures += passed ? 0 : 1;
+    printf( "  %-34s %s\n", tickFunctions[ index ], body.empty() ? "not found, FAILED" : passed ? "ok" : "FAILED" );
+  }
+  return failures;
+}
+
+/*
+  Runs the given effect with a call every AMBIENT_TICK ms and with calls that are up to a second late, and checks
+  that both give the same gain after each tick. Halfway the effect is turned off, so the glide back to the full gain
+  is checked as well. Returns true when they're the same.
+*/
+bool checkLateTicks( uint8_t effectId ) {
+  AmbientEffect onTime;
+  AmbientEffect late;
+  onTime.seed( 0x5EED );
+  late.seed( 0x5EED );
+  onTime.setEffect( effectId );
+  late.setEffect( effectId );
+
+  unsigned long onTimeMillis = 0;
+  unsigned long lateMillis = 0;
+  uint16_t      lateness = 1;
+  for ( uint16_t tick = 0; tick < TICK_REPLAY_TICKS; tick++ ) {
+    if ( tick == TICK_REPLAY_TICKS / 2 ) {
+      onTime.setEffect( AMBIENT_STEADY );
+      late.setEffect( AMBIENT_STEADY );
+    }
+    onTimeMillis += AMBIENT_TICK;
+    lateness = ( lateness * 7 + 3 ) & 0x3F; // 0 - 63 ticks late, in an order that doesn't repeat quickly
+    lateMillis += AMBIENT_TICK * ( 1 + lateness );
+    onTime.checkEffect( onTimeMillis );
+    late.checkEffect( lateMillis );
+    if ( onTime.apply( 0xFFFF ) != late.apply( 0xFFFF ) ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main( int argc, char **argv ) {
+  const char *names[ AMBIENT_EFFECT_COUNT ] = { "steady", "candle", "twinkle", "breathe" };
+  uint8_t failures = 0;
+
+  printf( "No loops and no divisions in a tick\n" );
+  failures += checkSources( argc - 1, argv + 1 );
+
+  printf( "A late call advances a single tick\n" );
+  for ( uint8_t effectId = AMBIENT_STEADY; effectId < AMBIENT_EFFECT_COUNT; effectId++ ) {
+    bool passed = checkLateTicks( effectId );
+    failures += passed ? 0 : 1;
+    printf( "  %-34s %s\n", names[ effectId ], passed ? "ok" : "FAILED" );
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+/*
+  Model of the battery monitor (see FairyLightLamp/batteryMonitor.h): the accuracy of the reading and the energy of a
+  sample.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  The first table runs batteryReadMillivolts() on the host over the voltage range of 3 AA cells and shows the error of
+  the 10 bit reading of the bandgap, the battery level that is sent and the brightness cap, with the settings of
+  config.h. The reading is exact on the host, the spread of the bandgap of a real chip (1.0 - 1.2V) comes on top, which
+  is why it has to be calibrated.
+
+  The second table is a power model of a sample. The time of each phase follows from the constants of the monitor
+  (the settle time, the amount of conversions and the ADC clock), the currents are typical values of the datasheets of
+  the ATmega328P at 8MHz and 3.6V and of the NRF24L01+, not measurements. It compares the conversions in the ADC noise
+  reduction sleep with polling them, adds the message of the battery level, and compares a day of samples (one per heart
+  beat) with leaving the ADC powered all the time, which is what sampling with analogRead() after before() would take.
+*/
+
+#include <stdio.h>
+
+#include "batteryMonitor.h"
+
+// The settings of config.h
+const uint16_t      MODEL_BANDGAP_MILLIVOLTS = 1100;
+const uint16_t      MODEL_EMPTY_MILLIVOLTS = 3000;
+const uint16_t      MODEL_FULL_MILLIVOLTS = 4500;
+const uint16_t      MODEL_CAP_FROM_MILLIVOLTS = 3900;
+const uint8_t       MODEL_MINIMUM_CAP = 128;
+const unsigned long MODEL_HEART_BEAT_INTERVAL = 1800000; // ms
+
+// Typical currents in mA (assumptions, see above)
+const double MODEL_ACTIVE_MA = 4.0;       // CPU active at 8MHz
+const double MODEL_ADC_SLEEP_MA = 1.0;    // ADC noise reduction sleep, without the ADC
+const double MODEL_ADC_MA = 0.3;          // The ADC while it's powered
+const double MODEL_RADIO_SEND_MA = 12.0;  // The radio while it sends a message and waits for the ack
+const double MODEL_RADIO_SEND_MICROS = 1000;
+const double MODEL_BATTERY_MAH = 2500;    // 3 AA alkaline cells in series
+
+/*
+  Prints the reading, the level and the cap from the empty up to the full voltage.
+*/
+void reportReadings() {
+  printf( "Battery readings (bandgap %u mV, empty %u mV, full %u mV, cap from %u mV)\n", MODEL_BANDGAP_MILLIVOLTS,
+          MODEL_EMPTY_MILLIVOLTS, MODEL_FULL_MILLIVOLTS, MODEL_CAP_FROM_MILLIVOLTS );
+  printf( "  %8s %8s %6s %6s %5s\n", "VCC mV", "read mV", "error", "level", "cap" );
+  for ( uint16_t millivolts = 2700; millivolts <= 4800; millivolts += 150 ) {
+    hostSetVcc( millivolts );
+    uint16_t read = batteryReadMillivolts( MODEL_BANDGAP_MILLIVOLTS, true );
+    printf( "  %8u %8u %+6d %5u%% %5u\n", millivolts, read, (int)read - millivolts,
+            batteryPercentage( read, MODEL_EMPTY_MILLIVOLTS, MODEL_FULL_MILLIVOLTS ),
+            batteryBrightnessCap( read, MODEL_CAP_FROM_MILLIVOLTS, MODEL_EMPTY_MILLIVOLTS, MODEL_MINIMUM_CAP ) );
+  }
+}
+
+/*
+  Prints a phase of a sample and returns its charge in uC.
+*/
+double reportPhase( const char *name, double micros, double milliamps ) {
+  double charge = micros * milliamps / 1000;
+  printf( "  %-34s %7.0f us %6.2f mA %7.2f uC\n", name, micros, milliamps, charge );
+  return charge;
+}
+
+/*
+  Prints the charge of a sample, per phase, and of a day of samples.
+*/
+void reportEnergy() {
+  double conversionMicros = ( BATTERY_FIRST_CONVERSION_CLOCKS + BATTERY_CONVERSIONS * BATTERY_CONVERSION_CLOCKS ) * 1e6 / BATTERY_ADC_CLOCK;
+  double samplesPerDay = 86400000.0 / MODEL_HEART_BEAT_INTERVAL;
+
+  printf( "\nCharge of a sample (%u + %u conversions at %lu kHz)\n", 1, BATTERY_CONVERSIONS,
+          (unsigned long)( BATTERY_ADC_CLOCK / 1000 ) );
+  double settle = reportPhase( "settle, CPU active", BATTERY_SETTLE_MICROS, MODEL_ACTIVE_MA + MODEL_ADC_MA );
+  double sleeping = reportPhase( "conversions, noise reduction sleep", conversionMicros, MODEL_ADC_SLEEP_MA + MODEL_ADC_MA );
+  double polling = reportPhase( "conversions, polled", conversionMicros, MODEL_ACTIVE_MA + MODEL_ADC_MA );
+  double radio = reportPhase( "battery level message", MODEL_RADIO_SEND_MICROS, MODEL_RADIO_SEND_MA );
+
+  double sample = settle + sleeping + radio;
+  double polledSample = settle + polling + radio;
+  double alwaysOn = MODEL_ADC_MA * 86400 * 1000; // uC per day
+  double battery = MODEL_BATTERY_MAH * 3600 * 1000; // uC
+  printf( "\n  %-34s %10s %13s  %s\n", "", "per sample", "per day", "battery per year" );
+  printf( "  %-34s %7.2f uC %10.1f uC %11.4f%%\n", "noise reduction sleep (lamp off)", sample, sample * samplesPerDay,
+          100 * sample * samplesPerDay * 365 / battery );
+  printf( "  %-34s %7.2f uC %10.1f uC %11.4f%%\n", "polled (lamp on)", polledSample, polledSample * samplesPerDay,
+          100 * polledSample * samplesPerDay * 365 / battery );
+  printf( "  %-34s %10s %10.1f uC %11.4f%%\n", "ADC powered all the time", "", alwaysOn, 100 * alwaysOn * 365 / battery );
+}
+
+int main() {
+  reportReadings();
+  reportEnergy();
+  return 0;
+}
@@ -0,0 +1,822 @@
+/*
+  Benchmark for the hot paths of the FairyLightLamp libraries.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  Reports the time per AnimationManager::checkAnimation(), SoftDebouncedMultiClick::checkSwitch() and
+  MultiClickBank::checkSwitches() call, measured on the host against the simulated hardware (see hostHal.h), and the amount of PWM
+  writes needed for the different animations. The absolute numbers say nothing about the timing on an
+  ATmega328P, but they do show when a change makes a hot path slower or causes more PWM writes. It also
+  checks that a double click is recognized when the loop is blocked during the clicks, that a script
+  uploaded in chunks runs from the EEPROM, and how many messages the outbox sends for a quick spin of the encoder.
+  It compares the dispatch of a click event through a handler pointer with the direct call of a StaticMultiClick.
+  It times each tick of the ambient effects and shows that an effect continues after a boundary reached blink.
+  It reports the cost of a frame of the layer compositor per amount of layers, and shows that a fade continues under a
+  boundary reached blink.
+  Finally it reports the cost of the loop profiler per loop pass, and its statistics for a simulated loop, and the
+  resolution and the interrupt cost of the dithered PWM.
+
+  The virtual clock is advanced 1ms between calls. The time it takes to advance the clock is measured
+  separately and subtracted from the results.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "ambientEffect.h"
+#include "animationManager.h"
+#include "ditheredPwm.h"
+#include "frameTimer.h"
+#include "layerCompositor.h"
+#include "loopProfiler.h"
+#include "messageQueue.h"
+#include "multiClick.h"
+#include "multiClickBank.h"
+#include "legacyFade.h"
+
+const uint8_t  BENCH_PWM_PIN = 5;
+const uint8_t  BENCH_SWITCH_PIN = 7;
+const uint8_t  BENCH_STATIC_SWITCH_PIN = 17;
+const uint8_t  BENCH_LEGACY_PWM_PIN = 6;
+const uint8_t  BENCH_PWM_PINS[ 1 ] = { BENCH_PWM_PIN };
+const uint8_t  BENCH_CHANNEL_PWM_PINS[ 3 ] = { 5, 6, 3 };
+const uint8_t  BENCH_BANK_PINS[ 8 ] = { 2, 4, 8, 12, 13, 14, 15, 16 }; // Spread over the 3 ports
+const uint8_t  BENCH_BANK_SWITCH = 5;
+const unsigned long BENCH_ITERATIONS = 2000000;
+const unsigned long BENCH_DITHER_TICKS_PER_SECOND = 980; // The Timer2 overflows per second on a 16MHz board
+const unsigned long BENCH_EFFECT_TICKS = 500000;
+
+/*
+  Calls the given function the given amount of times with a virtual clock that advances 1ms per call
+  and returns the average duration of a call in ns.
+*/
+template<typename Function> double measureNsPerCall( unsigned long iterations, Function function ) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for ( unsigned long cnt = 0; cnt < iterations; cnt++ ) {
+    hostAdvanceMillis( 1 );
+    function( halMillis() );
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>( end - start ).count() / iterations;
+}
+
+/*
+  Runs the animations until they're finished and returns the amount of ms it took.
+*/
+template<uint8_t channelCount> unsigned long runUntilFinished( AnimationManager<channelCount> &animations ) {
+  unsigned long started = halMillis();
+  while ( !animations.animationFinished() ) {
+    hostAdvanceMillis( 1 );
+    animations.checkAnimation( halMillis() );
+  }
+  return halMillis() - started;
+}
+
+/*
+  Prints the PWM writes and duration of a single fade from the current level to the given level.
+*/
+void reportFade( AnimationManager<1> &animations, const char *name, uint8_t targetLevel ) {
+  hostResetPwmWriteCounts();
+  animations.fadeToBrightnessLevel( 0, targetLevel );
+  unsigned long duration = runUntilFinished( animations );
+  printf( "  %-34s %6lu writes %6lu ms\n", name, hostPwmWriteCount( BENCH_PWM_PIN ), duration );
+}
+
+/*
+  Fades both the fixed point and the floating point reference implementation from the given start level
+  to the given target level, optionally retargeting after the given amount of steps, and compares the
+  brightness levels. Returns the largest difference. The amount of steps taken by each implementation
+  is returned in fixedPointSteps and referenceSteps.
+*/
+uint8_t compareFade( uint8_t startLevel, uint8_t targetLevel, uint8_t retargetStep, uint8_t retargetLevel,
+                     uint8_t &fixedPointSteps, uint8_t &referenceSteps ) {
+  SmoothBrightnessTransistion fixedPoint;
+  LegacySmoothBrightnessTransistion reference( BENCH_LEGACY_PWM_PIN );
+
+  // Get both to the start level
+  fixedPoint.setLevel( startLevel );
+  reference.setLevel( startLevel );
+  while ( !fixedPoint.isAnimationFinished() || !reference.isAnimationFinished() ) {
+    hostAdvanceMillis( 50 );
+    fixedPoint.checkAnimation( halMillis() );
+    reference.checkAnimation( halMillis() );
+  }
+
+  uint8_t largestDifference = 0;
+  fixedPointSteps = 0;
+  referenceSteps = 0;
+  fixedPoint.setLevel( targetLevel );
+  reference.setLevel( targetLevel );
+  for ( uint8_t step = 1; !fixedPoint.isAnimationFinished() || !reference.isAnimationFinished(); step++ ) {
+    fixedPointSteps += fixedPoint.isAnimationFinished() ? 0 : 1;
+    referenceSteps += reference.isAnimationFinished() ? 0 : 1;
+
+    hostAdvanceMillis( 50 );
+    fixedPoint.checkAnimation( halMillis() );
+    reference.checkAnimation( halMillis() );
+
+    uint8_t fixedPointValue = fixedPoint.getCurrentBrightnessLevel();
+    uint8_t referenceValue = reference.getCurrentBrightnessLevel();
+    uint8_t difference = fixedPointValue > referenceValue ? fixedPointValue - referenceValue : referenceValue - fixedPointValue;
+    if ( difference > largestDifference ) {
+      largestDifference = difference;
+    }
+    if ( step == retargetStep ) {
+      fixedPoint.setLevel( retargetLevel );
+      reference.setLevel( retargetLevel );
+    }
+  }
+  return largestDifference;
+}
+
+/*
+  Prints the comparison of the fixed point fade with the floating point reference implementation.
+  The float fade sometimes needs an extra step, because e.g. 10 * 0.3 adds up to 2.9999, which is
+  truncated to 2. Those are counted as "longer float fades".
+
+  The reference is a linear ramp, so the levels are only compared when the easing curve is linear.
+  Build with -DCMAKE_CXX_FLAGS=-DLED_EASING_CURVE=0 for that.
+*/
+void reportFixedPointComparison() {
+#if LED_EASING_CURVE == LED_EASING_LINEAR
+  uint8_t largestDifference = 0;
+  unsigned long fades = 0, longerFixedPointFades = 0, longerReferenceFades = 0;
+  uint8_t fixedPointSteps, referenceSteps;
+
+  for ( unsigned int startLevel = 0; startLevel <= 255; startLevel += 5 ) {
+    for ( unsigned int targetLevel = 0; targetLevel <= 255; targetLevel += 3 ) {
+      for ( uint8_t retargetStep = 0; retargetStep < animationSteps; retargetStep += 3 ) {
+        uint8_t difference = compareFade( startLevel, targetLevel, retargetStep, 255 - targetLevel, fixedPointSteps, referenceSteps );
+        if ( difference > largestDifference ) {
+          largestDifference = difference;
+        }
+        longerFixedPointFades += fixedPointSteps > referenceSteps ? 1 : 0;
+        longerReferenceFades += referenceSteps > fixedPointSteps ? 1 : 0;
+        fades++;
+      }
+    }
+  }
+  printf( "  %-34s %lu fades, largest level difference %u\n", "fixed point vs float", fades, largestDifference );
+  printf( "  %-34s %lu longer fixed point fades, %lu longer float fades\n", "", longerFixedPointFades, longerReferenceFades );
+#else
+  printf( "  %-34s skipped, the easing curve isn't linear\n", "fixed point vs float" );
+#endif
+
+  SmoothBrightnessTransistion fixedPoint;
+  LegacySmoothBrightnessTransistion reference( BENCH_LEGACY_PWM_PIN );
+  uint8_t fixedPointTarget = 0, referenceTarget = 0;
+
+  // Each call is a step, so these numbers are the cost of a step including the PWM write.
+  double fixedPointStep = measureNsPerCall( BENCH_ITERATIONS, [&]( unsigned long currentMillis ) {
+    if ( fixedPoint.isAnimationFinished() ) {
+      fixedPointTarget = fixedPointTarget == 0 ? 255 : 0;
+      fixedPoint.setLevel( fixedPointTarget );
+    }
+    fixedPoint.checkAnimation( currentMillis + 50 );
+  } );
+  double referenceStep = measureNsPerCall( BENCH_ITERATIONS, [&]( unsigned long currentMillis ) {
+    if ( reference.isAnimationFinished() ) {
+      referenceTarget = referenceTarget == 0 ? 255 : 0;
+      reference.setLevel( referenceTarget );
+    }
+    reference.checkAnimation( currentMillis + 50 );
+  } );
+  printf( "  %-34s %8.1f ns\n", "fade step fixed point", fixedPointStep );
+  printf( "  %-34s %8.1f ns\n", "fade step float (reference)", referenceStep );
+}
+
+/*
+  Prints the lightness and PWM value of each brightness level of the lamp and the easing curve of a fade.
+*/
+void reportCurves() {
+  typedef LedCurveTable< LedBrightnessLevelCurve<15, 10> > BrightnessLevels;
+
+  printf( "  %-34s", "level lightness/PWM" );
+  for ( uint8_t level = 1; level <= 15; level++ ) {
+    printf( " %u/%u", BrightnessLevels::read( level ), ledLightnessToPwm( BrightnessLevels::read( level ) ) );
+  }
+  printf( "\n  %-34s", "fade progress per step" );
+  for ( uint8_t step = 0; step <= animationSteps; step++ ) {
+    printf( " %u", LedCurveTable< LedEasingCurve<animationSteps> >::read( step ) );
+  }
+  printf( "\n" );
+}
+
+unsigned long clickEvents = 0;
+uint8_t       lastClickAmount = 0;
+
+void onSwitchClicked( KEY_SCAN_STATES type, uint8_t amount, SoftDebouncedMultiClick &source ) {
+  (void)type;
+  (void)source;
+  clickEvents++;
+  lastClickAmount = amount;
+}
+
+/*
+  The handler as it was before the switch was passed by reference, for the comparison of the event dispatch.
+*/
+void onSwitchClickedCopy( KEY_SCAN_STATES type, uint8_t amount, SoftDebouncedMultiClick source ) {
+  (void)type;
+  (void)source;
+  clickEvents++;
+  lastClickAmount = amount;
+}
+
+/*
+  The handlers of a StaticMultiClick, called directly by the switch.
+*/
+struct BenchSwitchHandler {
+  static void onKeyPress( KEY_SCAN_STATES type, uint8_t amount ) {
+    (void)type;
+    (void)amount;
+  }
+
+  static void onKeyClick( KEY_SCAN_STATES type, uint8_t amount ) {
+    (void)type;
+    clickEvents++;
+    lastClickAmount = amount;
+  }
+};
+
+/*
+  Sets the given pin for the given ms of a click of 80ms with 5ms of contact bounce on both edges, followed by a pause
+  of 500ms so that every click sequence ends with a click event.
+*/
+void setClickingPin( uint8_t pin, unsigned long phase ) {
+  unsigned long position = phase % 600;
+  if ( position < 5 ) {
+    hostSetPin( pin, position % 2 == 0 ? LOW : HIGH );
+  }
+  else if ( position < 80 ) {
+    hostSetPin( pin, LOW );
+  }
+  else if ( position < 85 ) {
+    hostSetPin( pin, position % 2 == 0 ? HIGH : LOW );
+  }
+  else {
+    hostSetPin( pin, HIGH );
+  }
+}
+
+/*
+  Presses the switch on the given pin for the given amount of ms, with 5ms of contact bounce on both edges, and releases it for
+  the given amount of ms, without calling the loop. Like a double click during a blocking radio transmission.
+*/
+void pressWhileBlocked( uint8_t pin, unsigned long pressedMillis, unsigned long releasedMillis ) {
+  for ( uint8_t bounce = 0; bounce < 5; bounce++ ) {
+    hostSetPin( pin, bounce % 2 == 0 ? LOW : HIGH );
+    hostAdvanceMillis( 1 );
+  }
+  hostSetPin( pin, LOW );
+  hostAdvanceMillis( pressedMillis - 5 );
+  for ( uint8_t bounce = 0; bounce < 5; bounce++ ) {
+    hostSetPin( pin, bounce % 2 == 0 ? HIGH : LOW );
+    hostAdvanceMillis( 1 );
+  }
+  hostSetPin( pin, HIGH );
+  hostAdvanceMillis( releasedMillis - 5 );
+}
+
+unsigned long bankEvents = 0;
+uint8_t       lastBankSwitch = 0;
+uint8_t       lastBankAmount = 0;
+
+void onBankSwitchClicked( KEY_SCAN_STATES type, uint8_t amount, uint8_t switchIndex ) {
+  (void)type;
+  bankEvents++;
+  lastBankSwitch = switchIndex;
+  lastBankAmount = amount;
+}
+
+/*
+  Double clicks while the loop is blocked and reports what the state machine makes of it once the loop runs again.
+*/
+template<typename Switch> void reportBlockedClicks( Switch &powerSwitch, uint8_t pin, const char *name ) {
+  // Finish the click sequences of the previous benchmarks
+  while ( !powerSwitch.isIdle( halMillis() ) ) {
+    hostAdvanceMillis( 1 );
+    powerSwitch.checkSwitch( halMillis() );
+  }
+
+  for ( uint8_t cnt = 0; cnt < 2; cnt++ ) {
+    pressWhileBlocked( pin, 70, 90 );
+  }
+  hostAdvanceMillis( 200 );
+
+  unsigned long eventsBefore = clickEvents;
+  for ( uint16_t cnt = 0; cnt < 1000; cnt++ ) {
+    hostAdvanceMillis( 1 );
+    powerSwitch.checkSwitch( halMillis() );
+  }
+  printf( "  %-34s %6lu event(s), %u click(s)\n", name, clickEvents - eventsBefore, lastClickAmount );
+}
+
+/*
+  Reports the cost of firing a click event to a handler: through a function pointer with a copy of the switch (as it
+  was), through a function pointer with a reference, and the direct call of a StaticMultiClick. The pointers are
+  volatile, so the compiler can't resolve them like it can't in checkSwitch(). Also reports the size of the objects
+  involved, on the host.
+*/
+void reportEventDispatch( SoftDebouncedMultiClick &powerSwitch, double overhead ) {
+  void ( * volatile copyHandler )( KEY_SCAN_STATES, uint8_t, SoftDebouncedMultiClick ) = onSwitchClickedCopy;
+  multiClickEventHandler volatile referenceHandler = onSwitchClicked;
+
+  double copying = measureNsPerCall( BENCH_ITERATIONS, [&]( unsigned long currentMillis ) {
+    copyHandler( KP_SHORT_PRESS_SEQUENCE, (uint8_t)currentMillis, powerSwitch );
+  } );
+  printf( "  %-34s %8.1f ns\n", "handler pointer, copy of switch", copying - overhead );
+  double referencing = measureNsPerCall( BENCH_ITERATIONS, [&]( unsigned long currentMillis ) {
+    referenceHandler( KP_SHORT_PRESS_SEQUENCE, (uint8_t)currentMillis, powerSwitch );
+  } );
+  printf( "  %-34s %8.1f ns\n", "handler pointer, reference", referencing - overhead );
+  double direct = measureNsPerCall( BENCH_ITERATIONS, [&]( unsigned long currentMillis ) {
+    BenchSwitchHandler::onKeyClick( KP_SHORT_PRESS_SEQUENCE, (uint8_t)currentMillis );
+  } );
+  printf( "  %-34s %8.1f ns\n", "StaticMultiClick handler", direct > overhead ? direct - overhead : 0.0 ); // Inlined into the loop
+
+  printf( "  %-34s %6zu bytes\n", "SoftDebouncedMultiClick", sizeof( SoftDebouncedMultiClick ) );
+  printf( "  %-34s %6zu bytes\n", "StaticMultiClick", sizeof( StaticMultiClick<BenchSwitchHandler> ) );
+  printf( "  %-34s %6zu bytes\n", "AnimationManager<3>", sizeof( AnimationManager<3> ) );
+}
+
+/*
+  Times the given amount of ticks of the given ambient effect one by one and returns the durations in ns, sorted. The
+  gain range of the effect is returned in lowest and highest.
+*/
+std::vector<double> timeEffectTicks( uint8_t effectId, unsigned long ticks, uint8_t &lowest, uint8_t &highest ) {
+  AmbientEffect effect;
+  effect.setEffect( effectId );
+  std::vector<double> durations;
+  durations.reserve( ticks );
+  lowest = 255;
+  highest = 0;
+  unsigned long tickMillis = 0;
+  for ( unsigned long cnt = 0; cnt < ticks; cnt++ ) {
+    tickMillis += AMBIENT_TICK;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    effect.checkEffect( tickMillis );
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    durations.push_back( std::chrono::duration<double, std::nano>( end - start ).count() );
+
+    uint8_t gain = effect.apply( 255 << 8 ) >> 8;
+    lowest = gain < lowest ? gain : lowest;
+    highest = gain > highest ? gain : highest;
+  }
+  std::sort( durations.begin(), durations.end() );
+  return durations;
+}
+
+/*
+  Prints the time per tick of each ambient effect: the median, the 99.9th percentile and the maximum, with the
+  duration of an empty timed call subtracted. The tail of the host includes its own noise (interrupts, cache misses),
+  so it's no proof of the fixed cost of a tick on the AVR: that's checked by the ambient_ticks test (ambientTicks.cpp).
+  Also prints the range of the gain of each effect.
+*/
+void reportAmbientEffects() {
+  const char *names[ AMBIENT_EFFECT_COUNT ] = { "steady", "candle", "twinkle", "breathe" };
+  uint8_t lowest;
+  uint8_t highest;
+  std::vector<double> empty = timeEffectTicks( AMBIENT_STEADY, BENCH_EFFECT_TICKS, lowest, highest );
+  double timing = empty[ empty.size() / 2 ];
+  printf( "  %-34s %8s %8s %8s %s\n", "", "median", "p99.9", "max", "gain" );
+  for ( uint8_t effectId = AMBIENT_CANDLE; effectId < AMBIENT_EFFECT_COUNT; effectId++ ) {
+    std::vector<double> durations = timeEffectTicks( effectId, BENCH_EFFECT_TICKS, lowest, highest );
+    double median = durations[ durations.size() / 2 ] - timing;
+    double tail = durations[ durations.size() * 999 / 1000 ] - timing;
+    double worst = durations.back() - timing;
+    printf( "  %-34s %5.1f ns %5.1f ns %5.0f ns %3u - %3u\n", names[ effectId ], median > 0 ? median : 0.0,
+            tail > 0 ? tail : 0.0, worst, lowest, highest );
+  }
+  printf( "  %-34s %5.1f ns\n", "(timing of an idle call)", timing );
+}
+
+/*
+  Runs a candle on 3 channels, starts a boundary reached blink on the first and reports the blink and the PWM writes
+  of the first channel in the second after the blink: the candle continues when the blink ends.
+*/
+void reportEffectWithBlink( double overhead ) {
+  AnimationManager<3> channelAnimations( BENCH_CHANNEL_PWM_PINS );
+  for ( uint8_t channel = 0; channel < 3; channel++ ) {
+    channelAnimations.fadeToBrightnessLevel( channel, 200 );
+    channelAnimations.setEffect( channel, AMBIENT_CANDLE );
+  }
+  runUntilFinished( channelAnimations );
+
+  double candles = measureNsPerCall( BENCH_ITERATIONS, [&]( unsigned long currentMillis ) {
+    channelAnimations.checkAnimation( currentMillis );
+  } ) - overhead;
+  printf( "  %-34s %8.1f ns\n", "checkAnimation() 3 channels candle", candles );
+
+  hostResetPwmWriteCounts();
+  channelAnimations.startBoundaryReachedAnimation( 0 );
+  unsigned long duration = runUntilFinished( channelAnimations );
+  printf( "  %-34s %6lu writes %6lu ms\n", "boundary reached blink on a candle", hostPwmWriteCount( BENCH_CHANNEL_PWM_PINS[ 0 ] ), duration );
+
+  hostResetPwmWriteCounts();
+  for ( unsigned int cnt = 0; cnt < 1000; cnt++ ) {
+    hostAdvanceMillis( 1 );
+    channelAnimations.checkAnimation( halMillis() );
+  }
+  printf( "  %-34s %6lu writes in 1000 ms\n", "candle after the blink", hostPwmWriteCount( BENCH_CHANNEL_PWM_PINS[ 0 ] ) );
+}
+
+/*
+  The layers of the benchmark of the compositor: the first one overrides, the others alternate between multiply and
+  add, so each blend mode is part of a frame.
+*/
+struct BenchLayers {
+  static inline uint8_t blendMode( uint8_t layer ) {
+    return layer == 0 ? BLEND_OVERRIDE : ( layer & 1 ? BLEND_MULTIPLY : BLEND_ADD );
+  }
+};
+
+/*
+  Prints the time of a frame of a compositor with the given amount of layers, all of them active.
+*/
+template<uint8_t layerCount> void reportComposition( double overhead ) {
+  volatile uint16_t level = 0;
+  double composed = measureNsPerCall( BENCH_ITERATIONS, [&]( unsigned long currentMillis ) {
+    LayerCompositor<BenchLayers> compositor;
+    for ( uint8_t layer = 0; layer < layerCount; layer++ ) {
+      compositor.addLayer( layer, true, (uint16_t)( currentMillis << layer ) );
+    }
+    level = compositor.getLevel();
+  } ) - overhead;
+  char name[ 16 ];
+  snprintf( name, sizeof( name ), "%u layer%s", layerCount, layerCount == 1 ? "" : "s" );
+  printf( "  %-34s %8.1f ns\n", name, composed > 0 ? composed : 0.0 );
+}
+
+/*
+  Prints the cost of a frame of the compositor for 1 up to 8 layers, and the size of the compositor, which only lives
+  on the stack during a frame.
+*/
+void reportCompositor( double overhead ) {
+  reportComposition<1>( overhead );
+  reportComposition<2>( overhead );
+  reportComposition<3>( overhead );
+  reportComposition<5>( overhead );
+  reportComposition<8>( overhead );
+  printf( "  %-34s %6zu bytes on the stack\n", "LayerCompositor<AnimationLayers>", sizeof( LayerCompositor<AnimationLayers> ) );
+}
+
+/*
+  Uploads the flicker script in chunks, like the controller does through MySensors, runs it for 10 seconds on
+  the given channel and reports the EEPROM writes and the PWM writes.
+*/
+void reportUploadedScript( AnimationManager<1> &animations ) {
+  // The output of the assembler (fairylight_asm) for the flicker script
+  const char *chunks[] = { "0006005A00C80006012800A0", "0B00C2000106010000780083", "16010900" };
+  unsigned long eepromWrites = hostEepromWriteCount();
+  bool uploaded = true;
+  for ( const char *chunk : chunks ) {
+    uint8_t offset = strtoul( std::string( chunk, 2 ).c_str(), NULL, 16 );
+    uploaded = uploaded && animationScriptUpload( offset, chunk + 2 );
+  }
+  uploaded = uploaded && animationScriptCommit( 25 );
+
+  hostResetPwmWriteCounts();
+  bool started = uploaded && animations.startScript( 0, SCRIPT_EEPROM );
+  for ( uint16_t cnt = 0; cnt < 10000; cnt++ ) {
+    hostAdvanceMillis( 1 );
+    animations.checkAnimation( halMillis() );
+  }
+  printf( "  %-34s %6lu EEPROM writes, %s, %lu PWM writes in 10s\n", "upload flicker script", hostEepromWriteCount() - eepromWrites,
+          started ? "running" : "not started", hostPwmWriteCount( BENCH_PWM_PIN ) );
+  animations.fadeToBrightnessLevel( 0, 0 );
+  runUntilFinished( animations );
+}
+
+unsigned long sentMessages = 0;
+bool          deliverMessages = true;
+
+// Send handler of the outbox, counts the messages instead of sending them
+bool onSendMessage( uint8_t sensor, uint8_t type, int16_t value, bool ack ) {
+  (void)sensor; (void)type; (void)value; (void)ack;
+  sentMessages++;
+  return deliverMessages;
+}
+
+/*
+  Spins the encoder 40 detents in 400ms, like checkEncoder() posts the brightness of 3 channels per detent, and reports the
+  messages the outbox sends with 15ms pacing. Then reports the resends of a message whose ack never arrives, and of a
+  message that can't be delivered to the parent node.
+*/
+void reportMessageQueue() {
+  QueuedMessage messages[ 3 ];
+  MessageQueue outbox( onSendMessage, 15, messages, 3 );
+  unsigned long duration = 0;
+  for ( uint8_t detent = 0; detent < 40 || !outbox.isIdle(); duration++ ) {
+    if ( detent < 40 && duration % 10 == 0 ) {
+      for ( uint8_t channel = 0; channel < 3; channel++ ) {
+        outbox.post( 1 + channel, 3, detent, false ); // V_DIMMER
+      }
+      detent++;
+    }
+    hostAdvanceMillis( 1 );
+    outbox.update( halMillis() );
+  }
+  printf( "  %-34s %6u sent %4u coalesced %6lu ms\n", "encoder spin, 120 posts", outbox.getSentCount(), outbox.getCoalescedCount(),
+          duration );
+
+  outbox.resetCounters();
+  outbox.post( 1, 2, 1, true ); // V_LIGHT, the ack is lost
+  for ( duration = 0; !outbox.isIdle(); duration++ ) {
+    hostAdvanceMillis( 1 );
+    outbox.update( halMillis() );
+  }
+  printf( "  %-34s %6u sent %4u retried %u dropped %6lu ms\n", "ack lost", outbox.getSentCount(), outbox.getRetriedCount(),
+          outbox.getDroppedCount(), duration );
+
+  outbox.resetCounters();
+  deliverMessages = false;
+  outbox.post( 1, 2, 1, false );
+  for ( duration = 0; !outbox.isIdle(); duration++ ) {
+    if ( duration == 300 ) {
+      deliverMessages = true; // The parent node is back after the first resend
+    }
+    hostAdvanceMillis( 1 );
+    outbox.update( halMillis() );
+  }
+  printf( "  %-34s %6u sent %4u retried %u dropped %6lu ms\n", "parent unreachable for 300ms", outbox.getSentCount(),
+          outbox.getRetriedCount(), outbox.getDroppedCount(), duration );
+
+  outbox.resetCounters();
+  outbox.post( 1, 2, 1, true );
+  hostAdvanceMillis( 1 );
+  outbox.update( halMillis() );
+  outbox.post( 1, 2, 0, true ); // Turned off before the echo of the first value arrived
+  outbox.acknowledged( 1, 2, 1 );
+  bool staleAckIgnored = !outbox.isIdle();
+  hostAdvanceMillis( 15 );
+  outbox.update( halMillis() );
+  outbox.acknowledged( 1, 2, 0 );
+  printf( "  %-34s %6s\n", "ack of a replaced value", staleAckIgnored && outbox.isIdle() ? "ignored" : "FAILED" );
+}
+
+/*
+  Feeds the profiler with a simulated loop: 10000 passes with an animation section of 40 - 110us and a switch section
+  of 10us, and a stall of 25ms (a radio send with retries) every 1000 passes. Prints the statistics like the sketch.
+*/
+void reportLoopProfile() {
+  LoopProfiler profiler( 10000 );
+  for ( uint16_t pass = 0; pass < 10000; pass++ ) {
+    unsigned long loopStartedAt = frameTimerMicros();
+    unsigned long sectionStartedAt = frameTimerMicros();
+    hostAdvanceMicros( 40 + pass % 8 * 10 );
+    profiler.addSection( 0, frameTimerMicros() - sectionStartedAt );
+    sectionStartedAt = frameTimerMicros();
+    hostAdvanceMicros( 10 );
+    profiler.addSection( 1, frameTimerMicros() - sectionStartedAt );
+    hostAdvanceMicros( pass % 1000 == 999 ? 25000 : 20 );
+    profiler.addLoop( frameTimerMicros() - loopStartedAt );
+  }
+  printf( "  %-34s %6lu passes, min %lu us, mean %lu us, max %lu us, %u stalls\n", "simulated loop", profiler.getLoopCount(),
+          profiler.getMinLoop(), profiler.getMeanLoop(), profiler.getMaxLoop(), profiler.getStallCount() );
+  printf( "  %-34s", "histogram (from 1, 2, 4 ... us)" );
+  for ( uint8_t bucket = 0; bucket < PROFILE_HISTOGRAM_BUCKETS; bucket++ ) {
+    printf( " %u", profiler.getHistogram( bucket ) );
+  }
+  printf( "\n  %-34s %u, %u per mille\n", "share of section 0, 1", profiler.getShare( 0 ), profiler.getShare( 1 ) );
+}
+
+/*
+  Fades from off to the given lightness and returns the amount of different duty cycles the fade goes through, either
+  as 8 bit PWM values or as the duty cycles of the dithered PWM.
+*/
+uint8_t countFadeDutyCycles( uint8_t lightness, bool dithered ) {
+  SmoothBrightnessTransistion fade;
+  fade.setLevel( lightness );
+  uint8_t  dutyCycles = 0;
+  uint16_t lastDuty = 0;
+  while ( !fade.isAnimationFinished() ) {
+    hostAdvanceMillis( animationStepDuration );
+    fade.checkAnimation( halMillis() );
+    uint16_t duty = dithered ? ledLightnessToDuty( fade.getCurrentLightLevel() ) : ledLightnessToPwm( fade.getCurrentBrightnessLevel() );
+    dutyCycles += duty != lastDuty ? 1 : 0;
+    lastDuty = duty;
+  }
+  return dutyCycles;
+}
+
+/*
+  Dithers the given duty cycle for 1600 PWM periods on the given pin and prints the mean PWM value and the longest run of
+  periods with the same PWM value, the slowest part of the pattern.
+*/
+void reportDitheredDuty( uint8_t pin, uint16_t duty ) {
+  ditheredPwmWrite( pin, duty );
+  unsigned long sum = 0;
+  uint16_t run = 0, longestRun = 0;
+  uint8_t  lastValue = hostPwmValue( pin );
+  for ( uint16_t period = 0; period < 1600; period++ ) {
+    ditheredPwmTick();
+    uint8_t value = hostPwmValue( pin );
+    sum += value;
+    run = value == lastValue ? run + 1 : 1;
+    longestRun = run > longestRun ? run : longestRun;
+    lastValue = value;
+  }
+  char name[ 40 ];
+  snprintf( name, sizeof( name ), "duty %u/%u (PWM %.3f)", duty, LED_DUTY_MAX, (double)duty / ( 1 << LED_DUTY_FRACTION_BITS ) );
+  printf( "  %-34s mean PWM %8.4f, longest run %2u periods\n", name, sum / 1600.0, longestRun );
+}
+
+/*
+  Prints the duty cycles of a fade to the lowest brightness level with the 8 bit and the dithered PWM, the mean and the
+  pattern of a few dithered duty cycles and the time per interrupt with 3 dithered pins.
+*/
+void reportDitheredPwm( double overhead ) {
+  typedef LedCurveTable< LedBrightnessLevelCurve<15, 10> > BrightnessLevels;
+  typedef LedCurveTable< LedBrightnessLevelCurve<15, 2> > NightLightLevels;
+  printf( "  %-34s %3u PWM values, %3u dithered duty cycles\n", "fade 0 -> level 1 (PWM 10)",
+          countFadeDutyCycles( BrightnessLevels::read( 1 ), false ), countFadeDutyCycles( BrightnessLevels::read( 1 ), true ) );
+  printf( "  %-34s %3u PWM values, %3u dithered duty cycles\n", "fade 0 -> level 1 (PWM 2)",
+          countFadeDutyCycles( NightLightLevels::read( 1 ), false ), countFadeDutyCycles( NightLightLevels::read( 1 ), true ) );
+
+  for ( uint8_t pin : BENCH_CHANNEL_PWM_PINS ) {
+    ditheredPwmAttach( pin );
+  }
+  const uint16_t duties[] = { 1, 8, 15, 37, 1000, LED_DUTY_MAX - 1 };
+  for ( uint16_t duty : duties ) {
+    reportDitheredDuty( BENCH_CHANNEL_PWM_PINS[ 2 ], duty );
+  }
+
+  // All pins dithered, the worst case for the interrupt
+  for ( uint8_t pin : BENCH_CHANNEL_PWM_PINS ) {
+    ditheredPwmWrite( pin, 37 );
+  }
+  double tick = measureNsPerCall( BENCH_ITERATIONS, []( unsigned long currentMillis ) {
+    (void)currentMillis;
+    ditheredPwmTick();
+  } ) - overhead;
+  printf( "  %-34s %8.1f ns, %.4f%% of the time at %lu ticks per second\n", "interrupt with 3 dithered pins", tick,
+          tick * BENCH_DITHER_TICKS_PER_SECOND / 1e7, BENCH_DITHER_TICKS_PER_SECOND );
+  for ( uint8_t pin : BENCH_CHANNEL_PWM_PINS ) {
+    ditheredPwmWrite( pin, 0 );
+  }
+  printf( "  %-34s %8s\n", "interrupt with all pins off", ditheredPwmIsDithering() ? "enabled" : "disabled" );
+}
+
+int main() {
+  double overhead = measureNsPerCall( BENCH_ITERATIONS, []( unsigned long currentMillis ) { (void)currentMillis; } );
+
+  AnimationManager<1> animations( BENCH_PWM_PINS );
+  SoftDebouncedMultiClick powerSwitch( BENCH_SWITCH_PIN );
+  powerSwitch.setKeyClickHandler( onSwitchClicked );
+
+  printf( "Curves (LED_GAMMA_CURVE %d, LED_EASING_CURVE %d)\n", LED_GAMMA_CURVE, LED_EASING_CURVE );
+  reportCurves();
+
+  printf( "\nPWM writes per animation\n" );
+  reportFade( animations, "fade 0 -> 255", 255 );
+  reportFade( animations, "fade 255 -> 10", 10 );
+  reportFade( animations, "fade 10 -> 0", 0 );
+
+  hostResetPwmWriteCounts();
+  animations.fadeToBrightnessLevel( 0, 255 );
+  for ( uint8_t cnt = 0; cnt < 5; cnt++ ) {
+    hostAdvanceMillis( 50 );
+    animations.checkAnimation( halMillis() );
+  }
+  animations.fadeToBrightnessLevel( 0, 60 );
+  unsigned long duration = runUntilFinished( animations ) + 250;
+  printf( "  %-34s %6lu writes %6lu ms\n", "fade 0 -> 255, retarget to 60", hostPwmWriteCount( BENCH_PWM_PIN ), duration );
+
+  hostResetPwmWriteCounts();
+  animations.startBoundaryReachedAnimation( 0 );
+  duration = runUntilFinished( animations );
+  printf( "  %-34s %6lu writes %6lu ms\n", "boundary reached blink", hostPwmWriteCount( BENCH_PWM_PIN ), duration );
+
+  // The blink is a layer on top of the fade, so the fade is done when the blink is
+  hostResetPwmWriteCounts();
+  animations.fadeToBrightnessLevel( 0, 200 );
+  animations.startBoundaryReachedAnimation( 0 );
+  duration = runUntilFinished( animations );
+  printf( "  %-34s %6lu writes %6lu ms\n", "fade 60 -> 200 under a blink", hostPwmWriteCount( BENCH_PWM_PIN ), duration );
+
+  printf( "\nTime per call (clock overhead of %.1f ns subtracted)\n", overhead );
+
+  double idle = measureNsPerCall( BENCH_ITERATIONS, [&]( unsigned long currentMillis ) {
+    animations.checkAnimation( currentMillis );
+  } );
+  printf( "  %-34s %8.1f ns\n", "checkAnimation() idle", idle - overhead );
+
+  uint8_t target = 0;
+  double fading = measureNsPerCall( BENCH_ITERATIONS, [&]( unsigned long currentMillis ) {
+    if ( animations.animationFinished() ) {
+      target = target == 0 ? 255 : 0;
+      animations.fadeToBrightnessLevel( 0, target );
+    }
+    animations.checkAnimation( currentMillis );
+  } );
+  printf( "  %-34s %8.1f ns\n", "checkAnimation() fading", fading - overhead );
+
+  AnimationManager<3> channelAnimations( BENCH_CHANNEL_PWM_PINS );
+  double channelsIdle = measureNsPerCall( BENCH_ITERATIONS, [&]( unsigned long currentMillis ) {
+    channelAnimations.checkAnimation( currentMillis );
+  } );
+  printf( "  %-34s %8.1f ns\n", "checkAnimation() 3 channels idle", channelsIdle - overhead );
+
+  uint8_t channelTargets[ 3 ] = { 0, 0, 0 };
+  double channelsFading = measureNsPerCall( BENCH_ITERATIONS, [&]( unsigned long currentMillis ) {
+    for ( uint8_t channel = 0; channel < 3; channel++ ) {
+      if ( channelAnimations.animationFinished( channel ) ) {
+        channelTargets[ channel ] = channelTargets[ channel ] == 0 ? 255 - channel * 60 : 0;
+        channelAnimations.fadeToBrightnessLevel( channel, channelTargets[ channel ] );
+      }
+    }
+    channelAnimations.checkAnimation( currentMillis );
+  } );
+  printf( "  %-34s %8.1f ns\n", "checkAnimation() 3 channels fading", channelsFading - overhead );
+
+  // The 3 built-in scripts, one on each channel, restarted when the party script ends
+  for ( uint8_t channel = 0; channel < 3; channel++ ) {
+    channelAnimations.startScript( channel, channel + 1 );
+  }
+  double channelsScripts = measureNsPerCall( BENCH_ITERATIONS, [&]( unsigned long currentMillis ) {
+    for ( uint8_t channel = 0; channel < 3; channel++ ) {
+      if ( channelAnimations.animationFinished( channel ) ) {
+        channelAnimations.startScript( channel, channel + 1 );
+      }
+    }
+    channelAnimations.checkAnimation( currentMillis );
+  } );
+  printf( "  %-34s %8.1f ns\n", "checkAnimation() 3 channels scripts", channelsScripts - overhead );
+
+  double switchIdle = measureNsPerCall( BENCH_ITERATIONS, [&]( unsigned long currentMillis ) {
+    powerSwitch.checkSwitch( currentMillis );
+  } );
+  printf( "  %-34s %8.1f ns\n", "checkSwitch() idle", switchIdle - overhead );
+
+  unsigned long phase = 0;
+  double switchClicking = measureNsPerCall( BENCH_ITERATIONS, [&]( unsigned long currentMillis ) {
+    setClickingPin( BENCH_SWITCH_PIN, phase++ );
+    powerSwitch.checkSwitch( currentMillis );
+  } );
+  printf( "  %-34s %8.1f ns (%lu click events)\n", "checkSwitch() clicking", switchClicking - overhead, clickEvents );
+
+  MultiClickBank<8> bank( BENCH_BANK_PINS );
+  bank.setKeyClickHandler( onBankSwitchClicked );
+  double bankIdle = measureNsPerCall( BENCH_ITERATIONS, [&]( unsigned long currentMillis ) {
+    bank.checkSwitches( currentMillis );
+  } );
+  printf( "  %-34s %8.1f ns\n", "checkSwitches() 8 switches idle", bankIdle - overhead );
+
+  // The same clicks as above, on one switch of the bank
+  phase = 0;
+  double bankClicking = measureNsPerCall( BENCH_ITERATIONS, [&]( unsigned long currentMillis ) {
+    setClickingPin( BENCH_BANK_PINS[ BENCH_BANK_SWITCH ], phase++ );
+    bank.checkSwitches( currentMillis );
+  } );
+  printf( "  %-34s %8.1f ns (%lu click events on switch %u)\n", "checkSwitches() 8 switches clicking", bankClicking - overhead,
+          bankEvents, lastBankSwitch );
+
+  printf( "\nScripts\n" );
+  hostResetPwmWriteCounts();
+  animations.startScript( 0, 3 );
+  duration = runUntilFinished( animations );
+  printf( "  %-34s %6lu writes %6lu ms\n", "party script", hostPwmWriteCount( BENCH_PWM_PIN ), duration );
+  reportUploadedScript( animations );
+
+  printf( "\nAmbient effects (a tick every %u ms)\n", AMBIENT_TICK );
+  reportAmbientEffects();
+  reportEffectWithBlink( overhead );
+
+  printf( "\nLayer compositor, time per frame\n" );
+  reportCompositor( overhead );
+
+  printf( "\nSwitch events\n" );
+  reportBlockedClicks( powerSwitch, BENCH_SWITCH_PIN, "double click, loop blocked 520ms" );
+  StaticMultiClick<BenchSwitchHandler> staticSwitch( BENCH_STATIC_SWITCH_PIN );
+  reportBlockedClicks( staticSwitch, BENCH_STATIC_SWITCH_PIN, "the same with a StaticMultiClick" );
+
+  printf( "\nEvent dispatch\n" );
+  reportEventDispatch( powerSwitch, overhead );
+
+  printf( "\nOutbox (15ms pacing)\n" );
+  reportMessageQueue();
+
+  printf( "\nLoop profiler\n" );
+  LoopProfiler profiler( 10000 );
+  double profiling = measureNsPerCall( BENCH_ITERATIONS, [&]( unsigned long currentMillis ) {
+    profiler.addSection( 0, currentMillis & 0xFF );
+    profiler.addSection( 1, currentMillis & 0x1F );
+    profiler.addSection( 2, currentMillis & 0x0F );
+    profiler.addLoop( currentMillis & 0x3FF );
+  } );
+  printf( "  %-34s %8.1f ns\n", "3 sections and a loop pass", profiling - overhead );
+  reportLoopProfile();
+
+  printf( "\nDithered PWM (%u fraction bits)\n", LED_DUTY_FRACTION_BITS );
+  reportDitheredPwm( overhead );
+
+  printf( "\nFixed point fade compared with the original floating point fade\n" );
+  reportFixedPointComparison();
+
+  return 0;
+}
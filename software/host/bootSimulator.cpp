@@ -0,0 +1,311 @@
+/*
+  Simulation of the boot of the lamp: the time to light and the time until the lamp is in sync with the controller,
+  and a model of the presentations of a house full of lamps after a power out.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  The first part runs the sketch itself (FairyLightLamp.ino, compiled against the stubs in sketchStubs/) with a virtual
+  clock from the power on. The journal holds a state with two channels on, and the gateway is found after the given
+  amount of ms (SIM_JOIN_MILLIS by default), before that every send fails at once. The boot follows MySensors: before(),
+  the wait for the gateway (at most MY_TRANSPORT_WAIT_READY_MS of config.h, FAST_BOOT sets it), presentation() once the
+  gateway is found and setup(), followed by loop() with the received messages passed to receive() between two passes.
+  The controller echoes an acked message and answers the request of the light state of a channel after
+  SIM_REPLY_MICROS. It reports the moment of the first light, the end of the restore fade, the end of the presentation
+  and the moment the last reply of the controller was handled (the lamp is in sync). Compare a build with and without
+  FAST_BOOT, e.g. with -DCMAKE_CXX_FLAGS=-DFAST_BOOT.
+
+  The second part doesn't run the sketch but models SIM_HOUSE_NODES lamps that find the gateway at the same moment
+  (within SIM_HOUSE_JOIN_SPREAD ms) and send the SIM_PRESENTATION_MESSAGES of their presentation. The radio channel is
+  slotted ALOHA: a send takes a slot of SIM_SLOT_MILLIS, two sends in the same slot both fail. It compares the fixed 50ms
+  delays without retries (the presentation without FAST_BOOT) with the random pacing and backoff of RandomBackoff (see
+  randomBackoff.h) with the settings of config.h. The model is crude, the radio's own retries are left out, but it shows
+  why equal delays keep the lamps colliding.
+
+    ./build/fairylight_boot [gateway found after ms]
+*/
+
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <MySensors.h>
+#include "frameTimer.h"
+#include "randomBackoff.h"
+#include "stateJournal.h"
+
+// The pins and the journal record of the sketch (see FairyLightLamp.ino and config.h)
+const uint8_t SIM_CHANNEL_PINS[ 3 ] = { 5, 6, 3 };
+const uint8_t SIM_CHANNELS_ON = 0x03;
+const uint8_t SIM_BRIGHTNESS = 10;
+const uint8_t SIM_JOURNAL_BRIGHTNESS = 1;
+const uint8_t SIM_JOURNAL_STORED_BRIGHTNESS = 4;
+
+const unsigned long SIM_JOIN_MILLIS = 1500;    // The time it takes to find the gateway, an assumption
+const unsigned long SIM_SEND_MICROS = 2000;
+const unsigned long SIM_REPLY_MICROS = 30000;  // The controller answers a request or echoes a message
+const unsigned long SIM_FRAME_MICROS = 10000;
+const unsigned long SIM_RUN_MICROS = 10000000; // The time the simulation runs after the gateway was found
+
+// The settings of the house model: the presentation (the sketch info is 2 messages) and the RandomBackoff of config.h
+const uint16_t      SIM_HOUSE_NODES = 20;
+const uint16_t      SIM_HOUSE_JOIN_SPREAD = 100;
+const uint8_t       SIM_PRESENTATION_MESSAGES = 2 + 3 + 5 + 3;
+const uint8_t       SIM_SLOT_MILLIS = 2;
+const uint16_t      SIM_FIXED_DELAY = 50;
+const uint16_t      SIM_BOOT_SYNC_PACING = 40;
+const uint16_t      SIM_BOOT_SYNC_SPREAD = 2000;
+const uint16_t      SIM_BOOT_SYNC_MAX_BACKOFF = 16000;
+const unsigned long SIM_HOUSE_TIMEOUT = 120000; // ms
+
+std::multimap<unsigned long, MyMessage> replies; // The messages of the controller, by the us of the virtual clock
+unsigned long nextFrameAt = SIM_FRAME_MICROS;
+unsigned long lightAt = 0;         // us of the first light
+unsigned long lastPwmChangeAt = 0; // us of the last PWM change
+unsigned long presentedAt = 0;     // us of the last presentation message or request that got through
+unsigned long syncedAt = 0;        // us at which the last reply to a request was handled
+uint8_t       pendingRequests = 0;
+unsigned long sentMessages = 0;
+unsigned long failedMessages = 0;
+
+/*
+  Moves the virtual clock to the given us, with the ticks of the frame timer on the way.
+*/
+void advanceClockTo( unsigned long target ) {
+  while ( nextFrameAt <= target ) {
+    hostAdvanceMicros( nextFrameAt - hostMicros() );
+    frameTimerTick();
+    nextFrameAt += SIM_FRAME_MICROS;
+  }
+  hostAdvanceMicros( target - hostMicros() );
+}
+
+/*
+  Wait handler of the sketch: moves the virtual clock the given amount of us forward. The replies of the controller are
+  received by the loop afterwards, like MySensors does.
+*/
+void wait( unsigned long us ) {
+  advanceClockTo( hostMicros() + us );
+}
+
+/*
+  Send handler of the sketch: fails at once until the gateway is found, otherwise blocks for the time the radio takes
+  and delivers the message. The controller echoes an acked message and answers a request.
+*/
+bool onSend( const MyMessage &message, bool ack ) {
+  sentMessages++;
+  if ( !isTransportReady() ) {
+    failedMessages++;
+    return false;
+  }
+  wait( SIM_SEND_MICROS );
+
+  if ( message.getCommand() == C_PRESENTATION || message.getCommand() == C_REQ ) {
+    presentedAt = hostMicros();
+  }
+  if ( message.getCommand() == C_REQ && message.type == V_LIGHT ) {
+    // The controller agrees with the journal
+    MyMessage reply( message.sensor, V_LIGHT );
+    reply.setDestination( HOST_SKETCH_NODE_ID ).set( (int16_t)( ( SIM_CHANNELS_ON >> ( message.sensor - 1 ) ) & 1 ) );
+    reply.sender = 0;
+    replies.insert( std::make_pair( hostMicros() + SIM_REPLY_MICROS, reply ) );
+    pendingRequests++;
+  }
+  else if ( ack ) {
+    MyMessage echo = message;
+    echo.setEcho( true ).setDestination( HOST_SKETCH_NODE_ID );
+    replies.insert( std::make_pair( hostMicros() + SIM_REPLY_MICROS, echo ) );
+  }
+  return true;
+}
+
+/*
+  Records the first light and the last change of the PWM of the channels.
+*/
+void onPwmWrite( uint8_t pin, uint8_t value ) {
+  if ( std::find( SIM_CHANNEL_PINS, SIM_CHANNEL_PINS + 3, pin ) == SIM_CHANNEL_PINS + 3 ) {
+    return;
+  }
+  if ( lightAt == 0 && value > 0 ) {
+    lightAt = hostMicros();
+  }
+  lastPwmChangeAt = hostMicros();
+}
+
+/*
+  Writes the state of the lamp before the power out to the journal in the EEPROM, and sets the clock to 0.
+*/
+void seedJournal() {
+  uint8_t state[ JOURNAL_PAYLOAD_SIZE ] = { 0 };
+  state[ 0 ] = SIM_CHANNELS_ON;
+  for ( uint8_t channel = 0; channel < 3; channel++ ) {
+    state[ SIM_JOURNAL_BRIGHTNESS + channel ] = SIM_BRIGHTNESS;
+    state[ SIM_JOURNAL_STORED_BRIGHTNESS + channel ] = SIM_BRIGHTNESS;
+  }
+  StateJournal journal( EEPROM_JOURNAL_ADDRESS, EEPROM_JOURNAL_SIZE, 0 );
+  journal.store( state, 0 );
+  while ( !journal.isIdle() ) {
+    hostAdvanceMillis( 1 ); // The EEPROM takes time per byte
+    journal.update( halMillis() );
+  }
+  hostSetMillis( 0 ); // The power on
+}
+
+/*
+  Boots the sketch with the gateway found after the given us, and prints the moments of the boot.
+*/
+void simulateBoot( unsigned long joinAt ) {
+  seedJournal();
+  hostSketchSetWaitHandler( wait );
+  hostSketchSetSendHandler( onSend );
+  hostSetPwmWriteCallback( onPwmWrite );
+  hostSketchSetTransportReady( false );
+
+  before();
+  // MySensors waits for the gateway, at most MY_TRANSPORT_WAIT_READY_MS
+  unsigned long waitUntil = joinAt;
+  if ( hostSketchTransportWaitReady > 0 && hostSketchTransportWaitReady * 1000 < joinAt ) {
+    waitUntil = hostSketchTransportWaitReady * 1000;
+  }
+  wait( waitUntil - hostMicros() );
+  bool presented = false;
+  if ( hostMicros() >= joinAt ) {
+    hostSketchSetTransportReady( true );
+    presentation();
+    presented = true;
+  }
+  setup();
+
+  while ( hostMicros() < joinAt + SIM_RUN_MICROS ) {
+    while ( !replies.empty() && replies.begin()->first <= hostMicros() ) {
+      MyMessage message = replies.begin()->second;
+      replies.erase( replies.begin() );
+      receive( message );
+      if ( !message.isEcho() && --pendingRequests == 0 ) {
+        syncedAt = hostMicros();
+      }
+    }
+    if ( !presented && hostMicros() >= joinAt ) {
+      // MySensors presents the node from the loop once the gateway is found
+      hostSketchSetTransportReady( true );
+      presentation();
+      presented = true;
+    }
+    loop();
+  }
+
+  printf( "Boot of the sketch, the gateway is found after %lu ms, MY_TRANSPORT_WAIT_READY_MS %lu%s\n", joinAt / 1000,
+          hostSketchTransportWaitReady, hostSketchTransportWaitReady == 0 ? " (waits for the gateway)" : "" );
+  printf( "  first light             %8.1f ms\n", lightAt / 1000.0 );
+  printf( "  restore fade completed  %8.1f ms\n", lastPwmChangeAt / 1000.0 );
+  printf( "  presentation sent       %8.1f ms (%.1f ms after the gateway was found)\n", presentedAt / 1000.0,
+          ( presentedAt - joinAt ) / 1000.0 );
+  printf( "  light state synced      %8.1f ms\n", syncedAt / 1000.0 );
+  printf( "  %lu messages sent, %lu failed before the gateway was found\n", sentMessages, failedMessages );
+}
+
+/*
+  A lamp of the house model.
+*/
+struct HouseNode {
+  unsigned long joinAt;    // ms
+  uint8_t       sent;      // The messages of the presentation that got through
+  uint8_t       attempts;  // Fixed delays: the messages that were sent
+  unsigned long doneAt;    // ms, 0 while not done
+  RandomBackoff backoff;
+};
+
+/*
+  Returns the given percentile (0 - 100) of the sorted times, nearest rank.
+*/
+unsigned long percentile( const std::vector<unsigned long> &times, double rank ) {
+  size_t index = (size_t)( rank / 100 * times.size() + 0.999999 );
+  return times[ index == 0 ? 0 : index - 1 ];
+}
+
+/*
+  Runs the presentations of the house with fixed delays (withBackoff false) or with RandomBackoff, and prints the
+  outcome.
+*/
+void simulateHouse( const char *name, bool withBackoff ) {
+  std::vector<HouseNode> nodes;
+  srand( 7 );
+  for ( uint16_t node = 0; node < SIM_HOUSE_NODES; node++ ) {
+    HouseNode house = { (unsigned long)( rand() % SIM_HOUSE_JOIN_SPREAD ), 0, 0, 0,
+                        RandomBackoff( SIM_BOOT_SYNC_PACING, SIM_BOOT_SYNC_SPREAD, SIM_BOOT_SYNC_MAX_BACKOFF ) };
+    house.backoff.seed( ( node + 1 ) * 251 ^ ( rand() & 0xFFFF ) );
+    house.backoff.start( house.joinAt );
+    nodes.push_back( house );
+  }
+
+  unsigned long sends = 0, collisions = 0;
+  std::vector<uint16_t> senders;
+  for ( unsigned long slot = 0; slot < SIM_HOUSE_TIMEOUT; slot += SIM_SLOT_MILLIS ) {
+    senders.clear();
+    for ( uint16_t index = 0; index < nodes.size(); index++ ) {
+      HouseNode &node = nodes[ index ];
+      bool due;
+      if ( withBackoff ) {
+        due = node.doneAt == 0 && node.backoff.isDue( slot );
+      }
+      else {
+        // Every SIM_FIXED_DELAY ms the next message, whether the previous one got through or not
+        due = node.attempts < SIM_PRESENTATION_MESSAGES && slot >= node.joinAt + node.attempts * SIM_FIXED_DELAY;
+      }
+      if ( due ) {
+        senders.push_back( index );
+      }
+    }
+    sends += senders.size();
+    collisions += senders.size() > 1 ? senders.size() : 0;
+    for ( uint16_t index : senders ) {
+      HouseNode &node = nodes[ index ];
+      bool delivered = senders.size() == 1;
+      node.attempts++;
+      if ( delivered ) {
+        node.sent++;
+      }
+      if ( withBackoff ) {
+        if ( !delivered ) {
+          node.backoff.failed( slot );
+        }
+        else if ( node.sent < SIM_PRESENTATION_MESSAGES ) {
+          node.backoff.succeeded( slot );
+        }
+      }
+      if ( node.sent == SIM_PRESENTATION_MESSAGES || ( !withBackoff && node.attempts == SIM_PRESENTATION_MESSAGES ) ) {
+        node.doneAt = slot + SIM_SLOT_MILLIS;
+      }
+    }
+  }
+
+  std::vector<unsigned long> complete;
+  unsigned long lost = 0;
+  for ( const HouseNode &node : nodes ) {
+    lost += SIM_PRESENTATION_MESSAGES - node.sent;
+    if ( node.sent == SIM_PRESENTATION_MESSAGES ) {
+      complete.push_back( node.doneAt );
+    }
+  }
+  std::sort( complete.begin(), complete.end() );
+  printf( "  %-26s %5lu %10lu %5lu %6lu/%-3u", name, sends, collisions, lost, (unsigned long)complete.size(), SIM_HOUSE_NODES );
+  if ( complete.empty() ) {
+    printf( "\n" );
+    return;
+  }
+  printf( " %7lu %7lu %7lu ms\n", percentile( complete, 50 ), percentile( complete, 90 ), percentile( complete, 100 ) );
+}
+
+int main( int argc, char *argv[] ) {
+  unsigned long joinMillis = argc > 1 ? strtoul( argv[ 1 ], NULL, 10 ) : SIM_JOIN_MILLIS;
+  simulateBoot( joinMillis * 1000 );
+
+  printf( "\nPresentations of %u lamps after a power out, %u messages each, slots of %u ms\n", SIM_HOUSE_NODES,
+          SIM_PRESENTATION_MESSAGES, SIM_SLOT_MILLIS );
+  printf( "  %-26s %5s %10s %5s %10s %s\n", "", "sends", "collisions", "lost", "complete", "presented p50/p90/max" );
+  simulateHouse( "fixed 50ms, no retries", false );
+  simulateHouse( "random pacing and backoff", true );
+  return 0;
+}
@@ -0,0 +1,131 @@
+/*
+  Replay test of the quadrature decoder (see FairyLightLamp/quadratureEncoder.h).
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  Replays edge sequences of the encoder on the simulated pins, each with a main loop that runs every
+  millisecond and with a main loop that is blocked most of the time, and checks that the detents the loop gets add up
+  to the turned detents. So no detent may be lost, also not when the ring buffer of the decoder overflows. It also
+  checks the brightness levels the detents are worth with the acceleration. The detents that overflow the buffer are
+  netted and count as fast steps, so with the blocked loop a back and forth turn gives more levels than with the loop
+  that keeps up (see quadratureEncoder.h). The expected levels pin that down, a change of the acceleration or the
+  overflow shows up as a failure.
+
+  A recording is the sequence of states of the pins (the first pin is bit 1, the second pin bit 0), starting from the
+  rest state 3 where both pins are pulled up. The pins change one at a time, like they do on a real encoder.
+
+  Returns 0 when all checks pass, so it can be run by ctest.
+*/
+
+#include <stdio.h>
+
+#include "quadratureEncoder.h"
+
+const uint8_t REPLAY_FIRST_PIN = 2;
+const uint8_t REPLAY_SECOND_PIN = 4;
+const uint8_t REPLAY_INCREMENTS = 4;
+
+struct EncoderRecording {
+  const char *name;
+  const char *states;      // The state after each edge
+  uint8_t    repeat;       // The amount of times the states are replayed
+  uint8_t    edgeMillis;   // The time between two edges
+  int16_t    detents;      // The expected detents, positive is clockwise
+  int16_t    levels[ 2 ];  // The expected brightness levels with each loop (see loops[])
+};
+
+// Typical turns of the knob, add the states of a troublesome turn here to check it
+const EncoderRecording recordings[] = {
+  { "slow clockwise, bouncing",     "232013",   10, 20,  10, {   10,   10 } },
+  { "fast counter clockwise spin",  "1023",     40,  1, -40, { -118, -118 } },
+  { "wobble at a detent",           "232023",    5, 10,   0, {    0,    0 } },
+  { "back and forth",               "2013201310231023102320132013", 3, 5, 3, { 7, 9 } }, // The stall nets the reversals
+  { "very fast spin, 200 detents",  "2013",    200,  1, 200, {  598,  596 } },
+};
+const uint8_t recordingCount = sizeof( recordings ) / sizeof( recordings[ 0 ] );
+
+/*
+  A main loop that is blocked for blockedMillis out of every periodMillis, 0 for a loop that is never blocked.
+*/
+struct LoopModel {
+  const char    *name;
+  unsigned long periodMillis;
+  unsigned long blockedMillis;
+};
+
+const LoopModel loops[] = {
+  { "loop every ms",             0,    0 },
+  { "loop blocked 500 of 600ms", 600, 500 },
+};
+const uint8_t loopCount = sizeof( loops ) / sizeof( loops[ 0 ] );
+static_assert( loopCount == 2, "A recording has the expected levels of 2 loops" );
+
+/*
+  Result of a replay: the net detents and the brightness levels the loop got.
+*/
+struct ReplayResult {
+  int16_t detents;
+  int16_t levels;
+};
+
+/*
+  Handles the detents of the encoder, like checkEncoder() does, unless the loop is blocked at the given time.
+*/
+void runLoop( QuadratureEncoder &encoder, const LoopModel &loop, ReplayResult &result ) {
+  if ( loop.periodMillis != 0 && halMillis() % loop.periodMillis < loop.blockedMillis ) {
+    return;
+  }
+  while ( encoder.update( halMillis() ) ) {
+    result.detents += encoder.getDirection();
+    result.levels += encoder.getDirection() * encoder.getStepSize();
+  }
+}
+
+/*
+  Replays the given recording with the given loop and returns what the loop got.
+*/
+ReplayResult replay( QuadratureEncoder &encoder, const EncoderRecording &recording, const LoopModel &loop ) {
+  ReplayResult result = { 0, 0 };
+  hostAdvanceMillis( 1000 ); // Far enough from the previous replay that the first detent isn't accelerated
+  runLoop( encoder, loop, result );
+  result.detents = 0;
+  result.levels = 0;
+
+  for ( uint8_t cnt = 0; cnt < recording.repeat; cnt++ ) {
+    for ( const char *state = recording.states; *state != '\0'; state++ ) {
+      uint8_t level = *state - '0';
+      hostSetPin( REPLAY_FIRST_PIN, level & 2 ? HIGH : LOW );
+      hostSetPin( REPLAY_SECOND_PIN, level & 1 ? HIGH : LOW );
+      for ( uint8_t ms = 0; ms < recording.edgeMillis; ms++ ) {
+        hostAdvanceMillis( 1 );
+        runLoop( encoder, loop, result );
+      }
+    }
+  }
+
+  // Let the loop handle the remaining detents
+  for ( uint16_t ms = 0; ms < 1000; ms++ ) {
+    hostAdvanceMillis( 1 );
+    runLoop( encoder, loop, result );
+  }
+  return result;
+}
+
+int main() {
+  QuadratureEncoder encoder( REPLAY_FIRST_PIN, REPLAY_SECOND_PIN, REPLAY_INCREMENTS );
+  uint8_t failures = 0;
+
+  printf( "Replayed encoder recordings\n" );
+  for ( uint8_t index = 0; index < recordingCount; index++ ) {
+    const EncoderRecording &recording = recordings[ index ];
+    for ( uint8_t loop = 0; loop < loopCount; loop++ ) {
+      ReplayResult result = replay( encoder, recording, loops[ loop ] );
+      bool passed = result.detents == recording.detents && result.levels == recording.levels[ loop ];
+      failures += passed ? 0 : 1;
+      printf( "  %-30s %-26s %4d detents (expected %4d) %4d levels (expected %4d)  %s\n", recording.name, loops[ loop ].name,
+              result.detents, recording.detents, result.levels, recording.levels[ loop ], passed ? "ok" : "FAILED" );
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+/*
+  Simulation of the frame timing of fades, with the animations advanced from the main loop (polling) and from the
+  frame timer interrupt.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  The main loop is modelled as a pass each millisecond, which is now and then blocked by one of the blocking calls
+  of the sketch. The durations and rates of the blocking calls below are estimates for a node that is used
+  actively, change them to model a different situation. While the loop is blocked the frame timer keeps firing,
+  like the Timer1 interrupt does during a delay().
+
+  During the simulation both channels fade continuously between two levels. For each fade step the time since the
+  previous step is compared with the step duration of 50ms. The deviation is the jitter.
+
+  Note that on the node millis() itself has a resolution of about 1ms, which adds up to 1ms of jitter in both modes.
+*/
+
+#include <algorithm>
+#include <stdio.h>
+#include <vector>
+
+#include "animationScheduler.h"
+
+const uint8_t       JITTER_PWM_PINS[ 2 ] = { 5, 6 };
+const unsigned long JITTER_DURATION = 3600000; // simulate an hour
+const uint8_t       JITTER_FRAME_RATE = 100;
+
+/*
+  A blocking call in the main loop: the duration it blocks the loop and how often it happens.
+*/
+struct BlockingCall {
+  const char    *name;
+  unsigned long duration;  // ms
+  unsigned long interval;  // average ms between two calls
+};
+
+const BlockingCall blockingCalls[] = {
+  { "sendPowerstateToGateWay(): 2 sends and delay(15)", 23, 20000 },
+  { "receive() V_LIGHT: delay(10) and a send",          14, 20000 },
+  { "radio send with retries",                          40, 10000 },
+  { "saveState() EEPROM write",                          4, 30000 },
+  { "sendBrightnessLevelToGateWay() per encoder detent", 5,  2000 },
+};
+const uint8_t blockingCallCount = sizeof( blockingCalls ) / sizeof( blockingCalls[ 0 ] );
+
+/*
+  xorshift32 pseudo random generator, so each run simulates the same sequence of blocking calls.
+*/
+uint32_t randomState = 2463534242UL;
+uint32_t nextRandom() {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+/*
+  Runs the simulation and returns the deviation from the step duration of each fade step.
+*/
+std::vector<long> simulate( bool useFrameTimer ) {
+  AnimationScheduler<2> animations( JITTER_PWM_PINS );
+  std::vector<long> deviations;
+  unsigned long loopBlockedUntil = 0;
+  unsigned long lastStep[ 2 ] = { 0, 0 };
+  unsigned long lastWriteCount[ 2 ] = { 0, 0 };
+  bool          stepInFade[ 2 ] = { false, false };
+  uint8_t       targets[ 2 ] = { 100, 100 };
+
+  randomState = 2463534242UL;
+  hostSetMillis( 0 );
+  hostResetPwmWriteCounts();
+  if ( useFrameTimer ) {
+    animations.startFrameTimer( JITTER_FRAME_RATE );
+  }
+
+  // Registers the fade steps (PWM writes) since the previous call
+  auto registerSteps = [&]( unsigned long now ) {
+    for ( uint8_t channel = 0; channel < 2; channel++ ) {
+      if ( hostPwmWriteCount( JITTER_PWM_PINS[ channel ] ) != lastWriteCount[ channel ] ) {
+        lastWriteCount[ channel ] = hostPwmWriteCount( JITTER_PWM_PINS[ channel ] );
+        if ( stepInFade[ channel ] ) {
+          deviations.push_back( (long)( now - lastStep[ channel ] ) - animationStepDuration );
+        }
+        lastStep[ channel ] = now;
+        stepInFade[ channel ] = true;
+      }
+    }
+  };
+
+  for ( unsigned long now = 0; now < JITTER_DURATION; now++ ) {
+    hostSetMillis( now );
+
+    if ( useFrameTimer && now % ( 1000 / JITTER_FRAME_RATE ) == 0 ) {
+      frameTimerTick();
+      registerSteps( now );
+    }
+
+    if ( now >= loopBlockedUntil ) {
+      for ( uint8_t channel = 0; channel < 2; channel++ ) {
+        if ( animations.animationFinished( channel ) ) {
+          // Fade between 100 and 255, in that range each step changes the PWM value, so each step is a PWM write
+          targets[ channel ] = targets[ channel ] == 100 ? 255 : 100;
+          animations.fadeToBrightnessLevel( channel, targets[ channel ] );
+          stepInFade[ channel ] = false;
+        }
+      }
+      animations.checkAnimation( now );
+      registerSteps( now );
+
+      for ( uint8_t call = 0; call < blockingCallCount; call++ ) {
+        if ( nextRandom() % blockingCalls[ call ].interval == 0 ) {
+          loopBlockedUntil = now + blockingCalls[ call ].duration;
+        }
+      }
+    }
+  }
+  return deviations;
+}
+
+/*
+  Prints the statistics of the given deviations.
+*/
+void report( const char *name, std::vector<long> deviations ) {
+  std::sort( deviations.begin(), deviations.end() );
+  long total = 0;
+  size_t late = 0;
+  for ( size_t index = 0; index < deviations.size(); index++ ) {
+    total += deviations[ index ];
+    late += deviations[ index ] > 1 ? 1 : 0;
+  }
+  printf( "  %-16s %7zu steps  mean %+5.2f ms  p50 %+3ld ms  p99.9 %+3ld ms  max %+3ld ms  %zu steps late by more than 1 ms\n",
+          name, deviations.size(), (double)total / deviations.size(), deviations[ deviations.size() / 2 ],
+          deviations[ deviations.size() * 999 / 1000 ], deviations.back(), late );
+}
+
+int main() {
+  printf( "Blocking calls in the main loop\n" );
+  for ( uint8_t call = 0; call < blockingCallCount; call++ ) {
+    printf( "  %-52s %3lu ms every %5lu ms\n", blockingCalls[ call ].name, blockingCalls[ call ].duration, blockingCalls[ call ].interval );
+  }
+
+  printf( "\nFade step jitter (deviation from %u ms) over %lu minutes\n", animationStepDuration, JITTER_DURATION / 60000 );
+  report( "loop (polling)", simulate( false ) );
+  report( "frame timer", simulate( true ) );
+  return 0;
+}
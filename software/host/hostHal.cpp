@@ -0,0 +1,230 @@
+#include <string.h>
+#include "hal.h"
+
+/*
+  The state of the simulated hardware. Pins that aren't driven by the simulation read HIGH, like an
+  open switch on an INPUT_PULLUP pin.
+*/
+static unsigned long hostMillis = 0;
+static unsigned long hostMicrosValue = 0;    // Wraps around like micros()
+static unsigned long hostMicrosFraction = 0; // The us since the last whole ms of hostAdvanceMicros()
+static uint8_t       hostPinLevels[ HOST_PIN_COUNT ] = { HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH,
+                                                         HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH };
+static uint8_t       hostPwmValues[ HOST_PIN_COUNT ];
+static unsigned long hostPwmWrites[ HOST_PIN_COUNT ];
+static hostPinChangeCallback pinChangeCallback = NULL;
+static hostPwmWriteCallback  pwmWriteCallback = NULL;
+static uint8_t       hostEeprom[ HOST_EEPROM_SIZE ];
+static bool          hostEepromErased = false;
+static unsigned long hostEepromWrites = 0;
+static unsigned long hostEepromCellWrites[ HOST_EEPROM_SIZE ];
+static unsigned long hostEepromBusyUntil = 0;
+static uint16_t      hostVccMillivolts = 4500; // 3 fresh AA cells
+
+
+//                              HAL functions
+
+/*
+  Returns the virtual clock.
+*/
+unsigned long halMillis() {
+  return hostMillis;
+}
+
+/*
+  Stores the written PWM value, counts the write and calls the PWM write callback. Writes to pins that don't exist are
+  ignored, like analogWrite() does.
+*/
+void halPwmWrite( uint8_t pin, uint8_t value ) {
+  if ( pin < HOST_PIN_COUNT ) {
+    hostPwmValues[ pin ] = value;
+    hostPwmWrites[ pin ]++;
+    if ( pwmWriteCallback != NULL ) {
+      pwmWriteCallback( pin, value );
+    }
+  }
+}
+
+/*
+  Pin modes aren't simulated, the level of a pin is fully controlled by the simulation.
+*/
+void halPinMode( uint8_t pin, uint8_t mode ) {
+  (void)pin;
+  (void)mode;
+}
+
+/*
+  Returns the level of the given pin as set by the simulation.
+*/
+uint8_t halDigitalRead( uint8_t pin ) {
+  return pin < HOST_PIN_COUNT ? hostPinLevels[ pin ] : LOW;
+}
+
+
+/*
+  Returns the levels of the pins of the given port, composed from the simulated pins.
+*/
+uint8_t halReadPort( uint8_t port ) {
+  uint8_t levels = 0;
+  for ( uint8_t pin = 0; pin < HOST_PIN_COUNT; pin++ ) {
+    if ( halPinPort( pin ) == port && hostPinLevels[ pin ] == HIGH ) {
+      levels |= halPinMask( pin );
+    }
+  }
+  return levels;
+}
+
+/*
+  Returns the given byte of the simulated EEPROM, bytes that don't exist read 0xFF.
+*/
+uint8_t halEepromRead( uint16_t address ) {
+  if ( !hostEepromErased ) {
+    memset( hostEeprom, 0xFF, sizeof( hostEeprom ) );
+    hostEepromErased = true;
+  }
+  return address < HOST_EEPROM_SIZE ? hostEeprom[ address ] : 0xFF;
+}
+
+/*
+  Reads the given amount of bytes of the simulated EEPROM from the given address into the buffer.
+*/
+void halEepromReadBlock( void *buffer, uint16_t address, uint8_t length ) {
+  for ( uint8_t index = 0; index < length; index++ ) {
+    ( (uint8_t *)buffer )[ index ] = halEepromRead( address + index );
+  }
+}
+
+/*
+  Writes the given byte of the simulated EEPROM if it differs from the stored value, like eeprom_update_byte(). The
+  write keeps the EEPROM busy for HOST_EEPROM_WRITE_MILLIS. The virtual clock doesn't move by itself, so unlike on the
+  node the write doesn't wait for a previous write.
+*/
+void halEepromUpdate( uint16_t address, uint8_t value ) {
+  if ( address < HOST_EEPROM_SIZE && halEepromRead( address ) != value ) {
+    hostEeprom[ address ] = value;
+    hostEepromWrites++;
+    hostEepromCellWrites[ address ]++;
+    hostEepromBusyUntil = hostMillis + HOST_EEPROM_WRITE_MILLIS;
+  }
+}
+
+/*
+  Returns true when the last write is done.
+*/
+bool halEepromReady() {
+  return (long)( hostMillis - hostEepromBusyUntil ) >= 0;
+}
+
+
+//                              Simulation controls
+
+/*
+  Sets the virtual clock to the given amount of milliseconds.
+*/
+void hostSetMillis( unsigned long ms ) {
+  hostMillis = ms;
+  hostMicrosValue = ms * 1000;
+  hostMicrosFraction = 0;
+}
+
+/*
+  Moves the virtual clock the given amount of milliseconds forward.
+*/
+void hostAdvanceMillis( unsigned long ms ) {
+  hostMillis += ms;
+  hostMicrosValue += ms * 1000;
+}
+
+/*
+  Moves the virtual clock the given amount of microseconds forward, millis() moves once a whole ms has passed.
+*/
+void hostAdvanceMicros( unsigned long us ) {
+  hostMicrosValue += us;
+  hostMicrosFraction += us;
+  hostMillis += hostMicrosFraction / 1000;
+  hostMicrosFraction %= 1000;
+}
+
+/*
+  Returns the microseconds of the virtual clock.
+*/
+unsigned long hostMicros() {
+  return hostMicrosValue;
+}
+
+/*
+  Drives the given input pin to the given level (LOW or HIGH). Calls the pin change callback when the level changes.
+*/
+void hostSetPin( uint8_t pin, uint8_t level ) {
+  if ( pin < HOST_PIN_COUNT && hostPinLevels[ pin ] != level ) {
+    hostPinLevels[ pin ] = level;
+    if ( pinChangeCallback != NULL ) {
+      pinChangeCallback( pin );
+    }
+  }
+}
+
+/*
+  Assigns the callback that is called when the simulation changes the level of a pin, NULL for none.
+*/
+void hostSetPinChangeCallback( hostPinChangeCallback callback ) {
+  pinChangeCallback = callback;
+}
+
+/*
+  Assigns the callback that is called for each PWM write, NULL for none.
+*/
+void hostSetPwmWriteCallback( hostPwmWriteCallback callback ) {
+  pwmWriteCallback = callback;
+}
+
+/*
+  Returns the last value written to the given PWM pin.
+*/
+uint8_t hostPwmValue( uint8_t pin ) {
+  return pin < HOST_PIN_COUNT ? hostPwmValues[ pin ] : 0;
+}
+
+/*
+  Returns the amount of PWM writes to the given pin since the last reset.
+*/
+unsigned long hostPwmWriteCount( uint8_t pin ) {
+  return pin < HOST_PIN_COUNT ? hostPwmWrites[ pin ] : 0;
+}
+
+/*
+  Returns the amount of bytes written to the EEPROM.
+*/
+unsigned long hostEepromWriteCount() {
+  return hostEepromWrites;
+}
+
+/*
+  Returns the amount of writes to the given byte of the EEPROM.
+*/
+unsigned long hostEepromWriteCount( uint16_t address ) {
+  return address < HOST_EEPROM_SIZE ? hostEepromCellWrites[ address ] : 0;
+}
+
+/*
+  Resets the PWM write counters of all pins.
+*/
+void hostResetPwmWriteCounts() {
+  for ( uint8_t pin = 0; pin < HOST_PIN_COUNT; pin++ ) {
+    hostPwmWrites[ pin ] = 0;
+  }
+}
+
+/*
+  Sets the voltage of VCC in mV, which the battery monitor measures.
+*/
+void hostSetVcc( uint16_t millivolts ) {
+  hostVccMillivolts = millivolts;
+}
+
+/*
+  Returns the voltage of VCC in mV.
+*/
+uint16_t hostVcc() {
+  return hostVccMillivolts;
+}
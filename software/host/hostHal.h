@@ -0,0 +1,87 @@
+#ifndef HOST_HAL_H
+#define HOST_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+  Host (Linux) implementation of the hardware abstraction layer in FairyLightLamp/hal.h.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  Instead of real hardware this implementation provides:
+  - a virtual clock, which only moves when the simulation tells it to move. It counts milliseconds, and microseconds
+    for the Timer1 clock (see frameTimer.h).
+  - a PWM sink, which stores the last written value and counts the writes per pin. A callback can watch the writes.
+  - an EEPROM, which starts erased (0xFF) like a new chip and counts the writes per byte. A write keeps it busy for
+    HOST_EEPROM_WRITE_MILLIS of the virtual clock.
+  - digital inputs, which are driven by the simulation (e.g. a benchmark pressing a switch). A change of the level
+    calls the pin change callback, like the pin change interrupt does on the node.
+
+  Revision history:
+    16-10-2026 Initial version.
+    16-10-2026 Pin change callback for the interrupt driven debouncer.
+    16-10-2026 EEPROM.
+    16-10-2026 EEPROM write time and wear per byte.
+    16-10-2026 Microseconds.
+    16-10-2026 PWM write callback.
+    16-10-2026 VCC for the battery monitor.
+    16-10-2026 Block reads of the EEPROM.
+*/
+
+// Arduino constants used by the libraries
+#define LOW          0x0
+#define HIGH         0x1
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+// There's no separate flash address space on the host
+#define PROGMEM
+#define pgm_read_byte( address ) ( *(const uint8_t *)( address ) )
+#define pgm_read_word( address ) ( *(const uint16_t *)( address ) )
+
+// The amount of pins of the Pro Mini (digital 0-13 and analog 0-5 used as digital pins)
+const uint8_t HOST_PIN_COUNT = 20;
+
+// The size of the EEPROM of the ATmega328P
+const uint16_t HOST_EEPROM_SIZE = 1024;
+
+// The time a byte write keeps the EEPROM busy, 3.3ms on the ATmega328P rounded up to the resolution of the clock
+const uint8_t HOST_EEPROM_WRITE_MILLIS = 4;
+
+// The HAL functions used by the libraries
+unsigned long halMillis();
+void          halPwmWrite( uint8_t pin, uint8_t value );
+void          halPinMode( uint8_t pin, uint8_t mode );
+uint8_t       halDigitalRead( uint8_t pin );
+uint8_t       halReadPort( uint8_t port );
+uint8_t       halEepromRead( uint16_t address );
+void          halEepromReadBlock( void *buffer, uint16_t address, uint8_t length );
+void          halEepromUpdate( uint16_t address, uint8_t value );
+bool          halEepromReady();
+
+// Called when the simulation changes the level of a pin, in place of the pin change interrupt
+typedef void (*hostPinChangeCallback)( uint8_t );
+
+// Called for each PWM write with the pin and the value
+typedef void (*hostPwmWriteCallback)( uint8_t, uint8_t );
+
+// Functions for controlling and inspecting the simulation
+void          hostSetMillis( unsigned long ms );
+void          hostAdvanceMillis( unsigned long ms );
+void          hostAdvanceMicros( unsigned long us );
+unsigned long hostMicros();
+void          hostSetPin( uint8_t pin, uint8_t level );
+void          hostSetPinChangeCallback( hostPinChangeCallback callback );
+void          hostSetPwmWriteCallback( hostPwmWriteCallback callback );
+uint8_t       hostPwmValue( uint8_t pin );
+unsigned long hostPwmWriteCount( uint8_t pin );
+void          hostResetPwmWriteCounts();
+unsigned long hostEepromWriteCount();
+unsigned long hostEepromWriteCount( uint16_t address );
+void          hostSetVcc( uint16_t millivolts );
+uint16_t      hostVcc();
+
+#endif
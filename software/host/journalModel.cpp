@@ -0,0 +1,211 @@
+/*
+  Endurance and latency model of the state journal (see FairyLightLamp/stateJournal.h).
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  Simulates a year of use of a lamp with 3 channels. The usage per day below is an estimate for a lamp that is used
+  actively, change it to model a different situation. Each change of the state is handed to the journal like the
+  sketch does each loop pass, and the journal is updated each millisecond until the record is written.
+
+  The journal is compared with writing the state to a fixed place in the EEPROM on every change (with
+  eeprom_update_byte(), so only the bytes that differ are written), which is what saveState() per change would do.
+  For both the wear of the most written byte and the longest stall of the loop are reported. The EEPROM of the
+  ATmega328P is specified for 100.000 writes per byte.
+
+  Finally the power is cut at every byte of a record write, and it's checked that restore() finds either the
+  previous or the new state.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "stateJournal.h"
+
+const uint8_t       MODEL_CHANNELS = 3;
+const uint16_t      MODEL_DAYS = 365;
+const uint16_t      MODEL_SETTLE_TIME = 2000;
+const unsigned long MODEL_ENDURANCE = 100000;
+const double        MODEL_WRITE_MILLIS = 3.3; // The time the loop waits for an EEPROM byte write on the ATmega328P
+
+/*
+  The use of the lamp per day.
+*/
+const uint8_t MODEL_TOGGLES_PER_DAY = 6;     // turned on or off with the switch or by the controller
+const uint8_t MODEL_SPINS_PER_DAY = 10;      // brightness changes with the encoder
+const uint8_t MODEL_DETENTS_PER_SPIN = 5;    // one detent per 100ms
+const uint8_t MODEL_LONG_PRESS_INTERVAL = 7; // days between two long presses
+
+struct LampState {
+  bool    powerState;
+  uint8_t brightness[ MODEL_CHANNELS ];
+  uint8_t storedBrightness[ MODEL_CHANNELS ];
+};
+
+/*
+  Converts the given state to a journal payload, with the layout the sketch uses (see config.h).
+*/
+void toPayload( const LampState &state, uint8_t *payload ) {
+  memset( payload, 0, JOURNAL_PAYLOAD_SIZE );
+  for ( uint8_t channel = 0; channel < MODEL_CHANNELS; channel++ ) {
+    payload[ 0 ] |= state.powerState ? 1 << channel : 0;
+    payload[ 1 + channel ] = state.brightness[ channel ];
+    payload[ 1 + MODEL_CHANNELS + channel ] = state.storedBrightness[ channel ];
+  }
+}
+
+/*
+  The state written to a fixed place on every change, like saveState() does.
+*/
+uint8_t       fixedState[ JOURNAL_PAYLOAD_SIZE ];
+unsigned long fixedWrites[ JOURNAL_PAYLOAD_SIZE ];
+unsigned long fixedLongestStall = 0; // bytes written by a single change
+
+void writeFixed( const uint8_t *payload ) {
+  unsigned long written = 0;
+  for ( uint8_t index = 0; index < JOURNAL_PAYLOAD_SIZE; index++ ) {
+    if ( fixedState[ index ] != payload[ index ] ) {
+      fixedState[ index ] = payload[ index ];
+      fixedWrites[ index ]++;
+      written++;
+    }
+  }
+  fixedLongestStall = written > fixedLongestStall ? written : fixedLongestStall;
+}
+
+/*
+  Hands the given state to the journal and to the fixed place, and runs the loop for the given amount of ms.
+*/
+unsigned long journalChanges = 0;
+
+void change( StateJournal &journal, const LampState &state, unsigned long loopMillis ) {
+  uint8_t payload[ JOURNAL_PAYLOAD_SIZE ];
+  toPayload( state, payload );
+  journal.store( payload, halMillis() );
+  writeFixed( payload );
+  journalChanges++;
+  for ( unsigned long cnt = 0; cnt < loopMillis; cnt++ ) {
+    hostAdvanceMillis( 1 );
+    journal.update( halMillis() );
+  }
+}
+
+/*
+  Runs the loop until the journal has written the last state and returns the ms it took.
+*/
+unsigned long settle( StateJournal &journal ) {
+  unsigned long duration = 0;
+  while ( !journal.isIdle() ) {
+    hostAdvanceMillis( 1 );
+    journal.update( halMillis() );
+    duration++;
+  }
+  return duration;
+}
+
+/*
+  Simulates a year of use and reports the wear and the stalls of the journal and of the fixed place.
+*/
+void reportEndurance() {
+  StateJournal journal( EEPROM_JOURNAL_ADDRESS, EEPROM_JOURNAL_SIZE, MODEL_SETTLE_TIME );
+  LampState state = { false, { 5, 5, 5 }, { 5, 5, 5 } };
+  unsigned long longestSettle = 0;
+  unsigned long eepromWrites = hostEepromWriteCount();
+
+  for ( uint16_t day = 0; day < MODEL_DAYS; day++ ) {
+    for ( uint8_t toggle = 0; toggle < MODEL_TOGGLES_PER_DAY; toggle++ ) {
+      state.powerState = !state.powerState;
+      change( journal, state, 0 );
+      unsigned long duration = settle( journal );
+      longestSettle = duration > longestSettle ? duration : longestSettle;
+
+      if ( state.powerState ) {
+        for ( uint8_t spin = 0; spin < MODEL_SPINS_PER_DAY / ( MODEL_TOGGLES_PER_DAY / 2 ); spin++ ) {
+          bool up = ( day + spin ) % 2 == 0;
+          for ( uint8_t detent = 0; detent < MODEL_DETENTS_PER_SPIN; detent++ ) {
+            for ( uint8_t channel = 0; channel < MODEL_CHANNELS; channel++ ) {
+              state.brightness[ channel ] += up ? 1 : -1;
+            }
+            change( journal, state, 100 );
+          }
+          settle( journal );
+        }
+        if ( day % MODEL_LONG_PRESS_INTERVAL == 0 && toggle == 0 ) {
+          memcpy( state.storedBrightness, state.brightness, MODEL_CHANNELS );
+          change( journal, state, 0 );
+          settle( journal );
+        }
+      }
+    }
+  }
+
+  unsigned long journalMax = 0;
+  for ( uint16_t address = EEPROM_JOURNAL_ADDRESS; address < EEPROM_JOURNAL_ADDRESS + EEPROM_JOURNAL_SIZE; address++ ) {
+    journalMax = hostEepromWriteCount( address ) > journalMax ? hostEepromWriteCount( address ) : journalMax;
+  }
+  unsigned long fixedMax = 0;
+  unsigned long fixedTotal = 0;
+  for ( uint8_t index = 0; index < JOURNAL_PAYLOAD_SIZE; index++ ) {
+    fixedMax = fixedWrites[ index ] > fixedMax ? fixedWrites[ index ] : fixedMax;
+    fixedTotal += fixedWrites[ index ];
+  }
+
+  printf( "State changes in %u days: %lu, journal records written: %u (%u slots of %u bytes)\n\n", MODEL_DAYS, journalChanges,
+          journal.getSequence(), journal.getSlotCount(), JOURNAL_RECORD_SIZE );
+  printf( "  %-24s %14s %14s %14s %18s\n", "", "bytes written", "max per byte", "years to 100k", "longest loop stall" );
+  printf( "  %-24s %14lu %14lu %14.0f %15.1f ms\n", "fixed place per change", fixedTotal, fixedMax,
+          (double)MODEL_ENDURANCE / fixedMax * MODEL_DAYS / 365, fixedLongestStall * MODEL_WRITE_MILLIS );
+  printf( "  %-24s %14lu %14lu %14.0f %15.1f ms\n", "journal", hostEepromWriteCount() - eepromWrites, journalMax,
+          (double)MODEL_ENDURANCE / journalMax * MODEL_DAYS / 365, 0.0 );
+  printf( "\n  The journal writes a byte only when the EEPROM is ready, a change is in the EEPROM %lu ms after the last change.\n",
+          longestSettle );
+  printf( "  restore() reads %u bytes at boot.\n", journal.getSlotCount() * JOURNAL_RECORD_SIZE );
+}
+
+/*
+  Cuts the power at every byte of a record write and reports if the previous or the new state was restored.
+*/
+void reportPowerCuts() {
+  uint8_t previous[ JOURNAL_PAYLOAD_SIZE ];
+  uint8_t next[ JOURNAL_PAYLOAD_SIZE ];
+  uint8_t restored[ JOURNAL_PAYLOAD_SIZE ];
+  uint16_t previousCount = 0, nextCount = 0, failed = 0;
+
+  for ( uint8_t cut = 0; cut <= JOURNAL_RECORD_SIZE; cut++ ) {
+    StateJournal journal( EEPROM_JOURNAL_ADDRESS, EEPROM_JOURNAL_SIZE, MODEL_SETTLE_TIME );
+    journal.restore( previous );
+    memcpy( next, previous, JOURNAL_PAYLOAD_SIZE );
+    next[ 1 ] ^= 0x0F;
+    next[ 7 ] += 1;
+
+    journal.store( next, halMillis() );
+    hostAdvanceMillis( MODEL_SETTLE_TIME );
+    journal.update( halMillis() ); // Starts the record
+    for ( uint8_t written = 0; written < cut; written++ ) {
+      hostAdvanceMillis( HOST_EEPROM_WRITE_MILLIS );
+      journal.update( halMillis() );
+    }
+
+    StateJournal rebooted( EEPROM_JOURNAL_ADDRESS, EEPROM_JOURNAL_SIZE, MODEL_SETTLE_TIME );
+    if ( !rebooted.restore( restored ) ) {
+      failed++;
+    }
+    else if ( memcmp( restored, previous, JOURNAL_PAYLOAD_SIZE ) == 0 ) {
+      previousCount++;
+    }
+    else if ( memcmp( restored, next, JOURNAL_PAYLOAD_SIZE ) == 0 ) {
+      nextCount++;
+    }
+    else {
+      failed++;
+    }
+  }
+  printf( "\nPower cut after 0 - %u bytes of a record: %u times the previous state, %u times the new state, %u failed\n",
+          JOURNAL_RECORD_SIZE, previousCount, nextCount, failed );
+}
+
+int main() {
+  reportEndurance();
+  reportPowerCuts();
+  return 0;
+}
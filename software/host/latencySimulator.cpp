@@ -0,0 +1,357 @@
+/*
+  Trace driven simulation of the latency from the input of the user (or the controller) to the light.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  Runs the sketch itself (FairyLightLamp.ino, compiled against the stubs in sketchStubs/) with a virtual clock and
+  replays a trace of events: clicks of the switch, detents of the encoder and V_DIMMER messages of the gateway. For each
+  event it measures the time from the start of the event (the first edge of the switch or the encoder, the arrival of
+  the message) to the first PWM change of a channel, and to the last PWM change, which is the end of the fade. So a
+  change of the control path (e.g. the click timeout, the pacing of the outbox, the frame timer) can be judged by
+  numbers.
+
+  The sketch runs like on the node: before(), presentation() and setup(), followed by loop() with the received messages
+  passed to receive() between two passes. A pass takes no time, except for what blocks the sketch:
+  - delay() and the idle sleep at the end of each pass, which lasts until the next millisecond.
+  - each message sent by the sketch, SIM_SEND_MICROS when the parent node acks it. SIM_LOSS_PER_MILLE of the messages
+    don't get through, these block for SIM_FAILED_SEND_MICROS (all retries of the radio). The controller echoes an acked
+    message, and answers a time request, after SIM_ECHO_MICROS.
+  The edges of the switch and the encoder happen at their time, also while the sketch is blocked, like the pin change
+  interrupt does. The radio times are assumptions for an NRF24 at 250kbps with the MySensors defaults, not
+  measurements. The frame timer (ANIMATION_TIMER_ISR) is ticked at 100 frames per second, its default frame rate.
+
+  The trace is read from the file given as argument, or else a synthetic trace of SIM_EVENT_COUNT random events is used.
+  Each line of a trace file is an event: the time in ms (from the end of setup()), the kind and its arguments.
+    <ms> switch [<pressed ms>]        a click, pressed for 80ms by default
+    <ms> encoder <+1 | -1>            a detent clockwise (+1) or counter clockwise (-1)
+    <ms> dimmer <channel> <1 - 100>   a V_DIMMER message of the gateway for the given channel (0 - 2)
+  Lines starting with # are comments. The events should be far enough apart for the fade of the previous event to end,
+  a PWM change is counted for the last event that started.
+
+    ./build/fairylight_latency [trace.txt]
+*/
+
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+#include <MySensors.h>
+#include "frameTimer.h"
+
+// The pins and the first dimmer child of the sketch (see FairyLightLamp.ino and config.h)
+const uint8_t SIM_CHANNEL_PINS[ 3 ] = { 5, 6, 3 };
+const uint8_t SIM_SWITCH_PIN = 7;
+const uint8_t SIM_ENCODER_FIRST_PIN = 2;
+const uint8_t SIM_ENCODER_SECOND_PIN = 4;
+const uint8_t SIM_CHILD_ID_LIGHT = 1;
+
+const unsigned long SIM_SEND_MICROS = 2000;
+const unsigned long SIM_FAILED_SEND_MICROS = 40000;
+const uint16_t      SIM_LOSS_PER_MILLE = 20;
+const unsigned long SIM_ECHO_MICROS = 30000;
+const unsigned long SIM_FRAME_MICROS = 10000;
+const unsigned long SIM_CONTROLLER_EPOCH = 1792000000; // The controller time at the start, in seconds
+const unsigned long SIM_SETTLE_MICROS = 3000000;    // The time the simulation runs after the last event
+const unsigned long SIM_BOUNCE_MICROS = 1000;       // The time between the edges of the contact bounce of the switch
+const unsigned long SIM_ENCODER_EDGE_MICROS = 3000; // The time between the edges of a detent
+const uint16_t      SIM_EVENT_COUNT = 1000;
+
+enum EventKind { EVENT_SWITCH, EVENT_ENCODER, EVENT_DIMMER, EVENT_KINDS };
+const char *eventNames[ EVENT_KINDS ] = { "switch click", "encoder detent", "gateway V_DIMMER" };
+
+/*
+  An event of the trace and its measured latencies, 0 when the light didn't change.
+*/
+struct TraceEvent {
+  unsigned long at;          // ms from the end of setup()
+  EventKind     kind;
+  int           arguments[ 2 ];
+  unsigned long startedAt;   // us of the virtual clock
+  unsigned long firstChange; // us from the start
+  unsigned long lastChange;  // us from the start
+};
+
+/*
+  Something that happens at a moment of the virtual clock: an edge of a pin or the arrival of a message. The first
+  action of an event starts the event.
+*/
+struct PendingAction {
+  uint8_t   pin;
+  uint8_t   level;
+  bool      isMessage;
+  MyMessage message;
+  int       event; // The event this action starts, -1 for none
+};
+
+std::vector<TraceEvent>                     events;
+std::multimap<unsigned long, PendingAction> actions;  // By the us of the virtual clock
+std::vector<MyMessage>                      received; // The received messages, passed to receive() before the next loop()
+int                                         currentEvent = -1;
+unsigned long                               nextFrameAt = SIM_FRAME_MICROS;
+unsigned long                               randomState = 1;
+unsigned long                               sentMessages = 0;
+unsigned long                               lostMessages = 0;
+
+/*
+  Returns a pseudo random number (0 - 32767), the same sequence for every run.
+*/
+unsigned long nextRandom() {
+  randomState = randomState * 1103515245 + 12345;
+  return ( randomState >> 16 ) & 0x7FFF;
+}
+
+/*
+  Moves the virtual clock to the given us, with the ticks of the frame timer on the way.
+*/
+void advanceClockTo( unsigned long target ) {
+  while ( nextFrameAt <= target ) {
+    hostAdvanceMicros( nextFrameAt - hostMicros() );
+    frameTimerTick();
+    nextFrameAt += SIM_FRAME_MICROS;
+  }
+  hostAdvanceMicros( target - hostMicros() );
+}
+
+/*
+  Wait handler of the sketch: moves the virtual clock the given amount of us forward and performs the actions that
+  happen in the mean time.
+*/
+void wait( unsigned long us ) {
+  unsigned long target = hostMicros() + us;
+  while ( !actions.empty() && actions.begin()->first <= target ) {
+    advanceClockTo( actions.begin()->first );
+    PendingAction action = actions.begin()->second;
+    actions.erase( actions.begin() );
+
+    if ( action.event >= 0 ) {
+      currentEvent = action.event;
+      events[ currentEvent ].startedAt = hostMicros();
+    }
+    if ( action.isMessage ) {
+      received.push_back( action.message );
+    }
+    else {
+      hostSetPin( action.pin, action.level );
+    }
+  }
+  advanceClockTo( target );
+}
+
+/*
+  Send handler of the sketch: blocks for the time the radio takes and returns whether the message got through. The
+  controller echoes an acked message and answers a time request.
+*/
+bool onSend( const MyMessage &message, bool ack ) {
+  sentMessages++;
+  bool delivered = nextRandom() % 1000 >= SIM_LOSS_PER_MILLE;
+  lostMessages += delivered ? 0 : 1;
+  wait( delivered ? SIM_SEND_MICROS : SIM_FAILED_SEND_MICROS );
+
+  if ( delivered && ( ack || ( message.sensor == 255 && message.type == HOST_SKETCH_TIME ) ) ) {
+    PendingAction echo = { 0, 0, true, message, -1 };
+    echo.message.setEcho( ack ).setDestination( HOST_SKETCH_NODE_ID );
+    actions.insert( std::make_pair( hostMicros() + SIM_ECHO_MICROS, echo ) );
+  }
+  return delivered;
+}
+
+/*
+  Counts a PWM write of a channel for the current event.
+*/
+void onPwmWrite( uint8_t pin, uint8_t value ) {
+  (void)value;
+  if ( currentEvent < 0 || std::find( SIM_CHANNEL_PINS, SIM_CHANNEL_PINS + 3, pin ) == SIM_CHANNEL_PINS + 3 ) {
+    return;
+  }
+  TraceEvent &event = events[ currentEvent ];
+  unsigned long latency = hostMicros() - event.startedAt;
+  if ( event.firstChange == 0 ) {
+    event.firstChange = latency == 0 ? 1 : latency;
+  }
+  event.lastChange = latency == 0 ? 1 : latency;
+}
+
+/*
+  Adds an edge of the given pin at the given us.
+*/
+void addEdge( unsigned long at, uint8_t pin, uint8_t level, int event ) {
+  PendingAction action = { pin, level, false, MyMessage(), event };
+  actions.insert( std::make_pair( at, action ) );
+}
+
+/*
+  Turns the event with the given index into the actions that replay it, from the given us (the end of setup()).
+*/
+void addActions( int index, unsigned long origin ) {
+  const TraceEvent &event = events[ index ];
+  unsigned long at = origin + event.at * 1000;
+
+  if ( event.kind == EVENT_SWITCH ) {
+    // Press with 5 bouncing edges, hold and release with 5 bouncing edges
+    unsigned long releasedAt = at + event.arguments[ 0 ] * 1000UL;
+    for ( uint8_t bounce = 0; bounce < 5; bounce++ ) {
+      addEdge( at + bounce * SIM_BOUNCE_MICROS, SIM_SWITCH_PIN, bounce % 2 == 0 ? LOW : HIGH, bounce == 0 ? index : -1 );
+      addEdge( releasedAt + bounce * SIM_BOUNCE_MICROS, SIM_SWITCH_PIN, bounce % 2 == 0 ? HIGH : LOW, -1 );
+    }
+    addEdge( at + 5 * SIM_BOUNCE_MICROS, SIM_SWITCH_PIN, LOW, -1 );
+    addEdge( releasedAt + 5 * SIM_BOUNCE_MICROS, SIM_SWITCH_PIN, HIGH, -1 );
+  }
+  else if ( event.kind == EVENT_ENCODER ) {
+    // The states of the pins (first pin bit 1, second pin bit 0) from one detent to the next, see quadratureEncoder.cpp
+    const uint8_t clockwise[ 4 ] = { 2, 0, 1, 3 };
+    const uint8_t counterClockwise[ 4 ] = { 1, 0, 2, 3 };
+    const uint8_t *states = event.arguments[ 0 ] > 0 ? clockwise : counterClockwise;
+    uint8_t previous = 3;
+    for ( uint8_t edge = 0; edge < 4; edge++ ) {
+      uint8_t changed = states[ edge ] ^ previous;
+      uint8_t pin = changed & 2 ? SIM_ENCODER_FIRST_PIN : SIM_ENCODER_SECOND_PIN;
+      addEdge( at + edge * SIM_ENCODER_EDGE_MICROS, pin, states[ edge ] & changed ? HIGH : LOW, edge == 0 ? index : -1 );
+      previous = states[ edge ];
+    }
+  }
+  else {
+    PendingAction action = { 0, 0, true, MyMessage( SIM_CHILD_ID_LIGHT + event.arguments[ 0 ], V_DIMMER ), index };
+    action.message.setDestination( HOST_SKETCH_NODE_ID ).set( (int16_t)event.arguments[ 1 ] );
+    action.message.sender = 0;
+    actions.insert( std::make_pair( at, action ) );
+  }
+}
+
+/*
+  Reads the trace from the given file. Returns false when it can't be read.
+*/
+bool readTrace( const char *fileName ) {
+  FILE *file = fopen( fileName, "r" );
+  if ( file == NULL ) {
+    return false;
+  }
+  char line[ 128 ];
+  while ( fgets( line, sizeof( line ), file ) != NULL ) {
+    TraceEvent event = { 0, EVENT_SWITCH, { 80, 0 }, 0, 0, 0 };
+    char kind[ 16 ];
+    int  arguments = sscanf( line, "%lu %15s %d %d", &event.at, kind, &event.arguments[ 0 ], &event.arguments[ 1 ] );
+    if ( line[ 0 ] == '#' || arguments < 2 ) {
+      continue;
+    }
+    if ( strcmp( kind, "encoder" ) == 0 && arguments == 3 ) {
+      event.kind = EVENT_ENCODER;
+    }
+    else if ( strcmp( kind, "dimmer" ) == 0 && arguments == 4 && event.arguments[ 0 ] >= 0 && event.arguments[ 0 ] < 3 ) {
+      event.kind = EVENT_DIMMER;
+    }
+    else if ( strcmp( kind, "switch" ) != 0 ) {
+      fprintf( stderr, "Skipped: %s", line );
+      continue;
+    }
+    events.push_back( event );
+  }
+  fclose( file );
+  std::stable_sort( events.begin(), events.end(), []( const TraceEvent &a, const TraceEvent &b ) { return a.at < b.at; } );
+  return true;
+}
+
+/*
+  Generates a trace of random events, 2.5 - 4.5 seconds apart.
+*/
+void generateTrace() {
+  unsigned long at = 0;
+  for ( uint16_t cnt = 0; cnt < SIM_EVENT_COUNT; cnt++ ) {
+    at += 2500 + nextRandom() % 2000;
+    TraceEvent event = { at, (EventKind)( nextRandom() % EVENT_KINDS ), { 80, 0 }, 0, 0, 0 };
+    if ( event.kind == EVENT_ENCODER ) {
+      event.arguments[ 0 ] = nextRandom() % 2 == 0 ? 1 : -1;
+    }
+    else if ( event.kind == EVENT_DIMMER ) {
+      event.arguments[ 0 ] = nextRandom() % 3;
+      event.arguments[ 1 ] = 1 + nextRandom() % 100;
+    }
+    events.push_back( event );
+  }
+}
+
+/*
+  Returns the given percentile (0 - 100) of the sorted latencies, nearest rank.
+*/
+double percentile( const std::vector<unsigned long> &latencies, double rank ) {
+  size_t index = (size_t)( rank / 100 * latencies.size() + 0.999999 );
+  return latencies[ index == 0 ? 0 : index - 1 ] / 1000.0;
+}
+
+/*
+  Prints the percentiles of the latencies of the events of each kind.
+*/
+void report() {
+  printf( "  %-18s %6s %8s   %-29s %s\n", "", "events", "no light", "first PWM change p50/p99/max", "fade completed p50/p99/max" );
+  for ( uint8_t kind = 0; kind < EVENT_KINDS; kind++ ) {
+    std::vector<unsigned long> first, completed;
+    unsigned long count = 0;
+    for ( const TraceEvent &event : events ) {
+      if ( event.kind == kind ) {
+        count++;
+        if ( event.firstChange != 0 ) {
+          first.push_back( event.firstChange );
+          completed.push_back( event.lastChange );
+        }
+      }
+    }
+    printf( "  %-18s %6lu %8lu", eventNames[ kind ], count, count - first.size() );
+    if ( first.empty() ) {
+      printf( "\n" );
+      continue;
+    }
+    std::sort( first.begin(), first.end() );
+    std::sort( completed.begin(), completed.end() );
+    printf( "   %7.1f %7.1f %7.1f ms   %7.1f %7.1f %7.1f ms\n", percentile( first, 50 ), percentile( first, 99 ),
+            percentile( first, 100 ), percentile( completed, 50 ), percentile( completed, 99 ), percentile( completed, 100 ) );
+  }
+}
+
+int main( int argc, char *argv[] ) {
+  if ( argc > 1 ) {
+    if ( !readTrace( argv[ 1 ] ) ) {
+      fprintf( stderr, "Can't read %s\n", argv[ 1 ] );
+      return 1;
+    }
+  }
+  else {
+    generateTrace();
+  }
+
+  hostSketchSetWaitHandler( wait );
+  hostSketchSetSendHandler( onSend );
+  hostSetPwmWriteCallback( onPwmWrite );
+
+  before();
+  presentation();
+  setup();
+  unsigned long setupDone = hostMicros();
+  for ( size_t index = 0; index < events.size(); index++ ) {
+    addActions( index, setupDone );
+  }
+  unsigned long end = ( actions.empty() ? setupDone : actions.rbegin()->first ) + SIM_SETTLE_MICROS;
+
+  while ( hostMicros() < end ) {
+    while ( !received.empty() ) {
+      MyMessage message = received.front();
+      received.erase( received.begin() );
+      if ( message.sensor == 255 && message.type == HOST_SKETCH_TIME ) {
+        receiveTime( SIM_CONTROLLER_EPOCH + hostMicros() / 1000000 );
+      }
+      else {
+        receive( message );
+      }
+    }
+    loop();
+  }
+
+  printf( "Input to light latency, %s (%lu events, %.0f minutes)\n", argc > 1 ? argv[ 1 ] : "synthetic trace",
+          (unsigned long)events.size(), ( end - setupDone ) / 60e6 );
+  printf( "Radio: %.1f ms per send, %.1f ms per lost send, %.1f%% lost, echo after %.0f ms: %lu sent, %lu lost\n",
+          SIM_SEND_MICROS / 1000.0, SIM_FAILED_SEND_MICROS / 1000.0, SIM_LOSS_PER_MILLE / 10.0, SIM_ECHO_MICROS / 1000.0,
+          sentMessages, lostMessages );
+  report();
+  return 0;
+}
@@ -0,0 +1,61 @@
+#ifndef LEGACY_FADE_H
+#define LEGACY_FADE_H
+
+#include "hal.h"
+
+/*
+  Reference copy of the original floating point SmoothBrightnessTransistion, used by the benchmark to
+  compare the fixed point implementation against. It uses float, because a double is a 32 bit float on
+  the AVR, so the rounding behaviour matches the one of the node.
+*/
+class LegacySmoothBrightnessTransistion {
+  public:
+    LegacySmoothBrightnessTransistion( uint8_t pwmPin ) {
+      this->pwmPin = pwmPin;
+      this->animationStarted = halMillis();
+    }
+
+    void checkAnimation( unsigned long currentMillis ) {
+      if ( !this->isAnimationFinished() ) {
+        if ( currentMillis - this->animationStarted >= animationStepDuration ) {
+          this->animationStarted = currentMillis;
+          this->currentLightLevel += this->stepIncrement;
+
+          if ( this->stepIncrement < 0 ) {
+            if ( this->currentLightLevel < this->targetLightLevel ) {
+              this->currentLightLevel = this->targetLightLevel;
+            }
+          }
+          else {
+            if ( this->currentLightLevel > this->targetLightLevel ) {
+              this->currentLightLevel = this->targetLightLevel;
+            }
+          }
+          halPwmWrite( this->pwmPin, (uint8_t)this->currentLightLevel );
+        }
+      }
+    }
+
+    void setLevel( uint8_t targetLevel ) {
+      this->targetLightLevel = targetLevel;
+      this->stepIncrement = ( (float)this->targetLightLevel - this->currentLightLevel ) / animationSteps;
+      this->animationStarted = halMillis();
+    }
+
+    uint8_t getCurrentBrightnessLevel() {
+      return (uint8_t)this->currentLightLevel;
+    }
+
+    bool isAnimationFinished() {
+      return (uint8_t)this->currentLightLevel == (uint8_t)this->targetLightLevel;
+    }
+  private:
+    uint8_t       pwmPin;
+    float         currentLightLevel = 0.0;
+    float         targetLightLevel = 0.0;
+    float         stepIncrement = 0.0;
+    unsigned long animationStarted;
+    unsigned long animationStepDuration = 50;
+};
+
+#endif
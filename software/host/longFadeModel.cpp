@@ -0,0 +1,132 @@
+/*
+  Model of the awake time of the long fades, the sunrise and the sunset (see LongFadeAnimation in
+  FairyLightLamp/ledAnimation.h).
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  Runs long fades of different durations on an AnimationManager, with the 8 bit PWM and with the dithered PWM. The
+  virtual clock jumps from step to step with getNextChange(), like the node sleeps until the next step. Per fade it
+  reports the amount of steps (the moments the node has to do something for the fade), the shortest, mean and longest
+  time between two steps, the largest change of the duty cycle in one step, and the time the steps took on the host.
+
+  The steps are compared with a fade that steps at a fixed interval, like the 50ms of SmoothBrightnessTransistion: the
+  node would wake up for every step, while most of them don't change the duty cycle at all. The absolute host times
+  say nothing about the ATmega328P, the ratio between the amounts of steps does.
+*/
+
+#include <chrono>
+#include <stdio.h>
+
+#include "animationManager.h"
+#include "ditheredPwm.h"
+
+const uint8_t  MODEL_PWM_PIN = 5;
+const uint8_t  MODEL_PWM_PINS[ 1 ] = { MODEL_PWM_PIN };
+const uint16_t MODEL_FIXED_STEP = 50; // ms, the step of SmoothBrightnessTransistion
+
+/*
+  A PWM sink that passes the duty cycles on to the given sink and keeps track of the writes.
+*/
+template<typename Sink> struct RecordingSink {
+  static unsigned long writes;
+  static uint16_t      lastDuty;
+  static uint16_t      largestStep;
+
+  static inline uint16_t toDuty( uint16_t lightLevel ) {
+    return Sink::toDuty( lightLevel );
+  }
+
+  static inline void write( uint8_t pin, uint16_t duty ) {
+    uint16_t step = duty > lastDuty ? duty - lastDuty : lastDuty - duty;
+    largestStep = step > largestStep ? step : largestStep;
+    lastDuty = duty;
+    writes++;
+    Sink::write( pin, duty );
+  }
+
+  static void reset( uint16_t duty ) {
+    lastDuty = duty;
+    writes = 0;
+    largestStep = 0;
+  }
+};
+
+template<typename Sink> unsigned long RecordingSink<Sink>::writes = 0;
+template<typename Sink> uint16_t      RecordingSink<Sink>::lastDuty = 0;
+template<typename Sink> uint16_t      RecordingSink<Sink>::largestStep = 0;
+
+/*
+  Runs a long fade from the given level to the given target in the given amount of minutes, and prints its steps.
+*/
+template<typename Sink> void reportLongFade( const char *name, uint8_t fromLevel, uint8_t targetLevel, uint8_t minutes ) {
+  typedef RecordingSink<Sink> Recorder;
+  AnimationManager<1, Recorder> animations( MODEL_PWM_PINS );
+
+  // Settle at the start level first
+  animations.fadeToBrightnessLevel( 0, fromLevel );
+  while ( !animations.animationFinished() ) {
+    hostAdvanceMillis( 1 );
+    animations.checkAnimation( halMillis() );
+  }
+
+  Recorder::reset( Sink::toDuty( (uint16_t)fromLevel << 8 ) );
+  unsigned long started = halMillis();
+  unsigned long previousStep = started;
+  unsigned long steps = 0;
+  unsigned long shortestGap = LONG_FADE_NO_CHANGE;
+  unsigned long longestGap = 0;
+  double        hostNanos = 0;
+  animations.startLongFade( 0, targetLevel, minutes );
+  for ( ;; ) {
+    unsigned long nextChange = animations.getNextChange( halMillis() );
+    if ( nextChange == LONG_FADE_NO_CHANGE ) {
+      break;
+    }
+    hostAdvanceMillis( nextChange );
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    animations.checkAnimation( halMillis() );
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    hostNanos += std::chrono::duration<double, std::nano>( end - start ).count();
+
+    // The first step is at the start of the fade, it only looks up the first level to wait for
+    if ( steps > 0 ) {
+      unsigned long gap = halMillis() - previousStep;
+      shortestGap = gap < shortestGap ? gap : shortestGap;
+      longestGap = gap > longestGap ? gap : longestGap;
+    }
+    previousStep = halMillis();
+    steps++;
+  }
+
+  unsigned long duration = halMillis() - started;
+  unsigned long fixedSteps = duration / MODEL_FIXED_STEP;
+  bool          reachedTarget = Recorder::lastDuty == Sink::toDuty( (uint16_t)targetLevel << 8 );
+  printf( "  %-22s %5lu steps %6lu writes %6lu /%6.0f /%7lu ms %4u %6.2f us %6.2f%% %s\n", name, steps, Recorder::writes,
+          shortestGap, steps > 1 ? (double)( duration ) / ( steps - 1 ) : 0.0, longestGap, Recorder::largestStep,
+          hostNanos / 1000 / ( steps > 0 ? steps : 1 ), 100.0 * steps / fixedSteps, reachedTarget ? "" : "(target not reached)" );
+}
+
+/*
+  Runs the fades with the given sink.
+*/
+template<typename Sink> void reportSink() {
+  printf( "  %-22s %11s %13s %28s %4s %9s %7s\n", "", "", "", "gap min / mean / max", "step", "host/step", "of 50ms" );
+  reportLongFade<Sink>( "sunrise 10 min", 0, 255, 10 );
+  reportLongFade<Sink>( "sunrise 30 min", 0, 255, 30 );
+  reportLongFade<Sink>( "sunrise 60 min", 0, 255, 60 );
+  reportLongFade<Sink>( "sunrise 30 min to 60", 0, 60, 30 );
+  reportLongFade<Sink>( "sunset 30 min", 255, 0, 30 );
+  reportLongFade<Sink>( "sunset 60 min from 60", 60, 0, 60 );
+}
+
+int main() {
+  printf( "Long fades, 8 bit PWM (LED_GAMMA_CURVE %d)\n", LED_GAMMA_CURVE );
+  reportSink<LedPwmSink>();
+
+  printf( "\nLong fades, dithered PWM (%u fraction bits)\n", LED_DUTY_FRACTION_BITS );
+  ditheredPwmAttach( MODEL_PWM_PIN );
+  reportSink<DitheredPwmSink>();
+  return 0;
+}
@@ -0,0 +1,297 @@
+/*
+  Simulation of the start of a scene on several nodes (see FairyLightLamp/controllerClock.h).
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  Simulates SIM_NODES lamps and a gateway stand-in for SIM_HOURS. Each node has its own resonator, SIM_MAX_DRIFT ppm
+  off at most and wandering a bit with the temperature, boots at its own moment and has a loop that is blocked now and
+  then (a send with retries). The nodes request the time of the controller with a ControllerClock like the sketch
+  does. The gateway stand-in answers with the controller time in seconds, after a random uplink and downlink latency,
+  and loses SIM_LOSS_PER_MILLE of the requests. The last SIM_REPEATED_NODES nodes are behind a repeater, which adds a
+  hop to every message.
+
+  Every few minutes the controller broadcasts a scene that starts at the second after the next one. A broadcast isn't
+  acked, so the controller sends it SIM_SCENE_COPIES times and a node ignores the copies of a scene it already has.
+  Each node converts the start second to its own millis() and starts the fade at the first loop pass after it, the
+  skew of a scene is the time between the first and the last node that started. It's compared with:
+  - a broadcast that each node starts on reception of its first copy, after a fixed delay: the skew is the spread of
+    the receptions.
+  - a message per node, sent one after the other by the controller (SIM_COMMAND_SPACING apart), which is what
+    Domoticz does for a group of lamps without a scene. These are acked, a lost message is resent
+    (SIM_COMMAND_SPACING later).
+
+  The latencies and the spacing are assumptions for an NRF24 network and a controller on a Raspberry Pi, not
+  measurements. The simulation fails (for ctest) when the p99 skew of the synchronized scenes exceeds SIM_MAX_SKEW.
+
+    ./build/fairylight_scene_sync
+*/
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#include "controllerClock.h"
+
+const uint8_t       SIM_NODES = 8;
+const uint8_t       SIM_HOURS = 6;
+const uint16_t      SIM_MAX_DRIFT = 3000;           // ppm, the spread of the resonators of the nodes
+const uint8_t       SIM_WANDER = 15;                // ppm the drift of a node wanders over a few hours
+const uint16_t      SIM_LOSS_PER_MILLE = 20;
+const uint8_t       SIM_MIN_UPLINK = 4;             // ms from the request to the stamp of the controller
+const uint8_t       SIM_MAX_UPLINK = 25;
+const uint8_t       SIM_MIN_DOWNLINK = 3;           // ms from the controller to the radio of the node
+const uint8_t       SIM_MAX_DOWNLINK = 15;
+const uint8_t       SIM_REPEATED_NODES = 3;         // The last nodes reach the gateway through a repeater
+const uint8_t       SIM_MIN_HOP = 5;                // ms the repeater adds in each direction
+const uint8_t       SIM_MAX_HOP = 20;
+const uint16_t      SIM_BLOCKED_PER_MILLION = 500;  // The chance per ms that the loop of a node gets blocked
+const uint8_t       SIM_MAX_BLOCKED = 40;           // ms the loop is blocked at most
+const uint8_t       SIM_SCENE_COPIES = 3;
+const uint16_t      SIM_SCENE_COPY_SPACING = 250;   // ms between the copies of a scene broadcast
+const uint16_t      SIM_COMMAND_SPACING = 60;       // ms between the messages of the controller to the nodes
+const unsigned long SIM_FIRST_SCENE = 120000;       // ms, the first scene is sent 2 minutes after the start
+const unsigned long SIM_MIN_SCENE_INTERVAL = 120000;
+const unsigned long SIM_MAX_SCENE_INTERVAL = 600000;
+const unsigned long long SIM_CONTROLLER_EPOCH = 1792000000000ULL; // The controller time at the start, in ms
+const uint16_t      SIM_MAX_SKEW = 100;             // ms, about where the nodes visibly start out of step
+
+/*
+  A message on its way to a node: the reply to a time request or a scene broadcast.
+*/
+struct Delivery {
+  unsigned long arrival;  // The true time in ms at which it reaches the node
+  bool          isScene;
+  unsigned long seconds;  // The controller time of the reply, the start second of the scene
+};
+
+/*
+  A simulated node with its own clock.
+*/
+struct Node {
+  double                ppm;            // The drift of the resonator, before the wander
+  double                wanderPhase;
+  unsigned long         bootAt;         // The true time in ms at which the node starts
+  double                local;          // millis() of the node, with its fraction
+  unsigned long         blockedUntil;   // The true time in ms until which the loop is blocked
+  ControllerClock       clock;
+  std::vector<Delivery> deliveries;
+  bool                  sceneWaiting;
+  unsigned long         sceneSecond;    // The start second of the last scene that was received
+  unsigned long         sceneStartAt;   // millis() of the node at which the scene starts
+  unsigned long         sceneStartedAt; // The true time in ms at which the scene started
+  unsigned long         sceneReceivedAt;
+  unsigned long         requests;
+  unsigned long         synchronizedAt; // The true time in ms at which the node got synchronized, 0 when not yet
+};
+
+Node          nodes[ SIM_NODES ];
+unsigned long idealStarts = 0;       // The true time in ms at which the current scene should start
+std::vector<unsigned long> startErrors; // ms between the start of a synchronized node and the ideal start
+unsigned long randomState = 7;
+
+/*
+  Returns a pseudo random number from min up to and including max, the same sequence for every run.
+*/
+unsigned long nextRandom( unsigned long min, unsigned long max ) {
+  randomState = randomState * 1103515245 + 12345;
+  return min + ( ( randomState >> 16 ) & 0x7FFF ) % ( max - min + 1 );
+}
+
+/*
+  Returns the latency in ms of a message from the controller to the given node, or the other way around.
+*/
+unsigned long latency( uint8_t node, uint8_t min, uint8_t max ) {
+  return nextRandom( min, max ) + ( node >= SIM_NODES - SIM_REPEATED_NODES ? nextRandom( SIM_MIN_HOP, SIM_MAX_HOP ) : 0 );
+}
+
+/*
+  Returns the time of the controller at the given true time in ms, in seconds.
+*/
+unsigned long controllerSeconds( unsigned long now ) {
+  return (unsigned long)( ( SIM_CONTROLLER_EPOCH + now ) / 1000 );
+}
+
+/*
+  Returns the given percentile (0 - 100) of the sorted skews, nearest rank.
+*/
+unsigned long percentile( const std::vector<unsigned long> &skews, double rank ) {
+  size_t index = (size_t)( rank / 100 * skews.size() + 0.999999 );
+  return skews[ index == 0 ? 0 : index - 1 ];
+}
+
+/*
+  Prints the p50/p99/max of the given skews and returns the p99.
+*/
+unsigned long reportSkews( const char *name, std::vector<unsigned long> skews ) {
+  if ( skews.empty() ) {
+    printf( "  %-36s no scenes\n", name );
+    return 0;
+  }
+  std::sort( skews.begin(), skews.end() );
+  printf( "  %-36s %6lu %6lu %6lu ms\n", name, percentile( skews, 50 ), percentile( skews, 99 ), percentile( skews, 100 ) );
+  return percentile( skews, 99 );
+}
+
+/*
+  Runs the loop pass of the given node at the given true time in ms.
+*/
+void runNode( uint8_t index, unsigned long now ) {
+  Node &node = nodes[ index ];
+  unsigned long local = (unsigned long)node.local;
+
+  for ( size_t index = 0; index < node.deliveries.size(); ) {
+    Delivery delivery = node.deliveries[ index ];
+    if ( delivery.arrival > now ) {
+      index++;
+      continue;
+    }
+    node.deliveries.erase( node.deliveries.begin() + index );
+    if ( !delivery.isScene ) {
+      node.clock.received( delivery.seconds, local );
+      if ( node.synchronizedAt == 0 && node.clock.isSynchronized( local ) ) {
+        node.synchronizedAt = now;
+      }
+    }
+    else if ( delivery.seconds != node.sceneSecond ) {
+      node.sceneSecond = delivery.seconds;
+      node.sceneReceivedAt = now;
+      node.sceneWaiting = true;
+      node.sceneStartAt = node.clock.isSynchronized( local ) ? node.clock.toLocal( delivery.seconds, local ) : local;
+    }
+  }
+
+  if ( node.sceneWaiting && (long)( local - node.sceneStartAt ) >= 0 ) {
+    node.sceneWaiting = false;
+    node.sceneStartedAt = now;
+    startErrors.push_back( now > idealStarts ? now - idealStarts : idealStarts - now );
+  }
+
+  if ( node.clock.isRequestDue( local ) ) {
+    node.clock.requested( local );
+    node.requests++;
+    if ( nextRandom( 0, 999 ) >= SIM_LOSS_PER_MILLE ) {
+      unsigned long stampedAt = now + latency( index, SIM_MIN_UPLINK, SIM_MAX_UPLINK );
+      Delivery reply = { stampedAt + latency( index, SIM_MIN_DOWNLINK, SIM_MAX_DOWNLINK ), false, controllerSeconds( stampedAt ) };
+      node.deliveries.push_back( reply );
+    }
+  }
+
+  if ( nextRandom( 0, 999999 ) < SIM_BLOCKED_PER_MILLION ) {
+    node.blockedUntil = now + nextRandom( 2, SIM_MAX_BLOCKED );
+  }
+}
+
+int main() {
+  for ( uint8_t index = 0; index < SIM_NODES; index++ ) {
+    Node &node = nodes[ index ];
+    node.ppm = (double)nextRandom( 0, 2 * SIM_MAX_DRIFT ) - SIM_MAX_DRIFT;
+    node.wanderPhase = nextRandom( 0, 628 ) / 100.0;
+    node.bootAt = nextRandom( 0, 10000 );
+    node.local = 0;
+    node.blockedUntil = 0;
+    node.sceneWaiting = false;
+    node.sceneSecond = 0;
+    node.requests = 0;
+    node.synchronizedAt = 0;
+  }
+
+  std::vector<unsigned long> synchronizedSkews, receptionSkews, commandSkews;
+  unsigned long scenes = 0, unsynchronizedScenes = 0;
+  unsigned long nextSceneAt = SIM_FIRST_SCENE;
+  unsigned long sceneSentAt = 0;
+  bool          sceneRunning = false;
+  unsigned long end = SIM_HOURS * 3600000UL;
+
+  for ( unsigned long now = 0; now < end; now++ ) {
+    if ( now == nextSceneAt ) {
+      // Broadcast a scene that starts at the second after the next one of the controller
+      Delivery scene = { 0, true, controllerSeconds( now ) + 2 };
+      idealStarts = (unsigned long)( scene.seconds * 1000ULL - SIM_CONTROLLER_EPOCH );
+      for ( uint8_t index = 0; index < SIM_NODES; index++ ) {
+        for ( uint8_t copy = 0; copy < SIM_SCENE_COPIES; copy++ ) {
+          if ( nextRandom( 0, 999 ) >= SIM_LOSS_PER_MILLE ) {
+            scene.arrival = now + copy * SIM_SCENE_COPY_SPACING + latency( index, SIM_MIN_DOWNLINK, SIM_MAX_DOWNLINK );
+            nodes[ index ].deliveries.push_back( scene );
+          }
+        }
+        nodes[ index ].sceneStartedAt = 0;
+        nodes[ index ].sceneReceivedAt = 0;
+        unsynchronizedScenes += nodes[ index ].clock.isSynchronized( (unsigned long)nodes[ index ].local ) ? 0 : 1;
+      }
+      sceneSentAt = now;
+      sceneRunning = true;
+      nextSceneAt = now + nextRandom( SIM_MIN_SCENE_INTERVAL, SIM_MAX_SCENE_INTERVAL );
+    }
+
+    for ( uint8_t index = 0; index < SIM_NODES; index++ ) {
+      Node &node = nodes[ index ];
+      if ( now < node.bootAt ) {
+        continue;
+      }
+      if ( now % 1000 == 0 ) {
+        node.ppm += SIM_WANDER * sin( now / 3600000.0 + node.wanderPhase ) / 3600.0; // Over an hour it wanders SIM_WANDER ppm
+      }
+      node.local += 1 + node.ppm / 1e6;
+      if ( now >= node.blockedUntil ) {
+        runNode( index, now );
+      }
+    }
+
+    if ( sceneRunning && now - sceneSentAt == 5000 ) {
+      // All nodes have started, collect the skews
+      sceneRunning = false;
+      scenes++;
+      unsigned long first = 0xFFFFFFFF, last = 0, firstReceived = 0xFFFFFFFF, lastReceived = 0;
+      for ( uint8_t index = 0; index < SIM_NODES; index++ ) {
+        if ( nodes[ index ].sceneStartedAt == 0 ) {
+          continue; // All copies got lost
+        }
+        first = std::min( first, nodes[ index ].sceneStartedAt );
+        last = std::max( last, nodes[ index ].sceneStartedAt );
+        firstReceived = std::min( firstReceived, nodes[ index ].sceneReceivedAt );
+        lastReceived = std::max( lastReceived, nodes[ index ].sceneReceivedAt );
+      }
+      synchronizedSkews.push_back( last - first );
+      receptionSkews.push_back( lastReceived - firstReceived );
+
+      // A message per node, each with its own latency and the chance that the node is blocked
+      unsigned long commandFirst = 0xFFFFFFFF, commandLast = 0;
+      for ( uint8_t index = 0; index < SIM_NODES; index++ ) {
+        unsigned long startedAt = index * SIM_COMMAND_SPACING + latency( index, SIM_MIN_DOWNLINK, SIM_MAX_DOWNLINK ) +
+                                  ( nextRandom( 0, 999 ) < 20 ? nextRandom( 2, SIM_MAX_BLOCKED ) : 0 );
+        while ( nextRandom( 0, 999 ) < SIM_LOSS_PER_MILLE ) {
+          startedAt += SIM_COMMAND_SPACING;
+        }
+        commandFirst = std::min( commandFirst, startedAt );
+        commandLast = std::max( commandLast, startedAt );
+      }
+      commandSkews.push_back( commandLast - commandFirst );
+    }
+  }
+
+  printf( "Scene start skew of %u nodes, %u hours, %lu scenes (%lu node starts before the clock was synchronized)\n",
+          SIM_NODES, SIM_HOURS, scenes, unsynchronizedScenes );
+  printf( "Nodes: drift up to %u ppm, uplink %u - %u ms, downlink %u - %u ms, %u nodes %u - %u ms more, %.1f%% of the requests lost\n",
+          SIM_MAX_DRIFT, SIM_MIN_UPLINK, SIM_MAX_UPLINK, SIM_MIN_DOWNLINK, SIM_MAX_DOWNLINK, SIM_REPEATED_NODES,
+          SIM_MIN_HOP, SIM_MAX_HOP, SIM_LOSS_PER_MILLE / 10.0 );
+  printf( "  %-36s %6s %6s %6s\n", "", "p50", "p99", "max" );
+  unsigned long skew = reportSkews( "broadcast, synchronized start", synchronizedSkews );
+  reportSkews( "broadcast, start on reception", receptionSkews );
+  reportSkews( "message per node", commandSkews );
+  reportSkews( "synchronized start - controller time", startErrors );
+
+  printf( "  %-4s %9s %14s %13s %16s\n", "node", "drift", "measured drift", "synchronized", "requests/hour" );
+  for ( uint8_t index = 0; index < SIM_NODES; index++ ) {
+    Node &node = nodes[ index ];
+    printf( "  %-4u %5.0f ppm %10ld ppm %11.1f s %16.1f\n", index, -node.ppm, (long)node.clock.getDrift(),
+            ( node.synchronizedAt - node.bootAt ) / 1000.0, node.requests / (double)SIM_HOURS );
+  }
+
+  if ( skew > SIM_MAX_SKEW ) {
+    printf( "FAILED: the p99 skew of the synchronized scenes exceeds %u ms\n", SIM_MAX_SKEW );
+    return 1;
+  }
+  return 0;
+}
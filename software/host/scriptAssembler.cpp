@@ -0,0 +1,253 @@
+/*
+  Assembler for the animation scripts of the FairyLightLamp (see FairyLightLamp/animationScript.h).
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  Translates a script in text to the bytecode of the interpreter and prints it as a C++ initializer (for a built-in
+  script) and as the MySensors messages that upload it to a node:
+
+    ./build/fairylight_asm breathe.txt
+
+  A line contains an optional label, an instruction and an optional comment after a ';'. Operands are separated by
+  commas, a register is written as R0 - R3 and a jump address as a label. For example:
+
+    loop:  RAND  R0, 90, 200   ; a random level
+           FADE  R0, 100
+           HOLD  50
+           JUMP  loop
+
+  Revision history:
+    16-10-2026 Initial version.
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "animationScript.h"
+
+const uint8_t CHILD_ID_SCRIPT = 11;  // See config.h
+const uint8_t UPLOAD_CHUNK_SIZE = 11; // Bytes per V_TEXT message: 2 + 22 hex digits fit in the 25 bytes of a payload
+
+struct Mnemonic {
+  const char *name;
+  uint8_t     opcode;
+  bool        hasRegister; // The first operand is the register that is written (SET, RAND, ADD, DJNZ)
+  bool        hasAddress;  // The last operand is a jump address (DJNZ, JUMP)
+};
+
+const Mnemonic mnemonics[] = {
+  { "END", SCRIPT_END, false, false },   { "LEVEL", SCRIPT_LEVEL, false, false }, { "FADE", SCRIPT_FADE, false, false },
+  { "HOLD", SCRIPT_HOLD, false, false }, { "BLINK", SCRIPT_BLINK, false, false }, { "SET", SCRIPT_SET, true, false },
+  { "RAND", SCRIPT_RAND, true, false },  { "ADD", SCRIPT_ADD, true, false },      { "DJNZ", SCRIPT_DJNZ, true, true },
+  { "JUMP", SCRIPT_JUMP, false, true }
+};
+
+struct Line {
+  int                      number;
+  const Mnemonic          *mnemonic;
+  std::vector<std::string> operands;
+};
+
+/*
+  Prints an error for the given line and stops.
+*/
+void fail( int lineNumber, const std::string &message ) {
+  fprintf( stderr, "line %d: %s\n", lineNumber, message.c_str() );
+  exit( 1 );
+}
+
+std::string trim( const std::string &text ) {
+  size_t start = text.find_first_not_of( " \t\r\n" );
+  size_t end = text.find_last_not_of( " \t\r\n" );
+  return start == std::string::npos ? "" : text.substr( start, end - start + 1 );
+}
+
+std::string upper( std::string text ) {
+  for ( size_t index = 0; index < text.size(); index++ ) {
+    text[ index ] = toupper( text[ index ] );
+  }
+  return text;
+}
+
+/*
+  Returns the register number of the given operand, or -1 when it isn't a register.
+*/
+int parseRegister( const std::string &operand ) {
+  std::string name = upper( operand );
+  if ( name.size() == 2 && name[ 0 ] == 'R' && name[ 1 ] >= '0' && name[ 1 ] < '0' + SCRIPT_REGISTERS ) {
+    return name[ 1 ] - '0';
+  }
+  return -1;
+}
+
+/*
+  Returns the value of the given number operand (decimal or 0x hex, negative values wrap around).
+*/
+long parseNumber( int lineNumber, const std::string &operand ) {
+  char *end;
+  long value = strtol( operand.c_str(), &end, 0 );
+  if ( operand.empty() || *end != '\0' ) {
+    fail( lineNumber, "'" + operand + "' isn't a number or register" );
+  }
+  return value;
+}
+
+/*
+  Returns the size in bytes of the given instruction.
+*/
+uint8_t instructionSize( const Line &line ) {
+  uint8_t size = 1;
+  uint8_t opcode = line.mnemonic->opcode;
+  size_t  operand = 0;
+
+  if ( line.mnemonic->hasRegister ) {
+    size++;
+    operand++;
+  }
+  for ( uint8_t value = 0; value < scriptValueOperands( opcode ); value++, operand++ ) {
+    if ( operand < line.operands.size() && parseRegister( line.operands[ operand ] ) >= 0 ) {
+      size++;
+    }
+    else {
+      size += scriptValueIsWide( opcode, value ) ? 2 : 1;
+    }
+  }
+  if ( line.mnemonic->hasAddress ) {
+    size++;
+  }
+  return size;
+}
+
+int main( int argc, char **argv ) {
+  FILE *input = argc > 1 ? fopen( argv[ 1 ], "r" ) : stdin;
+  if ( input == NULL ) {
+    fprintf( stderr, "Can't open %s\n", argv[ 1 ] );
+    return 1;
+  }
+
+  // Pass 1: parse the lines and determine the address of each label
+  std::vector<Line> lines;
+  std::map<std::string, int> labels;
+  int address = 0;
+  int lineNumber = 0;
+  char buffer[ 256 ];
+  while ( fgets( buffer, sizeof( buffer ), input ) != NULL ) {
+    lineNumber++;
+    std::string text = buffer;
+    text = trim( text.substr( 0, text.find( ';' ) ) );
+
+    size_t colon = text.find( ':' );
+    if ( colon != std::string::npos ) {
+      std::string label = upper( trim( text.substr( 0, colon ) ) );
+      if ( labels.count( label ) ) {
+        fail( lineNumber, "label " + label + " is defined twice" );
+      }
+      labels[ label ] = address;
+      text = trim( text.substr( colon + 1 ) );
+    }
+    if ( text.empty() ) {
+      continue;
+    }
+
+    Line line;
+    line.number = lineNumber;
+    line.mnemonic = NULL;
+    size_t space = text.find_first_of( " \t" );
+    std::string name = upper( text.substr( 0, space ) );
+    for ( const Mnemonic &mnemonic : mnemonics ) {
+      if ( name == mnemonic.name ) {
+        line.mnemonic = &mnemonic;
+      }
+    }
+    if ( line.mnemonic == NULL ) {
+      fail( lineNumber, "unknown instruction " + name );
+    }
+
+    std::string operands = space == std::string::npos ? "" : text.substr( space );
+    size_t start = 0;
+    while ( !trim( operands ).empty() && start <= operands.size() ) {
+      size_t comma = operands.find( ',', start );
+      line.operands.push_back( trim( operands.substr( start, comma == std::string::npos ? std::string::npos : comma - start ) ) );
+      if ( comma == std::string::npos ) {
+        break;
+      }
+      start = comma + 1;
+    }
+
+    size_t expected = ( line.mnemonic->hasRegister ? 1 : 0 ) + scriptValueOperands( line.mnemonic->opcode ) + ( line.mnemonic->hasAddress ? 1 : 0 );
+    if ( line.operands.size() != expected ) {
+      fail( lineNumber, name + " expects " + std::to_string( expected ) + " operand(s)" );
+    }
+
+    address += instructionSize( line );
+    lines.push_back( line );
+  }
+  if ( address > EEPROM_SCRIPT_SIZE - 1 ) {
+    fprintf( stderr, "The script is %d bytes, the EEPROM holds %d bytes\n", address, EEPROM_SCRIPT_SIZE - 1 );
+    return 1;
+  }
+
+  // Pass 2: generate the bytecode
+  std::vector<uint8_t> code;
+  for ( const Line &line : lines ) {
+    uint8_t opcode = line.mnemonic->opcode;
+    size_t  operand = 0;
+    std::vector<uint8_t> operands;
+
+    if ( line.mnemonic->hasRegister ) {
+      int registerNumber = parseRegister( line.operands[ operand++ ] );
+      if ( registerNumber < 0 ) {
+        fail( line.number, "the first operand must be a register" );
+      }
+      operands.push_back( registerNumber );
+    }
+    for ( uint8_t value = 0; value < scriptValueOperands( line.mnemonic->opcode ); value++, operand++ ) {
+      int registerNumber = parseRegister( line.operands[ operand ] );
+      if ( registerNumber >= 0 ) {
+        opcode |= value == 0 ? SCRIPT_REGISTER_1 : SCRIPT_REGISTER_2;
+        operands.push_back( registerNumber );
+      }
+      else {
+        long number = parseNumber( line.number, line.operands[ operand ] );
+        bool wide = scriptValueIsWide( line.mnemonic->opcode, value );
+        if ( number < ( wide ? -32768 : 0 ) || number > ( wide ? 65535 : 255 ) ) {
+          fail( line.number, line.operands[ operand ] + " is out of range" );
+        }
+        operands.push_back( (uint8_t)( number & 0xFF ) );
+        if ( wide ) {
+          operands.push_back( (uint8_t)( ( number >> 8 ) & 0xFF ) );
+        }
+      }
+    }
+    if ( line.mnemonic->hasAddress ) {
+      std::string label = upper( line.operands[ operand ] );
+      if ( !labels.count( label ) ) {
+        fail( line.number, "unknown label " + line.operands[ operand ] );
+      }
+      operands.push_back( labels[ label ] );
+    }
+
+    code.push_back( opcode );
+    code.insert( code.end(), operands.begin(), operands.end() );
+  }
+
+  printf( "// %u bytes\n{", (unsigned)code.size() );
+  for ( size_t index = 0; index < code.size(); index++ ) {
+    printf( "%s0x%02X", index == 0 ? " " : ", ", code[ index ] );
+  }
+  printf( " }\n\nMySensors upload (child %u):\n", CHILD_ID_SCRIPT );
+  for ( size_t offset = 0; offset < code.size(); offset += UPLOAD_CHUNK_SIZE ) {
+    printf( "  V_TEXT %02X", (unsigned)offset );
+    for ( size_t index = offset; index < code.size() && index < offset + UPLOAD_CHUNK_SIZE; index++ ) {
+      printf( "%02X", code[ index ] );
+    }
+    printf( "\n" );
+  }
+  printf( "  V_VAR1 %u\n", (unsigned)code.size() );
+  return 0;
+}
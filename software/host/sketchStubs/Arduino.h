@@ -0,0 +1,78 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/*
+  Host (Linux) stub of the parts of the Arduino core that the FairyLightLamp sketch uses directly.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  The libraries of the sketch talk to the hardware through hal.h, the sketch itself uses the Arduino core. This stub
+  maps the core onto the host implementation of the HAL (see hostHal.h), so the sketch can be compiled and run on the
+  host (see latencySimulator.cpp):
+  - millis() and micros() are the virtual clock.
+  - delay() and the idle sleep block the sketch. The time they block is handed to the wait handler of the simulation
+    (see hostSketchSetWaitHandler() in MySensors.h), which moves the clock and replays what happens in the mean time.
+  - Serial prints to stdout when hostSketchSetSerialOutput() enabled it, and never has input.
+  - the registers the sketch writes are plain variables.
+
+  Revision history:
+    16-10-2026 Initial version.
+    16-10-2026 F() texts.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "hal.h"
+
+#define min( a, b ) ( ( a ) < ( b ) ? ( a ) : ( b ) )
+#define max( a, b ) ( ( a ) > ( b ) ? ( a ) : ( b ) )
+#define constrain( amount, low, high ) ( ( amount ) < ( low ) ? ( low ) : ( ( amount ) > ( high ) ? ( high ) : ( amount ) ) )
+#define bitRead( value, bit ) ( ( ( value ) >> ( bit ) ) & 0x01 )
+#define bitSet( value, bit ) ( ( value ) |= ( 1UL << ( bit ) ) )
+#define bitClear( value, bit ) ( ( value ) &= ~( 1UL << ( bit ) ) )
+#define bitWrite( value, bit, bitValue ) ( ( bitValue ) ? bitSet( value, bit ) : bitClear( value, bit ) )
+
+extern uint8_t ADCSRA;
+
+// Texts in flash are plain texts on the host
+class __FlashStringHelper;
+#define F( text ) ( reinterpret_cast<const __FlashStringHelper *>( text ) )
+
+unsigned long millis();
+unsigned long micros();
+void          delay( unsigned long ms );
+void          pinMode( uint8_t pin, uint8_t mode );
+void          digitalWrite( uint8_t pin, uint8_t level );
+
+/*
+  The serial port: prints numbers like the Arduino core, never has input.
+*/
+class HostSerial {
+  public:
+    void print( const char *text );
+    void print( const __FlashStringHelper *text ) { this->print( reinterpret_cast<const char *>( text ) ); }
+    void print( char character );
+    void print( long value );
+    void print( unsigned long value );
+    void print( int value ) { this->print( (long)value ); }
+    void print( unsigned int value ) { this->print( (unsigned long)value ); }
+
+    template<typename T> void println( T value ) {
+      this->print( value );
+      this->println();
+    }
+    void println();
+
+    int available() { return 0; }
+    int read() { return -1; }
+
+    bool output = false; // Prints to stdout when true
+};
+
+extern HostSerial Serial;
+
+// Controls of the stub
+void hostSketchSetSerialOutput( bool enabled );
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef HOST_MYSENSORS_H
+#define HOST_MYSENSORS_H
+
+/*
+  Host (Linux) stub of the parts of MySensors that the FairyLightLamp sketch uses.
+
+  Author: By Theo
+  Created: October 16th 2026
+
+  There is no radio. Every message the sketch sends (send(), present(), request() ...) is handed to the send handler of
+  the simulation, which decides how long the send blocks and whether the message is delivered, like the radio with its
+  retries would. Until the simulation makes the transport ready, isTransportReady() returns false. Messages to the node are passed to receive() by the simulation, between two loop() calls like
+  MySensors does. The values of the types are the ones of MySensors, the payload is always stored as text.
+
+  Revision history:
+    16-10-2026 Initial version.
+*/
+
+#include <Arduino.h>
+
+#define MAX_PAYLOAD 25
+#define BROADCAST_ADDRESS 255
+
+// The node id of the simulated node
+const uint8_t HOST_SKETCH_NODE_ID = 21;
+
+// The sensor types (S_*) and value types (V_*) the sketch uses, with their MySensors values
+enum {
+  S_DIMMER = 4,
+  S_CUSTOM = 23,
+  S_SCENE_CONTROLLER = 25,
+  S_INFO = 36
+};
+
+enum {
+  V_LIGHT = 2,
+  V_DIMMER = 3,
+  V_SCENE_ON = 19,
+  V_VAR1 = 24,
+  V_VAR2 = 25,
+  V_VAR3 = 26,
+  V_VAR4 = 27,
+  V_VAR5 = 28,
+  V_TEXT = 47,
+  V_CUSTOM = 48
+};
+
+// The commands of the messages
+enum {
+  C_PRESENTATION = 0,
+  C_SET = 1,
+  C_REQ = 2,
+  C_INTERNAL = 3
+};
+
+// The internal messages (C_INTERNAL) the stub sends for the MySensors functions, type 255 is used for the presentations
+const uint8_t HOST_SKETCH_BATTERY_LEVEL = 0;
+const uint8_t HOST_SKETCH_TIME = 1;
+const uint8_t HOST_SKETCH_HEARTBEAT = 18;
+const uint8_t HOST_SKETCH_PRESENTATION = 255;
+
+/*
+  A message with the fields the sketch uses.
+*/
+class MyMessage {
+  public:
+    MyMessage( uint8_t sensor = 0, uint8_t type = 0 );
+
+    MyMessage &setSensor( uint8_t sensor );
+    MyMessage &setType( uint8_t type );
+    MyMessage &setDestination( uint8_t destination );
+    MyMessage &setEcho( bool echo );
+    MyMessage &set( int16_t value );
+    MyMessage &set( const char *value );
+
+    bool    isEcho() const;
+    uint8_t getCommand() const;
+    int16_t getInt() const;
+    char    *getString( char *buffer ) const;
+
+    uint8_t sender;
+    uint8_t destination;
+    uint8_t sensor;
+    uint8_t type;
+    uint8_t command;
+    bool    echo;
+    char    data[ MAX_PAYLOAD + 1 ];
+};
+
+// The MySensors functions used by the sketch
+bool    send( MyMessage &message, bool ack = false );
+bool    sendHeartbeat();
+bool    sendBatteryLevel( uint8_t level, bool ack = false );
+bool    sendSketchInfo( const char *name, const char *version );
+bool    present( uint8_t childSensorId, uint8_t sensorType );
+bool    request( uint8_t childSensorId, uint8_t variableType );
+bool    requestTime();
+uint8_t loadState( uint8_t position );
+void    saveState( uint8_t position, uint8_t value );
+uint8_t getNodeId();
+bool    isTransportReady();
+
+// The hooks of the sketch, called by the simulation
+void before();
+void presentation();
+void setup();
+void loop();
+void receive( const MyMessage &message );
+void receiveTime( uint32_t controllerTime );
+
+// Handles a message sent by the sketch: blocks for the time the send takes and returns true when the message was
+// delivered to the parent node.
+typedef bool (*hostSketchSendHandler)( const MyMessage &message, bool ack );
+
+// Moves the virtual clock the given amount of us forward while the sketch is blocked
+typedef void (*hostSketchWaitHandler)( unsigned long us );
+
+// Controls of the stub
+void hostSketchSetSendHandler( hostSketchSendHandler handler );
+void hostSketchSetWaitHandler( hostSketchWaitHandler handler );
+void hostSketchWait( unsigned long us );
+void hostSketchSetTransportReady( bool ready );
+
+// The ms MySensors waits for the transport before it calls setup() (MY_TRANSPORT_WAIT_READY_MS), 0 waits until the
+// transport is ready. The sketch includes this header after its MY_ defines, like it includes MySensors, so the sketch
+// defines it when config.h sets the wait. The stub has a weak definition of 0 for the other case.
+extern unsigned long hostSketchTransportWaitReady;
+#ifdef MY_TRANSPORT_WAIT_READY_MS
+unsigned long hostSketchTransportWaitReady = MY_TRANSPORT_WAIT_READY_MS;
+#endif
+
+#endif
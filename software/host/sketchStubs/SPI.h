@@ -0,0 +1,6 @@
+#ifndef HOST_SPI_H
+#define HOST_SPI_H
+
+// Host (Linux) stub of the SPI library, the radio is simulated by the MySensors stub (see MySensors.h).
+
+#endif
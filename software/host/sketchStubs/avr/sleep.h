@@ -0,0 +1,19 @@
+#ifndef HOST_AVR_SLEEP_H
+#define HOST_AVR_SLEEP_H
+
+/*
+  Host (Linux) stub of the sleep modes. The idle sleep lasts until the next interrupt, which is at the latest the 1ms
+  tick of millis(), so sleep_mode() waits until the next whole millisecond of the virtual clock.
+*/
+
+#include <stdint.h>
+
+#define SLEEP_MODE_IDLE 0
+
+inline void set_sleep_mode( uint8_t mode ) {
+  (void)mode;
+}
+
+void sleep_mode();
+
+#endif
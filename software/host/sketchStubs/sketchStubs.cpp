@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <MySensors.h>
+#include <avr/sleep.h>
+
+/*
+  Implementation of the Arduino core and MySensors stubs (see Arduino.h and MySensors.h).
+*/
+
+uint8_t    ADCSRA = 0;
+HostSerial Serial;
+
+static hostSketchSendHandler sendHandler = NULL;
+static hostSketchWaitHandler waitHandler = NULL;
+static uint8_t               userState[ 256 ]; // The EEPROM of loadState() and saveState(), erased
+static bool                  userStateErased = false;
+static bool                  transportReady = true;
+
+unsigned long hostSketchTransportWaitReady __attribute__ (( weak )) = 0;
+
+
+//                              Arduino core
+
+unsigned long millis() {
+  return halMillis();
+}
+
+unsigned long micros() {
+  return hostMicros();
+}
+
+/*
+  Blocks the sketch for the given amount of ms.
+*/
+void delay( unsigned long ms ) {
+  hostSketchWait( ms * 1000 );
+}
+
+/*
+  Pin modes and outputs aren't simulated, like halPinMode().
+*/
+void pinMode( uint8_t pin, uint8_t mode ) {
+  halPinMode( pin, mode );
+}
+
+void digitalWrite( uint8_t pin, uint8_t level ) {
+  (void)pin;
+  (void)level;
+}
+
+/*
+  Sleeps until the next whole millisecond, the tick of millis() that ends the idle sleep.
+*/
+void sleep_mode() {
+  hostSketchWait( 1000 - hostMicros() % 1000 );
+}
+
+void HostSerial::print( const char *text ) {
+  if ( this->output ) {
+    fputs( text, stdout );
+  }
+}
+
+void HostSerial::print( char character ) {
+  if ( this->output ) {
+    putchar( character );
+  }
+}
+
+void HostSerial::print( long value ) {
+  if ( this->output ) {
+    printf( "%ld", value );
+  }
+}
+
+void HostSerial::print( unsigned long value ) {
+  if ( this->output ) {
+    printf( "%lu", value );
+  }
+}
+
+void HostSerial::println() {
+  this->print( '\n' );
+}
+
+/*
+  Prints the output of the sketch on stdout when enabled is true.
+*/
+void hostSketchSetSerialOutput( bool enabled ) {
+  Serial.output = enabled;
+}
+
+
+//                              MyMessage
+
+MyMessage::MyMessage( uint8_t sensor, uint8_t type ) {
+  this->sender = HOST_SKETCH_NODE_ID;
+  this->destination = 0; // The gateway
+  this->sensor = sensor;
+  this->type = type;
+  this->command = C_SET;
+  this->echo = false;
+  this->data[ 0 ] = '\0';
+}
+
+MyMessage &MyMessage::setSensor( uint8_t sensor ) {
+  this->sensor = sensor;
+  return *this;
+}
+
+MyMessage &MyMessage::setType( uint8_t type ) {
+  this->type = type;
+  return *this;
+}
+
+MyMessage &MyMessage::setDestination( uint8_t destination ) {
+  this->destination = destination;
+  return *this;
+}
+
+MyMessage &MyMessage::setEcho( bool echo ) {
+  this->echo = echo;
+  return *this;
+}
+
+MyMessage &MyMessage::set( int16_t value ) {
+  snprintf( this->data, sizeof( this->data ), "%d", value );
+  return *this;
+}
+
+MyMessage &MyMessage::set( const char *value ) {
+  snprintf( this->data, sizeof( this->data ), "%s", value );
+  return *this;
+}
+
+bool MyMessage::isEcho() const {
+  return this->echo;
+}
+
+uint8_t MyMessage::getCommand() const {
+  return this->command;
+}
+
+int16_t MyMessage::getInt() const {
+  return atoi( this->data );
+}
+
+char *MyMessage::getString( char *buffer ) const {
+  strcpy( buffer, this->data );
+  return buffer;
+}
+
+
+//                              MySensors
+
+/*
+  Sends the given message through the send handler of the simulation. Without a handler every message is delivered
+  at once.
+*/
+bool send( MyMessage &message, bool ack ) {
+  return sendHandler == NULL || sendHandler( message, ack );
+}
+
+bool sendHeartbeat() {
+  MyMessage message( 255, HOST_SKETCH_HEARTBEAT );
+  message.command = C_INTERNAL;
+  return send( message );
+}
+
+bool sendBatteryLevel( uint8_t level, bool ack ) {
+  MyMessage message( 255, HOST_SKETCH_BATTERY_LEVEL );
+  message.command = C_INTERNAL;
+  return send( message.set( (int16_t)level ), ack );
+}
+
+bool sendSketchInfo( const char *name, const char *version ) {
+  MyMessage message( 255, HOST_SKETCH_PRESENTATION );
+  message.command = C_PRESENTATION;
+  return send( message.set( name ) ) && send( message.set( version ) );
+}
+
+bool present( uint8_t childSensorId, uint8_t sensorType ) {
+  MyMessage message( childSensorId, HOST_SKETCH_PRESENTATION );
+  message.command = C_PRESENTATION;
+  return send( message.set( (int16_t)sensorType ) );
+}
+
+bool request( uint8_t childSensorId, uint8_t variableType ) {
+  MyMessage message( childSensorId, variableType );
+  message.command = C_REQ;
+  return send( message );
+}
+
+bool requestTime() {
+  MyMessage message( 255, HOST_SKETCH_TIME );
+  message.command = C_INTERNAL;
+  return send( message );
+}
+
+/*
+  Returns the given byte of the user state, which starts erased (0xFF) like a new node.
+*/
+uint8_t loadState( uint8_t position ) {
+  if ( !userStateErased ) {
+    memset( userState, 0xFF, sizeof( userState ) );
+    userStateErased = true;
+  }
+  return userState[ position ];
+}
+
+void saveState( uint8_t position, uint8_t value ) {
+  loadState( position );
+  userState[ position ] = value;
+}
+
+uint8_t getNodeId() {
+  return HOST_SKETCH_NODE_ID;
+}
+
+bool isTransportReady() {
+  return transportReady;
+}
+
+
+//                              Simulation controls
+
+/*
+  Assigns the handler of the messages sent by the sketch, NULL to deliver them at once.
+*/
+void hostSketchSetSendHandler( hostSketchSendHandler handler ) {
+  sendHandler = handler;
+}
+
+/*
+  Assigns the handler that moves the clock while the sketch is blocked, NULL to just move the clock.
+*/
+void hostSketchSetWaitHandler( hostSketchWaitHandler handler ) {
+  waitHandler = handler;
+}
+
+/*
+  Blocks the sketch for the given amount of us, through the wait handler.
+*/
+void hostSketchWait( unsigned long us ) {
+  if ( waitHandler != NULL ) {
+    waitHandler( us );
+  }
+  else {
+    hostAdvanceMicros( us );
+  }
+}
+
+/*
+  Sets wether the transport is ready (the parent node has been found), it is by default.
+*/
+void hostSketchSetTransportReady( bool ready ) {
+  transportReady = ready;
+}